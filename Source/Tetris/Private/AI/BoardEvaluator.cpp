@@ -0,0 +1,185 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/BoardEvaluator.h"
+
+namespace
+{
+	/* The height of the walls on either side of the board, higher than any column.*/
+	constexpr int32 WallHeight = TNumericLimits<int32>::Max();
+
+	/* Get the number of changes between filled and empty cells along a row, with the walls counted as filled.*/
+	int32 GetRowTransitions(uint32 RowMask, int32 Width)
+	{
+		if (RowMask == 0) { return 0; }
+		const uint64 Walled = (uint64(RowMask) << 1) | 1u | (uint64(1) << (Width + 1));
+		return FMath::CountBits((Walled ^ (Walled >> 1)) & ((uint64(1) << (Width + 1)) - 1));
+	}
+
+	/* Get the depth of a column below the lower of its neighbors.*/
+	int32 GetWellDepth(int32 LeftHeight, int32 Height, int32 RightHeight)
+	{
+		const int32 NeighborHeight = FMath::Min(LeftHeight, RightHeight);
+		return NeighborHeight == WallHeight ? 0 : FMath::Max(NeighborHeight - Height, 0);
+	}
+
+	/* Measure the column features from the column heights.*/
+	void MeasureColumns(const int32* Heights, int32 Width, FBoardFeatures& Features)
+	{
+		Features.AggregateHeight = 0;
+		Features.Bumpiness = 0;
+		Features.Wells = 0;
+		for (int32 Col = 0; Col < Width; ++Col)
+		{
+			Features.AggregateHeight += Heights[Col];
+			Features.Bumpiness += Col + 1 < Width ? FMath::Abs(Heights[Col] - Heights[Col + 1]) : 0;
+			Features.Wells += GetWellDepth(Col > 0 ? Heights[Col - 1] : WallHeight, Heights[Col], Col + 1 < Width ? Heights[Col + 1] : WallHeight);
+		}
+		Features.Holes = Features.AggregateHeight - Features.FilledCells;
+	}
+
+	/**
+	 * Measure the features of the rows below TopRow, given by their masks. Full rows are counted as cleared and left out,
+	 * as if the rows above had collapsed onto the rows below.
+	 */
+	template<typename FGetRowMask>
+	FBoardFeatures MeasureRows(int32 Width, uint32 FullRowMask, int32 TopRow, FGetRowMask GetRowMask)
+	{
+		FBoardFeatures Features;
+		for (int32 Row = 0; Row < TopRow; ++Row)
+		{
+			Features.LinesCleared += GetRowMask(Row) == FullRowMask ? 1 : 0;
+		}
+
+		/* Walk down the rows so that each column's height is set by the first filled cell found in it.*/
+		int32 Heights[FBoardState::MaxWidth] = {};
+		uint32 SeenMask = 0;
+		uint32 AboveMask = 0;
+		int32 CollapsedRow = TopRow - Features.LinesCleared;
+		for (int32 Row = TopRow - 1; Row >= 0; --Row)
+		{
+			const uint32 RowMask = GetRowMask(Row);
+			if (RowMask == FullRowMask) { continue; }
+			--CollapsedRow;
+
+			Features.FilledCells += FMath::CountBits(RowMask);
+			Features.RowTransitions += GetRowTransitions(RowMask, Width);
+			Features.ColumnTransitions += FMath::CountBits(RowMask ^ AboveMask);
+			for (uint32 NewColumns = RowMask & ~SeenMask; NewColumns; NewColumns &= NewColumns - 1)
+			{
+				Heights[FMath::CountTrailingZeros(NewColumns)] = CollapsedRow + 1;
+			}
+			SeenMask |= RowMask;
+			AboveMask = RowMask;
+		}
+		Features.ColumnTransitions += FMath::CountBits(AboveMask ^ FullRowMask);
+
+		MeasureColumns(Heights, Width, Features);
+		return Features;
+	}
+}
+
+FBoardEvaluator::FBoardEvaluator(const FBoardEvaluationWeights& InWeights)
+	: Weights(InWeights)
+{}
+
+FBoardFeatures FBoardEvaluator::Measure(const FBoardState& Board)
+{
+	return MeasureRows(Board.GetWidth(), Board.GetFullRowMask(), Board.GetStackHeight(),
+		[&Board](int32 Row) { return Board.GetRowMask(Row); });
+}
+
+FBoardFeatures FBoardEvaluator::MeasurePlacement(const FBoardState& Board, const FBoardFeatures& BoardFeatures, const FPieceShape& Piece, const FIntPoint& Coordinate)
+{
+	const int32 Width = Board.GetWidth();
+	const uint32 FullRowMask = Board.GetFullRowMask();
+	const int32 FirstRow = Coordinate.Y + Piece.MinY;
+	const int32 LastRow = Coordinate.Y + Piece.MaxY;
+	const auto GetPlacedRowMask = [&Board, &Piece, &Coordinate, FirstRow, LastRow](int32 Row)
+	{
+		const uint32 RowMask = Row < Board.GetHeight() ? Board.GetRowMask(Row) : 0;
+		return Row >= FirstRow && Row <= LastRow ? RowMask | Piece.GetRowMask(Row - Coordinate.Y, Coordinate.X) : RowMask;
+	};
+
+	/* Filled rows shift the stack above them, so the rows that remain are scanned instead.*/
+	for (int32 Row = FirstRow; Row <= LastRow; ++Row)
+	{
+		if (GetPlacedRowMask(Row) == FullRowMask)
+		{
+			return MeasureRows(Width, FullRowMask, FMath::Max(Board.GetStackHeight(), LastRow + 1), GetPlacedRowMask);
+		}
+	}
+
+	/* Update the row features of the piece rows, and the column transitions up to the row above the piece.*/
+	FBoardFeatures Features = BoardFeatures;
+	Features.LinesCleared = 0;
+	uint32 OldBelowMask = FirstRow > 0 ? Board.GetRowMask(FirstRow - 1) : FullRowMask;
+	uint32 NewBelowMask = OldBelowMask;
+	for (int32 Row = FirstRow; Row <= LastRow + 1; ++Row)
+	{
+		const uint32 OldMask = Row < Board.GetHeight() ? Board.GetRowMask(Row) : 0;
+		const uint32 NewMask = GetPlacedRowMask(Row);
+		Features.FilledCells += FMath::CountBits(NewMask) - FMath::CountBits(OldMask);
+		Features.RowTransitions += GetRowTransitions(NewMask, Width) - GetRowTransitions(OldMask, Width);
+		Features.ColumnTransitions += FMath::CountBits(NewMask ^ NewBelowMask) - FMath::CountBits(OldMask ^ OldBelowMask);
+		OldBelowMask = OldMask;
+		NewBelowMask = NewMask;
+	}
+
+	/* Raise the columns the piece covers, keeping the new heights of two columns either side for the wells.*/
+	const TConstArrayView<int32> OldHeights = Board.GetColumnHeights();
+	const int32 FirstCol = Coordinate.X + Piece.MinX;
+	const int32 LastCol = Coordinate.X + Piece.MaxX;
+	constexpr int32 Margin = 2;
+	int32 NewHeights[FPieceShape::BoxSize + 2 * Margin];
+	const auto GetOldHeight = [&OldHeights, Width](int32 Col) { return Col >= 0 && Col < Width ? OldHeights[Col] : WallHeight; };
+	const auto GetNewHeight = [&NewHeights, FirstCol](int32 Col) { return NewHeights[Col - FirstCol + Margin]; };
+	for (int32 Col = FirstCol - Margin; Col <= LastCol + Margin; ++Col)
+	{
+		NewHeights[Col - FirstCol + Margin] = GetOldHeight(Col);
+	}
+	for (int32 PieceCol = Piece.MinX; PieceCol <= Piece.MaxX; ++PieceCol)
+	{
+		for (int32 PieceRow = Piece.MaxY; PieceRow >= Piece.MinY; --PieceRow)
+		{
+			if (!(Piece.RowMasks[PieceRow] & (1 << PieceCol))) { continue; }
+			int32& Height = NewHeights[PieceCol - Piece.MinX + Margin];
+			const int32 PieceHeight = Coordinate.Y + PieceRow + 1;
+			Features.AggregateHeight += FMath::Max(PieceHeight - Height, 0);
+			Height = FMath::Max(Height, PieceHeight);
+			break;
+		}
+	}
+	for (int32 Col = FMath::Max(FirstCol - 1, 0); Col <= FMath::Min(LastCol, Width - 2); ++Col)
+	{
+		Features.Bumpiness += FMath::Abs(GetNewHeight(Col) - GetNewHeight(Col + 1)) - FMath::Abs(GetOldHeight(Col) - GetOldHeight(Col + 1));
+	}
+	for (int32 Col = FMath::Max(FirstCol - 1, 0); Col <= FMath::Min(LastCol + 1, Width - 1); ++Col)
+	{
+		Features.Wells += GetWellDepth(GetNewHeight(Col - 1), GetNewHeight(Col), GetNewHeight(Col + 1))
+			- GetWellDepth(GetOldHeight(Col - 1), GetOldHeight(Col), GetOldHeight(Col + 1));
+	}
+	Features.Holes = Features.AggregateHeight - Features.FilledCells;
+	return Features;
+}
+
+float FBoardEvaluator::Score(const FBoardFeatures& Features) const
+{
+	return Weights.AggregateHeight * Features.AggregateHeight
+		+ Weights.Holes * Features.Holes
+		+ Weights.Bumpiness * Features.Bumpiness
+		+ Weights.Wells * Features.Wells
+		+ Weights.RowTransitions * Features.RowTransitions
+		+ Weights.ColumnTransitions * Features.ColumnTransitions
+		+ Weights.LinesCleared * Features.LinesCleared;
+}
+
+float FBoardEvaluator::ScorePlacement(const FBoardState& Board, const FBoardFeatures& BoardFeatures, const FPieceShape& Piece, const FIntPoint& Coordinate) const
+{
+	return Score(MeasurePlacement(Board, BoardFeatures, Piece, Coordinate));
+}
+
+const FBoardEvaluationWeights& FBoardEvaluator::GetWeights() const
+{
+	return Weights;
+}
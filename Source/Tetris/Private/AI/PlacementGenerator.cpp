@@ -0,0 +1,166 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/PlacementGenerator.h"
+
+namespace
+{
+	/* Return true if two shapes cover the same cells when their bounding boxes are aligned.*/
+	bool HasSameCells(const FPieceShape& A, const FPieceShape& B)
+	{
+		if (A.MaxX - A.MinX != B.MaxX - B.MinX || A.MaxY - A.MinY != B.MaxY - B.MinY) { return false; }
+		for (int32 Row = 0; Row <= A.MaxY - A.MinY; ++Row)
+		{
+			if ((A.RowMasks[A.MinY + Row] >> A.MinX) != (B.RowMasks[B.MinY + Row] >> B.MinX)) { return false; }
+		}
+		return true;
+	}
+}
+
+int32 FPlacementGenerator::Generate(const FBoardState& Board, const FPieceShape& Piece, const FIntPoint& Start)
+{
+	check(Board.CanPlace(Piece, Start));
+
+	/* Find the rotations that cover the same cells, so that their placements are only reported once.*/
+	const FPieceShape* FirstRotation = &Piece - Piece.Rotation;
+	for (int32 Rotation = 0; Rotation < FPieceShape::NumRotations; ++Rotation)
+	{
+		Rotations[Rotation] = FirstRotation + Rotation;
+		DistinctRotations[Rotation] = Rotation;
+		for (int32 Other = 0; Other < Rotation; ++Other)
+		{
+			if (HasSameCells(*Rotations[Other], *Rotations[Rotation]))
+			{
+				DistinctRotations[Rotation] = Other;
+				break;
+			}
+		}
+	}
+
+	/* Resetting keeps the buffers, so only the first search on a board of this size allocates.*/
+	NumRows = Board.GetHeight() + FPieceShape::BoxSize - 1;
+	Visited.Reset();
+	Visited.SetNumZeroed(FPieceShape::NumRotations * NumRows);
+	Placed.Reset();
+	Placed.SetNumZeroed(FPieceShape::NumRotations * NumRows);
+	Nodes.Reset();
+	Placements.Reset();
+	Actions.Reset();
+
+	/* Shift and rotate the piece at the start row first, so that every placement that can be hard dropped into is
+	 * reached from above, without a soft drop.*/
+	Visit(Board, Piece.Rotation, Start.X, Start.Y, INDEX_NONE, EAction::DOWN, 0);
+	for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+	{
+		Expand(Board, NodeIndex, false);
+	}
+
+	/* Then search every location reachable by dropping, to find the tucks and spins.*/
+	for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+	{
+		Expand(Board, NodeIndex, true);
+	}
+	return Placements.Num();
+}
+
+TConstArrayView<FPiecePlacement> FPlacementGenerator::GetPlacements() const
+{
+	return Placements;
+}
+
+TConstArrayView<EAction> FPlacementGenerator::GetPath(const FPiecePlacement& Placement) const
+{
+	return TConstArrayView<EAction>(Actions).Slice(Placement.FirstAction, Placement.NumActions);
+}
+
+int32 FPlacementGenerator::GetWordIndex(int32 Rotation, int32 Y) const
+{
+	const int32 Row = Y + FPieceShape::BoxSize - 1;
+	return Row >= 0 && Row < NumRows ? Rotation * NumRows + Row : INDEX_NONE;
+}
+
+uint64 FPlacementGenerator::GetColumnBit(int32 X)
+{
+	return uint64(1) << (X + FPieceShape::BoxSize - 1);
+}
+
+void FPlacementGenerator::Visit(const FBoardState& Board, int32 Rotation, int32 X, int32 Y, int32 Parent, EAction Action, int32 NumRepeats)
+{
+	if (X < 1 - FPieceShape::BoxSize || X >= Board.GetWidth()) { return; }
+	const int32 WordIndex = GetWordIndex(Rotation, Y);
+	if (WordIndex == INDEX_NONE) { return; }
+
+	/* Every location is tested against the board at most once.*/
+	const uint64 Bit = GetColumnBit(X);
+	if (Visited[WordIndex] & Bit) { return; }
+	Visited[WordIndex] |= Bit;
+	if (!Board.CanPlace(*Rotations[Rotation], { X, Y })) { return; }
+
+	Nodes.Add({ int16(X), int16(Y), uint8(Rotation), uint8(Action), uint16(NumRepeats), Parent });
+}
+
+void FPlacementGenerator::Expand(const FBoardState& Board, int32 NodeIndex, bool bAllowDrops)
+{
+	/* Copy the node, as visiting can grow the array.*/
+	const FNode Node = Nodes[NodeIndex];
+	Visit(Board, Node.Rotation, Node.X - 1, Node.Y, NodeIndex, EAction::LEFT, 1);
+	Visit(Board, Node.Rotation, Node.X + 1, Node.Y, NodeIndex, EAction::RIGHT, 1);
+	Visit(Board, (Node.Rotation + 1) % FPieceShape::NumRotations, Node.X, Node.Y, NodeIndex, EAction::ROTATE_R, 1);
+	Visit(Board, (Node.Rotation + FPieceShape::NumRotations - 1) % FPieceShape::NumRotations, Node.X, Node.Y, NodeIndex, EAction::ROTATE_L, 1);
+	if (!bAllowDrops) { return; }
+
+	/* A piece that can't move down locks here. Otherwise it can drop all the way, or one row to reach the rows in between.*/
+	const int32 DropRow = Board.GetDropRow(*Rotations[Node.Rotation], { Node.X, Node.Y });
+	if (DropRow == Node.Y)
+	{
+		AddPlacement(NodeIndex);
+		return;
+	}
+	Visit(Board, Node.Rotation, Node.X, DropRow, NodeIndex, EAction::DOWN, Node.Y - DropRow);
+	if (Node.Y - 1 > DropRow)
+	{
+		Visit(Board, Node.Rotation, Node.X, Node.Y - 1, NodeIndex, EAction::DOWN, 1);
+	}
+}
+
+void FPlacementGenerator::AddPlacement(int32 NodeIndex)
+{
+	/* Find the location of the distinct rotation that covers the same cells.*/
+	const FNode& Landing = Nodes[NodeIndex];
+	const FPieceShape& Piece = *Rotations[Landing.Rotation];
+	const int32 DistinctRotation = DistinctRotations[Landing.Rotation];
+	const FPieceShape& DistinctPiece = *Rotations[DistinctRotation];
+	const int32 DistinctX = Landing.X + Piece.MinX - DistinctPiece.MinX;
+	const int32 DistinctY = Landing.Y + Piece.MinY - DistinctPiece.MinY;
+	const int32 WordIndex = GetWordIndex(DistinctRotation, DistinctY);
+	const uint64 Bit = GetColumnBit(DistinctX);
+	if (Placed[WordIndex] & Bit) { return; }
+	Placed[WordIndex] |= Bit;
+
+	/* A final drop is replaced by the hard drop that locks the piece. Any other drop on the way is a soft drop.*/
+	const bool bEndsWithDrop = Landing.Parent != INDEX_NONE && Landing.Action == EAction::DOWN;
+	const int32 LastStep = bEndsWithDrop ? Landing.Parent : NodeIndex;
+	FPiecePlacement Placement;
+	Placement.Piece = &Piece;
+	Placement.Coordinate = { Landing.X, Landing.Y };
+	Placement.FirstAction = Actions.Num();
+	Placement.NumActions = 1;
+	for (int32 Step = LastStep; Nodes[Step].Parent != INDEX_NONE; Step = Nodes[Step].Parent)
+	{
+		Placement.NumActions += Nodes[Step].NumRepeats;
+		Placement.bNeedsSoftDrop |= Nodes[Step].Action == EAction::DOWN;
+	}
+
+	/* Write the path back to front while walking up to the start.*/
+	Actions.AddUninitialized(Placement.NumActions);
+	int32 ActionIndex = Placement.FirstAction + Placement.NumActions - 1;
+	Actions[ActionIndex] = EAction::HARD_DROP;
+	for (int32 Step = LastStep; Nodes[Step].Parent != INDEX_NONE; Step = Nodes[Step].Parent)
+	{
+		for (int32 Repeat = 0; Repeat < Nodes[Step].NumRepeats; ++Repeat)
+		{
+			Actions[--ActionIndex] = static_cast<EAction>(Nodes[Step].Action);
+		}
+	}
+	Placements.Add(Placement);
+}
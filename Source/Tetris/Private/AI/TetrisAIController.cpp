@@ -0,0 +1,203 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/TetrisAIController.h"
+#include "HAL/RunnableThread.h"
+#include "Core/TetrisStats.h"
+
+namespace
+{
+	/* Check if two locations of pieces of the same type cover the same cells, e.g. two rotations of O.*/
+	bool CoversSameCells(const FPieceShape& A, const FIntPoint& CoordinateA, const FPieceShape& B, const FIntPoint& CoordinateB)
+	{
+		if (A.Type != B.Type || A.MaxX - A.MinX != B.MaxX - B.MinX || A.MaxY - A.MinY != B.MaxY - B.MinY) { return false; }
+		if (CoordinateA.X + A.MinX != CoordinateB.X + B.MinX || CoordinateA.Y + A.MinY != CoordinateB.Y + B.MinY) { return false; }
+		for (int32 Row = 0; Row <= A.MaxY - A.MinY; ++Row)
+		{
+			if ((A.RowMasks[A.MinY + Row] >> A.MinX) != (B.RowMasks[B.MinY + Row] >> B.MinX)) { return false; }
+		}
+		return true;
+	}
+}
+
+FTetrisAIController::FTetrisAIController(const FBoardEvaluator& InEvaluator, const FTetrisSearchSettings& InSettings)
+	: Search(InEvaluator, InSettings)
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("TetrisAIController"), 0, TPri_BelowNormal);
+}
+
+FTetrisAIController::~FTetrisAIController()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+void FTetrisAIController::RequestPlan(const FTetrisSimulation& Game)
+{
+	Cancel();
+	if (Game.GetPhase() != ETetrisPhase::Falling || !Game.GetCurrentPiece()) { return; }
+
+	/* The copy is only read by the search, so it must not call back into anything observing the game.*/
+	FPlanRequest Request;
+	Request.Serial = ++LatestSerial;
+	Request.Game = Game;
+	Request.Game.SetObserver(nullptr);
+	PendingSerial = Request.Serial;
+
+	/* Without a thread, search straight away.*/
+	if (Thread)
+	{
+		Requests.Enqueue(MoveTemp(Request));
+		WakeEvent->Trigger();
+	}
+	else
+	{
+		Plan(Request);
+	}
+}
+
+void FTetrisAIController::Cancel()
+{
+	/* Stop the search in flight before anything newer is handed over, so the cancel can't land on the next search.*/
+	if (PendingSerial != 0)
+	{
+		++LatestSerial;
+		PendingSerial = 0;
+		Search.Cancel();
+	}
+}
+
+bool FTetrisAIController::ConsumePlan(const FTetrisSimulation& Game, TArray<EAction>& OutActions)
+{
+	TETRIS_SCOPE_CYCLE_COUNTER(AIHandoff);
+
+	/* Take the plan of the pending request. Plans arrive in request order, so anything before it is stale.*/
+	FTetrisAIPlan Plan;
+	bool bHasPlan = false;
+	while (!bHasPlan && Plans.Dequeue(Plan))
+	{
+		bHasPlan = Plan.Serial == PendingSerial && PendingSerial != 0;
+		if (!bHasPlan)
+		{
+			Discard();
+		}
+	}
+	if (!bHasPlan) { return false; }
+	PendingSerial = 0;
+
+	/* A plan for a board that has since changed is searched again.*/
+	const FPieceShape* Piece = Game.GetCurrentPiece();
+	if (Game.GetPhase() != ETetrisPhase::Falling || !Piece) { return false; }
+	if (!Plan.Result.Piece || Game.GetBoard().GetHash() != Plan.BoardHash || Piece->Type != Plan.StartPiece->Type)
+	{
+		Discard();
+		RequestPlan(Game);
+		return false;
+	}
+
+	/* If the piece moved while the plan was searched, find the path to the placement from where the piece is now.*/
+	const FIntPoint& Coordinate = Game.GetCurrentCoordinate();
+	if (Piece == Plan.StartPiece && Coordinate == Plan.StartCoordinate)
+	{
+		OutActions.Append(Plan.Result.Actions);
+	}
+	else
+	{
+		const FPiecePlacement* Path = nullptr;
+		Generator.Generate(Game.GetBoard(), *Piece, Coordinate);
+		for (const FPiecePlacement& Placement : Generator.GetPlacements())
+		{
+			if (CoversSameCells(*Placement.Piece, Placement.Coordinate, *Plan.Result.Piece, Plan.Result.Coordinate))
+			{
+				Path = &Placement;
+				break;
+			}
+		}
+		if (!Path)
+		{
+			Discard();
+			RequestPlan(Game);
+			return false;
+		}
+		OutActions.Append(Generator.GetPath(*Path).GetData(), Path->NumActions);
+	}
+	LastPlan = MoveTemp(Plan);
+	return true;
+}
+
+bool FTetrisAIController::IsPlanning() const
+{
+	return PendingSerial != 0;
+}
+
+const FTetrisAIPlan& FTetrisAIController::GetLastPlan() const
+{
+	return LastPlan;
+}
+
+int32 FTetrisAIController::GetNumDiscarded() const
+{
+	return NumDiscarded;
+}
+
+uint32 FTetrisAIController::Run()
+{
+	FPlanRequest Request;
+	while (!bStopping)
+	{
+		/* Only the latest request is worth searching.*/
+		bool bHasRequest = false;
+		while (Requests.Dequeue(Request))
+		{
+			bHasRequest = true;
+		}
+		if (bHasRequest && Request.Serial == LatestSerial)
+		{
+			Plan(Request);
+		}
+		else if (!bHasRequest)
+		{
+			WakeEvent->Wait();
+		}
+	}
+	return 0;
+}
+
+void FTetrisAIController::Stop()
+{
+	bStopping = true;
+	Search.Cancel();
+	WakeEvent->Trigger();
+}
+
+void FTetrisAIController::Plan(const FPlanRequest& Request)
+{
+	TETRIS_SCOPE_CYCLE_COUNTER(AISearch);
+	const FTetrisSimulation& Game = Request.Game;
+	FTetrisAIPlan Plan;
+	Plan.Serial = Request.Serial;
+	Plan.BoardHash = Game.GetBoard().GetHash();
+	Plan.StartPiece = Game.GetCurrentPiece();
+	Plan.StartCoordinate = Game.GetCurrentCoordinate();
+	const double Start = FPlatformTime::Seconds();
+	Search.Search(Game, Plan.Result);
+	Plan.SearchSeconds = FPlatformTime::Seconds() - Start;
+
+	/* A search cancelled part way is never handed back.*/
+	if (Request.Serial == LatestSerial)
+	{
+		Plans.Enqueue(MoveTemp(Plan));
+	}
+}
+
+void FTetrisAIController::Discard()
+{
+	INC_DWORD_STAT(STAT_TetrisAIPlansDiscarded);
+	++NumDiscarded;
+}
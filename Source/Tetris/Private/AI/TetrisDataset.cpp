@@ -0,0 +1,401 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/TetrisDataset.h"
+#include "Async/MappedFileHandle.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "Simulation/TetrisReplay.h"
+#include <atomic>
+
+static_assert(sizeof(FTetrisDatasetHeader) == 64, "Dataset header layout changed.");
+static_assert(sizeof(FTetrisPositionRecord) == 48, "Position record layout changed.");
+
+namespace
+{
+	/* Plays the games of one producer and writes their records.*/
+	class FDatasetProducer
+	{
+	public:
+		FDatasetProducer(const FTetrisDatasetSettings& InSettings, const FTetrisSimulationConfig& Config, int32 InNumPreviewPieces, int32 InRecordSize)
+			: Settings(InSettings)
+			, Evaluator(InSettings.Weights)
+			, NumPreviewPieces(InNumPreviewPieces)
+			, RecordSize(InRecordSize)
+		{
+			Game.Initialize(Config);
+			if (Settings.Policy == ETetrisDatasetPolicy::Search)
+			{
+				FTetrisSearchSettings SearchSettings = Settings.SearchSettings;
+				SearchSettings.NumTasks = 1;
+				Search = MakeUnique<FTetrisSearch>(Evaluator, SearchSettings);
+			}
+		}
+
+		/* Play a game and keep a record of every placement. Return the records.*/
+		TConstArrayView<uint8> PlayGame(int32 Seed)
+		{
+			Records.Reset();
+			Random.Initialize(Seed);
+			Game.Reset(Seed);
+			Game.Start();
+			int32 NumPieces = 0;
+			for (; NumPieces < Settings.MaxPiecesPerGame && Game.GetPhase() == ETetrisPhase::Falling; ++NumPieces)
+			{
+				if (!ChoosePlacement()) { break; }
+
+				/* Record the position, zeroed so that the padding of every file is the same.*/
+				const FBoardState& Board = Game.GetBoard();
+				const int32 Offset = Records.AddZeroed(RecordSize);
+				FTetrisPositionRecord& Record = *reinterpret_cast<FTetrisPositionRecord*>(&Records[Offset]);
+				Record.BoardHash = Board.GetHash();
+				Record.Seed = Seed;
+				Record.PieceIndex = NumPieces;
+				Record.Score = Game.GetScore();
+				Record.PieceType = Game.GetCurrentPiece()->Type;
+				Record.Rotation = ChosenPiece->Rotation;
+				Record.X = int8(ChosenCoordinate.X);
+				Record.Y = int8(ChosenCoordinate.Y);
+				const TConstArrayView<uint8> Preview = Game.GetSequence().PeekN(NumPreviewPieces);
+				FMemory::Memset(Record.Preview, MAX_uint8, sizeof(Record.Preview));
+				FMemory::Memcpy(Record.Preview, Preview.GetData(), Preview.Num());
+				uint32* Rows = reinterpret_cast<uint32*>(&Records[Offset + sizeof(FTetrisPositionRecord)]);
+				for (int32 Row = 0; Row < Board.GetHeight(); ++Row)
+				{
+					Rows[Row] = Board.GetRowMask(Row);
+				}
+
+				const int32 LinesBefore = Game.GetLinesCleared();
+				Game.ApplyActions(ChosenActions);
+				Record.LinesCleared = uint8(Game.GetLinesCleared() - LinesBefore);
+			}
+
+			/* Fill in how the game went on from each position.*/
+			for (int32 Offset = 0; Offset < Records.Num(); Offset += RecordSize)
+			{
+				FTetrisPositionRecord& Record = *reinterpret_cast<FTetrisPositionRecord*>(&Records[Offset]);
+				Record.ScoreToGo = Game.GetScore() - Record.Score;
+				Record.PiecesToGo = NumPieces - Record.PieceIndex;
+				Record.bGameOver = Game.IsGameOver() ? 1 : 0;
+			}
+			Game.ConsumeEvents();
+			return Records;
+		}
+
+	private:
+		const FTetrisDatasetSettings& Settings;
+		FBoardEvaluator Evaluator;
+		FPlacementGenerator Generator;
+		TUniquePtr<FTetrisSearch> Search;
+		FTetrisSearchResult SearchResult;
+		FTetrisSimulation Game;
+		FRandomStream Random;
+		int32 NumPreviewPieces;
+		int32 RecordSize;
+
+		/* The records of the game being played.*/
+		TArray<uint8> Records;
+
+		/* The placement chosen for the current piece, and the actions that play it.*/
+		const FPieceShape* ChosenPiece{ nullptr };
+		FIntPoint ChosenCoordinate{ 0, 0 };
+		TConstArrayView<EAction> ChosenActions;
+
+		/* Choose the placement of the current piece. Return false if it has none.*/
+		bool ChoosePlacement()
+		{
+			const FBoardState& Board = Game.GetBoard();
+			const int32 NumPlacements = Generator.Generate(Board, *Game.GetCurrentPiece(), Game.GetCurrentCoordinate());
+			if (NumPlacements == 0) { return false; }
+			const TConstArrayView<FPiecePlacement> Placements = Generator.GetPlacements();
+
+			/* The search finds its own paths.*/
+			const bool bRandom = Settings.Policy == ETetrisDatasetPolicy::Random || (Settings.RandomPlacementChance > 0.f && Random.FRand() < Settings.RandomPlacementChance);
+			if (!bRandom && Search && Search->Search(Game, SearchResult))
+			{
+				ChosenPiece = SearchResult.Piece;
+				ChosenCoordinate = SearchResult.Coordinate;
+				ChosenActions = SearchResult.Actions;
+				return true;
+			}
+
+			int32 Chosen = 0;
+			if (bRandom)
+			{
+				Chosen = Random.RandHelper(NumPlacements);
+			}
+			else
+			{
+				const FBoardFeatures Features = FBoardEvaluator::Measure(Board);
+				float BestScore = -MAX_flt;
+				for (int32 Index = 0; Index < NumPlacements; ++Index)
+				{
+					const float Score = Evaluator.ScorePlacement(Board, Features, *Placements[Index].Piece, Placements[Index].Coordinate);
+					if (Score > BestScore)
+					{
+						BestScore = Score;
+						Chosen = Index;
+					}
+				}
+			}
+			ChosenPiece = Placements[Chosen].Piece;
+			ChosenCoordinate = Placements[Chosen].Coordinate;
+			ChosenActions = Generator.GetPath(Placements[Chosen]);
+			return true;
+		}
+	};
+}
+
+FTetrisPositionView::FTetrisPositionView(const uint8* InData, int32 InNumRows)
+	: Data(InData)
+	, NumRows(InNumRows)
+{
+}
+
+const FTetrisPositionRecord& FTetrisPositionView::GetRecord() const
+{
+	return *reinterpret_cast<const FTetrisPositionRecord*>(Data);
+}
+
+TConstArrayView<uint32> FTetrisPositionView::GetRows() const
+{
+	return TConstArrayView<uint32>(reinterpret_cast<const uint32*>(Data + sizeof(FTetrisPositionRecord)), NumRows);
+}
+
+FTetrisDatasetWriter::~FTetrisDatasetWriter()
+{
+	Close();
+}
+
+int32 FTetrisDatasetWriter::GetRecordSize(int32 NumRows)
+{
+	return Align(int32(sizeof(FTetrisPositionRecord)) + NumRows * int32(sizeof(uint32)), 8);
+}
+
+bool FTetrisDatasetWriter::Open(const FString& InBaseFilename, const FTetrisDatasetHeader& InHeader, int32 InRecordsPerChunk)
+{
+	Close();
+	BaseFilename = InBaseFilename;
+	Header = InHeader;
+	RecordsPerChunk = FMath::Max(InRecordsPerChunk, 1);
+	NumRecords = 0;
+	Filenames.Reset();
+	return OpenChunk();
+}
+
+bool FTetrisDatasetWriter::Write(TConstArrayView<uint8> Records)
+{
+	if (!Archive) { return false; }
+
+	/* Split the records between files, starting the next file whenever one is full.*/
+	const int32 NumToWrite = Records.Num() / int32(Header.RecordSize);
+	for (int32 Written = 0; Written < NumToWrite;)
+	{
+		if (NumChunkRecords == RecordsPerChunk)
+		{
+			CloseChunk();
+			if (!OpenChunk()) { return false; }
+		}
+		const int32 NumInChunk = FMath::Min(NumToWrite - Written, RecordsPerChunk - NumChunkRecords);
+		Archive->Serialize(const_cast<uint8*>(Records.GetData()) + int64(Written) * Header.RecordSize, int64(NumInChunk) * Header.RecordSize);
+		Written += NumInChunk;
+		NumChunkRecords += NumInChunk;
+		NumRecords += NumInChunk;
+	}
+	return true;
+}
+
+void FTetrisDatasetWriter::Close()
+{
+	CloseChunk();
+}
+
+const TArray<FString>& FTetrisDatasetWriter::GetFilenames() const
+{
+	return Filenames;
+}
+
+int64 FTetrisDatasetWriter::GetNumRecords() const
+{
+	return NumRecords;
+}
+
+bool FTetrisDatasetWriter::OpenChunk()
+{
+	const FString Filename = FString::Printf(TEXT("%s-%04d.tetrisdata"), *BaseFilename, Filenames.Num());
+	Archive.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Archive)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not open %s for writing."), __FUNCTION__, *Filename);
+		return false;
+	}
+
+	/* The header is written again with the number of records when the file is finished.*/
+	Header.Chunk = Filenames.Num();
+	Header.NumRecords = FTetrisDatasetHeader::Unfinished;
+	Archive->Serialize(&Header, sizeof(Header));
+	Filenames.Add(Filename);
+	NumChunkRecords = 0;
+	return true;
+}
+
+void FTetrisDatasetWriter::CloseChunk()
+{
+	if (!Archive) { return; }
+	Header.NumRecords = NumChunkRecords;
+	Archive->Seek(0);
+	Archive->Serialize(&Header, sizeof(Header));
+	Archive->Close();
+	Archive.Reset();
+}
+
+FTetrisDatasetFile::FTetrisDatasetFile() = default;
+
+FTetrisDatasetFile::~FTetrisDatasetFile()
+{
+	Close();
+}
+
+bool FTetrisDatasetFile::Open(const FString& Filename)
+{
+	Close();
+	Handle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	if (Handle)
+	{
+		Region.Reset(Handle->MapRegion(0, Handle->GetFileSize()));
+	}
+	if (!Region)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not map %s."), __FUNCTION__, *Filename);
+		Close();
+		return false;
+	}
+
+	/* The layout of the records is checked once, so that they can be read without checks.*/
+	const int64 MappedSize = Region->GetMappedSize();
+	const FTetrisDatasetHeader& Header = GetHeader();
+	if (MappedSize < int64(sizeof(FTetrisDatasetHeader)) || Header.FileMagic != FTetrisDatasetHeader::Magic || Header.Version != FTetrisDatasetHeader::CurrentVersion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %s is not a version %d dataset."), __FUNCTION__, *Filename, FTetrisDatasetHeader::CurrentVersion);
+		Close();
+		return false;
+	}
+	if (Header.HeaderSize < sizeof(FTetrisDatasetHeader) || Header.HeaderSize % 8 != 0 || Header.RecordSize % 8 != 0
+		|| Header.RecordSize < sizeof(FTetrisPositionRecord) + Header.NumRows * sizeof(uint32))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %s has records of %d bytes for %d rows."), __FUNCTION__, *Filename, Header.RecordSize, Header.NumRows);
+		Close();
+		return false;
+	}
+
+	/* A file that was never finished holds every complete record written.*/
+	const int64 NumWritten = FMath::Max<int64>(MappedSize - Header.HeaderSize, 0) / Header.RecordSize;
+	NumRecords = Header.NumRecords == FTetrisDatasetHeader::Unfinished ? NumWritten : FMath::Min(Header.NumRecords, NumWritten);
+	return true;
+}
+
+void FTetrisDatasetFile::Close()
+{
+	Region.Reset();
+	Handle.Reset();
+	NumRecords = 0;
+}
+
+const FTetrisDatasetHeader& FTetrisDatasetFile::GetHeader() const
+{
+	check(Region);
+	return *reinterpret_cast<const FTetrisDatasetHeader*>(Region->GetMappedPtr());
+}
+
+int64 FTetrisDatasetFile::Num() const
+{
+	return NumRecords;
+}
+
+FTetrisPositionView FTetrisDatasetFile::Get(int64 Index) const
+{
+	check(Index >= 0 && Index < NumRecords);
+	const FTetrisDatasetHeader& Header = GetHeader();
+	return FTetrisPositionView(Region->GetMappedPtr() + Header.HeaderSize + Index * Header.RecordSize, Header.NumRows);
+}
+
+bool FTetrisDatasetGenerator::Generate(const FTetrisDatasetSettings& Settings, FTetrisDatasetResult& OutResult)
+{
+	OutResult = FTetrisDatasetResult();
+	if (Settings.OutputDirectory.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: No output directory was given."), __FUNCTION__);
+		return false;
+	}
+	const double Start = FPlatformTime::Seconds();
+
+	/* Placements are played as actions, so cleared rows must collapse before the next piece.*/
+	FTetrisSimulationConfig Config = Settings.Config;
+	Config.CollapseDelayTicks = 0;
+	const int32 NumGames = FMath::Max(Settings.NumGames, 0);
+	const int32 NumProducers = FMath::Clamp(Settings.NumProducers > 0 ? Settings.NumProducers : FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 1, FMath::Max(NumGames, 1));
+	const int32 NumPreviewPieces = FMath::Clamp(Settings.NumPreviewPieces, 0, FTetrisPositionRecord::MaxPreviewPieces);
+
+	FTetrisSimulation Standard;
+	Standard.Initialize(Config);
+	const int32 NumRows = Standard.GetBoard().GetHeight();
+	if (NumRows > FTetrisPositionRecord::MaxRows)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d rows exceeds the maximum of %d a record can locate."), __FUNCTION__, NumRows, FTetrisPositionRecord::MaxRows);
+		return false;
+	}
+	FTetrisDatasetHeader Header;
+	FMemory::Memzero(&Header, sizeof(Header));
+	Header.FileMagic = FTetrisDatasetHeader::Magic;
+	Header.Version = FTetrisDatasetHeader::CurrentVersion;
+	Header.HeaderSize = sizeof(FTetrisDatasetHeader);
+	Header.RecordSize = FTetrisDatasetWriter::GetRecordSize(NumRows);
+	Header.NumRows = uint16(NumRows);
+	Header.Width = uint8(Standard.GetBoard().GetWidth());
+	Header.NumPreviewPieces = uint8(NumPreviewPieces);
+	Header.ShapeTableCrc = FTetrisReplayReader::GetShapeTableCrc(Standard.GetShapeTable());
+	Header.Policy = uint8(Settings.Policy);
+
+	/* Producers claim games one at a time and only share the counter.*/
+	std::atomic<int32> NextGame{ 0 };
+	std::atomic<bool> bFailed{ false };
+	TArray<TUniquePtr<FTetrisDatasetWriter>> Writers;
+	Writers.SetNum(NumProducers);
+	TArray<int32> NumProducerGames;
+	NumProducerGames.SetNumZeroed(NumProducers);
+	ParallelFor(NumProducers, [&](int32 Producer)
+	{
+		Writers[Producer] = MakeUnique<FTetrisDatasetWriter>();
+		FTetrisDatasetWriter& Writer = *Writers[Producer];
+		FTetrisDatasetHeader ProducerHeader = Header;
+		ProducerHeader.Producer = Producer;
+		const FString BaseFilename = FPaths::Combine(Settings.OutputDirectory, FString::Printf(TEXT("%s-%03d"), *Settings.Name, Producer));
+		if (!Writer.Open(BaseFilename, ProducerHeader, Settings.RecordsPerChunk))
+		{
+			bFailed = true;
+			return;
+		}
+
+		FDatasetProducer Player(Settings, Config, NumPreviewPieces, Header.RecordSize);
+		for (int32 GameIndex = NextGame++; GameIndex < NumGames && !bFailed; GameIndex = NextGame++)
+		{
+			if (!Writer.Write(Player.PlayGame(Settings.FirstSeed + GameIndex)))
+			{
+				bFailed = true;
+			}
+			++NumProducerGames[Producer];
+		}
+		Writer.Close();
+	});
+
+	for (int32 Producer = 0; Producer < NumProducers; ++Producer)
+	{
+		OutResult.Filenames.Append(Writers[Producer]->GetFilenames());
+		OutResult.NumRecords += Writers[Producer]->GetNumRecords();
+		OutResult.NumGames += NumProducerGames[Producer];
+	}
+	OutResult.Seconds = FPlatformTime::Seconds() - Start;
+	return !bFailed;
+}
@@ -0,0 +1,65 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/TetrisDatasetCommandlet.h"
+#include "AI/BoardEvaluator.h"
+#include "AI/TetrisDataset.h"
+#include "Misc/Paths.h"
+
+UTetrisDatasetCommandlet::UTetrisDatasetCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UTetrisDatasetCommandlet::Main(const FString& Params)
+{
+	FTetrisDatasetSettings Settings;
+	Settings.OutputDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Datasets"));
+	FParse::Value(*Params, TEXT("Games="), Settings.NumGames);
+	FParse::Value(*Params, TEXT("Seed="), Settings.FirstSeed);
+	FParse::Value(*Params, TEXT("MaxPieces="), Settings.MaxPiecesPerGame);
+	FParse::Value(*Params, TEXT("RandomChance="), Settings.RandomPlacementChance);
+	FParse::Value(*Params, TEXT("Beam="), Settings.SearchSettings.BeamWidth);
+	FParse::Value(*Params, TEXT("SearchPreview="), Settings.SearchSettings.NumPreviewPieces);
+	FParse::Value(*Params, TEXT("ThinkTime="), Settings.SearchSettings.TimeBudgetSeconds);
+	FParse::Value(*Params, TEXT("Preview="), Settings.NumPreviewPieces);
+	FParse::Value(*Params, TEXT("ChunkSize="), Settings.RecordsPerChunk);
+	FParse::Value(*Params, TEXT("Producers="), Settings.NumProducers);
+	FParse::Value(*Params, TEXT("Output="), Settings.OutputDirectory);
+	FParse::Value(*Params, TEXT("Name="), Settings.Name);
+
+	FString Policy;
+	if (FParse::Value(*Params, TEXT("Policy="), Policy))
+	{
+		if (Policy == TEXT("Random")) { Settings.Policy = ETetrisDatasetPolicy::Random; }
+		else if (Policy == TEXT("Greedy")) { Settings.Policy = ETetrisDatasetPolicy::Greedy; }
+		else if (Policy == TEXT("Search")) { Settings.Policy = ETetrisDatasetPolicy::Search; }
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Error in %s: Unknown policy %s. Use Random, Greedy or Search."), __FUNCTION__, *Policy);
+			return 1;
+		}
+	}
+
+	FString WeightsPath;
+	if (FParse::Value(*Params, TEXT("Weights="), WeightsPath))
+	{
+		const UBoardEvaluatorWeights* Weights = LoadObject<UBoardEvaluatorWeights>(nullptr, *WeightsPath);
+		if (!Weights)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not load the weights %s."), __FUNCTION__, *WeightsPath);
+			return 1;
+		}
+		Settings.Weights = Weights->Weights;
+	}
+
+	FTetrisDatasetResult Result;
+	const bool bSucceeded = FTetrisDatasetGenerator::Generate(Settings, Result);
+	UE_LOG(LogTemp, Display, TEXT("Wrote %lld positions from %d games to %d files in %s in %.1f seconds: %.1f million positions per hour."),
+		Result.NumRecords, Result.NumGames, Result.Filenames.Num(), *Settings.OutputDirectory, Result.Seconds,
+		Result.Seconds > 0.0 ? Result.NumRecords / Result.Seconds * 3600.0 / 1e6 : 0.0);
+	return bSucceeded ? 0 : 1;
+}
@@ -0,0 +1,437 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/TetrisSearch.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	/* Get the transposition table key of the best placement of a piece type on a board.*/
+	uint64 GetTableKey(uint64 BoardHash, int32 Type)
+	{
+		return BoardHash ^ ((uint64(Type) + 1) * 0x9E3779B97F4A7C15ull);
+	}
+}
+
+FTetrisSearch::FTetrisSearch(const FBoardEvaluator& InEvaluator, const FTetrisSearchSettings& InSettings)
+	: Evaluator(InEvaluator)
+	, Settings(InSettings)
+{
+	Settings.BeamWidth = FMath::Max(Settings.BeamWidth, 1);
+	Settings.NumPreviewPieces = FMath::Clamp(Settings.NumPreviewPieces, 0, FPieceSequence::Capacity);
+	TranspositionTable.Initialize(Settings.TranspositionTableSize);
+}
+
+bool FTetrisSearch::Search(const FTetrisSimulation& Game, FTetrisSearchResult& OutResult)
+{
+	OutResult = FTetrisSearchResult();
+	const FPieceShape* CurrentPiece = Game.GetCurrentPiece();
+	if (Game.GetPhase() != ETetrisPhase::Falling || !CurrentPiece) { return false; }
+
+	Deadline = FPlatformTime::Seconds() + Settings.TimeBudgetSeconds;
+	bTimedOut = false;
+	const FBoardState& Board = Game.GetBoard();
+	Shapes = Game.GetShapeTable();
+	SpawnCoordinate = Game.GetSpawnCoordinate();
+	NumRows = Board.GetHeight();
+	MaxStackHeight = Game.GetConfig().Height;
+	PrepareTasks(Board);
+	TranspositionTable.NewGeneration();
+	NumTranspositions = 0;
+	NumBoundedSkipped = 0;
+
+	/* Score every placement of the current piece. The best is the answer if there's no time to look further.*/
+	FSearchTask& RootTask = *Tasks[0];
+	RootTask.Board = Board;
+	RootTask.Board.Commit();
+	const FBoardFeatures Features = FBoardEvaluator::Measure(Board);
+	RootGenerator.Generate(Board, *CurrentPiece, Game.GetCurrentCoordinate());
+	const TConstArrayView<FPiecePlacement> RootPlacements = RootGenerator.GetPlacements();
+	Beam.Reset();
+	for (int32 Index = 0; Index < RootPlacements.Num(); ++Index)
+	{
+		const FPiecePlacement& Placement = RootPlacements[Index];
+		const FBoardFeatures Placed = FBoardEvaluator::MeasurePlacement(Board, Features, *Placement.Piece, Placement.Coordinate);
+		Beam.Add({ Placement.Piece, Placement.Coordinate, 0, Index, Index, Evaluator.GetWeights().LinesCleared * Placed.LinesCleared, Evaluator.Score(Placed),
+			GetLockedHash(RootTask, Placement, Placed.LinesCleared) });
+	}
+	if (Beam.IsEmpty()) { return false; }
+	TrimBeam(Beam);
+	int32 BestRootMove = Beam[0].RootMove;
+	OutResult.Value = Beam[0].Value;
+	OutResult.Depth = 1;
+
+	/* The beam is placed on the searched board.*/
+	ParentRows.SetNumUninitialized(NumRows);
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		ParentRows[Row] = Board.GetRowMask(Row);
+	}
+
+	/* Search one preview piece at a time, keeping the answer of the deepest depth completed.*/
+	const TConstArrayView<uint8> Preview = Game.GetSequence().PeekN(Settings.NumPreviewPieces);
+	bool bCompleted = true;
+	for (const uint8 Type : Preview)
+	{
+		if (!ExpandBeam(Type))
+		{
+			bCompleted = false;
+			break;
+		}
+		BestRootMove = Beam[0].RootMove;
+		OutResult.Value = Beam[0].Value;
+		++OutResult.Depth;
+	}
+
+	/* Then value the boards left by the piece after the preview, which could be any piece left in its bag.*/
+	if (bCompleted && Settings.bExpectNextPiece)
+	{
+		float Chances[FPieceSequence::MaxBagSize] = {};
+		const int32 NumPieces = FMath::Min(Shapes.Num() / FPieceShape::NumRotations, FPieceSequence::MaxBagSize);
+		GetPieceChances(Game.GetSequence(), Preview.Num(), MakeArrayView(Chances, NumPieces));
+		if (ExpectBeam(MakeArrayView(Chances, NumPieces)))
+		{
+			BestRootMove = Beam[0].RootMove;
+			OutResult.Value = Beam[0].Value;
+			++OutResult.Depth;
+		}
+	}
+
+	const FPiecePlacement& Best = RootPlacements[BestRootMove];
+	OutResult.Piece = Best.Piece;
+	OutResult.Coordinate = Best.Coordinate;
+	OutResult.Actions.Append(RootGenerator.GetPath(Best).GetData(), Best.NumActions);
+	OutResult.bTimedOut = bTimedOut;
+	OutResult.NumTranspositions = NumTranspositions;
+	OutResult.NumSkipped = NumBoundedSkipped;
+	for (const TUniquePtr<FSearchTask>& Task : Tasks)
+	{
+		OutResult.NumExpanded += Task->NumExpanded;
+		OutResult.NumTableHits += Task->NumTableHits;
+	}
+	return true;
+}
+
+void FTetrisSearch::Cancel()
+{
+	/* Running out of time already stops every task at its next board.*/
+	bTimedOut = true;
+}
+
+void FTetrisSearch::GetPieceChances(const FPieceSequence& Sequence, int32 Index, TArrayView<float> OutChances)
+{
+	for (float& Chance : OutChances)
+	{
+		Chance = 0.f;
+	}
+
+	/* The sequence is refilled one whole bag at a time, so its first pieces finish the current bag and the rest are whole
+	 * bags. A piece beyond the sequence is drawn from a new bag of every piece.*/
+	const int32 BagSize = Sequence.GetBagSize();
+	const TConstArrayView<uint8> Queue = Sequence.PeekN(FPieceSequence::Capacity);
+	if (BagSize <= 0 || Index >= Queue.Num())
+	{
+		const int32 NumPieces = FMath::Min(BagSize > 0 ? BagSize : OutChances.Num(), OutChances.Num());
+		for (int32 Type = 0; Type < NumPieces; ++Type)
+		{
+			OutChances[Type] = 1.f / NumPieces;
+		}
+		return;
+	}
+
+	/* Otherwise it is one of the pieces of its bag that haven't been drawn or shown by then, in any order.*/
+	const int32 FirstBagEnd = Queue.Num() % BagSize;
+	const int32 BagEnd = Index < FirstBagEnd ? FirstBagEnd : FirstBagEnd + ((Index - FirstBagEnd) / BagSize + 1) * BagSize;
+	const float Chance = 1.f / (BagEnd - Index);
+	for (int32 QueueIndex = Index; QueueIndex < BagEnd; ++QueueIndex)
+	{
+		if (Queue[QueueIndex] < OutChances.Num())
+		{
+			OutChances[Queue[QueueIndex]] += Chance;
+		}
+	}
+}
+
+const FTetrisSearchSettings& FTetrisSearch::GetSettings() const
+{
+	return Settings;
+}
+
+void FTetrisSearch::PrepareTasks(const FBoardState& Board)
+{
+	const int32 NumTasks = Settings.NumTasks > 0 ? Settings.NumTasks : FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	while (Tasks.Num() < NumTasks)
+	{
+		Tasks.Add(MakeUnique<FSearchTask>());
+	}
+	Tasks.SetNum(NumTasks);
+	for (const TUniquePtr<FSearchTask>& Task : Tasks)
+	{
+		if (Task->Board.GetWidth() != Board.GetWidth() || Task->Board.GetHeight() != Board.GetHeight())
+		{
+			Task->Board.Initialize(Board.GetWidth(), Board.GetHeight());
+		}
+		Task->NumExpanded = 0;
+		Task->NumTableHits = 0;
+	}
+}
+
+void FTetrisSearch::RunTasks(TConstArrayView<int32> Nodes, TFunctionRef<void(FSearchTask&, int32)> Body)
+{
+	/* Tasks take the next board as they finish one, as boards near the top of the board take longer to expand.*/
+	std::atomic<int32> NextNode{ 0 };
+	ParallelFor(FMath::Min(Tasks.Num(), Nodes.Num()), [this, Nodes, &Body, &NextNode](int32 TaskIndex)
+	{
+		FSearchTask& Task = *Tasks[TaskIndex];
+		for (int32 Index = NextNode++; Index < Nodes.Num(); Index = NextNode++)
+		{
+			if (bTimedOut.load(std::memory_order_relaxed) || FPlatformTime::Seconds() > Deadline)
+			{
+				bTimedOut = true;
+				return;
+			}
+			Body(Task, Nodes[Index]);
+			++Task.NumExpanded;
+		}
+	});
+}
+
+uint64 FTetrisSearch::GetLockedHash(FSearchTask& Task, const FPiecePlacement& Placement, int32 LinesCleared)
+{
+	FBoardState& Board = Task.Board;
+	if (LinesCleared == 0)
+	{
+		return Board.GetHash() ^ FBoardState::GetPieceKey(*Placement.Piece, Placement.Coordinate);
+	}
+
+	Board.PushUndoLevel();
+	Board.Place(*Placement.Piece, Placement.Coordinate);
+	Task.ClearedRows.Reset();
+	Board.ClearRows(Task.ClearedRows, Placement.Coordinate.Y + Placement.Piece->MinY, Placement.Coordinate.Y + Placement.Piece->MaxY);
+	Board.Collapse();
+	const uint64 Hash = Board.GetHash();
+	Board.PopUndoLevel();
+	return Hash;
+}
+
+bool FTetrisSearch::LoadNode(FSearchTask& Task, int32 NodeIndex)
+{
+	/* Copy the parent's rows onto the task's board, skipping the rows that already match.*/
+	const FSearchNode& Node = Beam[NodeIndex];
+	FBoardState& Board = Task.Board;
+	const uint32* Rows = &ParentRows[Node.Parent * NumRows];
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		if (Board.GetRowMask(Row) != Rows[Row])
+		{
+			Board.SetRowMask(Row, Rows[Row]);
+		}
+	}
+
+	/* Lock the piece as the simulation would.*/
+	Board.Place(*Node.Piece, Node.Coordinate);
+	Task.ClearedRows.Reset();
+	if (Board.ClearRows(Task.ClearedRows, Node.Coordinate.Y + Node.Piece->MinY, Node.Coordinate.Y + Node.Piece->MaxY))
+	{
+		Board.Collapse();
+	}
+	Board.Commit();
+
+	uint32* NodeRow = &NodeRows[NodeIndex * NumRows];
+	for (int32 Row = 0; Row < NumRows; ++Row)
+	{
+		NodeRow[Row] = Board.GetRowMask(Row);
+	}
+	return Board.GetStackHeight() <= MaxStackHeight;
+}
+
+bool FTetrisSearch::ExpandBeam(int32 Type)
+{
+	const FPieceShape& Piece = Shapes[Type * FPieceShape::NumRotations];
+	const auto Expand = [this, &Piece, Type](FSearchTask& Task, int32 NodeIndex)
+	{
+		/* Boards that end the game, or that the piece can't spawn on, have no children.*/
+		if (!LoadNode(Task, NodeIndex) || !Task.Board.CanPlace(Piece, SpawnCoordinate)) { return; }
+
+		const FSearchNode& Node = Beam[NodeIndex];
+		const FBoardFeatures Features = FBoardEvaluator::Measure(Task.Board);
+		Task.Generator.Generate(Task.Board, Piece, SpawnCoordinate);
+		const TConstArrayView<FPiecePlacement> Placements = Task.Generator.GetPlacements();
+		float BestScore = TNumericLimits<float>::Lowest();
+		int32 BestIndex = INDEX_NONE;
+		for (int32 Index = 0; Index < Placements.Num(); ++Index)
+		{
+			const FPiecePlacement& Placement = Placements[Index];
+			const FBoardFeatures Placed = FBoardEvaluator::MeasurePlacement(Task.Board, Features, *Placement.Piece, Placement.Coordinate);
+			const float Score = Evaluator.Score(Placed);
+			const float Value = Node.LineReward + Score;
+			if (Score > BestScore)
+			{
+				BestScore = Score;
+				BestIndex = Index;
+			}
+
+			Task.Children.Add({ Placement.Piece, Placement.Coordinate, NodeIndex, Index, Node.RootMove,
+				Node.LineReward + Evaluator.GetWeights().LinesCleared * Placed.LinesCleared, Value, GetLockedHash(Task, Placement, Placed.LinesCleared) });
+		}
+		TranspositionTable.Store(GetTableKey(Task.Board.GetHash(), Type), BestScore, BestIndex, 1);
+	};
+
+	/* The best placement of the piece on a board bounds the values of its children. Boards of the previous search's beam
+	 * have their bound in the table, so they're expanded last, and only if they can beat the children found so far.*/
+	FirstNodes.Reset();
+	BoundedNodes.Reset();
+	for (int32 NodeIndex = 0; NodeIndex < Beam.Num(); ++NodeIndex)
+	{
+		const FSearchNode& Node = Beam[NodeIndex];
+		FTranspositionEntry Entry;
+		if (TranspositionTable.Probe(GetTableKey(Node.Hash, Type), Entry))
+		{
+			BoundedNodes.Add({ NodeIndex, Node.LineReward + Entry.Value });
+		}
+		else
+		{
+			FirstNodes.Add(NodeIndex);
+		}
+	}
+	BoundedNodes.Sort([](const FBoundedNode& A, const FBoundedNode& B)
+	{
+		return A.Bound != B.Bound ? A.Bound > B.Bound : A.NodeIndex < B.NodeIndex;
+	});
+
+	/* The boards without a bound and the board with the best bound are expanded first, to find a cutoff for the others. Then
+	 * the others are expanded in batches, best bound first, raising the cutoff, until no board left can make the beam.*/
+	NodeRows.SetNumUninitialized(Beam.Num() * NumRows);
+	NextBeam.Reset();
+	int32 NumBounded = 0;
+	if (!BoundedNodes.IsEmpty())
+	{
+		FirstNodes.Add(BoundedNodes[NumBounded++].NodeIndex);
+	}
+	ExpandNodes(FirstNodes, Expand);
+	while (!bTimedOut && NumBounded < BoundedNodes.Num())
+	{
+		const float Cutoff = NextBeam.Num() >= Settings.BeamWidth ? NextBeam.Last().Value : TNumericLimits<float>::Lowest();
+		if (BoundedNodes[NumBounded].Bound < Cutoff)
+		{
+			NumBoundedSkipped += BoundedNodes.Num() - NumBounded;
+			break;
+		}
+		FirstNodes.Reset();
+		for (; NumBounded < BoundedNodes.Num() && FirstNodes.Num() < Tasks.Num() && BoundedNodes[NumBounded].Bound >= Cutoff; ++NumBounded)
+		{
+			FirstNodes.Add(BoundedNodes[NumBounded].NodeIndex);
+		}
+		ExpandNodes(FirstNodes, Expand);
+	}
+	if (bTimedOut) { return false; }
+
+	/* The children are placed on the boards just expanded.*/
+	Swap(Beam, NextBeam);
+	Swap(ParentRows, NodeRows);
+	return !Beam.IsEmpty();
+}
+
+void FTetrisSearch::ExpandNodes(TConstArrayView<int32> Nodes, TFunctionRef<void(FSearchTask&, int32)> Expand)
+{
+	for (const TUniquePtr<FSearchTask>& Task : Tasks)
+	{
+		Task->Children.Reset();
+	}
+	RunTasks(Nodes, Expand);
+	for (const TUniquePtr<FSearchTask>& Task : Tasks)
+	{
+		NextBeam.Append(Task->Children);
+	}
+	TrimBeam(NextBeam);
+}
+
+bool FTetrisSearch::ExpectBeam(TConstArrayView<float> Chances)
+{
+	NodeRows.SetNumUninitialized(Beam.Num() * NumRows);
+	FirstNodes.Reset();
+	for (int32 NodeIndex = 0; NodeIndex < Beam.Num(); ++NodeIndex)
+	{
+		FirstNodes.Add(NodeIndex);
+	}
+	RunTasks(FirstNodes, [this, Chances](FSearchTask& Task, int32 NodeIndex)
+	{
+		FSearchNode& Node = Beam[NodeIndex];
+		if (!LoadNode(Task, NodeIndex))
+		{
+			Node.Value = GameOverValue;
+			return;
+		}
+
+		/* Each piece is placed where it scores best.*/
+		const FBoardFeatures Features = FBoardEvaluator::Measure(Task.Board);
+		float ExpectedValue = 0.f;
+		for (int32 Type = 0; Type < Chances.Num(); ++Type)
+		{
+			if (Chances[Type] <= 0.f) { continue; }
+			const FPieceShape& Piece = Shapes[Type * FPieceShape::NumRotations];
+			if (!Task.Board.CanPlace(Piece, SpawnCoordinate))
+			{
+				ExpectedValue += Chances[Type] * GameOverValue;
+				continue;
+			}
+
+			/* The best placement only depends on the board and the piece, so it may have been found by an earlier search.*/
+			const uint64 Key = GetTableKey(Task.Board.GetHash(), Type);
+			FTranspositionEntry Entry;
+			if (TranspositionTable.Probe(Key, Entry))
+			{
+				++Task.NumTableHits;
+				ExpectedValue += Chances[Type] * (Node.LineReward + Entry.Value);
+				continue;
+			}
+
+			float BestScore = TNumericLimits<float>::Lowest();
+			int32 BestIndex = INDEX_NONE;
+			Task.Generator.Generate(Task.Board, Piece, SpawnCoordinate);
+			const TConstArrayView<FPiecePlacement> Placements = Task.Generator.GetPlacements();
+			for (int32 Index = 0; Index < Placements.Num(); ++Index)
+			{
+				const float Score = Evaluator.ScorePlacement(Task.Board, Features, *Placements[Index].Piece, Placements[Index].Coordinate);
+				if (Score > BestScore)
+				{
+					BestScore = Score;
+					BestIndex = Index;
+				}
+			}
+			TranspositionTable.Store(Key, BestScore, BestIndex, 1);
+			ExpectedValue += Chances[Type] * (Node.LineReward + BestScore);
+		}
+		Node.Value = ExpectedValue;
+	});
+	if (bTimedOut) { return false; }
+
+	TrimBeam(Beam);
+	return true;
+}
+
+void FTetrisSearch::TrimBeam(TArray<FSearchNode>& Nodes)
+{
+	/* Equal boards are ordered by where they were found, so the result doesn't depend on how the tasks were scheduled.*/
+	Nodes.Sort([](const FSearchNode& A, const FSearchNode& B)
+	{
+		if (A.Value != B.Value) { return A.Value > B.Value; }
+		return A.Parent != B.Parent ? A.Parent < B.Parent : A.Order < B.Order;
+	});
+
+	/* Keep the best line of play to each board.*/
+	KeptHashes.Reset();
+	int32 NumKept = 0;
+	for (int32 Index = 0; Index < Nodes.Num() && NumKept < Settings.BeamWidth; ++Index)
+	{
+		bool bAlreadyKept = false;
+		KeptHashes.Add(Nodes[Index].Hash, &bAlreadyKept);
+		if (bAlreadyKept)
+		{
+			++NumTranspositions;
+			continue;
+		}
+		Nodes[NumKept++] = Nodes[Index];
+	}
+	Nodes.SetNum(NumKept);
+}
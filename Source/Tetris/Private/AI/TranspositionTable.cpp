@@ -0,0 +1,95 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "AI/TranspositionTable.h"
+
+void FTranspositionTable::Initialize(int32 NumEntries)
+{
+	if (NumEntries <= 0)
+	{
+		Slots.Reset();
+		IndexMask = 0;
+		return;
+	}
+	const uint32 NumSlots = 1u << FMath::FloorLog2(uint32(NumEntries));
+	Slots = MakeUnique<FSlot[]>(NumSlots);
+	IndexMask = NumSlots - 1;
+	Generation = 1;
+}
+
+void FTranspositionTable::Clear()
+{
+	if (!Slots) { return; }
+	for (uint64 Index = 0; Index <= IndexMask; ++Index)
+	{
+		Slots[Index].Check.store(0, std::memory_order_relaxed);
+		Slots[Index].Data.store(0, std::memory_order_relaxed);
+	}
+	Generation = 1;
+}
+
+void FTranspositionTable::NewGeneration()
+{
+	/* Zero marks an empty slot, so it is skipped when the generation wraps.*/
+	Generation = Generation == MAX_uint8 ? 1 : Generation + 1;
+}
+
+uint8 FTranspositionTable::GetGeneration() const
+{
+	return Generation;
+}
+
+int32 FTranspositionTable::GetNumEntries() const
+{
+	return Slots ? int32(IndexMask + 1) : 0;
+}
+
+bool FTranspositionTable::Probe(uint64 Key, FTranspositionEntry& OutEntry) const
+{
+	if (!Slots) { return false; }
+	const FSlot& Slot = Slots[Key & IndexMask];
+	const uint64 Data = Slot.Data.load(std::memory_order_relaxed);
+	const uint64 Check = Slot.Check.load(std::memory_order_relaxed);
+	if (Data == 0 || (Check ^ Data) != Key) { return false; }
+	OutEntry = Unpack(Data);
+	return true;
+}
+
+void FTranspositionTable::Store(uint64 Key, float Value, int32 BestMove, int32 Depth)
+{
+	if (!Slots) { return; }
+	FSlot& Slot = Slots[Key & IndexMask];
+
+	/* Another key's entry is only replaced if it is stale or no deeper. A racing store may still win, which only loses an entry.*/
+	const uint64 OldData = Slot.Data.load(std::memory_order_relaxed);
+	if (OldData != 0 && (Slot.Check.load(std::memory_order_relaxed) ^ OldData) != Key)
+	{
+		const FTranspositionEntry Old = Unpack(OldData);
+		if (Old.Generation == Generation && Old.Depth > Depth) { return; }
+	}
+
+	const uint64 Data = Pack(Value, BestMove, Depth, Generation);
+	Slot.Check.store(Key ^ Data, std::memory_order_relaxed);
+	Slot.Data.store(Data, std::memory_order_relaxed);
+}
+
+uint64 FTranspositionTable::Pack(float Value, int32 BestMove, int32 Depth, uint8 InGeneration)
+{
+	uint32 ValueBits;
+	FMemory::Memcpy(&ValueBits, &Value, sizeof(ValueBits));
+	const uint64 MoveBits = uint16(BestMove == INDEX_NONE ? MAX_uint16 : FMath::Clamp(BestMove, 0, MAX_uint16 - 1));
+	const uint64 DepthBits = uint8(FMath::Clamp(Depth, 0, int32(MAX_uint8)));
+	return uint64(ValueBits) | (MoveBits << 32) | (DepthBits << 48) | (uint64(InGeneration) << 56);
+}
+
+FTranspositionEntry FTranspositionTable::Unpack(uint64 Data)
+{
+	FTranspositionEntry Entry;
+	const uint32 ValueBits = uint32(Data);
+	FMemory::Memcpy(&Entry.Value, &ValueBits, sizeof(ValueBits));
+	const uint16 MoveBits = uint16(Data >> 32);
+	Entry.BestMove = MoveBits == MAX_uint16 ? INDEX_NONE : MoveBits;
+	Entry.Depth = uint8(Data >> 48);
+	Entry.Generation = uint8(Data >> 56);
+	return Entry;
+}
@@ -0,0 +1,315 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "BoardBatch.h"
+
+#if TETRIS_BOARD_BATCH_AVX2 || TETRIS_BOARD_BATCH_SSE
+#include <immintrin.h>
+#endif
+
+namespace BoardBatch
+{
+	/* The widest lane count of any kernel, which the stride is padded to.*/
+	constexpr int32 MaxLaneCount = 8;
+
+	/* A vector of one row mask per board. Comparisons produce all ones in the lanes where they hold.*/
+#if TETRIS_BOARD_BATCH_AVX2
+	using FVector = __m256i;
+	FORCEINLINE FVector Load(const uint32* Src) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src)); }
+	FORCEINLINE FVector Set(uint32 Value) { return _mm256_set1_epi32(int32(Value)); }
+	FORCEINLINE FVector And(FVector A, FVector B) { return _mm256_and_si256(A, B); }
+	FORCEINLINE FVector Or(FVector A, FVector B) { return _mm256_or_si256(A, B); }
+	FORCEINLINE FVector ShiftRight(FVector A, int32 Bits) { return _mm256_srl_epi32(A, _mm_cvtsi32_si128(Bits)); }
+	FORCEINLINE FVector Equal(FVector A, FVector B) { return _mm256_cmpeq_epi32(A, B); }
+	FORCEINLINE FVector Select(FVector Mask, FVector A, FVector B) { return _mm256_blendv_epi8(B, A, Mask); }
+	FORCEINLINE uint32 MoveMask(FVector Mask) { return uint32(_mm256_movemask_ps(_mm256_castsi256_ps(Mask))); }
+	FORCEINLINE void Store(uint32* Dst, FVector A) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst), A); }
+#elif TETRIS_BOARD_BATCH_SSE
+	using FVector = __m128i;
+	FORCEINLINE FVector Load(const uint32* Src) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src)); }
+	FORCEINLINE FVector Set(uint32 Value) { return _mm_set1_epi32(int32(Value)); }
+	FORCEINLINE FVector And(FVector A, FVector B) { return _mm_and_si128(A, B); }
+	FORCEINLINE FVector Or(FVector A, FVector B) { return _mm_or_si128(A, B); }
+	FORCEINLINE FVector ShiftRight(FVector A, int32 Bits) { return _mm_srl_epi32(A, _mm_cvtsi32_si128(Bits)); }
+	FORCEINLINE FVector Equal(FVector A, FVector B) { return _mm_cmpeq_epi32(A, B); }
+	FORCEINLINE FVector Select(FVector Mask, FVector A, FVector B) { return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B)); }
+	FORCEINLINE uint32 MoveMask(FVector Mask) { return uint32(_mm_movemask_ps(_mm_castsi128_ps(Mask))); }
+	FORCEINLINE void Store(uint32* Dst, FVector A) { _mm_storeu_si128(reinterpret_cast<__m128i*>(Dst), A); }
+#else
+	using FVector = uint32;
+	FORCEINLINE FVector Load(const uint32* Src) { return *Src; }
+	FORCEINLINE FVector Set(uint32 Value) { return Value; }
+	FORCEINLINE FVector And(FVector A, FVector B) { return A & B; }
+	FORCEINLINE FVector Or(FVector A, FVector B) { return A | B; }
+	FORCEINLINE FVector ShiftRight(FVector A, int32 Bits) { return A >> Bits; }
+	FORCEINLINE FVector Equal(FVector A, FVector B) { return A == B ? ~0u : 0u; }
+	FORCEINLINE FVector Select(FVector Mask, FVector A, FVector B) { return (Mask & A) | (~Mask & B); }
+	FORCEINLINE uint32 MoveMask(FVector Mask) { return Mask >> 31; }
+	FORCEINLINE void Store(uint32* Dst, FVector A) { *Dst = A; }
+#endif
+	static_assert(sizeof(FVector) == FBoardBatch::LaneCount * sizeof(uint32), "FBoardBatch lane count must match its vector width.");
+
+	/* Get the mask of the board columns where the leftmost body column can go such that the body stays on the board.*/
+	uint32 GetInBoundsColumns(const FPieceShape& Piece, int32 Width)
+	{
+		const int32 NumColumns = Width - (Piece.MaxX - Piece.MinX);
+		return NumColumns <= 0 ? 0u : NumColumns >= 32 ? ~0u : (1u << NumColumns) - 1u;
+	}
+}
+
+void FBoardBatch::Initialize(int32 InNumBoards, int32 BoardWidth, int32 BoardHeight)
+{
+	/* Each row is stored as a bitmask, so the width is limited by the mask size.*/
+	if (BoardWidth > FBoardState::MaxWidth)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Board width %d exceeds the maximum of %d. Clamping..."), __FUNCTION__, BoardWidth, FBoardState::MaxWidth);
+		BoardWidth = FBoardState::MaxWidth;
+	}
+
+	NumBoards = FMath::Max(InNumBoards, 0);
+	Stride = FMath::DivideAndRoundUp(NumBoards, BoardBatch::MaxLaneCount) * BoardBatch::MaxLaneCount;
+	Width = BoardWidth;
+	Height = FMath::Max(BoardHeight, 0);
+	FullRowMask = Width >= FBoardState::MaxWidth ? ~0u : (1u << Width) - 1u;
+	Rows.Init(0, Stride * Height);
+}
+
+void FBoardBatch::SetBoard(int32 BoardIndex, const FBoardState& Board)
+{
+	check(Board.GetWidth() == Width && Board.GetHeight() == Height);
+	for (int32 Row = 0; Row < Height; ++Row)
+	{
+		Rows[Row * Stride + BoardIndex] = Board.GetRowMask(Row);
+	}
+}
+
+int32 FBoardBatch::Num() const
+{
+	return NumBoards;
+}
+
+int32 FBoardBatch::GetWidth() const
+{
+	return Width;
+}
+
+int32 FBoardBatch::GetHeight() const
+{
+	return Height;
+}
+
+uint32 FBoardBatch::GetRowMask(int32 BoardIndex, int32 Row) const
+{
+	return Rows[Row * Stride + BoardIndex];
+}
+
+bool FBoardBatch::IsRowFull(int32 BoardIndex, int32 Row) const
+{
+	return GetRowMask(BoardIndex, Row) == FullRowMask;
+}
+
+int32 FBoardBatch::GetStackHeight(int32 BoardIndex) const
+{
+	for (int32 Row = Height - 1; Row >= 0; --Row)
+	{
+		if (GetRowMask(BoardIndex, Row) != 0)
+		{
+			return Row + 1;
+		}
+	}
+	return 0;
+}
+
+bool FBoardBatch::CanPlace(int32 BoardIndex, const FPieceShape& Piece, const FIntPoint& Coordinate) const
+{
+	if (!IsInBounds(Piece, Coordinate))
+	{
+		return false;
+	}
+	for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+	{
+		if (GetRowMask(BoardIndex, Coordinate.Y + PieceRow) & Piece.GetRowMask(PieceRow, Coordinate.X))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+EPlaceResult FBoardBatch::Place(int32 BoardIndex, const FPieceShape& Piece, const FIntPoint& Coordinate)
+{
+	if (!CanPlace(BoardIndex, Piece, Coordinate))
+	{
+		return EPlaceResult::BAD;
+	}
+	for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+	{
+		Rows[(Coordinate.Y + PieceRow) * Stride + BoardIndex] |= Piece.GetRowMask(PieceRow, Coordinate.X);
+	}
+	return EPlaceResult::OK;
+}
+
+void FBoardBatch::CanPlaceAll(const FPieceShape& Piece, const FIntPoint& Coordinate, TArrayView<bool> OutFits) const
+{
+	check(OutFits.Num() >= NumBoards);
+	using namespace BoardBatch;
+
+	/* The bounds are the same for every board.*/
+	if (!IsInBounds(Piece, Coordinate))
+	{
+		for (int32 Board = 0; Board < NumBoards; ++Board)
+		{
+			OutFits[Board] = false;
+		}
+		return;
+	}
+
+	/* Overlap the body rows with a vector of boards at a time.*/
+	for (int32 Board = 0; Board < NumBoards; Board += LaneCount)
+	{
+		FVector Overlap = Set(0);
+		for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+		{
+			const uint32* RowMasks = &Rows[(Coordinate.Y + PieceRow) * Stride + Board];
+			Overlap = Or(Overlap, And(Load(RowMasks), Set(Piece.GetRowMask(PieceRow, Coordinate.X))));
+		}
+
+		const uint32 Fits = MoveMask(Equal(Overlap, Set(0)));
+		const int32 NumLanes = FMath::Min(LaneCount, NumBoards - Board);
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			OutFits[Board + Lane] = (Fits >> Lane) & 1u;
+		}
+	}
+}
+
+void FBoardBatch::GetFittingColumnsAll(const FPieceShape& Piece, int32 Y, TArrayView<uint32> OutColumns) const
+{
+	check(OutColumns.Num() >= NumBoards);
+	using namespace BoardBatch;
+
+	/* The rows are tested for every column at once: each body cell blocks the columns its board cell is occupied from.*/
+	const uint32 InBoundsColumns = Y + Piece.MinY >= 0 && Y + Piece.MaxY < Height ? GetInBoundsColumns(Piece, Width) : 0u;
+	alignas(32) uint32 Blocked[MaxLaneCount];
+	for (int32 Board = 0; Board < NumBoards; Board += LaneCount)
+	{
+		FVector BlockedColumns = Set(0);
+		for (int32 PieceRow = Piece.MinY; InBoundsColumns && PieceRow <= Piece.MaxY; ++PieceRow)
+		{
+			const FVector RowMasks = Load(&Rows[(Y + PieceRow) * Stride + Board]);
+			for (uint32 BodyMask = Piece.RowMasks[PieceRow]; BodyMask; BodyMask &= BodyMask - 1)
+			{
+				BlockedColumns = Or(BlockedColumns, ShiftRight(RowMasks, FMath::CountTrailingZeros(BodyMask) - Piece.MinX));
+			}
+		}
+		Store(Blocked, BlockedColumns);
+
+		const int32 NumLanes = FMath::Min(LaneCount, NumBoards - Board);
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			OutColumns[Board + Lane] = InBoundsColumns & ~Blocked[Lane];
+		}
+	}
+}
+
+uint32 FBoardBatch::GetFittingColumns(int32 BoardIndex, const FPieceShape& Piece, int32 Y) const
+{
+	if (Y + Piece.MinY < 0 || Y + Piece.MaxY >= Height)
+	{
+		return 0;
+	}
+
+	uint32 BlockedColumns = 0;
+	for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+	{
+		const uint32 RowMask = GetRowMask(BoardIndex, Y + PieceRow);
+		for (uint32 BodyMask = Piece.RowMasks[PieceRow]; BodyMask; BodyMask &= BodyMask - 1)
+		{
+			BlockedColumns |= RowMask >> (FMath::CountTrailingZeros(BodyMask) - Piece.MinX);
+		}
+	}
+	return BoardBatch::GetInBoundsColumns(Piece, Width) & ~BlockedColumns;
+}
+
+void FBoardBatch::GetFullRowsAll(TArrayView<uint64> OutFullRows) const
+{
+	check(OutFullRows.Num() >= NumBoards && Height <= 64);
+	using namespace BoardBatch;
+
+	for (int32 Board = 0; Board < NumBoards; Board += LaneCount)
+	{
+		const int32 NumLanes = FMath::Min(LaneCount, NumBoards - Board);
+		uint64 FullRows[MaxLaneCount] = {};
+		for (int32 Row = 0; Row < Height; ++Row)
+		{
+			uint32 Full = MoveMask(Equal(Load(&Rows[Row * Stride + Board]), Set(FullRowMask)));
+			for (; Full; Full &= Full - 1)
+			{
+				FullRows[FMath::CountTrailingZeros(Full)] |= uint64(1) << Row;
+			}
+		}
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			OutFullRows[Board + Lane] = FullRows[Lane];
+		}
+	}
+}
+
+void FBoardBatch::GetStackHeightsAll(TArrayView<uint8> OutHeights) const
+{
+	check(OutHeights.Num() >= NumBoards);
+	using namespace BoardBatch;
+
+	alignas(32) uint32 Heights[MaxLaneCount];
+	for (int32 Board = 0; Board < NumBoards; Board += LaneCount)
+	{
+		/* Rows are visited from the bottom up, so the last non-empty row of each board sets its height.*/
+		FVector StackHeights = Set(0);
+		for (int32 Row = 0; Row < Height; ++Row)
+		{
+			const FVector IsEmpty = Equal(Load(&Rows[Row * Stride + Board]), Set(0));
+			StackHeights = Select(IsEmpty, StackHeights, Set(Row + 1));
+		}
+		Store(Heights, StackHeights);
+
+		const int32 NumLanes = FMath::Min(LaneCount, NumBoards - Board);
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			OutHeights[Board + Lane] = uint8(Heights[Lane]);
+		}
+	}
+}
+
+void FBoardBatch::GetColumnHeightsAll(TArrayView<uint8> OutHeights) const
+{
+	check(OutHeights.Num() >= NumBoards * Width);
+	using namespace BoardBatch;
+
+	alignas(32) uint32 Heights[MaxLaneCount];
+	for (int32 Board = 0; Board < NumBoards; Board += LaneCount)
+	{
+		const int32 NumLanes = FMath::Min(LaneCount, NumBoards - Board);
+		for (int32 Col = 0; Col < Width; ++Col)
+		{
+			/* Rows are visited from the bottom up, so the last occupied cell of each column sets its height.*/
+			FVector ColumnHeights = Set(0);
+			for (int32 Row = 0; Row < Height; ++Row)
+			{
+				const FVector IsEmpty = Equal(And(ShiftRight(Load(&Rows[Row * Stride + Board]), Col), Set(1)), Set(0));
+				ColumnHeights = Select(IsEmpty, ColumnHeights, Set(Row + 1));
+			}
+			Store(Heights, ColumnHeights);
+
+			for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+			{
+				OutHeights[(Board + Lane) * Width + Col] = uint8(Heights[Lane]);
+			}
+		}
+	}
+}
+
+bool FBoardBatch::IsInBounds(const FPieceShape& Piece, const FIntPoint& Coordinate) const
+{
+	return Coordinate.X + Piece.MinX >= 0 && Coordinate.X + Piece.MaxX < Width
+		&& Coordinate.Y + Piece.MinY >= 0 && Coordinate.Y + Piece.MaxY < Height;
+}
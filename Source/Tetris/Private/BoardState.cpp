@@ -0,0 +1,394 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "BoardState.h"
+#include "Core/TetrisStats.h"
+
+namespace
+{
+	/* Mix the index of a cell into its key. The keys are the SplitMix64 sequence indexed by cell, which is as good as a table
+	of random numbers and works for any board height.*/
+	constexpr uint64 MixCellKey(int32 Row, int32 Col)
+	{
+		uint64 Key = (uint64(Row) * FBoardState::MaxWidth + uint64(Col) + 1) * 0x9E3779B97F4A7C15ull;
+		Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ull;
+		Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBull;
+		return Key ^ (Key >> 31);
+	}
+
+	/* The number of rows whose keys are precomputed. Every standard board fits, and taller boards mix the rest on demand.*/
+	constexpr int32 NumTableRows = 64;
+
+	/* The precomputed keys of the lowest rows, so that updating the hash takes one load and one XOR per changed cell.*/
+	struct FCellKeyTable
+	{
+		uint64 Keys[NumTableRows][FBoardState::MaxWidth];
+
+		constexpr FCellKeyTable() : Keys{}
+		{
+			for (int32 Row = 0; Row < NumTableRows; ++Row)
+			{
+				for (int32 Col = 0; Col < FBoardState::MaxWidth; ++Col)
+				{
+					Keys[Row][Col] = MixCellKey(Row, Col);
+				}
+			}
+		}
+	};
+	constexpr FCellKeyTable CellKeys;
+}
+
+int32 FBoardState::GetWidth() const
+{
+	return Width;
+}
+
+int32 FBoardState::GetHeight() const
+{
+	return Rows.Num();
+}
+
+bool FBoardState::IsOccupied(const FIntPoint& Coordinate) const
+{
+	return (Rows[Coordinate.Y] >> Coordinate.X) & 1u;
+}
+
+bool FBoardState::CanPlace(const FPieceShape& Piece, const FIntPoint& Coordinate) const
+{
+	if (!IsInBounds(Piece, Coordinate))
+	{
+		return false;
+	}
+
+	/* Check that no row of the body overlaps the occupied cells of the board.*/
+	for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+	{
+		if (Rows[Coordinate.Y + PieceRow] & Piece.GetRowMask(PieceRow, Coordinate.X))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int32 FBoardState::GetDropRow(const FPieceShape& Piece, const FIntPoint& Coordinate) const
+{
+	/* Each column of the body lands on the top of its board column, or the floor, and the highest landing wins.*/
+	int32 DropRow = -Piece.MinY;
+	for (int32 PieceCol = Piece.MinX; PieceCol <= Piece.MaxX; ++PieceCol)
+	{
+		/* Columns of the bounding box without a body cell don't land on anything.*/
+		if (Piece.Skirt[PieceCol] == INDEX_NONE) { continue; }
+		DropRow = FMath::Max(DropRow, ColumnHeights[Coordinate.X + PieceCol] - Piece.Skirt[PieceCol]);
+	}
+
+	/* The heights are only exact when the piece is above every column, so fall back to stepping down when it is tucked under the stack.*/
+	if (DropRow <= Coordinate.Y)
+	{
+		return DropRow;
+	}
+	int32 Row = Coordinate.Y;
+	while (CanPlace(Piece, { Coordinate.X, Row - 1 }))
+	{
+		--Row;
+	}
+	return Row;
+}
+
+bool FBoardState::CanMove(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate) const
+{
+	if (!IsInBounds(ToPiece, ToCoordinate))
+	{
+		return false;
+	}
+
+	for (int32 PieceRow = ToPiece.MinY; PieceRow <= ToPiece.MaxY; ++PieceRow)
+	{
+		const int32 Row = ToCoordinate.Y + PieceRow;
+
+		/* The cells the piece is moving out of are free.*/
+		uint32 Occupied = Rows[Row];
+		const int32 FromPieceRow = Row - FromCoordinate.Y;
+		if (FromPieceRow >= FromPiece.MinY && FromPieceRow <= FromPiece.MaxY)
+		{
+			Occupied &= ~FromPiece.GetRowMask(FromPieceRow, FromCoordinate.X);
+		}
+
+		if (Occupied & ToPiece.GetRowMask(PieceRow, ToCoordinate.X))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+EPlaceResult FBoardState::Place(const FPieceShape& Piece, const FIntPoint& Coordinate)
+{
+	if (!CanPlace(Piece, Coordinate))
+	{
+		INC_DWORD_STAT(STAT_TetrisRejectedPlacements);
+		UE_LOG(LogTetrisBoard, Verbose, TEXT("Piece has collided with the board boundary or another piece at (%d,%d). Early exit..."), Coordinate.X, Coordinate.Y);
+		return EPlaceResult::BAD;
+	}
+
+	/* Place the rows that comprise the piece's body onto the board.*/
+	for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+	{
+		const int32 Row = Coordinate.Y + PieceRow;
+		SetRow(Row, Rows[Row] | Piece.GetRowMask(PieceRow, Coordinate.X));
+	}
+	return EPlaceResult::OK;
+}
+
+EPlaceResult FBoardState::Move(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate)
+{
+	if (!CanMove(FromPiece, FromCoordinate, ToPiece, ToCoordinate))
+	{
+		return EPlaceResult::BAD;
+	}
+
+	/* Lift the piece off the board, then put it down at the new placement.*/
+	for (int32 PieceRow = FromPiece.MinY; PieceRow <= FromPiece.MaxY; ++PieceRow)
+	{
+		const int32 Row = FromCoordinate.Y + PieceRow;
+		SetRow(Row, Rows[Row] & ~FromPiece.GetRowMask(PieceRow, FromCoordinate.X));
+	}
+	for (int32 PieceRow = ToPiece.MinY; PieceRow <= ToPiece.MaxY; ++PieceRow)
+	{
+		const int32 Row = ToCoordinate.Y + PieceRow;
+		SetRow(Row, Rows[Row] | ToPiece.GetRowMask(PieceRow, ToCoordinate.X));
+	}
+	return EPlaceResult::OK;
+}
+
+void FBoardState::Collapse()
+{
+	/* Compact the non-empty rows towards the bottom of the board, preserving their order. Rows above the stack are already empty.*/
+	const int32 PreviousStackHeight = StackHeight;
+	int32 TargetRow = 0;
+	for (int32 ReadRow = 0; ReadRow < PreviousStackHeight; ++ReadRow)
+	{
+		if (Rows[ReadRow] != 0)
+		{
+			SetRow(TargetRow++, Rows[ReadRow]);
+		}
+	}
+
+	/* Clear the top rows which are now effectively empty.*/
+	for (; TargetRow < PreviousStackHeight; ++TargetRow)
+	{
+		SetRow(TargetRow, 0);
+	}
+}
+
+bool FBoardState::ClearRows(TArray<int32>& ClearedRows)
+{
+	return ClearRows(ClearedRows, 0, StackHeight - 1);
+}
+
+bool FBoardState::ClearRows(TArray<int32>& ClearedRows, int32 FirstRow, int32 LastRow)
+{
+	FirstRow = FMath::Max(FirstRow, 0);
+	LastRow = FMath::Min(LastRow, StackHeight - 1);
+	for (int32 Row = FirstRow; Row <= LastRow; ++Row)
+	{
+		if (IsRowFull(Row))
+		{
+			EmptyRow(Row);
+			ClearedRows.Add(Row);
+		}
+	}
+	return !ClearedRows.IsEmpty();
+}
+
+bool FBoardState::IsRowFull(int32 Row) const
+{
+	return Rows[Row] == FullRowMask;
+}
+
+uint32 FBoardState::GetRowMask(int32 Row) const
+{
+	return Rows[Row];
+}
+
+int32 FBoardState::GetRowFillCount(int32 Row) const
+{
+	return FMath::CountBits(Rows[Row]);
+}
+
+uint32 FBoardState::GetFullRowMask() const
+{
+	return FullRowMask;
+}
+
+void FBoardState::EmptyRow(int32 Row)
+{
+	SetRow(Row, 0);
+}
+
+void FBoardState::SetRowMask(int32 Row, uint32 Mask)
+{
+	SetRow(Row, Mask & FullRowMask);
+}
+
+void FBoardState::Initialize(int32 BoardWidth, int32 BoardHeight)
+{
+	/* Each row is stored as a bitmask, so the width is limited by the mask size.*/
+	if (BoardWidth > MaxWidth)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Board width %d exceeds the maximum of %d. Clamping..."), __FUNCTION__, BoardWidth, MaxWidth);
+		BoardWidth = MaxWidth;
+	}
+
+	/* Empty the grid and fill it with empty rows.*/
+	Width = BoardWidth;
+	FullRowMask = Width >= MaxWidth ? ~0u : (1u << Width) - 1u;
+	Rows.Init(0, BoardHeight);
+	StackHeight = 0;
+	FMemory::Memzero(ColumnHeights, sizeof(ColumnHeights));
+	Hash = 0;
+	Journal.Reset();
+	UndoLevels.Reset();
+}
+
+void FBoardState::Undo()
+{
+	RollBack(UndoLevels.IsEmpty() ? 0 : UndoLevels.Last());
+}
+
+void FBoardState::Commit()
+{
+	/* Keep the allocations so that the journal doesn't reallocate between pieces.*/
+	Journal.Reset();
+	UndoLevels.Reset();
+}
+
+int32 FBoardState::PushUndoLevel()
+{
+	UndoLevels.Push(Journal.Num());
+	return UndoLevels.Num();
+}
+
+void FBoardState::PopUndoLevel()
+{
+	if (UndoLevels.IsEmpty()) { return; }
+	RollBack(UndoLevels.Pop(false));
+}
+
+int32 FBoardState::GetUndoDepth() const
+{
+	return UndoLevels.Num();
+}
+
+int32 FBoardState::GetStackHeight() const
+{
+	return StackHeight;
+}
+
+int32 FBoardState::GetColumnHeight(int32 Col) const
+{
+	return ColumnHeights[Col];
+}
+
+TConstArrayView<int32> FBoardState::GetColumnHeights() const
+{
+	return TConstArrayView<int32>(ColumnHeights, Width);
+}
+
+uint64 FBoardState::GetHash() const
+{
+	return Hash;
+}
+
+uint64 FBoardState::GetCellKey(int32 Row, int32 Col)
+{
+	return Row < NumTableRows ? CellKeys.Keys[Row][Col] : MixCellKey(Row, Col);
+}
+
+uint64 FBoardState::GetPieceKey(const FPieceShape& Piece, const FIntPoint& Coordinate)
+{
+	uint64 Key = 0;
+	for (int32 PieceRow = Piece.MinY; PieceRow <= Piece.MaxY; ++PieceRow)
+	{
+		Key ^= GetRowKey(Coordinate.Y + PieceRow, Piece.GetRowMask(PieceRow, Coordinate.X));
+	}
+	return Key;
+}
+
+uint64 FBoardState::GetRowKey(int32 Row, uint32 Mask)
+{
+	uint64 Key = 0;
+	if (Row >= NumTableRows)
+	{
+		for (; Mask; Mask &= Mask - 1)
+		{
+			Key ^= MixCellKey(Row, FMath::CountTrailingZeros(Mask));
+		}
+		return Key;
+	}
+
+	const uint64* RowKeys = CellKeys.Keys[Row];
+	for (; Mask; Mask &= Mask - 1)
+	{
+		Key ^= RowKeys[FMath::CountTrailingZeros(Mask)];
+	}
+	return Key;
+}
+
+bool FBoardState::IsInBounds(const FPieceShape& Piece, const FIntPoint& Coordinate) const
+{
+	return Coordinate.X + Piece.MinX >= 0 && Coordinate.X + Piece.MaxX < GetWidth()
+		&& Coordinate.Y + Piece.MinY >= 0 && Coordinate.Y + Piece.MaxY < GetHeight();
+}
+
+void FBoardState::SetRow(int32 Row, uint32 Mask)
+{
+	if (Rows[Row] == Mask) { return; }
+	Journal.Add({ Row, Rows[Row] });
+	WriteRow(Row, Mask);
+}
+
+void FBoardState::WriteRow(int32 Row, uint32 Mask)
+{
+	const uint32 AddedMask = Mask & ~Rows[Row];
+	const uint32 RemovedMask = Rows[Row] & ~Mask;
+	Hash ^= GetRowKey(Row, AddedMask | RemovedMask);
+	Rows[Row] = Mask;
+
+	/* Added cells can only raise their columns.*/
+	for (uint32 Added = AddedMask; Added; Added &= Added - 1)
+	{
+		int32& ColumnHeight = ColumnHeights[FMath::CountTrailingZeros(Added)];
+		ColumnHeight = FMath::Max(ColumnHeight, Row + 1);
+	}
+	StackHeight = Mask != 0 ? FMath::Max(StackHeight, Row + 1) : StackHeight;
+
+	/* Removing the top cell of a column lowers it to the next occupied cell below.*/
+	for (uint32 Removed = RemovedMask; Removed; Removed &= Removed - 1)
+	{
+		const int32 Col = FMath::CountTrailingZeros(Removed);
+		if (ColumnHeights[Col] != Row + 1) { continue; }
+
+		int32 Height = Row;
+		while (Height > 0 && !((Rows[Height - 1] >> Col) & 1u))
+		{
+			--Height;
+		}
+		ColumnHeights[Col] = Height;
+	}
+	while (StackHeight > 0 && Rows[StackHeight - 1] == 0)
+	{
+		--StackHeight;
+	}
+}
+
+void FBoardState::RollBack(int32 JournalLength)
+{
+	/* Restore the rows in reverse order so that rows changed more than once end up in their oldest state.*/
+	for (int32 i = Journal.Num() - 1; i >= JournalLength; --i)
+	{
+		const FBoardJournalEntry& Entry = Journal[i];
+		WriteRow(Entry.Row, Entry.PreviousMask);
+	}
+	Journal.SetNum(JournalLength, false);
+}
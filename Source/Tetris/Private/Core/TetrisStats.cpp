@@ -0,0 +1,30 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "Core/TetrisStats.h"
+
+UE_TRACE_CHANNEL_DEFINE(TetrisChannel);
+
+DEFINE_STAT(STAT_TetrisPlace);
+DEFINE_STAT(STAT_TetrisClearRows);
+DEFINE_STAT(STAT_TetrisCollapse);
+DEFINE_STAT(STAT_TetrisLockPiece);
+DEFINE_STAT(STAT_TetrisUpdate);
+DEFINE_STAT(STAT_TetrisBoardTick);
+DEFINE_STAT(STAT_TetrisSimulationSteps);
+DEFINE_STAT(STAT_TetrisReplayTick);
+DEFINE_STAT(STAT_TetrisProcessEvents);
+DEFINE_STAT(STAT_TetrisDraw);
+DEFINE_STAT(STAT_TetrisDrawActivePiece);
+DEFINE_STAT(STAT_TetrisHUDUpdate);
+DEFINE_STAT(STAT_TetrisAIHandoff);
+DEFINE_STAT(STAT_TetrisAISearch);
+
+DEFINE_STAT(STAT_TetrisStepsTaken);
+DEFINE_STAT(STAT_TetrisRejectedMoves);
+DEFINE_STAT(STAT_TetrisRejectedPlacements);
+DEFINE_STAT(STAT_TetrisInstancesUpdated);
+DEFINE_STAT(STAT_TetrisInstancesRebuilt);
+DEFINE_STAT(STAT_TetrisAIPlansDiscarded);
+
+DEFINE_LOG_CATEGORY(LogTetrisBoard);
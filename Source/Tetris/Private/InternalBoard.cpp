@@ -2,16 +2,15 @@
 
 
 #include "InternalBoard.h"
-#include "Piece.h"
 
 int32 UInternalBoard::GetWidth() const
 {
-	return Grid.Num();
+	return State.GetWidth();
 }
 
 int32 UInternalBoard::GetHeight() const
 {
-	return Grid.IsEmpty() ? 0 : Grid[0].Num();
+	return State.GetHeight();
 }
 
 TArray<FIntPoint> UInternalBoard::GetCoordinates() const
@@ -39,121 +38,63 @@ TArray<FIntPoint> UInternalBoard::GetRowCoordinates(int32 Row) const
 
 bool UInternalBoard::IsOccupied(const FIntPoint& Coordinate) const
 {
-	return Grid[Coordinate.X][Coordinate.Y];
+	return State.IsOccupied(Coordinate);
 }
 
-EPlaceResult UInternalBoard::Place(const UPiece* Piece, const FIntPoint& Coordinate)
+bool UInternalBoard::CanPlace(const FPieceShape& Piece, const FIntPoint& Coordinate) const
 {
-	/* Check that the skirt hasn't passed the bottom of the playfield or collided with an occupied cell.*/
-	for (const FIntPoint& SkirtPointInPieceSpace : Piece->Skirt)
-	{
-		FIntPoint SkirtPointInBoardSpace = SkirtPointInPieceSpace + Coordinate;
-
-		if (SkirtPointInBoardSpace.X < 0 || SkirtPointInBoardSpace.X >= GetWidth() || SkirtPointInBoardSpace.Y < 0)
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Piece body has collided with the board boundary. SkirtPointInBoardSpace: (%d,%d) Early exit..."), SkirtPointInBoardSpace.X, SkirtPointInBoardSpace.Y);
-			return EPlaceResult::BAD;
-		}
-		else if (IsOccupied(SkirtPointInBoardSpace))
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Piece has collided with another. Early exit..."))
-			return EPlaceResult::BAD;
-		}
-	}
-
-	/* Place the points that comprise the piece's body onto the board.*/
-	const TArray<FIntPoint> Body = Piece->Body;
-	for (const FIntPoint& BodyPointInPieceSpace : Body)
-	{
-		/* Update the point*/
-		FIntPoint BodyPointInBoardSpace = BodyPointInPieceSpace + Coordinate;
-		Grid[BodyPointInBoardSpace.X][BodyPointInBoardSpace.Y] = true;
-	}
-	return EPlaceResult::OK;
+	return State.CanPlace(Piece, Coordinate);
 }
 
-void UInternalBoard::Collapse()
+bool UInternalBoard::CanMove(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate) const
 {
-	/* Track the number of cleared rows.*/
-	int32 NumEmpty = 0;
+	return State.CanMove(FromPiece, FromCoordinate, ToPiece, ToCoordinate);
+}
 
-	/* Iterate from the bottom row to the top row.*/
-	for (int32 WorkingRow = 0; WorkingRow < GetHeight(); ++WorkingRow)
-	{
-		/* Count the number of occupied cells in the current row.*/
-		int32 NumOccupied = 0;
-		for (int32 Col = 0; Col < GetWidth(); ++Col)
-		{
-			if (IsOccupied({ Col, WorkingRow }))
-			{
-				++NumOccupied;
-			}
-		}
+EPlaceResult UInternalBoard::Place(const FPieceShape& Piece, const FIntPoint& Coordinate)
+{
+	return State.Place(Piece, Coordinate);
+}
 
-		/* If the current row is empty, increase the counter of empty rows.*/
-		if (NumOccupied == 0)
-		{
-			++NumEmpty;
-		}
-		else if (NumEmpty > 0)
-		{
-			/* If there are empty rows below, move the current row down. */
-			for (int32 Col = 0; Col < GetWidth(); ++Col)
-			{
-				Grid[Col][WorkingRow - NumEmpty] = Grid[Col][WorkingRow];
-				Grid[Col][WorkingRow] = false;
-			}
-		}
-	}
+EPlaceResult UInternalBoard::Move(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate)
+{
+	return State.Move(FromPiece, FromCoordinate, ToPiece, ToCoordinate);
+}
 
-	/* Clear the top NumEmpty rows which are now effectively empty.*/
-	for (int32 ClearRow = GetHeight() - NumEmpty; ClearRow < GetHeight(); ++ClearRow)
-	{
-		for (int32 Col = 0; Col < GetWidth(); ++Col)
-		{
-			Grid[Col][ClearRow] = false;
-		}
-	}
+void UInternalBoard::Collapse()
+{
+	State.Collapse();
 }
 
 bool UInternalBoard::ClearRows(TArray<int32>& ClearedRows)
 {
-	for (int32 Row = 0; Row < GetHeight(); ++Row)
-	{
-		if (IsRowFull(Row))
-		{
-			EmptyRow(Row);
-			ClearedRows.Add(Row);
-		}
-	}
-	return !ClearedRows.IsEmpty();
+	return State.ClearRows(ClearedRows);
 }
 
 bool UInternalBoard::IsRowFull(int32 Row) const
 {
-	for (int32 Col = 0; Col < GetWidth(); ++Col)
-	{
-		if (!IsOccupied({Col, Row}))
-		{
-			return false;
-		}
-	}
-	return true;
+	return State.IsRowFull(Row);
+}
+
+uint32 UInternalBoard::GetRowMask(int32 Row) const
+{
+	return State.GetRowMask(Row);
+}
+
+uint32 UInternalBoard::GetFullRowMask() const
+{
+	return State.GetFullRowMask();
 }
 
 void UInternalBoard::EmptyRow(int32 Row)
 {
-	for (int32 Col = 0; Col < GetWidth(); ++Col)
-	{
-		Grid[Col][Row] = false;
-	}
+	State.EmptyRow(Row);
 }
 
 UInternalBoard* UInternalBoard::NewInternalBoard(int BoardWidth, int BoardHeight)
 {
 	UInternalBoard* Board = NewObject<UInternalBoard>();
 	Board->Initialize(BoardWidth, BoardHeight);
-	Board->PreviousGrid = Board->Grid;
 	return Board;
 }
 
@@ -161,53 +102,45 @@ void UInternalBoard::Initialize(int BoardWidth, int BoardHeight)
 {
 	if (!this){return;} /* Necessary to avoid crash in UE from static NewInternalBoard*/
 
-	/* Empty the grid and fill it with empty columns.*/
-	Grid.Empty();
-	for (int i = 0; i < BoardWidth; ++i)
-	{
-		TArray<bool> Column;
-		Column.Init(false, BoardHeight);
-		Grid.Add(Column);
-	}
+	State.Initialize(BoardWidth, BoardHeight);
 }
 
 void UInternalBoard::Undo()
 {
-	Grid = PreviousGrid;
+	State.Undo();
 }
 
 void UInternalBoard::Commit()
 {
-	PreviousGrid = Grid;
+	State.Commit();
 }
 
-int32 UInternalBoard::GetStackHeight() const
+int32 UInternalBoard::PushUndoLevel()
+{
+	return State.PushUndoLevel();
+}
+
+void UInternalBoard::PopUndoLevel()
 {
-	int32 MaxStackHeight = 0;
-	int32 Width = GetWidth();
+	State.PopUndoLevel();
+}
 
-	for (int32 i = 0; i < Width; ++i)
-	{
-		int32 ColStackHeight = GetStackHeight(i);
-		if (ColStackHeight > MaxStackHeight)
-		{
-			MaxStackHeight = ColStackHeight;
-		}
-	}
-	return MaxStackHeight;
+int32 UInternalBoard::GetUndoDepth() const
+{
+	return State.GetUndoDepth();
+}
+
+int32 UInternalBoard::GetStackHeight() const
+{
+	return State.GetStackHeight();
 }
 
-int32 UInternalBoard::GetStackHeight(int32 Column) const
+uint64 UInternalBoard::GetHash() const
 {
-	int32 Height = GetHeight();
+	return State.GetHash();
+}
 
-	/* Start from the highest possible row */
-	for (int32 i = Height - 1; i >= 0; --i)
-	{
-		if (IsOccupied(FIntPoint(Column, i)))
-		{
-			return i + 1; 
-		}
-	}
-	return 0;
+const FBoardState& UInternalBoard::GetState() const
+{
+	return State;
 }
@@ -1,4 +0,0 @@
-// Copyright (C) 2024 Peter Carsten Collins
-
-
-#include "Piece.h"
\ No newline at end of file
@@ -3,78 +3,58 @@
 
 #include "PieceFactory.h"
 
-UPiece* UPieceFactory::Build(const FPieceData& PieceData)
+bool UPieceFactory::Build(const FPieceData& PieceData, TArray<FPieceShape>& OutShapes) const
 {
-	// Array to hold the pieces
-	UPiece* Pieces[4];
-
-	// Create the initial piece (0-rotation)
-	Pieces[0] = NewObject<UPiece>();
-	Pieces[0]->Body = PieceData.Body;
-	Pieces[0]->Skirt = CalculateSkirt(PieceData.Body);
-
-	// Create the rotated pieces
-	for (int i = 1; i < 4; ++i)
+	if (PieceData.Body.IsEmpty())
 	{
-		Pieces[i] = NewObject<UPiece>();
-		Pieces[i]->Body = CalculateRotation(Pieces[i - 1]->Body, PieceData.RotationOrigin);
-		Pieces[i]->Skirt = CalculateSkirt(Pieces[i]->Body);
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Piece has an empty body. Aborting..."), __FUNCTION__);
+		return false;
 	}
 
-	// Connect the pieces
-	for (int i = 0; i < 4; ++i)
+	// The piece is appended after the pieces already in the table
+	const uint8 Type = static_cast<uint8>(OutShapes.Num() / FPieceShape::NumRotations);
+
+	FPieceShape Shapes[FPieceShape::NumRotations];
+	TArray<FIntPoint> Body = PieceData.Body;
+	for (int32 Rotation = 0; Rotation < FPieceShape::NumRotations; ++Rotation)
 	{
-		Pieces[i]->Next = Pieces[(i + 1) % 4];
-		Pieces[i]->Prev = Pieces[(i + 3) % 4];
+		// Pack the body into row masks of the piece box
+		uint8 RowMasks[FPieceShape::BoxSize] = {};
+		for (const FIntPoint& Point : Body)
+		{
+			if (Point.X < 0 || Point.X >= FPieceShape::BoxSize || Point.Y < 0 || Point.Y >= FPieceShape::BoxSize)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Error in %s: Piece point (%d,%d) is outside of the %dx%d piece box. Aborting..."), __FUNCTION__, Point.X, Point.Y, FPieceShape::BoxSize, FPieceShape::BoxSize);
+				return false;
+			}
+			RowMasks[Point.Y] |= 1 << Point.X;
+		}
+		Shapes[Rotation] = FPieceShape::Make(RowMasks, Type, static_cast<uint8>(Rotation));
+
+		// Rotate the body for the next shape
+		Body = CalculateRotation(Body, PieceData.RotationOrigin);
 	}
 
-	return Pieces[0];
+	OutShapes.Append(Shapes, FPieceShape::NumRotations);
+	return true;
 }
 
 TArray<FIntPoint> UPieceFactory::CalculateRotation(const TArray<FIntPoint>& Points, const FVector2D& RotationOrigin) const
 {
+	// Convert the origin to half cells so that the rotation is exact
+	const int32 OriginX2 = FMath::RoundToInt32(RotationOrigin.X * 2.f);
+	const int32 OriginY2 = FMath::RoundToInt32(RotationOrigin.Y * 2.f);
+
 	TArray<FIntPoint> Rotated;
 	Rotated.Reserve(Points.Num());
 
 	for (const FIntPoint& Point : Points)
 	{
-		// Convert to float and center about the origin
-		FVector2D RotatedFloatPoint{ Point.X - RotationOrigin.X, Point.Y - RotationOrigin.Y };
-
 		// Perform R-rotation (clockwise 90 degrees)
-		RotatedFloatPoint = { RotatedFloatPoint.Y, -RotatedFloatPoint.X };
-
-		// Un-center the points
-		RotatedFloatPoint = { RotatedFloatPoint.X + RotationOrigin.X, RotatedFloatPoint.Y + RotationOrigin.Y };
-
-		// Convert back to FIntPoint
-		FIntPoint RotatedIntPoint{ FMath::RoundToInt32(RotatedFloatPoint.X), FMath::RoundToInt32(RotatedFloatPoint.Y) };
-		Rotated.Add(RotatedIntPoint);
+		int32 X = Point.X;
+		int32 Y = Point.Y;
+		FPieceShape::RotatePointR(X, Y, OriginX2, OriginY2);
+		Rotated.Add({ X, Y });
 	}
 	return Rotated;
 }
-
-TArray<FIntPoint> UPieceFactory::CalculateSkirt(const TArray<FIntPoint>& Points) const
-{
-	/* Mapping of column index to skirt points.*/
-	TMap<int, FIntPoint> SkirtMap;
-
-	/* Track the points with the smallest Y-value in each column.*/
-	for (const FIntPoint& Point : Points)
-	{
-		if (!SkirtMap.Contains(Point.X))
-		{
-			SkirtMap.Add(Point.X, Point);
-		}
-		else if (SkirtMap[Point.X].Y > Point.Y)
-		{
-			SkirtMap[Point.X] = Point;
-		}
-	}
-
-	/* Extract the values from the skirt map into an array.*/
-	TArray<FIntPoint> Skirt;
-	SkirtMap.GenerateValueArray(Skirt);
-	return Skirt;
-}
-
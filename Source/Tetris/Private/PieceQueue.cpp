@@ -3,69 +3,85 @@
 
 #include "PieceQueue.h"
 #include "PieceFactory.h"
-#include "Algo/RandomShuffle.h"
 
 UPieceQueue::UPieceQueue()
 {}
 
-void UPieceQueue::AddBatch()
+void UPieceQueue::SetSequence(const FPieceSequence* InSequence)
 {
-	/* Add a random permutation of all pieces to the queue.*/
-	TArray<UPiece*> ShuffledPieces = Pieces;
-	Algo::RandomShuffle(ShuffledPieces);
+	Sequence = InSequence;
+}
 
-	for (const UPiece* Piece : ShuffledPieces)
-	{
-		Queue.Enqueue(Piece);
-		++QueueSize;
-	}
+const FPieceShape* UPieceQueue::Top() const
+{
+	return Sequence && Sequence->Num() > 0 ? GetPieceShape(Sequence->Top()) : nullptr;
 }
 
-const UPiece* UPieceQueue::Pop()
+TConstArrayView<uint8> UPieceQueue::PeekN(int32 N) const
 {
-	const UPiece* Result;
-	Queue.Dequeue(Result);
-	--QueueSize;
-	/* Keep the queue filled with at least two batch at all times.*/
-	if (QueueSize < 2*Pieces.Num())
-	{
-		AddBatch();
-	}
-	return Result;
+	return Sequence ? Sequence->PeekN(N) : TConstArrayView<uint8>();
+}
+
+const FPieceShape* UPieceQueue::GetPieceShape(uint8 Type) const
+{
+	return &ShapeTable[Type * FPieceShape::NumRotations];
+}
+
+TConstArrayView<FPieceShape> UPieceQueue::GetShapeTable() const
+{
+	return ShapeTable;
+}
+
+int32 UPieceQueue::GetSeed() const
+{
+	return Sequence ? Sequence->GetSeed() : Seed;
 }
 
-const UPiece* UPieceQueue::Top() const
+int32 UPieceQueue::MakeSeed() const
 {
-	const UPiece* Result;
-	Queue.Peek(Result);
-	return Result;
+	return Seed != 0 ? Seed : FMath::Rand();
 }
 
+int32 UPieceQueue::GetNumPieces() const
+{
+	return ShapeTable.Num() / FPieceShape::NumRotations;
+}
 
 void UPieceQueue::BeginPlay()
 {
 	Super::BeginPlay();
 
-	/* Construct the pieces from the data table.*/
-	if (!PieceDataTable)
-	{
-		UE_LOG(LogTemp, Error, TEXT("Error in %s: PieceDataTable not set. Aborting..."), __FUNCTION__)
-		return;
-	}
-
-	/* Construct a piece for each row in the data table.*/
-	UPieceFactory* PieceFactory = NewObject<UPieceFactory>();
-	TArray<FName> RowNames = PieceDataTable->GetRowNames();
-	for (const FName RowName : RowNames)
+	/* Use the standard pieces unless a data table is set.*/
+	ShapeTable = FStandardPieceShapes::Get();
+	if (PieceDataTable)
 	{
-		FString ContextString;
-		FPieceData* Row = PieceDataTable->FindRow<FPieceData>(RowName, ContextString);
-		if (Row)
+		/* Construct the rotations of each row in the data table. The table is built once so the shapes never move.*/
+		UPieceFactory* PieceFactory = NewObject<UPieceFactory>();
+		TArray<FName> RowNames = PieceDataTable->GetRowNames();
+		DataTableShapes.Reserve(RowNames.Num() * FPieceShape::NumRotations);
+		for (const FName RowName : RowNames)
 		{
-			Pieces.Add(PieceFactory->Build(*Row));
+			FString ContextString;
+			FPieceData* Row = PieceDataTable->FindRow<FPieceData>(RowName, ContextString);
+			if (Row)
+			{
+				PieceFactory->Build(*Row, DataTableShapes);
+			}
 		}
+		if (!DataTableShapes.IsEmpty())
+		{
+			ShapeTable = DataTableShapes;
+		}
+	}
+	else
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s: PieceDataTable not set. Using the standard pieces."), __FUNCTION__)
 	}
 
-	/* Add a batch of pieces to the queue.*/
-	AddBatch();
+	/* A bag holds every piece, so the number of pieces is limited by the bag size.*/
+	if (GetNumPieces() > FPieceSequence::MaxBagSize)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d pieces exceeds the maximum of %d. Truncating..."), __FUNCTION__, GetNumPieces(), FPieceSequence::MaxBagSize);
+		ShapeTable = ShapeTable.Left(FPieceSequence::MaxBagSize * FPieceShape::NumRotations);
+	}
 }
@@ -0,0 +1,136 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "PieceSequence.h"
+
+static_assert((FPieceSequence::Capacity & (FPieceSequence::Capacity - 1)) == 0, "FPieceSequence capacity must be a power of two.");
+static_assert(3 * FPieceSequence::MaxBagSize - 1 <= FPieceSequence::Capacity, "FPieceSequence must hold two bags plus a refill.");
+static_assert(UE_ARRAY_COUNT(FPieceSequenceState::Pieces) == FPieceSequence::Capacity, "FPieceSequenceState must hold a full sequence.");
+
+void FPieceSequence::Initialize(int32 InBagSize, int32 InSeed)
+{
+	BagSize = FMath::Clamp(InBagSize, 0, MaxBagSize);
+	Seed = InSeed;
+	RandomStream.Initialize(Seed);
+	Head = 0;
+	Count = 0;
+
+	/* Keep the sequence filled with at least two bags at all times.*/
+	while (BagSize > 0 && Count < 2 * BagSize)
+	{
+		AddBag();
+	}
+}
+
+uint8 FPieceSequence::Pop()
+{
+	check(Count > 0);
+	const uint8 Result = Buffer[Head];
+	Head = (Head + 1) & (Capacity - 1);
+	--Count;
+
+	/* Keep the sequence filled with at least two bags at all times.*/
+	if (Count < 2 * BagSize)
+	{
+		AddBag();
+	}
+	return Result;
+}
+
+uint8 FPieceSequence::Top() const
+{
+	check(Count > 0);
+	return Buffer[Head];
+}
+
+TConstArrayView<uint8> FPieceSequence::PeekN(int32 N) const
+{
+	/* The mirrored half of the buffer keeps the view contiguous when it wraps around.*/
+	return TConstArrayView<uint8>(&Buffer[Head], FMath::Clamp(N, 0, Count));
+}
+
+int32 FPieceSequence::Num() const
+{
+	return Count;
+}
+
+int32 FPieceSequence::GetBagSize() const
+{
+	return BagSize;
+}
+
+int32 FPieceSequence::GetSeed() const
+{
+	return Seed;
+}
+
+bool FPieceSequence::AddBag()
+{
+	if (Count + BagSize > Capacity)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: A bag of %d doesn't fit after %d of %d pieces."), __FUNCTION__, BagSize, Count, Capacity);
+		return false;
+	}
+
+	/* Shuffle a bag of every piece in place.*/
+	uint8 Bag[MaxBagSize];
+	for (int32 i = 0; i < BagSize; ++i)
+	{
+		Bag[i] = static_cast<uint8>(i);
+	}
+	for (int32 i = BagSize - 1; i > 0; --i)
+	{
+		Swap(Bag[i], Bag[RandomStream.RandRange(0, i)]);
+	}
+
+	/* Append the bag, writing each piece to both halves of the buffer.*/
+	for (int32 i = 0; i < BagSize; ++i)
+	{
+		const int32 Index = (Head + Count) & (Capacity - 1);
+		Buffer[Index] = Bag[i];
+		Buffer[Index + Capacity] = Bag[i];
+		++Count;
+	}
+	return true;
+}
+
+void FPieceSequence::GetState(FPieceSequenceState& OutState) const
+{
+	OutState.Seed = Seed;
+	OutState.RandomSeed = RandomStream.GetCurrentSeed();
+	OutState.BagSize = static_cast<uint8>(BagSize);
+	OutState.Count = static_cast<uint8>(Count);
+	FMemory::Memzero(OutState.Pieces, sizeof(OutState.Pieces));
+	FMemory::Memcpy(OutState.Pieces, &Buffer[Head], Count);
+}
+
+bool FPieceSequence::SetState(const FPieceSequenceState& State)
+{
+	/* A valid sequence holds between two bags and the capacity, all of them pieces of the bag.*/
+	if (State.BagSize > MaxBagSize || State.Count > Capacity || State.Count < 2 * State.BagSize)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d pieces in bags of %d is not a valid sequence."), __FUNCTION__, State.Count, State.BagSize);
+		return false;
+	}
+	for (int32 i = 0; i < State.Count; ++i)
+	{
+		if (State.Pieces[i] >= State.BagSize)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Error in %s: Piece %d is not in bags of %d."), __FUNCTION__, State.Pieces[i], State.BagSize);
+			return false;
+		}
+	}
+
+	/* The random stream continues from its saved seed, so later bags are shuffled as they would have been.*/
+	Seed = State.Seed;
+	RandomStream.Initialize(State.RandomSeed);
+	BagSize = State.BagSize;
+	Head = 0;
+	Count = State.Count;
+	for (int32 i = 0; i < Count; ++i)
+	{
+		Buffer[i] = State.Pieces[i];
+		Buffer[i + Capacity] = State.Pieces[i];
+	}
+	return true;
+}
@@ -0,0 +1,38 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "PieceShape.h"
+
+TArray<FIntPoint> FPieceShape::GetBody() const
+{
+	TArray<FIntPoint> Body;
+	for (int32 Row = 0; Row < BoxSize; ++Row)
+	{
+		for (int32 Col = 0; Col < BoxSize; ++Col)
+		{
+			if (RowMasks[Row] & (1 << Col))
+			{
+				Body.Add({ Col, Row });
+			}
+		}
+	}
+	return Body;
+}
+
+TArray<FIntPoint> FPieceShape::GetSkirt() const
+{
+	TArray<FIntPoint> SkirtPoints;
+	for (int32 Col = 0; Col < BoxSize; ++Col)
+	{
+		if (Skirt[Col] != INDEX_NONE)
+		{
+			SkirtPoints.Add({ Col, Skirt[Col] });
+		}
+	}
+	return SkirtPoints;
+}
+
+TConstArrayView<FPieceShape> FStandardPieceShapes::Get()
+{
+	return GStandardPieceShapes.Shapes;
+}
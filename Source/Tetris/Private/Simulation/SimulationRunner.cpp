@@ -0,0 +1,124 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "Simulation/SimulationRunner.h"
+#include "Async/ParallelFor.h"
+
+FSimulationStats& FSimulationStats::operator+=(const FSimulationStats& Other)
+{
+	Ticks += Other.Ticks;
+	GamesFinished += Other.GamesFinished;
+	LinesCleared += Other.LinesCleared;
+	Score += Other.Score;
+	return *this;
+}
+
+void FSimulationRunner::Initialize(const FTetrisSimulationConfig& Config, int32 InNumBoards, int32 FirstSeed, TConstArrayView<FPieceShape> Shapes, int32 NumChunks)
+{
+	NumBoards = FMath::Max(InNumBoards, 0);
+	if (NumChunks <= 0)
+	{
+		NumChunks = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	}
+	NumChunks = FMath::Clamp(NumChunks, 1, FMath::Max(NumBoards, 1));
+	BoardsPerChunk = FMath::DivideAndRoundUp(FMath::Max(NumBoards, 1), NumChunks);
+	NumChunks = FMath::DivideAndRoundUp(FMath::Max(NumBoards, 1), BoardsPerChunk);
+
+	/* Allocate each chunk's games from the task that will step them.*/
+	Chunks.Reset();
+	Chunks.SetNum(NumChunks);
+	ParallelFor(NumChunks, [&](int32 ChunkIndex)
+	{
+		TUniquePtr<FChunk> Chunk = MakeUnique<FChunk>();
+		Chunk->FirstBoard = ChunkIndex * BoardsPerChunk;
+		const int32 NumChunkBoards = FMath::Clamp(NumBoards - Chunk->FirstBoard, 0, BoardsPerChunk);
+		Chunk->Boards.SetNum(NumChunkBoards);
+		Chunk->NextSeeds.SetNum(NumChunkBoards);
+		for (int32 i = 0; i < NumChunkBoards; ++i)
+		{
+			const int32 Seed = FirstSeed + Chunk->FirstBoard + i;
+			FTetrisSimulation& Board = Chunk->Boards[i];
+			Board.Initialize(Config, Shapes);
+			Board.Reset(Seed);
+			Board.Start();
+			Chunk->NextSeeds[i] = Seed + NumBoards;
+		}
+		Chunks[ChunkIndex] = MoveTemp(Chunk);
+	});
+}
+
+void FSimulationRunner::Step(int32 NumTicks)
+{
+	StepChunks(NumTicks, nullptr);
+}
+
+void FSimulationRunner::Step(int32 NumTicks, FController Controller)
+{
+	StepChunks(NumTicks, &Controller);
+}
+
+int32 FSimulationRunner::GetNumBoards() const
+{
+	return NumBoards;
+}
+
+int32 FSimulationRunner::GetNumChunks() const
+{
+	return Chunks.Num();
+}
+
+const FTetrisSimulation& FSimulationRunner::GetBoard(int32 BoardIndex) const
+{
+	check(BoardIndex >= 0 && BoardIndex < NumBoards);
+	return Chunks[BoardIndex / BoardsPerChunk]->Boards[BoardIndex % BoardsPerChunk];
+}
+
+FSimulationStats FSimulationRunner::GetStats() const
+{
+	FSimulationStats Stats;
+	for (const TUniquePtr<FChunk>& Chunk : Chunks)
+	{
+		Stats += Chunk->Stats;
+	}
+	return Stats;
+}
+
+void FSimulationRunner::StepChunks(int32 NumTicks, const FController* Controller)
+{
+	if (NumTicks <= 0 || NumBoards == 0) { return; }
+
+	ParallelFor(Chunks.Num(), [this, NumTicks, Controller](int32 ChunkIndex)
+	{
+		Chunks[ChunkIndex]->Step(NumTicks, NumBoards, Controller);
+	});
+}
+
+void FSimulationRunner::FChunk::Step(int32 NumTicks, int32 SeedStride, const FController* Controller)
+{
+	/* Step one game at a time so that its state stays in cache for all of its ticks.*/
+	for (int32 i = 0; i < Boards.Num(); ++i)
+	{
+		FTetrisSimulation& Board = Boards[i];
+		for (int32 Tick = 0; Tick < NumTicks; ++Tick)
+		{
+			if (Controller)
+			{
+				(*Controller)(Board, FirstBoard + i);
+			}
+			Board.Tick();
+
+			/* Record finished games and start the next one.*/
+			if (Board.IsGameOver())
+			{
+				++Stats.GamesFinished;
+				Stats.LinesCleared += Board.GetLinesCleared();
+				Stats.Score += Board.GetScore();
+				Board.Reset(NextSeeds[i]);
+				Board.Start();
+				NextSeeds[i] += SeedStride;
+			}
+		}
+		Board.ConsumeEvents();
+	}
+	Stats.Ticks += int64(NumTicks) * Boards.Num();
+}
@@ -0,0 +1,286 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "Simulation/TetrisEnvironment.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	/* The eight cells of each byte of a row mask as one byte per cell, lowest column first in little-endian memory.*/
+	struct FCellExpansion
+	{
+		uint64 Cells[256];
+
+		constexpr FCellExpansion()
+			: Cells()
+		{
+			for (int32 Bits = 0; Bits < 256; ++Bits)
+			{
+				for (int32 Bit = 0; Bit < 8; ++Bit)
+				{
+					Cells[Bits] |= uint64((Bits >> Bit) & 1) << (8 * Bit);
+				}
+			}
+		}
+	};
+	constexpr FCellExpansion CellExpansion;
+
+	/* Write a row mask as one byte per cell, eight cells at a time.*/
+	void WriteRowCells(uint32 Mask, int32 Width, uint8* OutCells)
+	{
+		for (int32 Col = 0; Col < Width; Col += 8)
+		{
+			const uint64 Cells = CellExpansion.Cells[(Mask >> Col) & 0xFF];
+			FMemory::Memcpy(OutCells + Col, &Cells, FMath::Min(Width - Col, 8));
+		}
+	}
+
+	/* Check that a buffer is empty or holds the given number of elements.*/
+	template<typename T>
+	bool HasSize(TArrayView<T> Buffer, int64 Size, const TCHAR* Name)
+	{
+		if (Buffer.IsEmpty() || Buffer.Num() == Size) { return true; }
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The %s buffer holds %d elements but %lld are needed."), __FUNCTION__, Name, Buffer.Num(), Size);
+		return false;
+	}
+}
+
+void FTetrisEnvironment::Initialize(const FTetrisSimulationConfig& Config, int32 InNumEnvironments, int32 InNumPreviewPieces, int32 InTicksPerStep, TConstArrayView<FPieceShape> Shapes, int32 NumChunks)
+{
+	NumEnvironments = FMath::Max(InNumEnvironments, 0);
+	NumPreviewPieces = FMath::Clamp(InNumPreviewPieces, 0, FPieceSequence::Capacity);
+	TicksPerStep = FMath::Max(InTicksPerStep, 0);
+	if (NumChunks <= 0)
+	{
+		NumChunks = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	}
+	NumChunks = FMath::Clamp(NumChunks, 1, FMath::Max(NumEnvironments, 1));
+	EnvironmentsPerChunk = FMath::DivideAndRoundUp(FMath::Max(NumEnvironments, 1), NumChunks);
+	NumChunks = FMath::DivideAndRoundUp(FMath::Max(NumEnvironments, 1), EnvironmentsPerChunk);
+
+	/* Allocate each chunk's games from the task that will step them. The games start on Reset.*/
+	Chunks.Reset();
+	Chunks.SetNum(NumChunks);
+	ParallelFor(NumChunks, [&](int32 ChunkIndex)
+	{
+		TUniquePtr<FChunk> Chunk = MakeUnique<FChunk>();
+		Chunk->FirstEnvironment = ChunkIndex * EnvironmentsPerChunk;
+		const int32 NumChunkGames = FMath::Clamp(NumEnvironments - Chunk->FirstEnvironment, 0, EnvironmentsPerChunk);
+		Chunk->Games.SetNum(NumChunkGames);
+		Chunk->NextSeeds.SetNumZeroed(NumChunkGames);
+		for (FTetrisSimulation& Game : Chunk->Games)
+		{
+			Game.Initialize(Config, Shapes);
+		}
+		Chunks[ChunkIndex] = MoveTemp(Chunk);
+	});
+
+	/* The planes cover the whole board, as the simulation sizes it.*/
+	Width = FMath::Min(Config.Width, FBoardState::MaxWidth);
+	Height = Config.Height + Config.TopSpace;
+}
+
+bool FTetrisEnvironment::Reset(TConstArrayView<int32> Seeds, const FTetrisObservationBuffers& OutObservations)
+{
+	if (Seeds.Num() != NumEnvironments)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d seeds were given for %d environments."), __FUNCTION__, Seeds.Num(), NumEnvironments);
+		return false;
+	}
+	if (!ValidateObservations(OutObservations)) { return false; }
+
+	ParallelFor(Chunks.Num(), [this, Seeds, &OutObservations](int32 ChunkIndex)
+	{
+		FChunk& Chunk = *Chunks[ChunkIndex];
+		for (int32 i = 0; i < Chunk.Games.Num(); ++i)
+		{
+			const int32 Index = Chunk.FirstEnvironment + i;
+			FTetrisSimulation& Game = Chunk.Games[i];
+			Game.Reset(Seeds[Index]);
+			Game.Start();
+			Game.ConsumeEvents();
+			Chunk.NextSeeds[i] = Seeds[Index] + NumEnvironments;
+			WriteObservation(Game, Index, OutObservations);
+		}
+	});
+	return true;
+}
+
+bool FTetrisEnvironment::Step(TConstArrayView<uint8> Actions, const FTetrisObservationBuffers& OutObservations, TArrayView<float> OutRewards, TArrayView<uint8> OutDones)
+{
+	if (Actions.Num() != NumEnvironments)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d actions were given for %d environments."), __FUNCTION__, Actions.Num(), NumEnvironments);
+		return false;
+	}
+	if (!ValidateObservations(OutObservations) || !HasSize(OutRewards, NumEnvironments, TEXT("reward")) || !HasSize(OutDones, NumEnvironments, TEXT("done")))
+	{
+		return false;
+	}
+
+	ParallelFor(Chunks.Num(), [this, Actions, &OutObservations, OutRewards, OutDones](int32 ChunkIndex)
+	{
+		FChunk& Chunk = *Chunks[ChunkIndex];
+		for (int32 i = 0; i < Chunk.Games.Num(); ++i)
+		{
+			const int32 Index = Chunk.FirstEnvironment + i;
+			FTetrisSimulation& Game = Chunk.Games[i];
+			const int32 ScoreBefore = Game.GetScore();
+			if (Actions[Index] < NoAction)
+			{
+				Game.ApplyAction(static_cast<EAction>(Actions[Index]));
+			}
+			int32 Tick = 0;
+			for (; Tick < TicksPerStep && !Game.IsGameOver(); ++Tick)
+			{
+				Game.Tick();
+			}
+			Chunk.Stats.Ticks += Tick;
+
+			/* The score only changes by the scoring rules of the game, so the reward is what they awarded this step.*/
+			const bool bDone = Game.IsGameOver();
+			if (!OutRewards.IsEmpty())
+			{
+				OutRewards[Index] = float(Game.GetScore() - ScoreBefore);
+			}
+			if (!OutDones.IsEmpty())
+			{
+				OutDones[Index] = bDone ? 1 : 0;
+			}
+
+			/* Record finished games and start the next one.*/
+			if (bDone)
+			{
+				++Chunk.Stats.GamesFinished;
+				Chunk.Stats.LinesCleared += Game.GetLinesCleared();
+				Chunk.Stats.Score += Game.GetScore();
+				Game.Reset(Chunk.NextSeeds[i]);
+				Game.Start();
+				Chunk.NextSeeds[i] += NumEnvironments;
+			}
+			Game.ConsumeEvents();
+			WriteObservation(Game, Index, OutObservations);
+		}
+	});
+	return true;
+}
+
+int32 FTetrisEnvironment::GetNumEnvironments() const
+{
+	return NumEnvironments;
+}
+
+int32 FTetrisEnvironment::GetNumChunks() const
+{
+	return Chunks.Num();
+}
+
+int32 FTetrisEnvironment::GetWidth() const
+{
+	return Width;
+}
+
+int32 FTetrisEnvironment::GetHeight() const
+{
+	return Height;
+}
+
+int32 FTetrisEnvironment::GetNumPreviewPieces() const
+{
+	return NumPreviewPieces;
+}
+
+int32 FTetrisEnvironment::GetPlanesSize() const
+{
+	return NumPlanes * Width * Height;
+}
+
+int32 FTetrisEnvironment::GetPreviewSize() const
+{
+	return NumPreviewPieces;
+}
+
+int32 FTetrisEnvironment::GetColumnHeightsSize() const
+{
+	return Width;
+}
+
+const FTetrisSimulation& FTetrisEnvironment::GetEnvironment(int32 Index) const
+{
+	check(Index >= 0 && Index < NumEnvironments);
+	return Chunks[Index / EnvironmentsPerChunk]->Games[Index % EnvironmentsPerChunk];
+}
+
+FSimulationStats FTetrisEnvironment::GetStats() const
+{
+	FSimulationStats Stats;
+	for (const TUniquePtr<FChunk>& Chunk : Chunks)
+	{
+		Stats += Chunk->Stats;
+	}
+	return Stats;
+}
+
+bool FTetrisEnvironment::ValidateObservations(const FTetrisObservationBuffers& Observations) const
+{
+	return HasSize(Observations.Planes, int64(NumEnvironments) * GetPlanesSize(), TEXT("planes"))
+		&& HasSize(Observations.Pieces, int64(NumEnvironments) * NumPieceValues, TEXT("pieces"))
+		&& HasSize(Observations.Preview, int64(NumEnvironments) * GetPreviewSize(), TEXT("preview"))
+		&& HasSize(Observations.ColumnHeights, int64(NumEnvironments) * GetColumnHeightsSize(), TEXT("column heights"));
+}
+
+void FTetrisEnvironment::WriteObservation(const FTetrisSimulation& Game, int32 Index, const FTetrisObservationBuffers& OutObservations) const
+{
+	const FBoardState& Board = Game.GetBoard();
+	const FPieceShape* Piece = Game.GetCurrentPiece();
+	const FIntPoint& Coordinate = Game.GetCurrentCoordinate();
+
+	/* Expand the row masks of the stack, then of the active piece, into one byte per cell.*/
+	if (!OutObservations.Planes.IsEmpty())
+	{
+		uint8* StackPlane = OutObservations.Planes.GetData() + int64(Index) * GetPlanesSize();
+		uint8* PiecePlane = StackPlane + Width * Height;
+		for (int32 Row = 0; Row < Height; ++Row)
+		{
+			WriteRowCells(Board.GetRowMask(Row), Width, StackPlane + Row * Width);
+		}
+		FMemory::Memzero(PiecePlane, Width * Height);
+		if (Piece)
+		{
+			for (int32 PieceRow = Piece->MinY; PieceRow <= Piece->MaxY; ++PieceRow)
+			{
+				const int32 Row = Coordinate.Y + PieceRow;
+				if (Row >= 0 && Row < Height)
+				{
+					WriteRowCells(Piece->GetRowMask(PieceRow, Coordinate.X), Width, PiecePlane + Row * Width);
+				}
+			}
+		}
+	}
+
+	if (!OutObservations.Pieces.IsEmpty())
+	{
+		int32* PieceValues = OutObservations.Pieces.GetData() + int64(Index) * NumPieceValues;
+		PieceValues[0] = Piece ? Piece->Type : INDEX_NONE;
+		PieceValues[1] = Piece ? Piece->Rotation : INDEX_NONE;
+		PieceValues[2] = Piece ? Coordinate.X : INDEX_NONE;
+		PieceValues[3] = Piece ? Coordinate.Y : INDEX_NONE;
+	}
+
+	if (!OutObservations.Preview.IsEmpty())
+	{
+		uint8* Preview = OutObservations.Preview.GetData() + int64(Index) * NumPreviewPieces;
+		const TConstArrayView<uint8> Queue = Game.GetSequence().PeekN(NumPreviewPieces);
+		FMemory::Memcpy(Preview, Queue.GetData(), Queue.Num());
+		FMemory::Memset(Preview + Queue.Num(), MAX_uint8, NumPreviewPieces - Queue.Num());
+	}
+
+	if (!OutObservations.ColumnHeights.IsEmpty())
+	{
+		uint8* ColumnHeights = OutObservations.ColumnHeights.GetData() + int64(Index) * Width;
+		for (int32 Col = 0; Col < Width; ++Col)
+		{
+			ColumnHeights[Col] = uint8(FMath::Min(Board.GetColumnHeight(Col), int32(MAX_uint8)));
+		}
+	}
+}
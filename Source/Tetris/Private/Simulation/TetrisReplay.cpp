@@ -0,0 +1,617 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "Simulation/TetrisReplay.h"
+#include "Containers/Queue.h"
+#include "HAL/FileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include <atomic>
+
+static_assert(sizeof(FTetrisReplayHeader) == 44, "The replay header must not contain padding.");
+
+namespace TetrisReplay
+{
+	/* Append a variable length integer, seven bits per byte with the high bit set on every byte but the last.*/
+	void WriteVarInt(TArray<uint8>& Buffer, uint64 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Buffer.Add(uint8(Value) | 0x80);
+			Value >>= 7;
+		}
+		Buffer.Add(uint8(Value));
+	}
+
+	/* Map signed integers to unsigned so that small magnitudes stay short.*/
+	uint64 ZigZag(int32 Value)
+	{
+		return (uint64(uint32(Value)) << 1) ^ (Value < 0 ? ~uint64(0) : 0);
+	}
+
+	int32 UnZigZag(uint64 Value)
+	{
+		return int32(uint32(Value >> 1) ^ (0u - uint32(Value & 1)));
+	}
+
+	/* Whether a header describes a game the simulation can be built for.*/
+	bool IsValidGame(const FTetrisReplayHeader& Header)
+	{
+		return Header.Width >= 1 && Header.Width <= FBoardState::MaxWidth
+			&& Header.Height >= 0 && Header.TopSpace >= 0 && Header.Height <= FTetrisReplayHeader::MaxRows - Header.TopSpace
+			&& Header.TicksPerSecond > 0 && Header.CollapseDelayTicks >= 0;
+	}
+}
+
+/**
+ * Writes a replay log to a file from its own thread.
+ *
+ * Chunks are handed over through a single producer, single consumer queue and handed back empty through another, so
+ * the game thread never blocks and reuses the chunk buffers once the first few are in circulation. Each hand-over still
+ * allocates a queue node.
+ */
+class FTetrisReplayWriter : public FRunnable
+{
+public:
+	/* Open the file and start the writer thread. Return null if the file can't be opened.*/
+	static TUniquePtr<FTetrisReplayWriter> Create(const FString& Filename)
+	{
+		FArchive* Archive = IFileManager::Get().CreateFileWriter(*Filename);
+		if (!Archive)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not open %s for writing."), __FUNCTION__, *Filename);
+			return nullptr;
+		}
+
+		TUniquePtr<FTetrisReplayWriter> Writer = MakeUnique<FTetrisReplayWriter>();
+		Writer->Archive.Reset(Archive);
+		Writer->WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		Writer->Thread = FRunnableThread::Create(Writer.Get(), TEXT("TetrisReplayWriter"), 0, TPri_BelowNormal);
+		return Writer;
+	}
+
+	/* Write everything handed over and close the file, waiting for the thread if it hasn't finished.*/
+	virtual ~FTetrisReplayWriter() override
+	{
+		Close();
+		if (Thread)
+		{
+			Thread->WaitForCompletion();
+			delete Thread;
+		}
+		else
+		{
+			Drain();
+			Archive->Close();
+		}
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	}
+
+	/* Stop accepting chunks. The thread writes what it has been handed and closes the file without being waited on.*/
+	void Close()
+	{
+		bFinishing = true;
+		if (Thread)
+		{
+			WakeEvent->Trigger();
+		}
+	}
+
+	/* Hand a chunk to the writer, replacing it with an empty buffer.*/
+	void Write(TArray<uint8>& Chunk)
+	{
+		Pending.Enqueue(MoveTemp(Chunk));
+		if (!Recycled.Dequeue(Chunk))
+		{
+			Chunk = TArray<uint8>();
+		}
+
+		/* Without a thread, write straight away.*/
+		if (Thread)
+		{
+			WakeEvent->Trigger();
+		}
+		else
+		{
+			Drain();
+		}
+	}
+
+	/*** FRunnable overrides ***/
+	virtual uint32 Run() override
+	{
+		for (;;)
+		{
+			/* Read the flag before draining, so that every chunk handed over before finishing is written.*/
+			const bool bLastPass = bFinishing;
+			Drain();
+			if (bLastPass) { break; }
+			WakeEvent->Wait();
+		}
+		Archive->Close();
+		return 0;
+	}
+
+private:
+	/* The file being written.*/
+	TUniquePtr<FArchive> Archive;
+
+	/* The chunks waiting to be written, and the emptied chunks waiting to be reused.*/
+	TQueue<TArray<uint8>, EQueueMode::Spsc> Pending;
+	TQueue<TArray<uint8>, EQueueMode::Spsc> Recycled;
+
+	/* The event that wakes the thread when there is something to write.*/
+	FEvent* WakeEvent{ nullptr };
+
+	/* The writer thread, or null if the platform has no threads.*/
+	FRunnableThread* Thread{ nullptr };
+
+	/* Flag set when no more chunks will be handed over.*/
+	std::atomic<bool> bFinishing{ false };
+
+	/* Write the chunks handed over so far and hand them back.*/
+	void Drain()
+	{
+		TArray<uint8> Chunk;
+		while (Pending.Dequeue(Chunk))
+		{
+			Archive->Serialize(Chunk.GetData(), Chunk.Num());
+			Chunk.Reset();
+			Recycled.Enqueue(MoveTemp(Chunk));
+		}
+		Archive->Flush();
+	}
+};
+
+bool FTetrisReplayReader::Initialize(TConstArrayView<uint8> InData)
+{
+	Data = InData;
+	Offset = 0;
+	Step = 0;
+	if (Data.Num() < int32(sizeof(FTetrisReplayHeader)))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The replay is too short to hold a header."), __FUNCTION__);
+		return false;
+	}
+
+	FMemory::Memcpy(&Header, Data.GetData(), sizeof(FTetrisReplayHeader));
+	if (Header.FileMagic != FTetrisReplayHeader::Magic || Header.Version != FTetrisReplayHeader::CurrentVersion || Header.HeaderSize < sizeof(FTetrisReplayHeader) || Header.HeaderSize > Data.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The replay is not a version %d replay."), __FUNCTION__, FTetrisReplayHeader::CurrentVersion);
+		return false;
+	}
+	if (!TetrisReplay::IsValidGame(Header))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The replay header describes an impossible game."), __FUNCTION__);
+		return false;
+	}
+	Offset = Header.HeaderSize;
+	return true;
+}
+
+const FTetrisReplayHeader& FTetrisReplayReader::GetHeader() const
+{
+	return Header;
+}
+
+bool FTetrisReplayReader::Next(FTetrisReplayEntry& OutEntry)
+{
+	if (IsAtEnd()) { return false; }
+
+	const uint8 First = Data[Offset++];
+	uint64 StepDelta = 0;
+	if (!ReadVarInt(StepDelta)) { return false; }
+	Step += int64(StepDelta);
+
+	OutEntry.Type = ETetrisReplayRecord(First & 0x3);
+	OutEntry.Step = Step;
+	switch (OutEntry.Type)
+	{
+	case ETetrisReplayRecord::Action:
+		OutEntry.Action = EAction(First >> 2);
+		return true;
+
+	case ETetrisReplayRecord::Lock:
+	{
+		uint64 X = 0, Y = 0, NumLines = 0;
+		if (Offset + 2 > Data.Num()) { return false; }
+		OutEntry.PieceType = Data[Offset++];
+		OutEntry.Rotation = Data[Offset++];
+		if (!ReadVarInt(X) || !ReadVarInt(Y) || !ReadVarInt(NumLines)) { return false; }
+		OutEntry.Coordinate = { TetrisReplay::UnZigZag(X), TetrisReplay::UnZigZag(Y) };
+		OutEntry.NumLines = int32(NumLines);
+		return true;
+	}
+
+	case ETetrisReplayRecord::End:
+	{
+		uint64 Score = 0, LinesCleared = 0;
+		if (!ReadVarInt(Score) || !ReadVarInt(LinesCleared)) { return false; }
+		OutEntry.Score = int32(Score);
+		OutEntry.LinesCleared = int32(LinesCleared);
+		return true;
+	}
+
+	default:
+		return true;
+	}
+}
+
+bool FTetrisReplayReader::IsAtEnd() const
+{
+	return Offset >= Data.Num();
+}
+
+uint32 FTetrisReplayReader::GetShapeTableCrc(TConstArrayView<FPieceShape> Shapes)
+{
+	return FCrc::MemCrc32(Shapes.GetData(), Shapes.Num() * sizeof(FPieceShape));
+}
+
+bool FTetrisReplayReader::ReadVarInt(uint64& OutValue)
+{
+	OutValue = 0;
+	for (int32 Shift = 0; Shift < 64; Shift += 7)
+	{
+		if (Offset >= Data.Num()) { return false; }
+		const uint8 Byte = Data[Offset++];
+		OutValue |= uint64(Byte & 0x7F) << Shift;
+		if (!(Byte & 0x80)) { return true; }
+	}
+	return false;
+}
+
+FTetrisReplayRecorder::FTetrisReplayRecorder() = default;
+
+FTetrisReplayRecorder::~FTetrisReplayRecorder()
+{
+	Finish();
+}
+
+bool FTetrisReplayRecorder::Begin(FTetrisSimulation& InSimulation)
+{
+	Finish();
+	Buffer.Reset();
+	RetiredWriter.Reset();
+	return BeginRecording(InSimulation);
+}
+
+bool FTetrisReplayRecorder::Begin(FTetrisSimulation& InSimulation, const FString& Filename)
+{
+	Finish();
+	Buffer.Reset();
+	RetiredWriter.Reset();
+	if (!BeginRecording(InSimulation)) { return false; }
+
+	/* Stop observing the game if the file can't be written.*/
+	Writer = FTetrisReplayWriter::Create(Filename);
+	if (!Writer)
+	{
+		Simulation->SetObserver(nullptr);
+		Simulation = nullptr;
+		Buffer.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool FTetrisReplayRecorder::BeginRecording(FTetrisSimulation& InSimulation)
+{
+	if (InSimulation.GetPhase() != ETetrisPhase::Idle || InSimulation.GetStepCount() != 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Recording must begin before the game starts."), __FUNCTION__);
+		return false;
+	}
+	if (InSimulation.GetObserver())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The game is already observed."), __FUNCTION__);
+		return false;
+	}
+
+	/* Write the header.*/
+	const FTetrisSimulationConfig& Config = InSimulation.GetConfig();
+	const TConstArrayView<FPieceShape> Shapes = InSimulation.GetShapeTable();
+	FTetrisReplayHeader Header;
+	Header.FileMagic = FTetrisReplayHeader::Magic;
+	Header.Version = FTetrisReplayHeader::CurrentVersion;
+	Header.HeaderSize = sizeof(FTetrisReplayHeader);
+	Header.Width = Config.Width;
+	Header.Height = Config.Height;
+	Header.TopSpace = Config.TopSpace;
+	Header.TicksPerSecond = Config.TicksPerSecond;
+	Header.CollapseDelayTicks = Config.CollapseDelayTicks;
+	Header.Gravity = Config.Gravity;
+	Header.Seed = InSimulation.GetSequence().GetSeed();
+	Header.ShapeTableCrc = FTetrisReplayReader::GetShapeTableCrc(Shapes);
+	Header.NumShapes = Shapes.Num();
+	if (!TetrisReplay::IsValidGame(Header))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The game is too large to record."), __FUNCTION__);
+		return false;
+	}
+	Buffer.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+
+	Simulation = &InSimulation;
+	Simulation->SetObserver(this);
+	LastStep = 0;
+	return true;
+}
+
+void FTetrisReplayRecorder::Finish(bool bWaitForWriter)
+{
+	if (!Simulation) { return; }
+
+	/* Log the final metrics.*/
+	WriteRecord(ETetrisReplayRecord::End);
+	TetrisReplay::WriteVarInt(Buffer, uint64(Simulation->GetScore()));
+	TetrisReplay::WriteVarInt(Buffer, uint64(Simulation->GetLinesCleared()));
+
+	Simulation->SetObserver(nullptr);
+	Simulation = nullptr;
+
+	/* Destroying the writer waits for it to write everything. Otherwise it is kept until the next recording, by when it is done.*/
+	if (Writer)
+	{
+		FlushChunk(true);
+		Writer->Close();
+		RetiredWriter = MoveTemp(Writer);
+		if (bWaitForWriter)
+		{
+			RetiredWriter.Reset();
+		}
+		Buffer.Reset();
+	}
+}
+
+bool FTetrisReplayRecorder::IsRecording() const
+{
+	return Simulation != nullptr;
+}
+
+TConstArrayView<uint8> FTetrisReplayRecorder::GetRecording() const
+{
+	return Writer ? TConstArrayView<uint8>() : TConstArrayView<uint8>(Buffer);
+}
+
+void FTetrisReplayRecorder::OnAction(const FTetrisSimulation& InSimulation, EAction Action)
+{
+	WriteRecord(ETetrisReplayRecord::Action, uint8(Action));
+	FlushChunk(false);
+}
+
+void FTetrisReplayRecorder::OnLock(const FTetrisSimulation& InSimulation, const FPieceShape& Piece, const FIntPoint& Coordinate, int32 NumLines)
+{
+	WriteRecord(ETetrisReplayRecord::Lock);
+	Buffer.Add(Piece.Type);
+	Buffer.Add(Piece.Rotation);
+	TetrisReplay::WriteVarInt(Buffer, TetrisReplay::ZigZag(Coordinate.X));
+	TetrisReplay::WriteVarInt(Buffer, TetrisReplay::ZigZag(Coordinate.Y));
+	TetrisReplay::WriteVarInt(Buffer, uint64(NumLines));
+	FlushChunk(false);
+}
+
+void FTetrisReplayRecorder::OnCollapse(const FTetrisSimulation& InSimulation)
+{
+	WriteRecord(ETetrisReplayRecord::Collapse);
+	FlushChunk(false);
+}
+
+void FTetrisReplayRecorder::WriteRecord(ETetrisReplayRecord Type, uint8 Payload)
+{
+	const int64 Step = Simulation->GetStepCount();
+	Buffer.Add(uint8(Type) | uint8(Payload << 2));
+	TetrisReplay::WriteVarInt(Buffer, uint64(Step - LastStep));
+	LastStep = Step;
+}
+
+void FTetrisReplayRecorder::FlushChunk(bool bForce)
+{
+	if (!Writer || Buffer.IsEmpty() || (!bForce && Buffer.Num() < ChunkSize)) { return; }
+	Writer->Write(Buffer);
+	Buffer.Reset();
+}
+
+FTetrisReplayPlayer::~FTetrisReplayPlayer()
+{
+	Stop();
+}
+
+bool FTetrisReplayPlayer::Begin(FTetrisSimulation& InSimulation, TArray<uint8>&& InReplay, TConstArrayView<FPieceShape> Shapes)
+{
+	Stop();
+	Replay = MoveTemp(InReplay);
+	Result = ETetrisReplayResult::Invalid;
+	Error.Reset();
+	if (!Reader.Initialize(Replay))
+	{
+		Error = TEXT("The replay has no valid header.");
+		return false;
+	}
+
+	/* The recorded actions only replay the game on the shape table it was recorded with.*/
+	const FTetrisReplayHeader& Header = Reader.GetHeader();
+	const TConstArrayView<FPieceShape> ShapeTable = Shapes.IsEmpty() ? FStandardPieceShapes::Get() : Shapes;
+	if (Header.NumShapes != ShapeTable.Num() || Header.ShapeTableCrc != FTetrisReplayReader::GetShapeTableCrc(ShapeTable))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The replay was recorded with another shape table."), __FUNCTION__);
+		Error = TEXT("The replay was recorded with another shape table.");
+		return false;
+	}
+
+	/* Rebuild the game from the header.*/
+	FTetrisSimulationConfig Config;
+	Config.Width = Header.Width;
+	Config.Height = Header.Height;
+	Config.TopSpace = Header.TopSpace;
+	Config.TicksPerSecond = Header.TicksPerSecond;
+	Config.CollapseDelayTicks = Header.CollapseDelayTicks;
+	Config.Gravity = Header.Gravity;
+	Simulation = &InSimulation;
+	Simulation->SetObserver(nullptr);
+	Simulation->Initialize(Config, Shapes);
+	Simulation->Reset(Header.Seed);
+	Simulation->SetObserver(this);
+
+	Result = ETetrisReplayResult::Playing;
+	Simulation->Start();
+	ReadEntry();
+	return true;
+}
+
+bool FTetrisReplayPlayer::Begin(FTetrisSimulation& InSimulation, const FString& Filename, TConstArrayView<FPieceShape> Shapes)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not read %s."), __FUNCTION__, *Filename);
+		Stop();
+		Result = ETetrisReplayResult::Invalid;
+		Error = TEXT("The replay file could not be read.");
+		return false;
+	}
+	return Begin(InSimulation, MoveTemp(Bytes), Shapes);
+}
+
+ETetrisReplayResult FTetrisReplayPlayer::Advance(int64 NumSteps)
+{
+	for (;;)
+	{
+		PlayDueRecords();
+		if (Result != ETetrisReplayResult::Playing || NumSteps-- <= 0) { break; }
+		Simulation->Tick();
+	}
+	return Result;
+}
+
+ETetrisReplayResult FTetrisReplayPlayer::PlayToEnd()
+{
+	return Advance(MAX_int64);
+}
+
+void FTetrisReplayPlayer::Stop()
+{
+	if (Simulation && Simulation->GetObserver() == this)
+	{
+		Simulation->SetObserver(nullptr);
+	}
+	Simulation = nullptr;
+	bHasEntry = false;
+}
+
+ETetrisReplayResult FTetrisReplayPlayer::GetResult() const
+{
+	return Result;
+}
+
+const FString& FTetrisReplayPlayer::GetError() const
+{
+	return Error;
+}
+
+const FTetrisReplayHeader& FTetrisReplayPlayer::GetHeader() const
+{
+	return Reader.GetHeader();
+}
+
+void FTetrisReplayPlayer::OnLock(const FTetrisSimulation& InSimulation, const FPieceShape& Piece, const FIntPoint& Coordinate, int32 NumLines)
+{
+	if (Result != ETetrisReplayResult::Playing) { return; }
+
+	/* Every lock must be the next record of the log.*/
+	const int64 Step = InSimulation.GetStepCount();
+	if (!bHasEntry || Entry.Type != ETetrisReplayRecord::Lock || Entry.Step != Step)
+	{
+		Finish(ETetrisReplayResult::Diverged, FString::Printf(TEXT("A piece locked on step %lld that was not recorded."), Step));
+		return;
+	}
+	if (Entry.PieceType != Piece.Type || Entry.Rotation != Piece.Rotation || Entry.Coordinate != Coordinate || Entry.NumLines != NumLines)
+	{
+		Finish(ETetrisReplayResult::Diverged, FString::Printf(TEXT("The piece locked on step %lld differs from the recording."), Step));
+		return;
+	}
+	ReadEntry();
+}
+
+void FTetrisReplayPlayer::OnCollapse(const FTetrisSimulation& InSimulation)
+{
+	if (Result != ETetrisReplayResult::Playing) { return; }
+
+	const int64 Step = InSimulation.GetStepCount();
+	if (!bHasEntry || Entry.Type != ETetrisReplayRecord::Collapse || Entry.Step != Step)
+	{
+		Finish(ETetrisReplayResult::Diverged, FString::Printf(TEXT("The board collapsed on step %lld without a recorded collapse."), Step));
+		return;
+	}
+	ReadEntry();
+}
+
+void FTetrisReplayPlayer::PlayDueRecords()
+{
+	const int64 Step = Simulation->GetStepCount();
+	while (Result == ETetrisReplayResult::Playing && bHasEntry && Entry.Step <= Step)
+	{
+		switch (Entry.Type)
+		{
+		case ETetrisReplayRecord::Action:
+		{
+			/* Read ahead before applying the action, as any lock it causes is checked against the next record.*/
+			const EAction Action = Entry.Action;
+			ReadEntry();
+			if (Result == ETetrisReplayResult::Playing)
+			{
+				Simulation->ApplyAction(Action);
+			}
+			break;
+		}
+
+		case ETetrisReplayRecord::Collapse:
+			/* A collapse recorded while the board is still clearing was forced early. The collapse consumes the record.*/
+			if (Simulation->GetPhase() != ETetrisPhase::Clearing)
+			{
+				Finish(ETetrisReplayResult::Diverged, FString::Printf(TEXT("The board did not collapse on step %lld."), Entry.Step));
+				break;
+			}
+			Simulation->Collapse();
+			break;
+
+		case ETetrisReplayRecord::Lock:
+			Finish(ETetrisReplayResult::Diverged, FString::Printf(TEXT("No piece locked on step %lld."), Entry.Step));
+			break;
+
+		case ETetrisReplayRecord::End:
+			if (Simulation->GetScore() != Entry.Score || Simulation->GetLinesCleared() != Entry.LinesCleared)
+			{
+				Finish(ETetrisReplayResult::Diverged, FString::Printf(TEXT("Played %d points and %d lines, recorded %d points and %d lines."),
+					Simulation->GetScore(), Simulation->GetLinesCleared(), Entry.Score, Entry.LinesCleared));
+				break;
+			}
+			Finish(ETetrisReplayResult::Verified);
+			break;
+		}
+	}
+}
+
+void FTetrisReplayPlayer::ReadEntry()
+{
+	bHasEntry = Reader.Next(Entry);
+	if (!bHasEntry)
+	{
+		Finish(ETetrisReplayResult::Invalid, TEXT("The replay ends without a result."));
+	}
+}
+
+void FTetrisReplayPlayer::Finish(ETetrisReplayResult InResult, const FString& InError)
+{
+	Result = InResult;
+	Error = InError;
+	if (Result == ETetrisReplayResult::Verified)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Replay verified: %d points, %d lines."), Simulation->GetScore(), Simulation->GetLinesCleared());
+	}
+	else if (Result == ETetrisReplayResult::Diverged || Result == ETetrisReplayResult::Invalid)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Replay playback failed: %s"), *Error);
+	}
+	Stop();
+}
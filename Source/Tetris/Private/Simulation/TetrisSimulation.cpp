@@ -0,0 +1,429 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "Simulation/TetrisSimulation.h"
+#include "Core/TetrisStats.h"
+
+void FTetrisSimulation::Initialize(const FTetrisSimulationConfig& InConfig, TConstArrayView<FPieceShape> InShapes)
+{
+	Config = InConfig;
+	if (Config.TicksPerSecond <= 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d ticks per second is not positive. Using 60..."), __FUNCTION__, Config.TicksPerSecond);
+		Config.TicksPerSecond = 60;
+	}
+
+	/* Use the standard pieces unless a shape table is given.*/
+	Shapes = InShapes.IsEmpty() ? FStandardPieceShapes::Get() : InShapes;
+
+	/* A bag holds every piece, so the number of pieces is limited by the bag size.*/
+	if (Shapes.Num() > FPieceSequence::MaxBagSize * FPieceShape::NumRotations)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d pieces exceeds the maximum of %d. Truncating..."), __FUNCTION__, Shapes.Num() / FPieceShape::NumRotations, FPieceSequence::MaxBagSize);
+		Shapes = Shapes.Left(FPieceSequence::MaxBagSize * FPieceShape::NumRotations);
+	}
+
+	Reset(Sequence.GetSeed());
+}
+
+void FTetrisSimulation::Reset(int32 Seed)
+{
+	/* Clear the board.*/
+	Board.Initialize(Config.Width, Config.Height + Config.TopSpace);
+	Sequence.Initialize(Shapes.Num() / FPieceShape::NumRotations, Seed);
+	CurrentPiece = nullptr;
+	CurrentCoordinate = { 0, 0 };
+	ClearedRows.Reset();
+
+	/* Reset metrics.*/
+	Phase = ETetrisPhase::Idle;
+	Score = 0;
+	LinesCleared = 0;
+	ElapsedTicks = 0;
+	StepCount = 0;
+	GravityAccumulator = 0;
+	CollapseCounter = 0;
+	PendingEvents = ETetrisEvents::StackChanged | ETetrisEvents::PieceMoved;
+}
+
+void FTetrisSimulation::Start()
+{
+	if (Phase != ETetrisPhase::Idle) { return; }
+	SpawnPiece();
+}
+
+void FTetrisSimulation::Tick()
+{
+	++StepCount;
+
+	/* The game clock runs from the first piece until the game ends, including the time rows are shown cleared.*/
+	if (Phase == ETetrisPhase::Falling || Phase == ETetrisPhase::Clearing)
+	{
+		++ElapsedTicks;
+	}
+	switch (Phase)
+	{
+	case ETetrisPhase::Falling:
+	{
+		int32 GravityRows = 0;
+		int32 GravitySteps = 0;
+		GetGravity(GravityRows, GravitySteps);
+		GravityAccumulator += GravityRows;
+		ApplyGravity(GravitySteps);
+		break;
+	}
+
+	case ETetrisPhase::Clearing:
+		/* Collapse the board once the cleared rows have been shown for the delay.*/
+		if (--CollapseCounter <= 0)
+		{
+			Collapse();
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool FTetrisSimulation::ApplyAction(EAction Action)
+{
+	/* Do nothing if there isn't a piece in play.*/
+	if (Phase != ETetrisPhase::Falling || !CurrentPiece) { return false; }
+	if (Observer)
+	{
+		Observer->OnAction(*this, Action);
+	}
+
+	/* Drop the piece straight onto the stack and lock it in one step.*/
+	if (Action == EAction::HARD_DROP)
+	{
+		CurrentCoordinate.Y = Board.GetDropRow(*CurrentPiece, CurrentCoordinate);
+		LockPiece();
+		return true;
+	}
+
+	/* Set the new placement according to the action.*/
+	FIntPoint NewCoordinate = CurrentCoordinate;
+	const FPieceShape* NewPiece = CurrentPiece;
+	switch (Action)
+	{
+	case EAction::DOWN:
+		--NewCoordinate.Y;
+		break;
+	case EAction::LEFT:
+		--NewCoordinate.X;
+		break;
+	case EAction::RIGHT:
+		++NewCoordinate.X;
+		break;
+	case EAction::ROTATE_L:
+		NewPiece = &CurrentPiece->RotateL();
+		break;
+	case EAction::ROTATE_R:
+		NewPiece = &CurrentPiece->RotateR();
+		break;
+	default:
+		break;
+	}
+
+	/* Test the new placement against the locked stack. The board is never modified while the piece falls.*/
+	if (Board.CanPlace(*NewPiece, NewCoordinate))
+	{
+		CurrentPiece = NewPiece;
+		CurrentCoordinate = NewCoordinate;
+		PendingEvents |= ETetrisEvents::PieceMoved;
+		return true;
+	}
+
+	/* If the piece could not be moved down, start the lock procedure.*/
+	INC_DWORD_STAT(STAT_TetrisRejectedMoves);
+	if (Action == EAction::DOWN)
+	{
+		LockPiece();
+	}
+	return false;
+}
+
+int32 FTetrisSimulation::ApplyActions(TConstArrayView<EAction> Actions)
+{
+	int32 NumApplied = 0;
+	for (const EAction Action : Actions)
+	{
+		NumApplied += ApplyAction(Action) ? 1 : 0;
+	}
+	return NumApplied;
+}
+
+void FTetrisSimulation::SpawnPiece()
+{
+	if (Phase == ETetrisPhase::GameOver || Shapes.IsEmpty()) { return; }
+
+	/* Add the next piece to the top of the board.*/
+	CurrentPiece = &Shapes[Sequence.Pop() * FPieceShape::NumRotations];
+	CurrentCoordinate = GetSpawnCoordinate();
+	GravityAccumulator = 0;
+	PendingEvents |= ETetrisEvents::PieceSpawned | ETetrisEvents::PieceMoved;
+
+	/* The game is over if the new piece overlaps the stack.*/
+	if (!Board.CanPlace(*CurrentPiece, CurrentCoordinate))
+	{
+		CurrentPiece = nullptr;
+		Phase = ETetrisPhase::GameOver;
+		PendingEvents |= ETetrisEvents::GameOver;
+		return;
+	}
+	Phase = ETetrisPhase::Falling;
+}
+
+void FTetrisSimulation::ApplyGravity(int32 StepsPerRow)
+{
+	/* The remainder is carried to the next step, so no fraction of a row is lost or gained.*/
+	const int32 DueRows = GravityAccumulator / StepsPerRow;
+	if (DueRows == 0) { return; }
+	GravityAccumulator -= DueRows * StepsPerRow;
+
+	/* Move straight to the landing row rather than testing each row on the way down.*/
+	const int32 DropRow = Board.GetDropRow(*CurrentPiece, CurrentCoordinate);
+	const int32 DropDistance = CurrentCoordinate.Y - DropRow;
+	if (DropDistance > 0)
+	{
+		CurrentCoordinate.Y -= FMath::Min(DueRows, DropDistance);
+		PendingEvents |= ETetrisEvents::PieceMoved;
+	}
+
+	/* A drop that is due once the piece has landed locks it, as when a DOWN action fails.*/
+	if (DueRows > DropDistance)
+	{
+		LockPiece();
+	}
+}
+
+void FTetrisSimulation::Collapse()
+{
+	if (Phase != ETetrisPhase::Clearing) { return; }
+	{
+		TETRIS_SCOPE_CYCLE_COUNTER(Collapse);
+		Board.Collapse();
+	}
+	PendingEvents |= ETetrisEvents::StackChanged;
+	if (Observer)
+	{
+		Observer->OnCollapse(*this);
+	}
+	CompleteLock();
+}
+
+ETetrisEvents FTetrisSimulation::ConsumeEvents()
+{
+	const ETetrisEvents Events = PendingEvents;
+	PendingEvents = ETetrisEvents::None;
+	return Events;
+}
+
+void FTetrisSimulation::LockPiece()
+{
+	TETRIS_SCOPE_CYCLE_COUNTER(LockPiece);
+
+	/* Move the current piece from play onto the stack.*/
+	const FPieceShape& Piece = *CurrentPiece;
+	{
+		TETRIS_SCOPE_CYCLE_COUNTER(Place);
+		Board.Place(Piece, CurrentCoordinate);
+	}
+	CurrentPiece = nullptr;
+	PendingEvents |= ETetrisEvents::StackChanged | ETetrisEvents::PieceMoved;
+
+	/* Clear any rows filled by the piece, then wait for the collapse.*/
+	ClearedRows.Reset();
+	bool bClearedRows;
+	{
+		TETRIS_SCOPE_CYCLE_COUNTER(ClearRows);
+		bClearedRows = Board.ClearRows(ClearedRows, CurrentCoordinate.Y + Piece.MinY, CurrentCoordinate.Y + Piece.MaxY);
+	}
+	if (Observer)
+	{
+		Observer->OnLock(*this, Piece, CurrentCoordinate, ClearedRows.Num());
+	}
+	if (bClearedRows)
+	{
+		LinesCleared += ClearedRows.Num();
+		UpdateScore(ClearedRows.Num());
+		PendingEvents |= ETetrisEvents::LinesCleared;
+		Phase = ETetrisPhase::Clearing;
+		CollapseCounter = Config.CollapseDelayTicks;
+		if (CollapseCounter <= 0)
+		{
+			Collapse();
+		}
+		return;
+	}
+
+	/* Lock is complete if there's nothing to clear.*/
+	CompleteLock();
+}
+
+void FTetrisSimulation::CompleteLock()
+{
+	PendingEvents |= ETetrisEvents::LockComplete;
+
+	/* The game is over if the stack reaches into the spawn space.*/
+	if (Board.GetStackHeight() > Config.Height)
+	{
+		Phase = ETetrisPhase::GameOver;
+		PendingEvents |= ETetrisEvents::GameOver;
+		return;
+	}
+
+	/* Commit changes and continue play.*/
+	Board.Commit();
+	SpawnPiece();
+}
+
+void FTetrisSimulation::UpdateScore(int32 NumLines)
+{
+	/* Hard code the scoring rules for simplicity.*/
+	const int32 Level = GetLevel();
+	switch (NumLines)
+	{
+	case 1:
+		Score += Level * 100;
+		break;
+	case 2:
+		Score += Level * 300;
+		break;
+	case 3:
+		Score += Level * 500;
+		break;
+	case 4:
+		Score += Level * 800;
+		break;
+	}
+}
+
+const FTetrisSimulationConfig& FTetrisSimulation::GetConfig() const
+{
+	return Config;
+}
+
+const FBoardState& FTetrisSimulation::GetBoard() const
+{
+	return Board;
+}
+
+const FPieceSequence& FTetrisSimulation::GetSequence() const
+{
+	return Sequence;
+}
+
+TConstArrayView<FPieceShape> FTetrisSimulation::GetShapeTable() const
+{
+	return Shapes;
+}
+
+TConstArrayView<int32> FTetrisSimulation::GetClearedRows() const
+{
+	return ClearedRows;
+}
+
+const FPieceShape* FTetrisSimulation::GetCurrentPiece() const
+{
+	return CurrentPiece;
+}
+
+const FIntPoint& FTetrisSimulation::GetCurrentCoordinate() const
+{
+	return CurrentCoordinate;
+}
+
+FIntPoint FTetrisSimulation::GetGhostCoordinate() const
+{
+	if (!CurrentPiece) { return CurrentCoordinate; }
+	return { CurrentCoordinate.X, Board.GetDropRow(*CurrentPiece, CurrentCoordinate) };
+}
+
+FIntPoint FTetrisSimulation::GetSpawnCoordinate() const
+{
+	return { Config.Width / 2 - 2, Config.Height };
+}
+
+ETetrisPhase FTetrisSimulation::GetPhase() const
+{
+	return Phase;
+}
+
+bool FTetrisSimulation::IsGameOver() const
+{
+	return Phase == ETetrisPhase::GameOver;
+}
+
+int32 FTetrisSimulation::GetScore() const
+{
+	return Score;
+}
+
+int32 FTetrisSimulation::GetLinesCleared() const
+{
+	return LinesCleared;
+}
+
+int32 FTetrisSimulation::GetLevel() const
+{
+	/* Using the Tetris guideline formula.*/
+	return FMath::Min((LinesCleared / 10) + 1, 20);
+}
+
+int32 FTetrisSimulation::GetLinesNextLevel() const
+{
+	/* Using the Tetris guideline formula.*/
+	return GetLevel() * 10;
+}
+
+float FTetrisSimulation::GetTickDelta() const
+{
+	/* Using the Tetris guideline formula.*/
+	const int32 Level = GetLevel();
+	return FMath::Pow((0.8 - ((Level - 1) * 0.007)), Level - 1);
+}
+
+void FTetrisSimulation::GetGravity(int32& OutRows, int32& OutSteps) const
+{
+	/* Below a row per step the steps per row are rounded to the nearest 1/65536 of a step, which drifts by less than a
+	step in 65536 drops. Rounding the rows per step instead would make every drop of the level curve early or late.*/
+	const double RowsPerTick = Config.Gravity > 0.f ? Config.Gravity : 1.0 / (GetTickDelta() * Config.TicksPerSecond);
+	if (RowsPerTick >= 1.0)
+	{
+		OutRows = FMath::Clamp(FMath::RoundToInt(RowsPerTick * GravityOne), GravityOne, MAX_int32 / 2);
+		OutSteps = GravityOne;
+	}
+	else
+	{
+		OutRows = GravityOne;
+		OutSteps = FMath::Clamp(FMath::RoundToInt(GravityOne / RowsPerTick), GravityOne, MAX_int32 / 2);
+	}
+}
+
+int64 FTetrisSimulation::GetElapsedTicks() const
+{
+	return ElapsedTicks;
+}
+
+int32 FTetrisSimulation::GetElapsedSeconds() const
+{
+	return static_cast<int32>(ElapsedTicks / Config.TicksPerSecond);
+}
+
+int64 FTetrisSimulation::GetStepCount() const
+{
+	return StepCount;
+}
+
+void FTetrisSimulation::SetObserver(ITetrisSimulationObserver* InObserver)
+{
+	Observer = InObserver;
+}
+
+ITetrisSimulationObserver* FTetrisSimulation::GetObserver() const
+{
+	return Observer;
+}
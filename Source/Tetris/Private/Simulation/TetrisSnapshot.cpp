@@ -0,0 +1,297 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+
+#include "Simulation/TetrisSnapshot.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Simulation/TetrisReplay.h"
+
+static_assert(sizeof(FTetrisSnapshotHeader) == 120, "The snapshot header must not contain implicit padding.");
+static_assert(sizeof(FTetrisSnapshotHeader) % sizeof(uint64) == 0, "The snapshot grid must be aligned to its words.");
+
+namespace TetrisSnapshot
+{
+	/* The most rows a snapshot can hold, limited by the mask of cleared rows.*/
+	constexpr int32 MaxRows = 64;
+
+	/* Get the number of grid words of a board.*/
+	int32 GetNumWords(int32 Width, int32 NumRows)
+	{
+		return FMath::DivideAndRoundUp(Width * NumRows, 64);
+	}
+
+	/* Read a grid word without assuming the alignment of the data.*/
+	uint64 ReadWord(const uint8* Grid, int32 Index)
+	{
+		uint64 Word;
+		FMemory::Memcpy(&Word, Grid + Index * sizeof(uint64), sizeof(uint64));
+		return Word;
+	}
+}
+
+FTetrisSnapshotView::FTetrisSnapshotView(TConstArrayView<uint8> InData)
+	: Data(InData)
+{
+}
+
+bool FTetrisSnapshotView::IsValid() const
+{
+	if (Data.Num() < int32(sizeof(FTetrisSnapshotHeader))) { return false; }
+	const FTetrisSnapshotHeader& Header = GetHeader();
+	const int32 NumRows = Header.Height + Header.TopSpace;
+	return Header.FileMagic == FTetrisSnapshotHeader::Magic
+		&& Header.Version == FTetrisSnapshotHeader::CurrentVersion
+		&& Header.Width > 0 && Header.Width <= FBoardState::MaxWidth
+		&& NumRows <= TetrisSnapshot::MaxRows
+		&& Header.Size == sizeof(FTetrisSnapshotHeader) + TetrisSnapshot::GetNumWords(Header.Width, NumRows) * sizeof(uint64)
+		&& Header.Size <= Data.Num();
+}
+
+const FTetrisSnapshotHeader& FTetrisSnapshotView::GetHeader() const
+{
+	return *reinterpret_cast<const FTetrisSnapshotHeader*>(Data.GetData());
+}
+
+uint32 FTetrisSnapshotView::GetRowMask(int32 Row) const
+{
+	const FTetrisSnapshotHeader& Header = GetHeader();
+	check(Row >= 0 && Row < GetNumRows());
+
+	/* A row may straddle two words.*/
+	const uint8* Grid = Data.GetData() + sizeof(FTetrisSnapshotHeader);
+	const int32 Bit = Row * Header.Width;
+	const int32 Word = Bit / 64;
+	const int32 Shift = Bit % 64;
+	uint64 Bits = TetrisSnapshot::ReadWord(Grid, Word) >> Shift;
+	if (Shift + Header.Width > 64)
+	{
+		Bits |= TetrisSnapshot::ReadWord(Grid, Word + 1) << (64 - Shift);
+	}
+	return uint32(Bits & ((uint64(1) << Header.Width) - 1));
+}
+
+int32 FTetrisSnapshotView::GetNumRows() const
+{
+	return GetHeader().Height + GetHeader().TopSpace;
+}
+
+int32 FTetrisSnapshot::GetSize(const FTetrisSimulationConfig& Config)
+{
+	return sizeof(FTetrisSnapshotHeader) + TetrisSnapshot::GetNumWords(Config.Width, Config.Height + Config.TopSpace) * sizeof(uint64);
+}
+
+int32 FTetrisSnapshot::Write(const FTetrisSimulation& Simulation, TArrayView<uint8> OutData)
+{
+	const FTetrisSimulationConfig& Config = Simulation.Config;
+	const FBoardState& Board = Simulation.Board;
+	const int32 NumRows = Board.GetHeight();
+	const int32 Size = GetSize(Config);
+	if (NumRows > TetrisSnapshot::MaxRows || Config.Height > MAX_uint8 || Config.TopSpace > MAX_uint8 || Config.TicksPerSecond > MAX_uint16 || Config.CollapseDelayTicks > MAX_uint16)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The board is too large for a snapshot."), __FUNCTION__);
+		return 0;
+	}
+	if (OutData.Num() < Size)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %d bytes can't hold a snapshot of %d bytes."), __FUNCTION__, OutData.Num(), Size);
+		return 0;
+	}
+
+	/* Zero everything first, so that the reserved bytes and the unused grid bits are always the same.*/
+	FMemory::Memzero(OutData.GetData(), Size);
+	FTetrisSnapshotHeader& Header = *reinterpret_cast<FTetrisSnapshotHeader*>(OutData.GetData());
+	Header.FileMagic = FTetrisSnapshotHeader::Magic;
+	Header.Version = FTetrisSnapshotHeader::CurrentVersion;
+	Header.Size = static_cast<uint16>(Size);
+
+	/* Save the configuration.*/
+	Header.Width = static_cast<uint8>(Config.Width);
+	Header.Height = static_cast<uint8>(Config.Height);
+	Header.TopSpace = static_cast<uint8>(Config.TopSpace);
+	Header.NumPieces = static_cast<uint8>(Simulation.Shapes.Num() / FPieceShape::NumRotations);
+	Header.TicksPerSecond = static_cast<uint16>(Config.TicksPerSecond);
+	Header.CollapseDelayTicks = static_cast<uint16>(FMath::Max(Config.CollapseDelayTicks, 0));
+	Header.Gravity = Config.Gravity;
+	Header.ShapeTableCrc = FTetrisReplayReader::GetShapeTableCrc(Simulation.Shapes);
+
+	/* Save the active piece.*/
+	Header.Phase = static_cast<uint8>(Simulation.Phase);
+	Header.PieceType = Simulation.CurrentPiece ? Simulation.CurrentPiece->Type : FTetrisSnapshotHeader::NoPiece;
+	Header.Rotation = Simulation.CurrentPiece ? Simulation.CurrentPiece->Rotation : 0;
+	Header.X = static_cast<int16>(Simulation.CurrentCoordinate.X);
+	Header.Y = static_cast<int16>(Simulation.CurrentCoordinate.Y);
+	Header.CollapseCounter = static_cast<uint16>(FMath::Max(Simulation.CollapseCounter, 0));
+
+	/* Save the metrics.*/
+	Header.Level = static_cast<uint16>(Simulation.GetLevel());
+	Header.Score = Simulation.Score;
+	Header.LinesCleared = Simulation.LinesCleared;
+	Header.GravityAccumulator = Simulation.GravityAccumulator;
+	Header.ElapsedTicks = Simulation.ElapsedTicks;
+	Header.StepCount = Simulation.StepCount;
+	for (const int32 Row : Simulation.ClearedRows)
+	{
+		Header.ClearedRows |= uint64(1) << Row;
+	}
+	Simulation.Sequence.GetState(Header.Sequence);
+
+	/* Pack the rows into the grid, Width bits each.*/
+	uint64* Grid = reinterpret_cast<uint64*>(OutData.GetData() + sizeof(FTetrisSnapshotHeader));
+	const int32 Width = Board.GetWidth();
+	for (int32 Row = 0; Row < FMath::Min(NumRows, Board.GetStackHeight()); ++Row)
+	{
+		const uint64 Bits = Board.GetRowMask(Row);
+		const int32 Bit = Row * Width;
+		uint64 Word;
+		FMemory::Memcpy(&Word, &Grid[Bit / 64], sizeof(Word));
+		Word |= Bits << (Bit % 64);
+		FMemory::Memcpy(&Grid[Bit / 64], &Word, sizeof(Word));
+		if (Bit % 64 + Width > 64)
+		{
+			FMemory::Memcpy(&Word, &Grid[Bit / 64 + 1], sizeof(Word));
+			Word |= Bits >> (64 - Bit % 64);
+			FMemory::Memcpy(&Grid[Bit / 64 + 1], &Word, sizeof(Word));
+		}
+	}
+	return Size;
+}
+
+bool FTetrisSnapshot::Save(const FTetrisSimulation& Simulation, TArray<uint8>& OutData)
+{
+	const int32 Offset = OutData.AddUninitialized(GetSize(Simulation.Config));
+	if (!Write(Simulation, TArrayView<uint8>(OutData.GetData() + Offset, OutData.Num() - Offset)))
+	{
+		OutData.SetNum(Offset, false);
+		return false;
+	}
+	return true;
+}
+
+bool FTetrisSnapshot::Restore(FTetrisSimulation& Simulation, const FTetrisSnapshotView& Snapshot, TConstArrayView<FPieceShape> Shapes)
+{
+	if (!Snapshot.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The data is not a version %d snapshot."), __FUNCTION__, FTetrisSnapshotHeader::CurrentVersion);
+		return false;
+	}
+
+	/* The saved pieces are only meaningful with the shape table the game was saved with.*/
+	const FTetrisSnapshotHeader& Header = Snapshot.GetHeader();
+	const TConstArrayView<FPieceShape> ShapeTable = Shapes.IsEmpty() ? FStandardPieceShapes::Get() : Shapes;
+	if (Header.NumPieces * FPieceShape::NumRotations != ShapeTable.Num() || Header.ShapeTableCrc != FTetrisReplayReader::GetShapeTableCrc(ShapeTable))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The snapshot was saved with another shape table."), __FUNCTION__);
+		return false;
+	}
+	/* A piece is in play exactly while one is falling.*/
+	const bool bHasPiece = Header.PieceType != FTetrisSnapshotHeader::NoPiece;
+	if ((bHasPiece && (Header.PieceType >= Header.NumPieces || Header.Rotation >= FPieceShape::NumRotations)) || Header.Phase > uint8(ETetrisPhase::GameOver)
+		|| bHasPiece != (Header.Phase == uint8(ETetrisPhase::Falling)))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The snapshot holds an invalid piece or phase."), __FUNCTION__);
+		return false;
+	}
+
+	/* Rebuild the game, then overwrite its state. The game is left reset if the sequence is invalid.*/
+	FTetrisSimulationConfig Config;
+	Config.Width = Header.Width;
+	Config.Height = Header.Height;
+	Config.TopSpace = Header.TopSpace;
+	Config.TicksPerSecond = Header.TicksPerSecond;
+	Config.CollapseDelayTicks = Header.CollapseDelayTicks;
+	Config.Gravity = Header.Gravity;
+	Simulation.Initialize(Config, Shapes);
+	if (!Simulation.Sequence.SetState(Header.Sequence)) { return false; }
+
+	/* Restore the board as committed.*/
+	for (int32 Row = 0; Row < Snapshot.GetNumRows(); ++Row)
+	{
+		if (const uint32 RowMask = Snapshot.GetRowMask(Row))
+		{
+			Simulation.Board.SetRowMask(Row, RowMask);
+		}
+	}
+	Simulation.Board.Commit();
+
+	/* Restore the active piece and the lock state machine. The game is left reset if the piece doesn't fit on the board.*/
+	const FPieceShape* Piece = bHasPiece ? &Simulation.Shapes[Header.PieceType * FPieceShape::NumRotations + Header.Rotation] : nullptr;
+	if (Piece && !Simulation.Board.CanPlace(*Piece, { Header.X, Header.Y }))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: The piece of the snapshot overlaps the board."), __FUNCTION__);
+		Simulation.Reset(Header.Sequence.Seed);
+		return false;
+	}
+	Simulation.CurrentPiece = Piece;
+	Simulation.CurrentCoordinate = { Header.X, Header.Y };
+	Simulation.Phase = static_cast<ETetrisPhase>(Header.Phase);
+	Simulation.CollapseCounter = Header.CollapseCounter;
+	Simulation.ClearedRows.Reset();
+	for (uint64 ClearedRows = Header.ClearedRows; ClearedRows; ClearedRows &= ClearedRows - 1)
+	{
+		Simulation.ClearedRows.Add(static_cast<int32>(FMath::CountTrailingZeros64(ClearedRows)));
+	}
+
+	/* Restore the metrics.*/
+	Simulation.Score = Header.Score;
+	Simulation.LinesCleared = Header.LinesCleared;
+	Simulation.GravityAccumulator = Header.GravityAccumulator;
+	Simulation.ElapsedTicks = Header.ElapsedTicks;
+	Simulation.StepCount = Header.StepCount;
+	Simulation.PendingEvents = ETetrisEvents::StackChanged | ETetrisEvents::PieceMoved;
+	return true;
+}
+
+FTetrisSnapshotFile::FTetrisSnapshotFile() = default;
+
+FTetrisSnapshotFile::~FTetrisSnapshotFile()
+{
+	Close();
+}
+
+bool FTetrisSnapshotFile::Open(const FString& Filename)
+{
+	Close();
+	Handle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	if (Handle)
+	{
+		Region.Reset(Handle->MapRegion(0, Handle->GetFileSize()));
+	}
+	if (!Region)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not map %s."), __FUNCTION__, *Filename);
+		Close();
+		return false;
+	}
+
+	/* Every snapshot in the file has the size of the first.*/
+	const int64 MappedSize = Region->GetMappedSize();
+	const FTetrisSnapshotView First(TConstArrayView<uint8>(Region->GetMappedPtr(), int32(FMath::Min<int64>(MappedSize, MAX_uint16))));
+	if (!First.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %s does not start with a version %d snapshot."), __FUNCTION__, *Filename, FTetrisSnapshotHeader::CurrentVersion);
+		Close();
+		return false;
+	}
+	Stride = First.GetHeader().Size;
+	NumSnapshots = int32(FMath::Min<int64>(MappedSize / Stride, MAX_int32));
+	return true;
+}
+
+void FTetrisSnapshotFile::Close()
+{
+	Region.Reset();
+	Handle.Reset();
+	Stride = 0;
+	NumSnapshots = 0;
+}
+
+int32 FTetrisSnapshotFile::Num() const
+{
+	return NumSnapshots;
+}
+
+FTetrisSnapshotView FTetrisSnapshotFile::Get(int32 Index) const
+{
+	check(Index >= 0 && Index < NumSnapshots);
+	return FTetrisSnapshotView(TConstArrayView<uint8>(Region->GetMappedPtr() + int64(Index) * Stride, Stride));
+}
@@ -0,0 +1,161 @@
+#include "CoreMinimal.h"
+#include "BoardBatch.h"
+#include "PieceShape.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBoardBatchTests, "Tetris.Board Batch", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FBoardBatchTests::RunTest(const FString& Parameters)
+{
+	/* An odd board count exercises the partial vector at the end of the batch.*/
+	constexpr int32 NumBoards = 37;
+	FBoardBatch Batch;
+	TArray<FBoardState> Boards;
+	TetrisTests::MakeRandomBatch(Batch, Boards, NumBoards, 1234);
+	const TConstArrayView<FPieceShape> Shapes = FStandardPieceShapes::Get();
+
+	/* Tests for the per-board queries.*/
+	{
+		bool bQueriesMatch = true;
+		for (int32 i = 0; i < NumBoards; ++i)
+		{
+			bQueriesMatch &= Batch.GetStackHeight(i) == Boards[i].GetStackHeight();
+			for (int32 Row = 0; Row < Batch.GetHeight(); ++Row)
+			{
+				bQueriesMatch &= Batch.IsRowFull(i, Row) == Boards[i].IsRowFull(Row);
+			}
+		}
+		TestTrue("Batch queries match the boards.", bQueriesMatch);
+	}
+
+	/* Tests for placements against every board.*/
+	{
+		TArray<bool> Fits;
+		Fits.SetNum(NumBoards);
+		bool bPlacementsMatch = true;
+		int32 NumFits = 0;
+		for (const FPieceShape& Piece : Shapes)
+		{
+			for (int32 Y = -2; Y < Batch.GetHeight(); ++Y)
+			{
+				for (int32 X = -2; X < Batch.GetWidth(); ++X)
+				{
+					Batch.CanPlaceAll(Piece, { X, Y }, Fits);
+					for (int32 i = 0; i < NumBoards; ++i)
+					{
+						bPlacementsMatch &= Fits[i] == Boards[i].CanPlace(Piece, { X, Y });
+						bPlacementsMatch &= Batch.CanPlace(i, Piece, { X, Y }) == Fits[i];
+						NumFits += Fits[i];
+					}
+				}
+			}
+		}
+		TestTrue("Batch placements match the boards.", bPlacementsMatch);
+		TestTrue("Some placements fit.", NumFits > 0);
+	}
+
+	/* Tests for fitting columns.*/
+	{
+		TArray<uint32> Columns;
+		Columns.SetNum(NumBoards);
+		bool bColumnsMatch = true;
+		for (const FPieceShape& Piece : Shapes)
+		{
+			for (int32 Y = -2; Y < Batch.GetHeight(); ++Y)
+			{
+				Batch.GetFittingColumnsAll(Piece, Y, Columns);
+				for (int32 i = 0; i < NumBoards; ++i)
+				{
+					uint32 Expected = 0;
+					for (int32 Col = 0; Col < Batch.GetWidth(); ++Col)
+					{
+						Expected |= uint32(Boards[i].CanPlace(Piece, { Col - Piece.MinX, Y })) << Col;
+					}
+					bColumnsMatch &= Columns[i] == Expected;
+					bColumnsMatch &= Batch.GetFittingColumns(i, Piece, Y) == Expected;
+				}
+			}
+		}
+		TestTrue("Fitting columns match the boards.", bColumnsMatch);
+	}
+
+	/* Tests for rows and heights.*/
+	{
+		TArray<uint64> FullRows;
+		TArray<uint8> StackHeights;
+		TArray<uint8> ColumnHeights;
+		FullRows.SetNum(NumBoards);
+		StackHeights.SetNum(NumBoards);
+		ColumnHeights.SetNum(NumBoards * Batch.GetWidth());
+		Batch.GetFullRowsAll(FullRows);
+		Batch.GetStackHeightsAll(StackHeights);
+		Batch.GetColumnHeightsAll(ColumnHeights);
+
+		bool bRowsMatch = true;
+		bool bHeightsMatch = true;
+		for (int32 i = 0; i < NumBoards; ++i)
+		{
+			for (int32 Row = 0; Row < Batch.GetHeight(); ++Row)
+			{
+				bRowsMatch &= bool((FullRows[i] >> Row) & 1) == Boards[i].IsRowFull(Row);
+			}
+			bHeightsMatch &= StackHeights[i] == Boards[i].GetStackHeight();
+			for (int32 Col = 0; Col < Batch.GetWidth(); ++Col)
+			{
+				int32 Expected = 0;
+				for (int32 Row = 0; Row < Batch.GetHeight(); ++Row)
+				{
+					Expected = Boards[i].IsOccupied({ Col, Row }) ? Row + 1 : Expected;
+				}
+				bHeightsMatch &= ColumnHeights[i * Batch.GetWidth() + Col] == Expected;
+			}
+		}
+		TestTrue("Full rows match the boards.", bRowsMatch);
+		TestTrue("Heights match the boards.", bHeightsMatch);
+	}
+
+	/* Tests for placing.*/
+	{
+		const FPieceShape& Piece = Shapes[0];
+		const FIntPoint Coordinate(0, Batch.GetHeight() - FPieceShape::BoxSize);
+		TestTrue("Placement in empty space succeeds.", Batch.Place(3, Piece, Coordinate) == EPlaceResult::OK);
+		TestTrue("Overlapping placement fails.", Batch.Place(3, Piece, Coordinate) == EPlaceResult::BAD);
+		TestFalse("Placed piece blocks the board.", Batch.CanPlace(3, Piece, Coordinate));
+		TestTrue("Other boards are unchanged.", Batch.CanPlace(4, Piece, Coordinate) == Boards[4].CanPlace(Piece, Coordinate));
+	}
+
+	/* Tests for the batch kernels against testing each board in turn.*/
+	{
+		constexpr int32 NumKernelBoards = 256;
+		TetrisTests::MakeRandomBatch(Batch, Boards, NumKernelBoards, 99);
+		TArray<bool> Fits;
+		TArray<uint32> Columns;
+		Fits.SetNum(NumKernelBoards);
+		Columns.SetNum(NumKernelBoards);
+
+		bool bFitsMatch = true;
+		bool bColumnsMatch = true;
+		for (const FPieceShape& Piece : Shapes)
+		{
+			for (int32 Y = 0; Y < Batch.GetHeight(); ++Y)
+			{
+				Batch.GetFittingColumnsAll(Piece, Y, Columns);
+				for (int32 X = -2; X < Batch.GetWidth(); ++X)
+				{
+					Batch.CanPlaceAll(Piece, { X, Y }, Fits);
+					for (int32 i = 0; i < NumKernelBoards; ++i)
+					{
+						const bool bFits = Boards[i].CanPlace(Piece, { X, Y });
+						bFitsMatch &= Fits[i] == bFits;
+						const int32 Column = X + Piece.MinX;
+						bColumnsMatch &= Column < 0 || Column >= Batch.GetWidth() || (((Columns[i] >> Column) & 1u) != 0) == bFits;
+					}
+				}
+			}
+		}
+		TestTrue("Batch finds the same placements.", bFitsMatch);
+		TestTrue("Fitting columns find the same placements.", bColumnsMatch);
+	}
+	return true;
+}
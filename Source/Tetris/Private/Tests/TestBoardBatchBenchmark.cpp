@@ -0,0 +1,94 @@
+#include "CoreMinimal.h"
+#include "BoardBatch.h"
+#include "TetrisBenchmark.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+namespace
+{
+	/* A piece and where it is tested.*/
+	struct FPlacementQuery
+	{
+		const FPieceShape* Piece;
+		FIntPoint Coordinate;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBoardBatchBenchmark, "Tetris.Benchmark.Board Batch", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FBoardBatchBenchmark::RunTest(const FString& Parameters)
+{
+	/* Every operation answers one query for every board of the batch, so the per-board rows and the kernels compare directly.*/
+	constexpr int32 NumBoards = 256;
+	FBoardBatch Batch;
+	TArray<FBoardState> Boards;
+	TetrisTests::MakeRandomBatch(Batch, Boards, NumBoards, 99);
+	const TConstArrayView<FPieceShape> Shapes = FStandardPieceShapes::Get();
+
+	/* Query every rotation at every location, so that the boards answer both ways.*/
+	TArray<FPlacementQuery> Placements;
+	TArray<FPlacementQuery> Rows;
+	for (const FPieceShape& Piece : Shapes)
+	{
+		for (int32 Y = 0; Y < Batch.GetHeight(); ++Y)
+		{
+			Rows.Add({ &Piece, { 0, Y } });
+			for (int32 X = -Piece.MinX; X + Piece.MaxX < Batch.GetWidth(); ++X)
+			{
+				Placements.Add({ &Piece, { X, Y } });
+			}
+		}
+	}
+
+	TArray<bool> Fits;
+	TArray<uint32> Columns;
+	Fits.SetNum(NumBoards);
+	Columns.SetNum(NumBoards);
+	int64 NumFits = 0;
+	FTetrisBenchmark Benchmark(*this, TEXT("BoardBatch"));
+
+	/* Test one placement against every board.*/
+	Benchmark.Run(TEXT("BoardBatch.CanPlace (per board)"), Placements.Num(),
+		[&Boards, &Placements, &NumFits](int32 i)
+		{
+			for (const FBoardState& Board : Boards)
+			{
+				NumFits += Board.CanPlace(*Placements[i].Piece, Placements[i].Coordinate);
+			}
+		});
+
+	Benchmark.Run(TEXT("BoardBatch.CanPlaceAll"), Placements.Num(),
+		[&Batch, &Placements, &Fits, &NumFits](int32 i)
+		{
+			Batch.CanPlaceAll(*Placements[i].Piece, Placements[i].Coordinate, Fits);
+			NumFits += Fits[i % NumBoards];
+		});
+
+	/* Find every column where a piece fits at one row of every board.*/
+	Benchmark.Run(TEXT("BoardBatch.GetFittingColumns (per board)"), Rows.Num(),
+		[&Batch, &Boards, &Rows, &NumFits](int32 i)
+		{
+			const FPieceShape& Piece = *Rows[i].Piece;
+			for (const FBoardState& Board : Boards)
+			{
+				uint32 Mask = 0;
+				for (int32 X = -Piece.MinX; X + Piece.MaxX < Batch.GetWidth(); ++X)
+				{
+					Mask |= Board.CanPlace(Piece, { X, Rows[i].Coordinate.Y }) ? 1u << (X + Piece.MinX) : 0u;
+				}
+				NumFits += Mask;
+			}
+		});
+
+	Benchmark.Run(TEXT("BoardBatch.GetFittingColumnsAll"), Rows.Num(),
+		[&Batch, &Rows, &Columns, &NumFits](int32 i)
+		{
+			Batch.GetFittingColumnsAll(*Rows[i].Piece, Rows[i].Coordinate.Y, Columns);
+			NumFits += Columns[i % NumBoards];
+		});
+
+	TestTrue("Placements are found.", NumFits > 0);
+	AddInfo(FString::Printf(TEXT("%d lanes."), FBoardBatch::LaneCount));
+	Benchmark.Finish();
+	return true;
+}
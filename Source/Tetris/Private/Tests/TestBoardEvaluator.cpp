@@ -0,0 +1,121 @@
+#include "CoreMinimal.h"
+#include "AI/BoardEvaluator.h"
+#include "AI/PlacementGenerator.h"
+#include "Simulation/TetrisSimulation.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	/* Return true if two sets of features are the same.*/
+	bool IsSameFeatures(const FBoardFeatures& A, const FBoardFeatures& B)
+	{
+		return A.AggregateHeight == B.AggregateHeight && A.Holes == B.Holes && A.Bumpiness == B.Bumpiness && A.Wells == B.Wells
+			&& A.RowTransitions == B.RowTransitions && A.ColumnTransitions == B.ColumnTransitions
+			&& A.LinesCleared == B.LinesCleared && A.FilledCells == B.FilledCells;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBoardEvaluatorTests, "Tetris.AI.Board Evaluator", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FBoardEvaluatorTests::RunTest(const FString& Parameters)
+{
+	const TConstArrayView<FPieceShape> Shapes = FStandardPieceShapes::Get();
+
+	/* Tests for measuring a board.*/
+	{
+		/* Columns of height 3, 1, 3 and 1, with two holes under the third.*/
+		FBoardState Board;
+		Board.Initialize(4, 6);
+		Board.SetRowMask(0, 0b1011);
+		Board.SetRowMask(1, 0b0001);
+		Board.SetRowMask(2, 0b0101);
+
+		const FBoardFeatures Features = FBoardEvaluator::Measure(Board);
+		TestEqual("Aggregate height is measured.", Features.AggregateHeight, 8);
+		TestEqual("Holes are measured.", Features.Holes, 2);
+		TestEqual("Bumpiness is measured.", Features.Bumpiness, 6);
+		TestEqual("Wells are measured against the walls.", Features.Wells, 4);
+		TestEqual("Row transitions are measured.", Features.RowTransitions, 8);
+		TestEqual("Column transitions are measured.", Features.ColumnTransitions, 6);
+		TestEqual("No lines are cleared.", Features.LinesCleared, 0);
+
+		FBoardState Empty;
+		Empty.Initialize(10, 24);
+		const FBoardFeatures EmptyFeatures = FBoardEvaluator::Measure(Empty);
+		TestTrue("Empty board only has the transitions of the floor.", EmptyFeatures.AggregateHeight == 0 && EmptyFeatures.RowTransitions == 0 && EmptyFeatures.ColumnTransitions == 10);
+	}
+
+	/* Tests for scoring.*/
+	{
+		/* A vertical I in a well of depth four clears four lines, where anywhere else it leaves the well open.*/
+		FBoardState Board;
+		Board.Initialize(10, 24);
+		for (int32 Row = 0; Row < 4; ++Row)
+		{
+			Board.SetRowMask(Row, 0b0111111111);
+		}
+		const FBoardEvaluator Evaluator;
+		const FBoardFeatures Features = FBoardEvaluator::Measure(Board);
+		const FPieceShape& VerticalI = Shapes[0].RotateR();
+		const FIntPoint InWell(9 - VerticalI.MinX, -VerticalI.MinY);
+		const FIntPoint Beside(8 - VerticalI.MinX, 4 - VerticalI.MinY);
+		TestEqual("Filling the well clears four lines.", FBoardEvaluator::MeasurePlacement(Board, Features, VerticalI, InWell).LinesCleared, 4);
+		TestTrue("Filling the well scores higher than covering it.",
+			Evaluator.ScorePlacement(Board, Features, VerticalI, InWell) > Evaluator.ScorePlacement(Board, Features, VerticalI, Beside));
+
+		FBoardEvaluationWeights Weights;
+		Weights.LinesCleared = -100.f;
+		TestTrue("Weights are applied.",
+			FBoardEvaluator(Weights).ScorePlacement(Board, Features, VerticalI, InWell) < FBoardEvaluator(Weights).ScorePlacement(Board, Features, VerticalI, Beside));
+	}
+
+	/* Tests that the features of every placement match those measured on the placed board, on the boards of random games.*/
+	{
+		FTetrisSimulationConfig Config;
+		Config.CollapseDelayTicks = 0;
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(3);
+		Simulation.Start();
+		FRandomStream Policy(3);
+		FPlacementGenerator Generator;
+
+		int32 NumPlacements = 0;
+		int32 NumClears = 0;
+		bool bAllMatch = true;
+		TArray<int32> ClearedRows;
+		for (int32 Step = 0; Step < 20000; ++Step)
+		{
+			if (Simulation.IsGameOver())
+			{
+				Simulation.Reset(3 + Step);
+				Simulation.Start();
+			}
+			if (Simulation.GetPhase() == ETetrisPhase::Falling && Step % 5 == 0)
+			{
+				const FBoardState& Board = Simulation.GetBoard();
+				const FBoardFeatures Features = FBoardEvaluator::Measure(Board);
+				Generator.Generate(Board, *Simulation.GetCurrentPiece(), Simulation.GetCurrentCoordinate());
+				for (const FPiecePlacement& Placement : Generator.GetPlacements())
+				{
+					FBoardState Placed = Board;
+					Placed.Place(*Placement.Piece, Placement.Coordinate);
+					ClearedRows.Reset();
+					Placed.ClearRows(ClearedRows);
+					Placed.Collapse();
+
+					FBoardFeatures Expected = FBoardEvaluator::Measure(Placed);
+					Expected.LinesCleared = ClearedRows.Num();
+					bAllMatch &= IsSameFeatures(FBoardEvaluator::MeasurePlacement(Board, Features, *Placement.Piece, Placement.Coordinate), Expected);
+					NumClears += ClearedRows.IsEmpty() ? 0 : 1;
+					++NumPlacements;
+				}
+			}
+			Simulation.ApplyAction(static_cast<EAction>(Policy.RandRange(EAction::LEFT, EAction::ROTATE_L)));
+			Simulation.Tick();
+		}
+		TestTrue("Placements are measured, some clearing lines.", NumPlacements > 0 && NumClears > 0);
+		TestTrue("Features of placements match the placed boards.", bAllMatch);
+	}
+	return true;
+}
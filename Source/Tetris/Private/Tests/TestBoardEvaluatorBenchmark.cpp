@@ -0,0 +1,43 @@
+#include "CoreMinimal.h"
+#include "AI/BoardEvaluator.h"
+#include "AI/PlacementGenerator.h"
+#include "TetrisBenchmark.h"
+#include "Misc/AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBoardEvaluatorBenchmark, "Tetris.Benchmark.Board Evaluator", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FBoardEvaluatorBenchmark::RunTest(const FString& Parameters)
+{
+	const TConstArrayView<FPieceShape> Shapes = FStandardPieceShapes::Get();
+	FTetrisBenchmark Benchmark(*this, TEXT("BoardEvaluator"));
+
+	/* A mid-game board with a ragged stack and two open columns.*/
+	FBoardState Board;
+	Board.Initialize(10, 24);
+	FRandomStream Random(9);
+	for (int32 Row = 0; Row < 8; ++Row)
+	{
+		Board.SetRowMask(Row, uint32(Random.RandRange(0, 1022)) | (Row < 6 ? 0b1000010000u : 0u));
+	}
+	const FBoardEvaluator Evaluator;
+	const FBoardFeatures Features = FBoardEvaluator::Measure(Board);
+	FPlacementGenerator Generator;
+	Generator.Generate(Board, Shapes[2 * FPieceShape::NumRotations], { 3, 20 });
+	const TConstArrayView<FPiecePlacement> Placements = Generator.GetPlacements();
+	TestTrue("Placements are found.", Placements.Num() > 0);
+
+	int32 SumOfHeights = 0;
+	Benchmark.Run(TEXT("BoardEvaluator.Measure"), 20000,
+		[&Board, &SumOfHeights](int32) { SumOfHeights += FBoardEvaluator::Measure(Board).AggregateHeight; });
+	TestTrue("Boards are measured.", SumOfHeights > 0);
+
+	/* Score every placement of one piece in turn, as the search does for each board it expands.*/
+	float ScoreSum = 0.f;
+	Benchmark.Run(TEXT("BoardEvaluator.ScorePlacement"), 500, Placements.Num(),
+		[] {},
+		[&Board, &Features, &Evaluator, &Placements, &ScoreSum](int32 i) { ScoreSum += Evaluator.ScorePlacement(Board, Features, *Placements[i].Piece, Placements[i].Coordinate); });
+	TestTrue("Placements are scored.", ScoreSum != 0.f);
+
+	Benchmark.Finish();
+	return true;
+}
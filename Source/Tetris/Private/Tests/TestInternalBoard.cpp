@@ -0,0 +1,267 @@
+#include "CoreMinimal.h"
+#include "InternalBoard.h"
+#include "PieceFactory.h"
+#include "Misc/AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInternalBoardTests, "Tetris.Internal Board", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FInternalBoardTests::RunTest(const FString& Parameters)
+{
+	/* The piece factory to use in all tests.*/
+	UPieceFactory* PieceFactory = NewObject<UPieceFactory>();
+	FPieceData PieceDataI{ {{0,2},{1,2},{2,2},{3,2}}, {1.5f, 1.5f} };
+	FPieceData PieceDataO{ {{1,1},{1,2},{2,1},{2,2}}, {1.5f, 1.5f} };
+	TArray<FPieceShape> Shapes;
+	PieceFactory->Build(PieceDataI, Shapes);
+	PieceFactory->Build(PieceDataO, Shapes);
+	const FPieceShape& IPiece = Shapes[0];
+	const FPieceShape& OPiece = Shapes[FPieceShape::NumRotations];
+
+	/* Tests for an empty board.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		TestEqual("Board width is correct.", Board->GetWidth(), 10);
+		TestEqual("Board height is correct.", Board->GetHeight(), 24);
+		TestTrue("Full row mask covers the width.", Board->GetFullRowMask() == 0x3FFu);
+		TestEqual("Empty board has no stack.", Board->GetStackHeight(), 0);
+		TestFalse("Empty board has no occupied cells.", Board->IsOccupied({ 0,0 }));
+		TestFalse("Empty board has no full rows.", Board->IsRowFull(0));
+	}
+
+	/* Tests for placement.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		TestTrue("I piece is placed on the floor.", Board->Place(IPiece, { 0,-2 }) == EPlaceResult::OK);
+		TestTrue("Row mask reflects the placed piece.", Board->GetRowMask(0) == 0xFu);
+		TestTrue("Placed cell is occupied.", Board->IsOccupied({ 3,0 }));
+		TestFalse("Cell beside the piece is empty.", Board->IsOccupied({ 4,0 }));
+		TestEqual("Stack height is one row.", Board->GetStackHeight(), 1);
+		TestTrue("Piece below the floor is rejected.", Board->Place(IPiece, { 0,-3 }) == EPlaceResult::BAD);
+		TestTrue("Piece past the left wall is rejected.", Board->Place(IPiece, { -1,0 }) == EPlaceResult::BAD);
+		TestTrue("Piece past the right wall is rejected.", Board->Place(IPiece, { 7,0 }) == EPlaceResult::BAD);
+		TestTrue("Piece on an occupied cell is rejected.", Board->Place(OPiece, { 1,-1 }) == EPlaceResult::BAD);
+	}
+
+	/* Tests for read-only collision queries and moves.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		Board->Place(OPiece, { 2,-1 });
+		TestFalse("Body collision from the side is detected.", Board->CanPlace(IPiece, { 0,-1 }));
+		TestFalse("Piece above the board is rejected.", Board->CanPlace(OPiece, { 0,22 }));
+		TestTrue("Free placement is accepted.", Board->CanPlace(IPiece, { 0,0 }));
+
+		Board->Place(IPiece, { 5,0 });
+		TestTrue("Piece can move into the cells it occupies.", Board->CanMove(IPiece, { 5,0 }, IPiece, { 6,0 }));
+		TestFalse("Piece can't move into the stack.", Board->CanMove(IPiece, { 5,0 }, IPiece, { 4,-1 }));
+		TestTrue("Rejected move is reported.", Board->Move(IPiece, { 5,0 }, IPiece, { 4,-1 }) == EPlaceResult::BAD);
+		TestTrue("Rejected move leaves the board untouched.", Board->GetRowMask(2) == 0x1E0u);
+		TestTrue("Valid move is accepted.", Board->Move(IPiece, { 5,0 }, IPiece.RotateR(), { 5,0 }) == EPlaceResult::OK);
+		TestTrue("Moved piece leaves its old cells.", Board->GetRowMask(2) == 0x80u);
+		TestTrue("Moved piece occupies its new cells.", Board->IsOccupied({ 7,0 }) && Board->IsOccupied({ 7,1 }));
+	}
+
+	/* Tests for clearing and collapsing rows.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		Board->Place(IPiece, { 0,-2 });
+		Board->Place(IPiece, { 4,-2 });
+		Board->Place(OPiece, { 7,-1 });
+		TestTrue("Bottom row is full.", Board->IsRowFull(0));
+		TestFalse("Second row is not full.", Board->IsRowFull(1));
+
+		TArray<int32> ClearedRows;
+		TestTrue("Rows are cleared.", Board->ClearRows(ClearedRows));
+		TestTrue("Only the bottom row is cleared.", ClearedRows == TArray<int32>{ 0 });
+		TestTrue("Cleared row is empty.", Board->GetRowMask(0) == 0u);
+
+		Board->Collapse();
+		TestTrue("Remaining blocks fall into the cleared row.", Board->GetRowMask(0) == 0x300u);
+		TestTrue("Collapsed row is empty.", Board->GetRowMask(1) == 0u);
+		TestEqual("Stack height after collapse is one row.", Board->GetStackHeight(), 1);
+	}
+
+	/* Tests for undo and commit.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		Board->Place(IPiece, { 0,-2 });
+		Board->Undo();
+		TestFalse("Undo removes an uncommitted placement.", Board->IsOccupied({ 0,0 }));
+
+		Board->Place(IPiece, { 0,-2 });
+		Board->Commit();
+		Board->Place(OPiece, { 0,0 });
+		Board->Undo();
+		TestTrue("Undo keeps committed placements.", Board->IsOccupied({ 0,0 }));
+		TestFalse("Undo removes placements after the commit.", Board->IsOccupied({ 1,1 }));
+
+		/* Undo levels unwind one speculative placement at a time.*/
+		TestEqual("First undo level is opened.", Board->PushUndoLevel(), 1);
+		Board->Place(OPiece, { 0,0 });
+		TestEqual("Second undo level is opened.", Board->PushUndoLevel(), 2);
+		Board->Place(OPiece, { 2,0 });
+		Board->PopUndoLevel();
+		TestFalse("Popping an undo level removes its placement.", Board->IsOccupied({ 3,1 }));
+		TestTrue("Popping an undo level keeps earlier placements.", Board->IsOccupied({ 1,1 }));
+		Board->PopUndoLevel();
+		TestFalse("Popping every undo level restores the commit.", Board->IsOccupied({ 1,1 }));
+		TestEqual("No undo levels remain.", Board->GetUndoDepth(), 0);
+
+		/* Collapses are journaled like placements.*/
+		Board->Place(OPiece, { 7,-1 });
+		Board->EmptyRow(0);
+		Board->Collapse();
+		Board->Undo();
+		TestTrue("Undo restores a collapsed board.", Board->GetRowMask(0) == 0xFu && Board->GetRowMask(1) == 0u);
+	}
+
+	/* Tests for the maintained heights.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		const FBoardState& State = Board->GetState();
+		Board->Place(IPiece.RotateR(), { 0,0 });
+		Board->Place(OPiece, { 2,-1 });
+		TestEqual("Column height covers a vertical piece.", State.GetColumnHeight(2), 4);
+		TestEqual("Column height covers a square.", State.GetColumnHeight(3), 2);
+		TestEqual("Empty column has no height.", State.GetColumnHeight(0), 0);
+		TestEqual("Row fill count is maintained.", State.GetRowFillCount(0), 3);
+
+		Board->EmptyRow(3);
+		TestEqual("Emptying the top cell lowers the column.", State.GetColumnHeight(2), 3);
+		TestEqual("Emptying the top row lowers the stack.", Board->GetStackHeight(), 3);
+		Board->Undo();
+		TestEqual("Undo restores the column heights.", State.GetColumnHeight(2), 0);
+		TestEqual("Undo restores the stack height.", Board->GetStackHeight(), 0);
+
+		/* Random placements, clears and undos always agree with a scan of the rows.*/
+		FRandomStream Random(7);
+		bool bHeightsMatch = true;
+		for (int32 Step = 0; Step < 2000; ++Step)
+		{
+			const FPieceShape& Piece = Shapes[Random.RandRange(0, Shapes.Num() - 1)];
+			const FIntPoint Coordinate(Random.RandRange(-1, 8), Random.RandRange(-2, 20));
+			switch (Random.RandRange(0, 9))
+			{
+			case 0: Board->Undo(); break;
+			case 1: Board->Commit(); break;
+			case 2: Board->EmptyRow(Random.RandRange(0, 23)); break;
+			case 3: Board->Collapse(); break;
+			default: Board->Place(Piece, Coordinate); break;
+			}
+
+			int32 ExpectedStackHeight = 0;
+			for (int32 Col = 0; Col < Board->GetWidth(); ++Col)
+			{
+				int32 ExpectedHeight = 0;
+				for (int32 Row = 0; Row < Board->GetHeight(); ++Row)
+				{
+					ExpectedHeight = Board->IsOccupied({ Col, Row }) ? Row + 1 : ExpectedHeight;
+				}
+				bHeightsMatch &= State.GetColumnHeight(Col) == ExpectedHeight;
+				ExpectedStackHeight = FMath::Max(ExpectedStackHeight, ExpectedHeight);
+			}
+			bHeightsMatch &= Board->GetStackHeight() == ExpectedStackHeight;
+		}
+		TestTrue("Maintained heights match the rows.", bHeightsMatch);
+	}
+
+	/* Tests for drops.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		const FBoardState& State = Board->GetState();
+		TestEqual("Piece drops to the floor.", State.GetDropRow(IPiece, { 0,20 }), -2);
+		Board->Place(OPiece, { 0,-1 });
+		TestEqual("Piece drops onto the stack.", State.GetDropRow(IPiece, { 0,20 }), 0);
+		TestEqual("Skirt lets a vertical piece drop past the stack.", State.GetDropRow(IPiece.RotateR(), { 1,20 }), 0);
+
+		/* A piece tucked under an overhang lands on the floor below it.*/
+		Board->Place(IPiece, { 0,1 });
+		TestEqual("Tucked piece drops under the overhang.", State.GetDropRow(OPiece, { 2,0 }), -1);
+
+		/* A piece with an empty column inside its bounds straddles the stack under that column.*/
+		const FPieceShape ForkPiece = FPieceShape::Make({ 0b101, 0b101, 0, 0 }, 0, 0);
+		Board->Initialize(10, 24);
+		Board->Place(IPiece.RotateR(), { 2,0 });
+		TestEqual("Empty piece columns don't land on the stack.", State.GetDropRow(ForkPiece, { 3,20 }), 0);
+
+		/* Drops always agree with stepping down one row at a time.*/
+		FRandomStream Random(11);
+		bool bDropsMatch = true;
+		for (int32 Step = 0; Step < 2000; ++Step)
+		{
+			const FPieceShape& Piece = Shapes[Random.RandRange(0, Shapes.Num() - 1)];
+			const FIntPoint Coordinate(Random.RandRange(-1, 8), Random.RandRange(-2, 20));
+			if (!Board->CanPlace(Piece, Coordinate)) { continue; }
+
+			int32 ExpectedRow = Coordinate.Y;
+			while (Board->CanPlace(Piece, { Coordinate.X, ExpectedRow - 1 }))
+			{
+				--ExpectedRow;
+			}
+			bDropsMatch &= State.GetDropRow(Piece, Coordinate) == ExpectedRow;
+			if (Random.RandRange(0, 3) == 0)
+			{
+				Board->Place(Piece, { Coordinate.X, ExpectedRow });
+			}
+			if (Board->GetStackHeight() > 16)
+			{
+				Board->Initialize(10, 24);
+			}
+		}
+		TestTrue("Drops match stepping down.", bDropsMatch);
+	}
+
+	/* Tests for the maintained hash.*/
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		TestTrue("Empty board has no hash.", Board->GetHash() == 0);
+		Board->Place(IPiece, { 0,-2 });
+		Board->Place(OPiece, { 4,-1 });
+		const uint64 PlacedHash = Board->GetHash();
+		TestTrue("Hash changes with the cells.", PlacedHash != 0);
+
+		/* The same cells filled in another order, or by collapsing a row onto the floor, give the same hash.*/
+		UInternalBoard* Other = UInternalBoard::NewInternalBoard(10, 24);
+		Other->Place(OPiece, { 4,-1 });
+		Other->Place(IPiece, { 0,-2 });
+		TestTrue("Boards filled in any order have the same hash.", Other->GetHash() == PlacedHash);
+		Other->Initialize(10, 24);
+		Other->Place(IPiece, { 0,-1 });
+		Other->Place(OPiece, { 4,0 });
+		Other->Collapse();
+		TestTrue("Collapsed rows are hashed by their new row.", Other->GetHash() == PlacedHash);
+		Board->Undo();
+		TestTrue("Undo restores the hash.", Board->GetHash() == 0);
+
+		/* Random placements, clears and undos always agree with hashing the cells.*/
+		FRandomStream Random(13);
+		bool bHashesMatch = true;
+		for (int32 Step = 0; Step < 2000; ++Step)
+		{
+			const FPieceShape& Piece = Shapes[Random.RandRange(0, Shapes.Num() - 1)];
+			const FIntPoint Coordinate(Random.RandRange(-1, 8), Random.RandRange(-2, 20));
+			const uint64 OldHash = Board->GetHash();
+			switch (Random.RandRange(0, 9))
+			{
+			case 0: Board->Undo(); break;
+			case 1: Board->Commit(); break;
+			case 2: Board->EmptyRow(Random.RandRange(0, 23)); break;
+			case 3: Board->Collapse(); break;
+			default:
+				bHashesMatch &= Board->Place(Piece, Coordinate) == EPlaceResult::BAD || Board->GetHash() == (OldHash ^ FBoardState::GetPieceKey(Piece, Coordinate));
+				break;
+			}
+
+			uint64 ExpectedHash = 0;
+			for (int32 Row = 0; Row < Board->GetHeight(); ++Row)
+			{
+				for (int32 Col = 0; Col < Board->GetWidth(); ++Col)
+				{
+					ExpectedHash ^= Board->IsOccupied({ Col, Row }) ? FBoardState::GetCellKey(Row, Col) : 0;
+				}
+			}
+			bHashesMatch &= Board->GetHash() == ExpectedHash;
+		}
+		TestTrue("Maintained hash matches the cells.", bHashesMatch);
+	}
+	return true;
+}
@@ -0,0 +1,145 @@
+#include "CoreMinimal.h"
+#include "InternalBoard.h"
+#include "TetrisBenchmark.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	/* A piece and where it was placed.*/
+	struct FPlacement
+	{
+		const FPieceShape* Piece;
+		FIntPoint Coordinate;
+	};
+
+	/* Drop the piece straight down from the top of the board at the given column. Return false if it doesn't fit at the top.*/
+	bool DropPiece(UInternalBoard& Board, const FPieceShape& Piece, int32 X, FPlacement* OutPlacement = nullptr)
+	{
+		FIntPoint Coordinate(X, Board.GetHeight() - 1 - Piece.MaxY);
+		if (!Board.CanPlace(Piece, Coordinate)) { return false; }
+		while (Board.CanPlace(Piece, Coordinate - FIntPoint(0, 1)))
+		{
+			--Coordinate.Y;
+		}
+		Board.Place(Piece, Coordinate);
+		if (OutPlacement)
+		{
+			*OutPlacement = { &Piece, Coordinate };
+		}
+		return true;
+	}
+
+	/* Drop a random piece at a random column.*/
+	bool DropRandomPiece(UInternalBoard& Board, TConstArrayView<FPieceShape> Shapes, FRandomStream& Random, FPlacement* OutPlacement = nullptr)
+	{
+		const FPieceShape& Piece = Shapes[Random.RandRange(0, Shapes.Num() - 1)];
+		return DropPiece(Board, Piece, Random.RandRange(-Piece.MinX, Board.GetWidth() - 1 - Piece.MaxX), OutPlacement);
+	}
+
+	/* Build a committed mid-game board: four full rows under a ragged stack with holes, as when a tetris is about to be scored.*/
+	UInternalBoard* MakeRealisticBoard(TConstArrayView<FPieceShape> Shapes)
+	{
+		UInternalBoard* Board = UInternalBoard::NewInternalBoard(10, 24);
+		const FPieceShape& VerticalI = Shapes[0].RotateR();
+		for (int32 Col = 0; Col < Board->GetWidth(); ++Col)
+		{
+			DropPiece(*Board, VerticalI, Col - VerticalI.MinX);
+		}
+		FRandomStream Random(17);
+		while (Board->GetStackHeight() < 12)
+		{
+			DropRandomPiece(*Board, Shapes, Random);
+		}
+		Board->Commit();
+		return Board;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FInternalBoardBenchmark, "Tetris.Benchmark.Internal Board", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FInternalBoardBenchmark::RunTest(const FString& Parameters)
+{
+	const TConstArrayView<FPieceShape> Shapes = FStandardPieceShapes::Get();
+	FTetrisBenchmark Benchmark(*this, TEXT("InternalBoard"));
+
+	/* Operations that change the board are timed on a batch of identical boards, so that each batch is long enough to time precisely.*/
+	constexpr int32 NumBoards = 16;
+	TArray<UInternalBoard*> Boards;
+	for (int32 i = 0; i < NumBoards; ++i)
+	{
+		Boards.Add(MakeRealisticBoard(Shapes));
+	}
+	UInternalBoard* Board = Boards[0];
+
+	/* Find pieces that land one after another on the board, so that every batch can place them again in order.*/
+	TArray<FPlacement> Landings;
+	FRandomStream Random(23);
+	while (Landings.Num() < 8)
+	{
+		FPlacement Placement;
+		if (DropRandomPiece(*Board, Shapes, Random, &Placement))
+		{
+			Landings.Add(Placement);
+		}
+	}
+	Board->Undo();
+
+	TArray<int32> ClearedRows;
+	Board->ClearRows(ClearedRows);
+	TestTrue("Benchmark board clears the four full rows.", ClearedRows.Num() >= 4);
+	Board->Undo();
+
+	const auto UndoAll = [&Boards] { for (UInternalBoard* Each : Boards) { Each->Undo(); } };
+	const auto ClearAll = [&Boards, &ClearedRows] { for (UInternalBoard* Each : Boards) { ClearedRows.Reset(); Each->ClearRows(ClearedRows); } };
+
+	Benchmark.Run(TEXT("InternalBoard.Place"), 500, Landings.Num(),
+		[Board] { Board->Undo(); },
+		[Board, &Landings](int32 i) { Board->Place(*Landings[i].Piece, Landings[i].Coordinate); });
+
+	Benchmark.Run(TEXT("InternalBoard.Place (rejected)"), 4000,
+		[Board, &Landings](int32 i) { Board->Place(*Landings[i & 7].Piece, Landings[i & 7].Coordinate - FIntPoint(0, 1)); });
+
+	Benchmark.Run(TEXT("InternalBoard.ClearRows"), 250, NumBoards,
+		[&UndoAll, &ClearedRows] { UndoAll(); ClearedRows.Reset(); },
+		[&Boards, &ClearedRows](int32 i) { Boards[i]->ClearRows(ClearedRows); });
+
+	Benchmark.Run(TEXT("InternalBoard.Collapse"), 250, NumBoards,
+		[&UndoAll, &ClearAll] { UndoAll(); ClearAll(); },
+		[&Boards](int32 i) { Boards[i]->Collapse(); });
+
+	Benchmark.Run(TEXT("InternalBoard.Undo"), 250, NumBoards,
+		[&Boards, &ClearAll] { ClearAll(); for (UInternalBoard* Each : Boards) { Each->Collapse(); } },
+		[&Boards](int32 i) { Boards[i]->Undo(); });
+
+	int32 SumOfHeights = 0;
+	Benchmark.Run(TEXT("InternalBoard.GetStackHeight"), 10000,
+		[Board, &SumOfHeights](int32) { SumOfHeights += Board->GetStackHeight(); });
+	TestTrue("Stack height is read.", SumOfHeights > 0);
+
+	/* Commit boards whose top piece moves up and down a row between commits, so that they never fill up.*/
+	{
+		const FPlacement& Top = Landings[0];
+		for (UInternalBoard* Each : Boards)
+		{
+			Each->Undo();
+			Each->Place(*Top.Piece, Top.Coordinate);
+			Each->Commit();
+		}
+		int32 Offset = 0;
+		Benchmark.Run(TEXT("InternalBoard.Commit"), 250, NumBoards,
+			[&Boards, &Top, &Offset]
+			{
+				const int32 NewOffset = 1 - Offset;
+				for (UInternalBoard* Each : Boards)
+				{
+					Each->Move(*Top.Piece, Top.Coordinate + FIntPoint(0, Offset), *Top.Piece, Top.Coordinate + FIntPoint(0, NewOffset));
+				}
+				Offset = NewOffset;
+			},
+			[&Boards](int32 i) { Boards[i]->Commit(); });
+		TestFalse("Committed piece is where it was last moved.", Board->CanPlace(*Top.Piece, Top.Coordinate + FIntPoint(0, Offset)));
+	}
+
+	Benchmark.Finish();
+	return true;
+}
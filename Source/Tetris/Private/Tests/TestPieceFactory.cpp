@@ -52,76 +52,106 @@ bool FPieceFactoryTests::RunTest(const FString& Parameters)
 	/* Tests for 'I' piece*/
     {
         FPieceData PieceDataI{ {{0,2},{1,2},{2,2},{3,2}}, {1.5f, 1.5f} };
-        UPiece* IPiece0 = PieceFactory->Build(PieceDataI);
+        TArray<FPieceShape> Shapes;
+        TestTrue("IPiece is built.", PieceFactory->Build(PieceDataI, Shapes));
+        const FPieceShape& IPiece0 = Shapes[0];
 
         /* 0-rotation tests.*/
-        TestTrue("IPiece 0-rotation Body is correct.", AreArraysEqual(IPiece0->Body, { {{0,2},{1,2},{2,2},{3,2}} }));
-        TestTrue("IPiece 0-rotation skirt is correct.", AreArraysEqual(IPiece0->Skirt, { {{0,2},{1,2},{2,2},{3,2}} }));
+        TestTrue("IPiece 0-rotation Body is correct.", AreArraysEqual(IPiece0.GetBody(), { {{0,2},{1,2},{2,2},{3,2}} }));
+        TestTrue("IPiece 0-rotation skirt is correct.", AreArraysEqual(IPiece0.GetSkirt(), { {{0,2},{1,2},{2,2},{3,2}} }));
 
         /* R-rotation tests.*/
-        UPiece* IPieceR = IPiece0->Next;
-        TestTrue("IPiece R-rotation Body is correct.", AreArraysEqual(IPieceR->Body, { {{2,3},{2,2},{2,1},{2,0}} }));
-        TestTrue("IPiece R-rotation skirt is correct.", AreArraysEqual(IPieceR->Skirt, { {2,0} }));
+        const FPieceShape& IPieceR = IPiece0.RotateR();
+        TestTrue("IPiece R-rotation Body is correct.", AreArraysEqual(IPieceR.GetBody(), { {{2,3},{2,2},{2,1},{2,0}} }));
+        TestTrue("IPiece R-rotation skirt is correct.", AreArraysEqual(IPieceR.GetSkirt(), { {2,0} }));
 
         /* 2-rotation tests.*/
-        UPiece* IPiece2 = IPieceR->Next;
-        TestTrue("IPiece 2-rotation Body is correct.", AreArraysEqual(IPiece2->Body, { {{0,1},{1,1},{2,1},{3,1}} }));
-        TestTrue("IPiece 2-rotation skirt is correct.", AreArraysEqual(IPiece2->Skirt, { {{0,1},{1,1},{2,1},{3,1}} }));
+        const FPieceShape& IPiece2 = IPieceR.RotateR();
+        TestTrue("IPiece 2-rotation Body is correct.", AreArraysEqual(IPiece2.GetBody(), { {{0,1},{1,1},{2,1},{3,1}} }));
+        TestTrue("IPiece 2-rotation skirt is correct.", AreArraysEqual(IPiece2.GetSkirt(), { {{0,1},{1,1},{2,1},{3,1}} }));
 
         /* L-rotation tests.*/
-        UPiece* IPieceL = IPiece0->Prev;
-        TestTrue("IPiece L-rotation Body is correct.", AreArraysEqual(IPieceL->Body, { {{1,3},{1,2},{1,1},{1,0}} }));
-        TestTrue("IPiece L-rotation skirt is correct.", AreArraysEqual(IPieceL->Skirt, { {1,0} }));
+        const FPieceShape& IPieceL = IPiece0.RotateL();
+        TestTrue("IPiece L-rotation Body is correct.", AreArraysEqual(IPieceL.GetBody(), { {{1,3},{1,2},{1,1},{1,0}} }));
+        TestTrue("IPiece L-rotation skirt is correct.", AreArraysEqual(IPieceL.GetSkirt(), { {1,0} }));
     }
 
     /* Tests for 'O' piece*/
     {
         FPieceData PieceDataO{ {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}, {1.5f, 1.5f} };
-        UPiece* OPiece0 = PieceFactory->Build(PieceDataO);
+        TArray<FPieceShape> Shapes;
+        TestTrue("OPiece is built.", PieceFactory->Build(PieceDataO, Shapes));
+        const FPieceShape& OPiece0 = Shapes[0];
 
         /* 0-rotation tests.*/
-        TestTrue("OPiece 0-rotation Body is correct.", AreArraysEqual(OPiece0->Body, {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
-        TestTrue("OPiece 0-rotation skirt is correct.", AreArraysEqual(OPiece0->Skirt, { {1, 1}, { 2,1 } }));
+        TestTrue("OPiece 0-rotation Body is correct.", AreArraysEqual(OPiece0.GetBody(), {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
+        TestTrue("OPiece 0-rotation skirt is correct.", AreArraysEqual(OPiece0.GetSkirt(), { {1, 1}, { 2,1 } }));
 
         /* R-rotation tests.*/
-        UPiece* OPieceR = OPiece0->Next;
-        TestTrue("OPiece R-rotation Body is correct.", AreArraysEqual(OPieceR->Body, {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
-        TestTrue("OPiece R-rotation skirt is correct.", AreArraysEqual(OPieceR->Skirt, { {1, 1}, { 2,1 } }));
+        const FPieceShape& OPieceR = OPiece0.RotateR();
+        TestTrue("OPiece R-rotation Body is correct.", AreArraysEqual(OPieceR.GetBody(), {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
+        TestTrue("OPiece R-rotation skirt is correct.", AreArraysEqual(OPieceR.GetSkirt(), { {1, 1}, { 2,1 } }));
 
         /* 2-rotation tests.*/
-        UPiece* OPiece2 = OPieceR->Next;
-        TestTrue("OPiece 2-rotation Body is correct.", AreArraysEqual(OPiece2->Body, {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
-        TestTrue("OPiece 2-rotation skirt is correct.", AreArraysEqual(OPiece2->Skirt, { {1, 1}, { 2,1 } }));
+        const FPieceShape& OPiece2 = OPieceR.RotateR();
+        TestTrue("OPiece 2-rotation Body is correct.", AreArraysEqual(OPiece2.GetBody(), {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
+        TestTrue("OPiece 2-rotation skirt is correct.", AreArraysEqual(OPiece2.GetSkirt(), { {1, 1}, { 2,1 } }));
 
         /* L-rotation tests.*/
-        UPiece* OPieceL = OPiece0->Prev;
-        TestTrue("OPiece L-rotation Body is correct.", AreArraysEqual(OPieceL->Body, {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
-        TestTrue("OPiece L-rotation skirt is correct.", AreArraysEqual(OPieceL->Skirt, { {1, 1}, { 2,1 } }));
+        const FPieceShape& OPieceL = OPiece0.RotateL();
+        TestTrue("OPiece L-rotation Body is correct.", AreArraysEqual(OPieceL.GetBody(), {{1, 1}, { 1,2 }, { 2,1 }, { 2, 2 }}));
+        TestTrue("OPiece L-rotation skirt is correct.", AreArraysEqual(OPieceL.GetSkirt(), { {1, 1}, { 2,1 } }));
     }
 
     /* Tests for 'L' piece*/
     {
         FPieceData PieceDataL{ {{0, 2}, { 0,1 }, { 1,1 }, { 2, 1 }}, {1.f, 1.f} };
-        UPiece* LPiece0 = PieceFactory->Build(PieceDataL);
+        TArray<FPieceShape> Shapes;
+        TestTrue("LPiece is built.", PieceFactory->Build(PieceDataL, Shapes));
+        const FPieceShape& LPiece0 = Shapes[0];
 
         /* 0-rotation tests.*/
-        TestTrue("LPiece 0-rotation Body is correct.", AreArraysEqual(LPiece0->Body, {{0,2}, {0,1}, {1,1}, {2, 1 }}));
-        TestTrue("LPiece 0-rotation skirt is correct.", AreArraysEqual(LPiece0->Skirt, { {0,1}, {1,1}, {2,1} }));
+        TestTrue("LPiece 0-rotation Body is correct.", AreArraysEqual(LPiece0.GetBody(), {{0,2}, {0,1}, {1,1}, {2, 1 }}));
+        TestTrue("LPiece 0-rotation skirt is correct.", AreArraysEqual(LPiece0.GetSkirt(), { {0,1}, {1,1}, {2,1} }));
 
         /* R-rotation tests.*/
-        UPiece* LPieceR = LPiece0->Next;
-        TestTrue("LPiece R-rotation Body is correct.", AreArraysEqual(LPieceR->Body, {{1,0}, {1,1}, {1,2}, {2,2}}));
-        TestTrue("LPiece R-rotation skirt is correct.", AreArraysEqual(LPieceR->Skirt, { {1,0},{2,2} }));
+        const FPieceShape& LPieceR = LPiece0.RotateR();
+        TestTrue("LPiece R-rotation Body is correct.", AreArraysEqual(LPieceR.GetBody(), {{1,0}, {1,1}, {1,2}, {2,2}}));
+        TestTrue("LPiece R-rotation skirt is correct.", AreArraysEqual(LPieceR.GetSkirt(), { {1,0},{2,2} }));
 
         /* 2-rotation tests.*/
-        UPiece* LPiece2 = LPieceR->Next;
-        TestTrue("LPiece 2-rotation Body is correct.", AreArraysEqual(LPiece2->Body, {{0,1}, {1,1}, {2,1}, {2,0}}));
-        TestTrue("LPiece 2-rotation skirt is correct.", AreArraysEqual(LPiece2->Skirt, { {0,1}, {1,1}, {2,0} }));
+        const FPieceShape& LPiece2 = LPieceR.RotateR();
+        TestTrue("LPiece 2-rotation Body is correct.", AreArraysEqual(LPiece2.GetBody(), {{0,1}, {1,1}, {2,1}, {2,0}}));
+        TestTrue("LPiece 2-rotation skirt is correct.", AreArraysEqual(LPiece2.GetSkirt(), { {0,1}, {1,1}, {2,0} }));
 
         /* L-rotation tests.*/
-        UPiece* LPieceL = LPiece0->Prev;
-        TestTrue("LPiece L-rotation Body is correct.", AreArraysEqual(LPieceL->Body, { {0,0},{1,0},{1,1},{1,2} }));
-        TestTrue("LPiece L-rotation skirt is correct.", AreArraysEqual(LPieceL->Skirt, { {0,0}, {1,0} }));
+        const FPieceShape& LPieceL = LPiece0.RotateL();
+        TestTrue("LPiece L-rotation Body is correct.", AreArraysEqual(LPieceL.GetBody(), { {0,0},{1,0},{1,1},{1,2} }));
+        TestTrue("LPiece L-rotation skirt is correct.", AreArraysEqual(LPieceL.GetSkirt(), { {0,0}, {1,0} }));
+    }
+
+    /* Tests for the compile-time standard pieces.*/
+    {
+        TConstArrayView<FPieceShape> StandardShapes = FStandardPieceShapes::Get();
+        TestEqual("Standard table has every rotation of every piece.", StandardShapes.Num(), FStandardPieceShapes::NumPieces * FPieceShape::NumRotations);
+
+        /* The factory builds data table pieces into the same layout.*/
+        FPieceData PieceDataI{ {{0,2},{1,2},{2,2},{3,2}}, {1.5f, 1.5f} };
+        FPieceData PieceDataO{ {{1,1},{1,2},{2,1},{2,2}}, {1.5f, 1.5f} };
+        TArray<FPieceShape> Shapes;
+        PieceFactory->Build(PieceDataI, Shapes);
+        PieceFactory->Build(PieceDataO, Shapes);
+        for (int32 i = 0; i < Shapes.Num(); ++i)
+        {
+            TestTrue("Standard shape matches the factory.", FMemory::Memcmp(&Shapes[i], &StandardShapes[i], sizeof(FPieceShape)) == 0);
+        }
+
+        /* Four rotations in either direction return to the same shape.*/
+        for (const FPieceShape& Shape : StandardShapes)
+        {
+            TestTrue("R-rotations cycle.", &Shape.RotateR().RotateR().RotateR().RotateR() == &Shape);
+            TestTrue("L-rotations undo R-rotations.", &Shape.RotateR().RotateL() == &Shape);
+        }
     }
 	return true;
 }
@@ -0,0 +1,75 @@
+#include "CoreMinimal.h"
+#include "PieceSequence.h"
+#include "Misc/AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPieceSequenceTests, "Tetris.Piece Sequence", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FPieceSequenceTests::RunTest(const FString& Parameters)
+{
+	/* Tests for the bag contents.*/
+	{
+		FPieceSequence Sequence;
+		Sequence.Initialize(7, 1234);
+		TestEqual("Sequence is filled with two bags.", Sequence.Num(), 14);
+
+		/* Every bag is a permutation of all pieces.*/
+		bool bAllBagsArePermutations = true;
+		for (int32 Bag = 0; Bag < 10; ++Bag)
+		{
+			uint32 SeenPieces = 0;
+			for (int32 i = 0; i < 7; ++i)
+			{
+				SeenPieces |= 1u << Sequence.Pop();
+			}
+			bAllBagsArePermutations &= SeenPieces == 0x7Fu;
+		}
+		TestTrue("Every bag contains every piece once.", bAllBagsArePermutations);
+		TestTrue("Sequence never runs below two bags.", Sequence.Num() >= 14);
+	}
+
+	/* Tests for reproducibility.*/
+	{
+		FPieceSequence SequenceA;
+		FPieceSequence SequenceB;
+		SequenceA.Initialize(7, 42);
+		SequenceB.Initialize(7, 42);
+		bool bSequencesMatch = true;
+		for (int32 i = 0; i < 100; ++i)
+		{
+			bSequencesMatch &= SequenceA.Pop() == SequenceB.Pop();
+		}
+		TestTrue("Sequences with the same seed match.", bSequencesMatch);
+		TestEqual("Seed is reported.", SequenceA.GetSeed(), 42);
+	}
+
+	/* Tests for peeking.*/
+	{
+		FPieceSequence Sequence;
+		Sequence.Initialize(7, 7);
+
+		/* Pop enough pieces that the view wraps around the end of the buffer.*/
+		bool bPeekMatchesPops = true;
+		for (int32 i = 0; i < 50; ++i)
+		{
+			TConstArrayView<uint8> Preview = Sequence.PeekN(6);
+			uint8 Expected[6];
+			FMemory::Memcpy(Expected, Preview.GetData(), 6);
+			bPeekMatchesPops &= Sequence.Top() == Expected[0];
+			bPeekMatchesPops &= Sequence.Pop() == Expected[0];
+			bPeekMatchesPops &= FMemory::Memcmp(Sequence.PeekN(5).GetData(), &Expected[1], 5) == 0;
+		}
+		TestTrue("Peeked pieces match the popped pieces.", bPeekMatchesPops);
+		TestEqual("Peeking is limited to the queued pieces.", Sequence.PeekN(100).Num(), Sequence.Num());
+	}
+
+	/* Tests for adding bags to a full sequence.*/
+	{
+		FPieceSequence Sequence;
+		Sequence.Initialize(7, 3);
+		TestTrue("Bag is added while there is room.", Sequence.AddBag() && Sequence.AddBag());
+		const uint8 Next = Sequence.Top();
+		TestFalse("Bag is refused when the sequence is full.", Sequence.AddBag());
+		TestTrue("Full sequence is unchanged.", Sequence.Num() == 28 && Sequence.Top() == Next);
+	}
+	return true;
+}
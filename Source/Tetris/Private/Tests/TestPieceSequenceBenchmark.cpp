@@ -0,0 +1,34 @@
+#include "CoreMinimal.h"
+#include "PieceSequence.h"
+#include "TetrisBenchmark.h"
+#include "Misc/AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPieceSequenceBenchmark, "Tetris.Benchmark.Piece Sequence", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FPieceSequenceBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 BagSize = 7;
+	FTetrisBenchmark Benchmark(*this, TEXT("PieceSequence"));
+	FPieceSequence Sequence;
+	Sequence.Initialize(BagSize, 5);
+
+	/* Every seventh pop refills a bag, so the time per pop includes its share of the refills.*/
+	int32 SumOfPieces = 0;
+	Benchmark.Run(TEXT("PieceSequence.Pop"), 7000,
+		[&Sequence, &SumOfPieces](int32) { SumOfPieces += Sequence.Pop(); });
+	TestTrue("Pieces are popped.", SumOfPieces > 0);
+
+	/* A fresh sequence holds two bags, leaving room for two more. Each batch refills a set of fresh sequences, so that it is long enough to time precisely.*/
+	constexpr int32 NumFreeBags = (FPieceSequence::Capacity - 2 * BagSize) / BagSize;
+	constexpr int32 NumSequences = 64;
+	TArray<FPieceSequence> Sequences;
+	Sequences.SetNum(NumSequences);
+	bool bAllBagsFit = true;
+	Benchmark.Run(TEXT("PieceSequence.AddBag"), 250, NumFreeBags * NumSequences,
+		[&Sequences] { for (FPieceSequence& Each : Sequences) { Each.Initialize(BagSize, 5); } },
+		[&Sequences, &bAllBagsFit](int32 i) { bAllBagsFit &= Sequences[i % NumSequences].AddBag(); });
+	TestTrue("Every bag fits.", bAllBagsFit);
+
+	Benchmark.Finish();
+	return true;
+}
@@ -0,0 +1,122 @@
+#include "CoreMinimal.h"
+#include "AI/PlacementGenerator.h"
+#include "Simulation/TetrisSimulation.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+namespace
+{
+	/* Return true if the path doesn't end with its only hard drop.*/
+	bool HasMalformedPath(TConstArrayView<EAction> Path)
+	{
+		return Path.IsEmpty() || Path.Last() != EAction::HARD_DROP || Path.Left(Path.Num() - 1).Contains(EAction::HARD_DROP);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlacementGeneratorTests, "Tetris.AI.Placement Generator", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FPlacementGeneratorTests::RunTest(const FString& Parameters)
+{
+	const TConstArrayView<FPieceShape> Shapes = FStandardPieceShapes::Get();
+	const FTetrisSimulationConfig Config;
+	const FIntPoint Spawn(Config.Width / 2 - 2, Config.Height);
+	FPlacementGenerator Generator;
+
+	/* Tests on an empty board, where every placement is a hard drop.*/
+	{
+		FBoardState Board;
+		Board.Initialize(Config.Width, Config.Height + Config.TopSpace);
+
+		/* Pieces are ordered I, O, T, S, Z, J, L.*/
+		constexpr int32 ExpectedPlacements[] = { 17, 9, 34, 17, 17, 34, 34 };
+		bool bCountsMatch = true;
+		bool bAllHardDrops = true;
+		bool bPathsWellFormed = true;
+		for (int32 Piece = 0; Piece < FStandardPieceShapes::NumPieces; ++Piece)
+		{
+			bCountsMatch &= Generator.Generate(Board, Shapes[Piece * FPieceShape::NumRotations], Spawn) == ExpectedPlacements[Piece];
+			for (const FPiecePlacement& Placement : Generator.GetPlacements())
+			{
+				bAllHardDrops &= !Placement.bNeedsSoftDrop && !Generator.GetPath(Placement).Contains(EAction::DOWN);
+				bPathsWellFormed &= !HasMalformedPath(Generator.GetPath(Placement));
+			}
+		}
+		TestTrue("Every distinct placement of every piece is found once.", bCountsMatch);
+		TestTrue("Placements on an empty board are hard dropped.", bAllHardDrops);
+		TestTrue("Paths end with their only hard drop.", bPathsWellFormed);
+	}
+
+	/* Tests for tucks.*/
+	{
+		FBoardState Board;
+		Board.Initialize(Config.Width, Config.Height + Config.TopSpace);
+		Board.SetRowMask(1, 0b1111);
+
+		/* A flat I fits under the overhang only by sliding in from the right along the floor.*/
+		bool bFoundTuck = false;
+		Generator.Generate(Board, Shapes[0], Spawn);
+		for (const FPiecePlacement& Placement : Generator.GetPlacements())
+		{
+			const TConstArrayView<EAction> Path = Generator.GetPath(Placement);
+			const bool bUnderOverhang = Placement.Coordinate.X + Placement.Piece->MinX == 0 && Placement.Coordinate.Y + Placement.Piece->MinY == 0 && Placement.Piece->MinY == Placement.Piece->MaxY;
+			bFoundTuck |= bUnderOverhang && Placement.bNeedsSoftDrop && Path.Num() >= 2 && Path[Path.Num() - 2] == EAction::LEFT;
+		}
+		TestTrue("Piece is tucked under an overhang.", bFoundTuck);
+		TestEqual("Board is not modified.", Board.GetRowMask(1), uint32(0b1111));
+		TestEqual("Board is not journaled.", Board.GetUndoDepth(), 0);
+	}
+
+	/* Tests that every path plays out in the simulation, on the boards of random games.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(5);
+		Simulation.Start();
+		FRandomStream Policy(5);
+
+		int32 NumGenerated = 0;
+		int32 NumPlacements = 0;
+		int32 NumTucks = 0;
+		int32 NumSpins = 0;
+		bool bPathsPlayOut = true;
+		double GenerateSeconds = 0.0;
+		for (int32 Step = 0; Step < 20000; ++Step)
+		{
+			if (Simulation.IsGameOver())
+			{
+				Simulation.Reset(5 + Step);
+				Simulation.Start();
+			}
+			if (Simulation.GetPhase() == ETetrisPhase::Falling && Step % 7 == 0)
+			{
+				const double Start = FPlatformTime::Seconds();
+				Generator.Generate(Simulation.GetBoard(), *Simulation.GetCurrentPiece(), Simulation.GetCurrentCoordinate());
+				GenerateSeconds += FPlatformTime::Seconds() - Start;
+				++NumGenerated;
+
+				for (const FPiecePlacement& Placement : Generator.GetPlacements())
+				{
+					const TConstArrayView<EAction> Path = Generator.GetPath(Placement);
+					FTetrisSimulation Copy = Simulation;
+					TetrisTests::FLockRecorder Recorder;
+					Copy.SetObserver(&Recorder);
+					bPathsPlayOut &= Copy.ApplyActions(Path) == Path.Num() && Recorder.Piece == Placement.Piece && Recorder.Coordinate == Placement.Coordinate;
+
+					const EAction LastMove = Path.Num() >= 2 ? Path[Path.Num() - 2] : EAction::HARD_DROP;
+					NumTucks += Placement.bNeedsSoftDrop && (LastMove == EAction::LEFT || LastMove == EAction::RIGHT) ? 1 : 0;
+					NumSpins += Placement.bNeedsSoftDrop && (LastMove == EAction::ROTATE_L || LastMove == EAction::ROTATE_R) ? 1 : 0;
+					++NumPlacements;
+				}
+			}
+			Simulation.ApplyAction(static_cast<EAction>(Policy.RandRange(EAction::LEFT, EAction::ROTATE_L)));
+			Simulation.Tick();
+		}
+		TestTrue("Placements are generated.", NumGenerated > 0 && NumPlacements > 0);
+		TestTrue("Every path locks the piece where it says.", bPathsPlayOut);
+		TestTrue("Tucks are found.", NumTucks > 0);
+		TestTrue("Spins are found.", NumSpins > 0);
+		AddInfo(FString::Printf(TEXT("%d searches, %.1f placements each, %.2f us per search."),
+			NumGenerated, double(NumPlacements) / NumGenerated, GenerateSeconds * 1e6 / NumGenerated));
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+#include "CoreMinimal.h"
+#include "Simulation/SimulationRunner.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	/* A stateless controller, so that the actions don't depend on how the boards are split between threads.*/
+	void HashedController(FTetrisSimulation& Board, int32 BoardIndex)
+	{
+		const uint32 Hash = (uint32(BoardIndex) * 2654435761u) ^ (uint32(Board.GetElapsedTicks()) * 40503u);
+		Board.ApplyAction(static_cast<EAction>((Hash >> 7) % 5));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSimulationRunnerTests, "Tetris.Simulation Runner", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FSimulationRunnerTests::RunTest(const FString& Parameters)
+{
+	FTetrisSimulationConfig Config;
+	Config.CollapseDelayTicks = 0;
+
+	/* Tests for the chunk layout.*/
+	{
+		FSimulationRunner Runner;
+		Runner.Initialize(Config, 10, 1, {}, 4);
+		TestEqual("Every board is created.", Runner.GetNumBoards(), 10);
+		TestEqual("Boards are split into the requested chunks.", Runner.GetNumChunks(), 4);
+
+		Runner.Initialize(Config, 3, 1, {}, 8);
+		TestEqual("Chunks never outnumber boards.", Runner.GetNumChunks(), 3);
+	}
+
+	/* Tests for matching a single game.*/
+	{
+		FSimulationRunner Runner;
+		Runner.Initialize(Config, 64, 100, {}, 8);
+		Runner.Step(200, HashedController);
+
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(100 + 37);
+		Simulation.Start();
+		for (int32 Tick = 0; Tick < 200; ++Tick)
+		{
+			HashedController(Simulation, 37);
+			Simulation.Tick();
+		}
+		const FTetrisSimulation& Board = Runner.GetBoard(37);
+		TestEqual("Runner board matches a single game.", Board.GetElapsedTicks(), Simulation.GetElapsedTicks());
+		TestTrue("Runner board has the same stack.", Board.GetBoard().GetStackHeight() == Simulation.GetBoard().GetStackHeight() && Board.GetCurrentCoordinate() == Simulation.GetCurrentCoordinate());
+	}
+
+	/* Tests for determinism across chunk counts.*/
+	{
+		FSimulationRunner SerialRunner;
+		FSimulationRunner ParallelRunner;
+		SerialRunner.Initialize(Config, 64, 1, {}, 1);
+		ParallelRunner.Initialize(Config, 64, 1, {}, 7);
+		SerialRunner.Step(3000, HashedController);
+		ParallelRunner.Step(3000, HashedController);
+
+		const FSimulationStats SerialStats = SerialRunner.GetStats();
+		const FSimulationStats ParallelStats = ParallelRunner.GetStats();
+		TestEqual("Every board step is counted.", ParallelStats.Ticks, int64(64 * 3000));
+		TestTrue("Games finish and restart.", ParallelStats.GamesFinished > 0);
+		TestEqual("Finished games match.", ParallelStats.GamesFinished, SerialStats.GamesFinished);
+		TestEqual("Scores match.", ParallelStats.Score, SerialStats.Score);
+
+		bool bBoardsMatch = true;
+		for (int32 i = 0; i < 64; ++i)
+		{
+			bBoardsMatch &= SerialRunner.GetBoard(i).GetScore() == ParallelRunner.GetBoard(i).GetScore();
+			bBoardsMatch &= SerialRunner.GetBoard(i).GetElapsedTicks() == ParallelRunner.GetBoard(i).GetElapsedTicks();
+		}
+		TestTrue("Every board matches.", bBoardsMatch);
+	}
+
+	/* Measure the scaling across cores.*/
+	{
+		constexpr int32 NumBoards = 1024;
+		constexpr int32 NumTicks = 1000;
+		double TicksPerSecond[2] = {};
+		for (int32 Run = 0; Run < 2; ++Run)
+		{
+			FSimulationRunner Runner;
+			Runner.Initialize(Config, NumBoards, 1, {}, Run == 0 ? 1 : 0);
+			const double StartTime = FPlatformTime::Seconds();
+			Runner.Step(NumTicks, HashedController);
+			const double Duration = FMath::Max(FPlatformTime::Seconds() - StartTime, 1e-9);
+			TicksPerSecond[Run] = Runner.GetStats().Ticks / Duration;
+			AddInfo(FString::Printf(TEXT("%d chunk(s): %.0f board ticks/s, %lld games finished."), Runner.GetNumChunks(), TicksPerSecond[Run], Runner.GetStats().GamesFinished));
+		}
+		AddInfo(FString::Printf(TEXT("Speedup over one chunk: %.2fx."), TicksPerSecond[1] / TicksPerSecond[0]));
+	}
+	return true;
+}
@@ -0,0 +1,137 @@
+#include "CoreMinimal.h"
+#include "AI/TetrisAIController.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+namespace
+{
+	/* Search settings that always search to the same depth, so that plans don't depend on timing.*/
+	FTetrisSearchSettings MakeSettings()
+	{
+		FTetrisSearchSettings Settings;
+		Settings.BeamWidth = 8;
+		Settings.NumPreviewPieces = 2;
+		Settings.TimeBudgetSeconds = 30.0;
+		return Settings;
+	}
+
+	/* Poll for the plan like a frame would, until it arrives. Return false if it doesn't arrive in time.*/
+	bool WaitForPlan(FTetrisAIController& Controller, const FTetrisSimulation& Game, TArray<EAction>& OutActions)
+	{
+		const double Deadline = FPlatformTime::Seconds() + 60.0;
+		while (!Controller.ConsumePlan(Game, OutActions))
+		{
+			if (FPlatformTime::Seconds() > Deadline) { return false; }
+			FPlatformProcess::Sleep(0.001f);
+		}
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisAIControllerTests, "Tetris.AI.Controller", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisAIControllerTests::RunTest(const FString& Parameters)
+{
+	/* Tests for playing a game frame by frame.*/
+	{
+		FTetrisAIController Controller(FBoardEvaluator(), MakeSettings());
+		FTetrisSimulation Game = TetrisTests::MakeGame(6);
+
+		/* Request a plan when a piece spawns and play it when it arrives, never waiting in between.*/
+		constexpr int32 MaxPieces = 40;
+		int32 NumPieces = 0;
+		int32 NumFrames = 0;
+		double FrameSeconds = 0.0;
+		double SearchSeconds = 0.0;
+		TArray<EAction> Actions;
+		const double Deadline = FPlatformTime::Seconds() + 120.0;
+		while (NumPieces < MaxPieces && !Game.IsGameOver() && FPlatformTime::Seconds() < Deadline)
+		{
+			const double FrameStart = FPlatformTime::Seconds();
+			if (Controller.ConsumePlan(Game, Actions))
+			{
+				Game.ApplyActions(Actions);
+				Actions.Reset();
+				SearchSeconds += Controller.GetLastPlan().SearchSeconds;
+				++NumPieces;
+			}
+			if (EnumHasAnyFlags(Game.ConsumeEvents(), ETetrisEvents::PieceSpawned))
+			{
+				Controller.RequestPlan(Game);
+			}
+			FrameSeconds += FPlatformTime::Seconds() - FrameStart;
+			++NumFrames;
+			FPlatformProcess::Sleep(0.0005f);
+		}
+		TestEqual("Every piece is played.", NumPieces, MaxPieces);
+		TestEqual("No plan is discarded.", Controller.GetNumDiscarded(), 0);
+		TestTrue("Handing plans over costs less than searching them.", FrameSeconds < SearchSeconds);
+		AddInfo(FString::Printf(TEXT("%d frames, %.1f us per frame, %.2f ms per search."), NumFrames, FrameSeconds * 1e6 / FMath::Max(NumFrames, 1), SearchSeconds * 1e3 / FMath::Max(NumPieces, 1)));
+
+		/* The plans are the moves the search would make on the game thread.*/
+		FTetrisSearch Search(FBoardEvaluator(), MakeSettings());
+		FTetrisSimulation SearchedGame = TetrisTests::MakeGame(6);
+		FTetrisSearchResult Result;
+		for (int32 Piece = 0; Piece < NumPieces && Search.Search(SearchedGame, Result); ++Piece)
+		{
+			SearchedGame.ApplyActions(Result.Actions);
+		}
+		TestTrue("Game is played as by the search.", SearchedGame.GetBoard().GetHash() == Game.GetBoard().GetHash() && SearchedGame.GetScore() == Game.GetScore());
+	}
+
+	/* Tests for plans that arrive after the piece moved.*/
+	{
+		FTetrisAIController Controller(FBoardEvaluator(), MakeSettings());
+		FTetrisSimulation Game = TetrisTests::MakeGame(3, 0.5f);
+		FTetrisSimulation StillGame = Game;
+		Controller.RequestPlan(Game);
+		const FIntPoint Start = Game.GetCurrentCoordinate();
+		for (int32 Step = 0; Step < 6; ++Step)
+		{
+			Game.Tick();
+		}
+		TestTrue("Piece falls while the plan is searched.", Game.GetCurrentCoordinate() != Start && Game.GetCurrentPiece() == StillGame.GetCurrentPiece());
+
+		TArray<EAction> Actions;
+		TestTrue("Plan arrives.", WaitForPlan(Controller, Game, Actions));
+		Game.ApplyActions(Actions);
+		StillGame.ApplyActions(Controller.GetLastPlan().Result.Actions);
+		TestTrue("Piece that fell is placed where it was planned.", Game.GetBoard().GetHash() == StillGame.GetBoard().GetHash());
+	}
+
+	/* Tests for cancelling plans.*/
+	{
+		FTetrisAIController Controller(FBoardEvaluator(), MakeSettings());
+		FTetrisSimulation Game = TetrisTests::MakeGame(4);
+		TArray<EAction> Actions;
+
+		/* A plan for a board that changed is searched again for the board as it is.*/
+		Controller.RequestPlan(Game);
+		Game.ApplyAction(EAction::HARD_DROP);
+		const uint64 ChangedHash = Game.GetBoard().GetHash();
+		TestTrue("Plan arrives for the changed board.", WaitForPlan(Controller, Game, Actions));
+		TestEqual("Plan for the old board is discarded.", Controller.GetNumDiscarded(), 1);
+		Game.ApplyActions(Actions);
+		TestTrue("Plan for the changed board is played.", Game.GetBoard().GetHash() != ChangedHash && Actions.Last() == EAction::HARD_DROP);
+		Actions.Reset();
+
+		/* Only the latest request is answered.*/
+		Controller.RequestPlan(Game);
+		Controller.RequestPlan(Game);
+		TestTrue("Latest plan arrives.", WaitForPlan(Controller, Game, Actions));
+		TestFalse("Nothing is left to plan.", Controller.IsPlanning());
+		TestFalse("Earlier plan is never played.", Controller.ConsumePlan(Game, Actions));
+		Actions.Reset();
+
+		/* A cancelled plan never arrives.*/
+		Controller.RequestPlan(Game);
+		Controller.Cancel();
+		TestFalse("Nothing is planned after a cancel.", Controller.IsPlanning());
+		FPlatformProcess::Sleep(0.05f);
+		TestFalse("Cancelled plan isn't played.", Controller.ConsumePlan(Game, Actions));
+
+		/* The controller can be destroyed while it searches.*/
+		Controller.RequestPlan(Game);
+	}
+	return true;
+}
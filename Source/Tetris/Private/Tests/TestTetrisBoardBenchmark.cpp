@@ -0,0 +1,79 @@
+#include "CoreMinimal.h"
+#include "TetrisBoard.h"
+#include "PieceQueue.h"
+#include "Simulation/TetrisSnapshot.h"
+#include "TetrisBenchmark.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	/* Play a game headlessly until the stack is half the height of the board, and save it to a snapshot file.*/
+	bool SaveMidGameSnapshot(const FTetrisSimulationConfig& Config, TConstArrayView<FPieceShape> Shapes, const FString& Filename)
+	{
+		constexpr EAction Actions[] = { EAction::LEFT, EAction::RIGHT, EAction::ROTATE_R, EAction::ROTATE_L, EAction::HARD_DROP };
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config, Shapes);
+		Simulation.Reset(11);
+		Simulation.Start();
+		FRandomStream Policy(11);
+		while (!Simulation.IsGameOver() && (Simulation.GetPhase() != ETetrisPhase::Falling || Simulation.GetBoard().GetStackHeight() < Config.Height / 2))
+		{
+			Simulation.ApplyAction(Actions[Policy.RandRange(0, int32(UE_ARRAY_COUNT(Actions)) - 1)]);
+			Simulation.Tick();
+		}
+
+		TArray<uint8> Data;
+		return !Simulation.IsGameOver() && FTetrisSnapshot::Save(Simulation, Data) && FFileHelper::SaveArrayToFile(Data, *Filename);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisBoardBenchmark, "Tetris.Benchmark.Tetris Board", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FTetrisBoardBenchmark::RunTest(const FString& Parameters)
+{
+	/* Spawn the board used by the game into a world of its own, or the native board if the blueprint can't be loaded.*/
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	UClass* BoardClass = LoadClass<ATetrisBoard>(nullptr, TEXT("/Game/Core/BP_TetrisBoard.BP_TetrisBoard_C"));
+	ATetrisBoard* Board = World->SpawnActor<ATetrisBoard>(BoardClass ? BoardClass : ATetrisBoard::StaticClass());
+	if (Board)
+	{
+		Board->DispatchBeginPlay();
+	}
+	UPieceQueue* PieceQueue = Board ? Board->FindComponentByClass<UPieceQueue>() : nullptr;
+
+	const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("TetrisBoardBenchmark.tetrissnapshot"));
+	if (TestNotNull("Board is spawned.", PieceQueue)
+		&& TestTrue("Mid-game board is saved.", SaveMidGameSnapshot(Board->GetSimulation().GetConfig(), PieceQueue->GetShapeTable(), Filename))
+		&& TestTrue("Mid-game board is loaded.", Board->LoadSnapshot(Filename)))
+	{
+		FTetrisBenchmark Benchmark(*this, TEXT("TetrisBoard"));
+
+		/* Shift and rotate the active piece back and forth, redrawing it and its ghost after each move.*/
+		constexpr EAction Moves[] = { EAction::LEFT, EAction::ROTATE_R, EAction::RIGHT, EAction::ROTATE_L };
+		Benchmark.Run(TEXT("TetrisBoard.Update (move)"), 10000,
+			[Board, &Moves](int32 i) { Board->Update(Moves[i & 3]); });
+
+		/* Lock the active piece of the mid-game board, redrawing the changed blocks of the stack.*/
+		Benchmark.Run(TEXT("TetrisBoard.Update (hard drop)"), 200, 1,
+			[Board, &Filename] { Board->LoadSnapshot(Filename); },
+			[Board](int32) { Board->Update(EAction::HARD_DROP); });
+
+		/* Draw a stack that hasn't changed since the last draw.*/
+		Benchmark.Run(TEXT("TetrisBoard.Draw"), 10000,
+			[Board](int32) { Board->Draw(); });
+
+		Benchmark.Finish();
+	}
+
+	IFileManager::Get().Delete(*Filename);
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
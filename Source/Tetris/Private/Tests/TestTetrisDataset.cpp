@@ -0,0 +1,213 @@
+#include "CoreMinimal.h"
+#include "AI/TetrisDataset.h"
+#include "AI/PlacementGenerator.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	/* A record read back from a dataset, with its rows.*/
+	struct FReadRecord
+	{
+		FTetrisPositionRecord Record;
+		TArray<uint32> Rows;
+	};
+
+	/* Read every record of the files, ordered by game and then by piece. Return false if a file can't be read.*/
+	bool ReadRecords(const TArray<FString>& Filenames, TArray<FReadRecord>& OutRecords, int32& OutNumUnfinished)
+	{
+		OutRecords.Reset();
+		OutNumUnfinished = 0;
+		for (const FString& Filename : Filenames)
+		{
+			FTetrisDatasetFile File;
+			if (!File.Open(Filename)) { return false; }
+			OutNumUnfinished += File.GetHeader().NumRecords == FTetrisDatasetHeader::Unfinished ? 1 : 0;
+			for (int64 Index = 0; Index < File.Num(); ++Index)
+			{
+				const FTetrisPositionView View = File.Get(Index);
+				OutRecords.Add({ View.GetRecord(), TArray<uint32>(View.GetRows()) });
+			}
+		}
+		OutRecords.Sort([](const FReadRecord& A, const FReadRecord& B)
+		{
+			return A.Record.Seed != B.Record.Seed ? A.Record.Seed < B.Record.Seed : A.Record.PieceIndex < B.Record.PieceIndex;
+		});
+		return true;
+	}
+
+	/* Delete the files of a dataset.*/
+	void DeleteFiles(const TArray<FString>& Filenames)
+	{
+		for (const FString& Filename : Filenames)
+		{
+			IFileManager::Get().Delete(*Filename);
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisDatasetTests, "Tetris.AI.Dataset", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisDatasetTests::RunTest(const FString& Parameters)
+{
+	FTetrisDatasetSettings Settings;
+	Settings.NumGames = 12;
+	Settings.FirstSeed = 40;
+	Settings.MaxPiecesPerGame = 150;
+	Settings.RandomPlacementChance = 0.1f;
+	Settings.NumPreviewPieces = 3;
+	Settings.RecordsPerChunk = 500;
+	Settings.NumProducers = 3;
+	Settings.OutputDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("Datasets"));
+	Settings.Name = TEXT("DatasetTest");
+
+	/* Tests for writing and reading back.*/
+	FTetrisDatasetResult Result;
+	TArray<FReadRecord> Records;
+	{
+		TestTrue("Dataset is generated.", FTetrisDatasetGenerator::Generate(Settings, Result));
+		TestEqual("Every game is played.", Result.NumGames, Settings.NumGames);
+
+		int32 NumUnfinished = 0;
+		TestTrue("Every file is mapped.", ReadRecords(Result.Filenames, Records, NumUnfinished));
+		TestEqual("Every record is read.", int64(Records.Num()), Result.NumRecords);
+		TestEqual("Every file is finished.", NumUnfinished, 0);
+		TestTrue("Records are split into chunks.", Result.Filenames.Num() > Settings.NumProducers);
+
+		FTetrisDatasetFile File;
+		File.Open(Result.Filenames[0]);
+		const FTetrisDatasetHeader& Header = File.GetHeader();
+		TestTrue("Header describes the records.", Header.NumRows == Settings.Config.Height + Settings.Config.TopSpace && Header.Width == Settings.Config.Width
+			&& Header.NumPreviewPieces == Settings.NumPreviewPieces && Header.RecordSize % 8 == 0 && File.Num() <= Settings.RecordsPerChunk);
+	}
+
+	/* Tests for the records against the games they were played from.*/
+	{
+		FTetrisSimulationConfig Config = Settings.Config;
+		Config.CollapseDelayTicks = 0;
+		FTetrisSimulation Game;
+		Game.Initialize(Config);
+		FPlacementGenerator Generator;
+		bool bPositionsMatch = true;
+		bool bPlacementsFound = true;
+		bool bOutcomesMatch = true;
+		int32 NumGames = 0;
+		for (int32 First = 0; First < Records.Num();)
+		{
+			const int32 Seed = Records[First].Record.Seed;
+			Game.Reset(Seed);
+			Game.Start();
+			int32 Index = First;
+			for (; Index < Records.Num() && Records[Index].Record.Seed == Seed; ++Index)
+			{
+				const FTetrisPositionRecord& Record = Records[Index].Record;
+				const FBoardState& Board = Game.GetBoard();
+				bPositionsMatch &= Record.PieceIndex == Index - First && Record.BoardHash == Board.GetHash() && Record.Score == Game.GetScore()
+					&& Record.PieceType == Game.GetCurrentPiece()->Type;
+				for (int32 Row = 0; Row < Board.GetHeight(); ++Row)
+				{
+					bPositionsMatch &= Records[Index].Rows[Row] == Board.GetRowMask(Row);
+				}
+				const TConstArrayView<uint8> Preview = Game.GetSequence().PeekN(Settings.NumPreviewPieces);
+				for (int32 i = 0; i < FTetrisPositionRecord::MaxPreviewPieces; ++i)
+				{
+					bPositionsMatch &= Record.Preview[i] == (i < Preview.Num() ? Preview[i] : MAX_uint8);
+				}
+
+				/* Play the recorded placement.*/
+				Generator.Generate(Board, *Game.GetCurrentPiece(), Game.GetCurrentCoordinate());
+				const FPiecePlacement* Placement = Generator.GetPlacements().FindByPredicate([&Record](const FPiecePlacement& Candidate)
+				{
+					return Candidate.Piece->Rotation == Record.Rotation && Candidate.Coordinate == FIntPoint(Record.X, Record.Y);
+				});
+				bPlacementsFound &= Placement != nullptr;
+				if (!Placement) { break; }
+				const int32 LinesBefore = Game.GetLinesCleared();
+				Game.ApplyActions(Generator.GetPath(*Placement));
+				bOutcomesMatch &= Record.LinesCleared == Game.GetLinesCleared() - LinesBefore;
+			}
+			const int32 NumPieces = Index - First;
+			for (int32 i = First; i < Index; ++i)
+			{
+				const FTetrisPositionRecord& Record = Records[i].Record;
+				bOutcomesMatch &= Record.ScoreToGo == Game.GetScore() - Record.Score && Record.PiecesToGo == NumPieces - Record.PieceIndex
+					&& Record.bGameOver == (Game.IsGameOver() ? 1 : 0);
+			}
+			bOutcomesMatch &= Game.IsGameOver() || NumPieces == Settings.MaxPiecesPerGame;
+			First = Index;
+			++NumGames;
+		}
+		TestEqual("Records cover every game.", NumGames, Settings.NumGames);
+		TestTrue("Records describe the positions of their games.", bPositionsMatch);
+		TestTrue("Recorded placements can be played.", bPlacementsFound);
+		TestTrue("Records describe how their games went on.", bOutcomesMatch);
+	}
+
+	/* Tests for determinism across producer counts.*/
+	{
+		FTetrisDatasetSettings SerialSettings = Settings;
+		SerialSettings.NumProducers = 1;
+		SerialSettings.Name = TEXT("DatasetTestSerial");
+		FTetrisDatasetResult SerialResult;
+		TArray<FReadRecord> SerialRecords;
+		int32 NumUnfinished = 0;
+		FTetrisDatasetGenerator::Generate(SerialSettings, SerialResult);
+		ReadRecords(SerialResult.Filenames, SerialRecords, NumUnfinished);
+		bool bRecordsMatch = SerialRecords.Num() == Records.Num();
+		for (int32 i = 0; bRecordsMatch && i < Records.Num(); ++i)
+		{
+			bRecordsMatch &= FMemory::Memcmp(&SerialRecords[i].Record, &Records[i].Record, sizeof(FTetrisPositionRecord)) == 0 && SerialRecords[i].Rows == Records[i].Rows;
+		}
+		TestTrue("Records don't depend on the producers.", bRecordsMatch);
+		DeleteFiles(SerialResult.Filenames);
+	}
+	DeleteFiles(Result.Filenames);
+
+	/* Tests for the other policies.*/
+	{
+		FTetrisDatasetSettings PolicySettings = Settings;
+		PolicySettings.NumGames = 2;
+		PolicySettings.MaxPiecesPerGame = 20;
+		PolicySettings.Name = TEXT("DatasetTestPolicy");
+		PolicySettings.SearchSettings.BeamWidth = 4;
+		PolicySettings.SearchSettings.NumPreviewPieces = 1;
+		for (const ETetrisDatasetPolicy Policy : { ETetrisDatasetPolicy::Random, ETetrisDatasetPolicy::Search })
+		{
+			PolicySettings.Policy = Policy;
+			FTetrisDatasetResult PolicyResult;
+			TArray<FReadRecord> PolicyRecords;
+			int32 NumUnfinished = 0;
+			TestTrue("Dataset is generated with every policy.", FTetrisDatasetGenerator::Generate(PolicySettings, PolicyResult)
+				&& ReadRecords(PolicyResult.Filenames, PolicyRecords, NumUnfinished) && PolicyRecords.Num() > 0);
+			FTetrisDatasetFile File;
+			TestTrue("Header records the policy.", File.Open(PolicyResult.Filenames[0]) && File.GetHeader().Policy == uint8(Policy));
+			File.Close();
+			DeleteFiles(PolicyResult.Filenames);
+		}
+	}
+
+	/* Tests for boards too tall for a record to locate a placement.*/
+	{
+		FTetrisDatasetSettings TallSettings = Settings;
+		TallSettings.Config.Height = FTetrisPositionRecord::MaxRows + 1 - TallSettings.Config.TopSpace;
+		TallSettings.NumGames = 1;
+		TallSettings.Name = TEXT("DatasetTestTall");
+		FTetrisDatasetResult TallResult;
+		TestFalse("Boards too tall for a record are rejected.", FTetrisDatasetGenerator::Generate(TallSettings, TallResult));
+		TestEqual("Nothing is written for a rejected board.", TallResult.Filenames.Num(), 0);
+	}
+
+	/* Tests for files that aren't datasets.*/
+	{
+		const FString Filename = FPaths::Combine(Settings.OutputDirectory, TEXT("DatasetTestInvalid.tetrisdata"));
+		TArray<uint8> Data;
+		Data.SetNumZeroed(256);
+		FFileHelper::SaveArrayToFile(Data, *Filename);
+		FTetrisDatasetFile File;
+		TestFalse("Files without the magic are rejected.", File.Open(Filename));
+		IFileManager::Get().Delete(*Filename);
+	}
+	return true;
+}
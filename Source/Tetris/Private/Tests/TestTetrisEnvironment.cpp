@@ -0,0 +1,223 @@
+#include "CoreMinimal.h"
+#include "Simulation/TetrisEnvironment.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	/* A stateless policy, so that the actions don't depend on how the environments are split between threads.*/
+	uint8 HashedAction(int32 Index, int32 Step)
+	{
+		const uint32 Hash = (uint32(Index) * 2654435761u) ^ (uint32(Step) * 40503u);
+		return uint8((Hash >> 7) % FTetrisEnvironment::NumActions);
+	}
+
+	/* The buffers of a vectorized environment.*/
+	struct FEnvironmentBuffers
+	{
+		TArray<uint8> Planes;
+		TArray<int32> Pieces;
+		TArray<uint8> Preview;
+		TArray<uint8> ColumnHeights;
+		TArray<uint8> Actions;
+		TArray<float> Rewards;
+		TArray<uint8> Dones;
+
+		explicit FEnvironmentBuffers(const FTetrisEnvironment& Environment)
+		{
+			const int32 Num = Environment.GetNumEnvironments();
+			Planes.SetNumZeroed(Num * Environment.GetPlanesSize());
+			Pieces.SetNumZeroed(Num * FTetrisEnvironment::NumPieceValues);
+			Preview.SetNumZeroed(Num * Environment.GetPreviewSize());
+			ColumnHeights.SetNumZeroed(Num * Environment.GetColumnHeightsSize());
+			Actions.SetNumZeroed(Num);
+			Rewards.SetNumZeroed(Num);
+			Dones.SetNumZeroed(Num);
+		}
+
+		FTetrisObservationBuffers GetObservations()
+		{
+			return { Planes, Pieces, Preview, ColumnHeights };
+		}
+	};
+
+	/* Check that the observation of an environment describes its game.*/
+	bool ObservationMatches(const FTetrisEnvironment& Environment, FEnvironmentBuffers& Buffers, int32 Index)
+	{
+		const FTetrisSimulation& Game = Environment.GetEnvironment(Index);
+		const FBoardState& Board = Game.GetBoard();
+		const int32 Width = Environment.GetWidth();
+		const int32 Height = Environment.GetHeight();
+		const uint8* StackPlane = &Buffers.Planes[Index * Environment.GetPlanesSize()];
+		const uint8* PiecePlane = StackPlane + Width * Height;
+		const FPieceShape* Piece = Game.GetCurrentPiece();
+		bool bMatches = true;
+		int32 NumPieceCells = 0;
+		for (int32 Row = 0; Row < Height; ++Row)
+		{
+			for (int32 Col = 0; Col < Width; ++Col)
+			{
+				bMatches &= StackPlane[Row * Width + Col] == (Board.IsOccupied({ Col, Row }) ? 1 : 0);
+				NumPieceCells += PiecePlane[Row * Width + Col];
+				if (PiecePlane[Row * Width + Col] && Piece)
+				{
+					const FIntPoint Local = FIntPoint(Col, Row) - Game.GetCurrentCoordinate();
+					bMatches &= Local.Y >= 0 && Local.Y < FPieceShape::BoxSize && (Piece->RowMasks[Local.Y] >> Local.X) & 1;
+				}
+			}
+		}
+		bMatches &= NumPieceCells == (Piece ? 4 : 0);
+
+		const int32* PieceValues = &Buffers.Pieces[Index * FTetrisEnvironment::NumPieceValues];
+		bMatches &= PieceValues[0] == (Piece ? Piece->Type : INDEX_NONE) && PieceValues[2] == (Piece ? Game.GetCurrentCoordinate().X : INDEX_NONE);
+
+		const TConstArrayView<uint8> Queue = Game.GetSequence().PeekN(Environment.GetNumPreviewPieces());
+		for (int32 i = 0; i < Queue.Num(); ++i)
+		{
+			bMatches &= Buffers.Preview[Index * Environment.GetPreviewSize() + i] == Queue[i];
+		}
+		for (int32 Col = 0; Col < Width; ++Col)
+		{
+			bMatches &= Buffers.ColumnHeights[Index * Width + Col] == Board.GetColumnHeight(Col);
+		}
+		return bMatches;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisEnvironmentTests, "Tetris.Environment", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisEnvironmentTests::RunTest(const FString& Parameters)
+{
+	FTetrisSimulationConfig Config;
+	Config.CollapseDelayTicks = 0;
+
+	/* Tests for resetting.*/
+	{
+		FTetrisEnvironment Environment;
+		Environment.Initialize(Config, 10, 5, 1, {}, 4);
+		TestEqual("Environments are split into the requested chunks.", Environment.GetNumChunks(), 4);
+		TestTrue("Planes cover the whole board.", Environment.GetWidth() == Config.Width && Environment.GetHeight() == Config.Height + Config.TopSpace);
+
+		FEnvironmentBuffers Buffers(Environment);
+		TArray<int32> Seeds = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+		TestFalse("Reset needs a seed per environment.", Environment.Reset(MakeArrayView(Seeds.GetData(), 9), Buffers.GetObservations()));
+		TestFalse("Reset needs full buffers.", Environment.Reset(Seeds, { MakeArrayView(Buffers.Planes.GetData(), 1) }));
+
+		TestTrue("Environments are reset.", Environment.Reset(Seeds, Buffers.GetObservations()));
+		bool bObservationsMatch = true;
+		for (int32 Index = 0; Index < 10; ++Index)
+		{
+			bObservationsMatch &= ObservationMatches(Environment, Buffers, Index);
+		}
+		TestTrue("First observations describe the games.", bObservationsMatch);
+		TestEqual("Environment plays its seed.", Environment.GetEnvironment(6).GetSequence().GetSeed(), 7);
+
+		TestTrue("Buffers can be skipped.", Environment.Reset(Seeds, FTetrisObservationBuffers()));
+	}
+
+	/* Tests for stepping against single games.*/
+	{
+		constexpr int32 NumEnvironments = 16;
+		constexpr int32 NumSteps = 3000;
+		FTetrisEnvironment Environment;
+		Environment.Initialize(Config, NumEnvironments, 3, 2, {}, 3);
+		FEnvironmentBuffers Buffers(Environment);
+		TArray<int32> Seeds;
+		for (int32 Index = 0; Index < NumEnvironments; ++Index)
+		{
+			Seeds.Add(100 + Index);
+		}
+		Environment.Reset(Seeds, Buffers.GetObservations());
+
+		/* Play environment 5 as a single game alongside.*/
+		FTetrisSimulation Game;
+		Game.Initialize(Config);
+		Game.Reset(105);
+		Game.Start();
+		int32 NextSeed = 105 + NumEnvironments;
+
+		double TotalReward = 0.0;
+		int32 NumDone = 0;
+		bool bStepsMatch = true;
+		bool bObservationsMatch = true;
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			for (int32 Index = 0; Index < NumEnvironments; ++Index)
+			{
+				Buffers.Actions[Index] = HashedAction(Index, Step);
+			}
+			bStepsMatch &= Environment.Step(Buffers.Actions, Buffers.GetObservations(), Buffers.Rewards, Buffers.Dones);
+
+			const int32 ScoreBefore = Game.GetScore();
+			if (Buffers.Actions[5] < FTetrisEnvironment::NoAction)
+			{
+				Game.ApplyAction(static_cast<EAction>(Buffers.Actions[5]));
+			}
+			Game.Tick();
+			if (!Game.IsGameOver())
+			{
+				Game.Tick();
+			}
+			bStepsMatch &= Buffers.Rewards[5] == float(Game.GetScore() - ScoreBefore) && Buffers.Dones[5] == (Game.IsGameOver() ? 1 : 0);
+			if (Game.IsGameOver())
+			{
+				Game.Reset(NextSeed);
+				Game.Start();
+				NextSeed += NumEnvironments;
+			}
+			bStepsMatch &= Game.GetBoard().GetHash() == Environment.GetEnvironment(5).GetBoard().GetHash();
+
+			for (int32 Index = 0; Index < NumEnvironments; ++Index)
+			{
+				TotalReward += Buffers.Rewards[Index];
+				NumDone += Buffers.Dones[Index];
+			}
+			if (Step % 100 == 0)
+			{
+				bObservationsMatch &= ObservationMatches(Environment, Buffers, Step % NumEnvironments);
+			}
+		}
+		const FSimulationStats Stats = Environment.GetStats();
+		TestTrue("Steps match a single game.", bStepsMatch);
+		TestTrue("Observations describe the games.", bObservationsMatch);
+		TestTrue("Games end and restart.", NumDone > 0 && NumDone == Stats.GamesFinished);
+
+		double OpenScore = 0.0;
+		for (int32 Index = 0; Index < NumEnvironments; ++Index)
+		{
+			OpenScore += Environment.GetEnvironment(Index).GetScore();
+		}
+		TestEqual("Rewards add up to the score.", TotalReward, double(Stats.Score) + OpenScore);
+	}
+
+	/* Tests for determinism across chunk counts.*/
+	{
+		constexpr int32 NumEnvironments = 64;
+		FTetrisEnvironment SerialEnvironment;
+		FTetrisEnvironment ParallelEnvironment;
+		SerialEnvironment.Initialize(Config, NumEnvironments, 5, 1, {}, 1);
+		ParallelEnvironment.Initialize(Config, NumEnvironments, 5, 1, {}, 7);
+		FEnvironmentBuffers SerialBuffers(SerialEnvironment);
+		FEnvironmentBuffers ParallelBuffers(ParallelEnvironment);
+		TArray<int32> Seeds;
+		for (int32 Index = 0; Index < NumEnvironments; ++Index)
+		{
+			Seeds.Add(Index * 3);
+		}
+		SerialEnvironment.Reset(Seeds, SerialBuffers.GetObservations());
+		ParallelEnvironment.Reset(Seeds, ParallelBuffers.GetObservations());
+		for (int32 Step = 0; Step < 1000; ++Step)
+		{
+			for (int32 Index = 0; Index < NumEnvironments; ++Index)
+			{
+				SerialBuffers.Actions[Index] = ParallelBuffers.Actions[Index] = HashedAction(Index, Step);
+			}
+			SerialEnvironment.Step(SerialBuffers.Actions, SerialBuffers.GetObservations(), SerialBuffers.Rewards, SerialBuffers.Dones);
+			ParallelEnvironment.Step(ParallelBuffers.Actions, ParallelBuffers.GetObservations(), ParallelBuffers.Rewards, ParallelBuffers.Dones);
+		}
+		TestTrue("Observations don't depend on the chunks.", SerialBuffers.Planes == ParallelBuffers.Planes && SerialBuffers.Pieces == ParallelBuffers.Pieces
+			&& SerialBuffers.Preview == ParallelBuffers.Preview && SerialBuffers.ColumnHeights == ParallelBuffers.ColumnHeights);
+		TestTrue("Rewards don't depend on the chunks.", SerialBuffers.Rewards == ParallelBuffers.Rewards && SerialBuffers.Dones == ParallelBuffers.Dones);
+		TestEqual("Finished games don't depend on the chunks.", SerialEnvironment.GetStats().GamesFinished, ParallelEnvironment.GetStats().GamesFinished);
+	}
+	return true;
+}
@@ -0,0 +1,160 @@
+#include "CoreMinimal.h"
+#include "Simulation/TetrisReplay.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisReplayTests, "Tetris.Replay", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisReplayTests::RunTest(const FString& Parameters)
+{
+	/* A narrow board clears lines often enough to exercise the collapse records.*/
+	FTetrisSimulationConfig Config;
+	Config.Width = 5;
+	Config.TicksPerSecond = 240;
+	Config.CollapseDelayTicks = 10;
+
+	/* Record a game into memory.*/
+	FTetrisSimulation Simulation;
+	Simulation.Initialize(Config);
+	Simulation.Reset(7);
+	FTetrisReplayRecorder Recorder;
+	TestTrue("Recording begins before the start.", Recorder.Begin(Simulation));
+	FRandomStream Policy(7);
+	Simulation.Start();
+	const int64 NumSteps = TetrisTests::PlayRandomSteps(Simulation, Policy, MAX_int64, true);
+	Recorder.Finish();
+	TestFalse("Recording stops when finished.", Recorder.IsRecording());
+	TestNull("Recorder stops observing the game.", Simulation.GetObserver());
+	TestTrue("Recorded game clears lines.", Simulation.GetLinesCleared() > 0);
+	const TArray<uint8> Recording(Recorder.GetRecording().GetData(), Recorder.GetRecording().Num());
+	AddInfo(FString::Printf(TEXT("Recorded %lld steps in %d bytes."), NumSteps, Recording.Num()));
+
+	/* Tests for the log.*/
+	{
+		FTetrisReplayReader Reader;
+		TestTrue("Log has a valid header.", Reader.Initialize(Recording));
+		TestEqual("Header holds the seed.", Reader.GetHeader().Seed, 7);
+		TestEqual("Header holds the width.", Reader.GetHeader().Width, Config.Width);
+
+		FTetrisReplayEntry Entry;
+		int32 NumEntries = 0;
+		int64 LastStep = 0;
+		bool bStepsIncrease = true;
+		while (Reader.Next(Entry))
+		{
+			bStepsIncrease &= Entry.Step >= LastStep;
+			LastStep = Entry.Step;
+			++NumEntries;
+		}
+		TestTrue("Every record is read.", Reader.IsAtEnd());
+		TestTrue("Records are in step order.", bStepsIncrease);
+		TestTrue("Log ends with the result.", Entry.Type == ETetrisReplayRecord::End && Entry.Step == NumSteps);
+		TestEqual("Log holds the final score.", Entry.Score, Simulation.GetScore());
+		TestTrue("Records take a few bytes each.", Recording.Num() < NumEntries * 4 + int32(sizeof(FTetrisReplayHeader)));
+		TestFalse("Recording can't begin after the start.", FTetrisReplayRecorder().Begin(Simulation));
+	}
+
+	/* Tests for unthrottled playback.*/
+	{
+		FTetrisSimulation Playback;
+		FTetrisReplayPlayer Player;
+		TestTrue("Playback begins.", Player.Begin(Playback, TArray<uint8>(Recording)));
+		TestTrue("Playback is verified.", Player.PlayToEnd() == ETetrisReplayResult::Verified);
+		TestEqual("Playback takes the recorded steps.", Playback.GetStepCount(), NumSteps);
+		TestEqual("Playback scores the recorded score.", Playback.GetScore(), Simulation.GetScore());
+		TestNull("Player stops observing the game.", Playback.GetObserver());
+	}
+
+	/* Tests for throttled playback.*/
+	{
+		FTetrisSimulation Playback;
+		FTetrisReplayPlayer Player;
+		Player.Begin(Playback, TArray<uint8>(Recording));
+		int32 NumFrames = 0;
+		while (Player.Advance(7) == ETetrisReplayResult::Playing)
+		{
+			++NumFrames;
+		}
+		TestTrue("Throttled playback is verified.", Player.GetResult() == ETetrisReplayResult::Verified);
+		TestEqual("Throttled playback takes the given steps per call.", NumFrames, int32((NumSteps - 1) / 7));
+	}
+
+	/* Tests for failed playback.*/
+	{
+		FTetrisSimulation Playback;
+		FTetrisReplayPlayer Player;
+		TArray<uint8> WrongSeed = Recording;
+		reinterpret_cast<FTetrisReplayHeader*>(WrongSeed.GetData())->Seed = 8;
+		Player.Begin(Playback, MoveTemp(WrongSeed));
+		TestTrue("Playback with another seed diverges.", Player.PlayToEnd() == ETetrisReplayResult::Diverged);
+		TestFalse("Divergence is explained.", Player.GetError().IsEmpty());
+
+		TArray<uint8> Truncated = Recording;
+		Truncated.SetNum(Truncated.Num() - 3);
+		Player.Begin(Playback, MoveTemp(Truncated));
+		TestTrue("Truncated playback is invalid.", Player.PlayToEnd() == ETetrisReplayResult::Invalid);
+
+		const TConstArrayView<FPieceShape> OtherShapes = FStandardPieceShapes::Get().Left(FPieceShape::NumRotations);
+		TestFalse("Playback with another shape table is rejected.", Player.Begin(Playback, TArray<uint8>(Recording), OtherShapes));
+		TestFalse("Empty log is rejected.", Player.Begin(Playback, TArray<uint8>()));
+
+		/* Corrupt headers are rejected before they reach the simulation.*/
+		const auto BeginCorrupted = [&Playback, &Player, &Recording](auto Corrupt)
+		{
+			TArray<uint8> Corrupted = Recording;
+			Corrupt(*reinterpret_cast<FTetrisReplayHeader*>(Corrupted.GetData()));
+			return !Player.Begin(Playback, MoveTemp(Corrupted)) && Player.GetResult() == ETetrisReplayResult::Invalid;
+		};
+		TestTrue("Zero width is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.Width = 0; }));
+		TestTrue("Excess width is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.Width = FBoardState::MaxWidth + 1; }));
+		TestTrue("Negative height is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.Height = -1; }));
+		TestTrue("Huge height is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.Height = 1 << 30; }));
+		TestTrue("Overflowing top space is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.TopSpace = MAX_int32; }));
+		TestTrue("Negative collapse delay is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.CollapseDelayTicks = -1; }));
+		TestTrue("Zero ticks per second is rejected.", BeginCorrupted([](FTetrisReplayHeader& Header) { Header.TicksPerSecond = 0; }));
+		TestFalse("Rejection is explained.", Player.GetError().IsEmpty());
+	}
+
+	/* Tests for streaming to disk.*/
+	{
+		const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("TetrisReplayTest.tetrisreplay"));
+		FTetrisSimulation StreamedGame;
+		StreamedGame.Initialize(Config);
+		StreamedGame.Reset(7);
+		FTetrisReplayRecorder StreamRecorder;
+		TestTrue("Streaming recording begins.", StreamRecorder.Begin(StreamedGame, Filename));
+		FRandomStream StreamPolicy(7);
+		StreamedGame.Start();
+		TetrisTests::PlayRandomSteps(StreamedGame, StreamPolicy, MAX_int64, true);
+		StreamRecorder.Finish();
+
+		TArray<uint8> Streamed;
+		TestTrue("Streamed log is written.", FFileHelper::LoadFileToArray(Streamed, *Filename));
+		TestTrue("Streamed log matches the log recorded in memory.", Streamed == Recording);
+
+		FTetrisSimulation Playback;
+		FTetrisReplayPlayer Player;
+		TestTrue("Playback from a file begins.", Player.Begin(Playback, Filename));
+		TestTrue("Playback from a file is verified.", Player.PlayToEnd() == ETetrisReplayResult::Verified);
+		IFileManager::Get().Delete(*Filename);
+	}
+
+	/* Time unthrottled playback.*/
+	{
+		constexpr int32 NumPlaybacks = 50;
+		FTetrisSimulation Playback;
+		FTetrisReplayPlayer Player;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < NumPlaybacks; ++i)
+		{
+			Player.Begin(Playback, TArray<uint8>(Recording));
+			Player.PlayToEnd();
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		AddInfo(FString::Printf(TEXT("Played back %.0f steps per second."), NumPlaybacks * NumSteps / FMath::Max(Seconds, 1e-9)));
+	}
+	return true;
+}
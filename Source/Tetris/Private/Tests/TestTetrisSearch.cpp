@@ -0,0 +1,136 @@
+#include "CoreMinimal.h"
+#include "AI/TetrisSearch.h"
+#include "Simulation/TetrisSnapshot.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+namespace
+{
+	/* The totals of the searches of a game.*/
+	struct FSearchTotals
+	{
+		int32 NumExpanded{ 0 };
+		int32 NumTranspositions{ 0 };
+		int32 NumTableHits{ 0 };
+		int32 NumSkipped{ 0 };
+	};
+
+	/* Play the chosen placement of every piece. Return the number of pieces placed.*/
+	int32 PlayGame(FTetrisSimulation& Game, FTetrisSearch& Search, int32 MaxPieces, bool& bOutPathsLock, FSearchTotals& OutTotals)
+	{
+		TetrisTests::FLockRecorder Recorder;
+		Game.SetObserver(&Recorder);
+		int32 NumPieces = 0;
+		FTetrisSearchResult Result;
+		for (; NumPieces < MaxPieces && Search.Search(Game, Result); ++NumPieces)
+		{
+			Recorder.Piece = nullptr;
+			Game.ApplyActions(Result.Actions);
+			bOutPathsLock &= Recorder.Piece == Result.Piece && Recorder.Coordinate == Result.Coordinate;
+			OutTotals.NumExpanded += Result.NumExpanded;
+			OutTotals.NumTranspositions += Result.NumTranspositions;
+			OutTotals.NumTableHits += Result.NumTableHits;
+			OutTotals.NumSkipped += Result.NumSkipped;
+		}
+		Game.SetObserver(nullptr);
+		return NumPieces;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisSearchTests, "Tetris.AI.Search", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisSearchTests::RunTest(const FString& Parameters)
+{
+	/* Tests for the chances of unknown pieces.*/
+	{
+		FPieceSequence Sequence;
+		Sequence.Initialize(7, 4);
+		Sequence.Pop();
+		Sequence.Pop();
+		const TConstArrayView<uint8> Queue = Sequence.PeekN(FPieceSequence::Capacity);
+
+		/* Five pieces are left in the first bag.*/
+		float Chances[7];
+		FTetrisSearch::GetPieceChances(Sequence, 2, Chances);
+		bool bLeftInBag = true;
+		float Sum = 0.f;
+		for (int32 Type = 0; Type < 7; ++Type)
+		{
+			const bool bInBag = Type == Queue[2] || Type == Queue[3] || Type == Queue[4];
+			bLeftInBag &= FMath::IsNearlyEqual(Chances[Type], bInBag ? 1.f / 3.f : 0.f);
+			Sum += Chances[Type];
+		}
+		TestTrue("Only the pieces left in the bag can be drawn.", bLeftInBag);
+		TestTrue("Chances sum to one.", FMath::IsNearlyEqual(Sum, 1.f));
+
+		FTetrisSearch::GetPieceChances(Sequence, 5, Chances);
+		TestTrue("A new bag holds every piece.", FMath::IsNearlyEqual(Chances[Queue[5]], 1.f / 7.f) && FMath::IsNearlyEqual(Chances[Queue[11]], 1.f / 7.f));
+		FTetrisSearch::GetPieceChances(Sequence, Queue.Num(), Chances);
+		TestTrue("Pieces beyond the sequence are equally likely.", FMath::IsNearlyEqual(Chances[0], 1.f / 7.f) && FMath::IsNearlyEqual(Chances[6], 1.f / 7.f));
+	}
+
+	/* Tests for a single search.*/
+	{
+		FTetrisSearchSettings Settings;
+		Settings.TimeBudgetSeconds = 10.0;
+		FTetrisSearch Search(FBoardEvaluator(), Settings);
+		FTetrisSimulation Game = TetrisTests::MakeGame(2);
+
+		TArray<uint8> Before;
+		FTetrisSnapshot::Save(Game, Before);
+		FTetrisSearchResult Result;
+		TestTrue("Game is searched.", Search.Search(Game, Result));
+		TArray<uint8> After;
+		FTetrisSnapshot::Save(Game, After);
+		TestTrue("Searched game is not modified.", Before == After);
+		TestEqual("Every preview piece and the expected piece are searched.", Result.Depth, Settings.NumPreviewPieces + 2);
+		TestFalse("Search completes in time.", Result.bTimedOut);
+		TestTrue("Result has a path.", Result.Piece && Result.Actions.Num() > 0 && Result.Actions.Last() == EAction::HARD_DROP);
+
+		FTetrisSearchSettings SingleTaskSettings = Settings;
+		SingleTaskSettings.NumTasks = 1;
+		FTetrisSearch SingleTaskSearch(FBoardEvaluator(), SingleTaskSettings);
+		FTetrisSearchResult SingleTaskResult;
+		SingleTaskSearch.Search(Game, SingleTaskResult);
+		TestTrue("Result doesn't depend on the number of tasks.", SingleTaskResult.Piece == Result.Piece && SingleTaskResult.Coordinate == Result.Coordinate && SingleTaskResult.Value == Result.Value);
+
+		FTetrisSearchSettings NoTimeSettings = Settings;
+		NoTimeSettings.TimeBudgetSeconds = 0.0;
+		FTetrisSearch NoTimeSearch(FBoardEvaluator(), NoTimeSettings);
+		FTetrisSearchResult NoTimeResult;
+		TestTrue("Search without time still answers.", NoTimeSearch.Search(Game, NoTimeResult) && NoTimeResult.Piece);
+		TestTrue("Search without time only places the current piece.", NoTimeResult.bTimedOut && NoTimeResult.Depth == 1);
+	}
+
+	/* Tests for playing games.*/
+	{
+		FTetrisSearchSettings Settings;
+		Settings.BeamWidth = 8;
+		Settings.NumPreviewPieces = 2;
+		Settings.TimeBudgetSeconds = 10.0;
+		FTetrisSearch Search(FBoardEvaluator(), Settings);
+		FTetrisSimulation Game = TetrisTests::MakeGame(6);
+
+		constexpr int32 MaxPieces = 150;
+		bool bPathsLock = true;
+		FSearchTotals Totals;
+		const int32 NumPieces = PlayGame(Game, Search, MaxPieces, bPathsLock, Totals);
+		TestTrue("Every chosen path locks the piece.", bPathsLock);
+		TestEqual("AI survives.", NumPieces, MaxPieces);
+		TestTrue("AI clears most of the pieces it places.", Game.GetLinesCleared() * 10 >= MaxPieces * 4 * 8 / 10);
+
+		/* The transposition table only saves work, so a game played without it is the same.*/
+		FTetrisSearchSettings NoTableSettings = Settings;
+		NoTableSettings.TranspositionTableSize = 0;
+		FTetrisSearch NoTableSearch(FBoardEvaluator(), NoTableSettings);
+		FTetrisSimulation NoTableGame = TetrisTests::MakeGame(6);
+		FSearchTotals NoTableTotals;
+		PlayGame(NoTableGame, NoTableSearch, MaxPieces, bPathsLock, NoTableTotals);
+		TestTrue("Transposition table doesn't change the game.", NoTableGame.GetBoard().GetHash() == Game.GetBoard().GetHash() && NoTableGame.GetScore() == Game.GetScore());
+		TestTrue("Boards are skipped by the best placements of the previous searches.", Totals.NumSkipped > 0 && Totals.NumExpanded < NoTableTotals.NumExpanded);
+		TestTrue("Search without the table has no hits.", NoTableTotals.NumSkipped == 0 && NoTableTotals.NumTableHits == 0);
+		AddInfo(FString::Printf(TEXT("%d boards expanded, %d skipped, %d lines of play merged, %d table hits. %d boards expanded without the table."),
+			Totals.NumExpanded, Totals.NumSkipped, Totals.NumTranspositions, Totals.NumTableHits, NoTableTotals.NumExpanded));
+	}
+	return true;
+}
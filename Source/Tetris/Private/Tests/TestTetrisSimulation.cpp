@@ -0,0 +1,218 @@
+#include "CoreMinimal.h"
+#include "Simulation/TetrisSimulation.h"
+#include "Misc/AutomationTest.h"
+
+namespace
+{
+	/* Play a game to the end with random actions and return the number of steps taken.*/
+	int32 PlayRandomGame(FTetrisSimulation& Simulation, int32 Seed, int32 MaxTicks)
+	{
+		FRandomStream Policy(Seed);
+		Simulation.Reset(Seed);
+		Simulation.Start();
+		int32 Ticks = 0;
+		for (; Ticks < MaxTicks && !Simulation.IsGameOver(); ++Ticks)
+		{
+			Simulation.ApplyAction(static_cast<EAction>(Policy.RandRange(EAction::LEFT, EAction::ROTATE_L)));
+			Simulation.Tick();
+		}
+		return Ticks;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisSimulationTests, "Tetris.Simulation", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisSimulationTests::RunTest(const FString& Parameters)
+{
+	FTetrisSimulationConfig Config;
+	Config.CollapseDelayTicks = 0;
+
+	/* Tests for starting a game.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(1);
+		TestTrue("Game is idle after a reset.", Simulation.GetPhase() == ETetrisPhase::Idle);
+		TestNull("No piece is in play before the start.", Simulation.GetCurrentPiece());
+
+		Simulation.ConsumeEvents();
+		Simulation.Start();
+		TestTrue("Piece is falling after the start.", Simulation.GetPhase() == ETetrisPhase::Falling);
+		TestNotNull("Piece is in play after the start.", Simulation.GetCurrentPiece());
+		TestTrue("Spawn is reported.", EnumHasAnyFlags(Simulation.ConsumeEvents(), ETetrisEvents::PieceSpawned));
+		TestTrue("Events are cleared once consumed.", Simulation.ConsumeEvents() == ETetrisEvents::None);
+	}
+
+	/* Tests for gravity.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(1);
+		Simulation.Start();
+		const int32 StartY = Simulation.GetCurrentCoordinate().Y;
+		for (int32 i = 0; i < Config.TicksPerSecond - 1; ++i)
+		{
+			Simulation.Tick();
+		}
+		TestEqual("Piece holds until the gravity interval has passed.", Simulation.GetCurrentCoordinate().Y, StartY);
+		Simulation.Tick();
+		TestEqual("Level 1 drops once per second.", Simulation.GetCurrentCoordinate().Y, StartY - 1);
+
+		/* The drops stay on the second however long the piece falls.*/
+		FTetrisSimulationConfig TallConfig = Config;
+		TallConfig.Height = 60;
+		Simulation.Initialize(TallConfig);
+		Simulation.Reset(1);
+		Simulation.Start();
+		const int32 TallStartY = Simulation.GetCurrentCoordinate().Y;
+		constexpr int32 NumDrops = 50;
+		for (int32 i = 0; i < NumDrops * TallConfig.TicksPerSecond - 1; ++i)
+		{
+			Simulation.Tick();
+		}
+		TestEqual("Level 1 drops don't drift early.", Simulation.GetCurrentCoordinate().Y, TallStartY - (NumDrops - 1));
+		Simulation.Tick();
+		TestEqual("Level 1 drops don't drift late.", Simulation.GetCurrentCoordinate().Y, TallStartY - NumDrops);
+
+		/* At 20G the piece falls 20 rows per step.*/
+		FTetrisSimulationConfig InstantConfig = Config;
+		InstantConfig.Gravity = 20.f;
+		Simulation.Initialize(InstantConfig);
+		Simulation.Reset(1);
+		Simulation.Start();
+		const int32 SpawnY = Simulation.GetCurrentCoordinate().Y;
+		const int32 LandingY = Simulation.GetGhostCoordinate().Y;
+		Simulation.Tick();
+		TestEqual("20G drops 20 rows in one step.", Simulation.GetCurrentCoordinate().Y, FMath::Max(SpawnY - 20, LandingY));
+		const FPieceShape& Piece = *Simulation.GetCurrentPiece();
+		const FIntPoint Coordinate = Simulation.GetCurrentCoordinate();
+		Simulation.Tick();
+		TestTrue("20G locks the piece on its landing row once a drop is due past it.", Simulation.GetBoard().GetStackHeight() > 0 && !Simulation.GetBoard().CanPlace(Piece, { Coordinate.X, LandingY }));
+	}
+
+	/* Tests for locking.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(1);
+		Simulation.Start();
+		const FPieceShape& Piece = *Simulation.GetCurrentPiece();
+		FIntPoint LockCoordinate = Simulation.GetCurrentCoordinate();
+		while (Simulation.ApplyAction(EAction::DOWN))
+		{
+			LockCoordinate = Simulation.GetCurrentCoordinate();
+		}
+		TestTrue("Failed drop locks the piece.", Simulation.GetBoard().GetStackHeight() > 0);
+		TestFalse("Locked piece is on the board.", Simulation.GetBoard().CanPlace(Piece, LockCoordinate));
+		TestNotNull("Next piece spawns after a lock.", Simulation.GetCurrentPiece());
+		TestEqual("Spawned piece is in its spawn rotation.", int32(Simulation.GetCurrentPiece()->Rotation), 0);
+	}
+
+	/* Tests for hard drops.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(1);
+		Simulation.Start();
+		const FIntPoint GhostCoordinate = Simulation.GetGhostCoordinate();
+		const FPieceShape& Piece = *Simulation.GetCurrentPiece();
+		TestTrue("Hard drop is applied.", Simulation.ApplyAction(EAction::HARD_DROP));
+		TestFalse("Dropped piece lands on the ghost.", Simulation.GetBoard().CanPlace(Piece, GhostCoordinate));
+		TestEqual("Dropped piece lands on the floor.", Simulation.GetBoard().GetStackHeight(), GhostCoordinate.Y + Piece.MaxY + 1);
+		TestTrue("Next piece spawns after a hard drop.", Simulation.GetCurrentPiece() != nullptr && Simulation.GetElapsedTicks() == 0);
+	}
+
+	/* Tests for action sequences.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(1);
+		Simulation.Start();
+		const FIntPoint StartCoordinate = Simulation.GetCurrentCoordinate();
+		const EAction Actions[] = { EAction::LEFT, EAction::LEFT, EAction::RIGHT, EAction::ROTATE_R, EAction::ROTATE_L };
+		Simulation.ConsumeEvents();
+		TestEqual("Every action in the sequence is applied.", Simulation.ApplyActions(Actions), 5);
+		TestEqual("Sequence is applied in order.", Simulation.GetCurrentCoordinate().X, StartCoordinate.X - 1);
+		TestTrue("Sequence is reported as one set of events.", Simulation.ConsumeEvents() == ETetrisEvents::PieceMoved);
+
+		const EAction DropActions[] = { EAction::HARD_DROP, EAction::HARD_DROP };
+		Simulation.ApplyActions(DropActions);
+		int32 NumLockedCells = 0;
+		for (int32 Row = 0; Row < Simulation.GetBoard().GetHeight(); ++Row)
+		{
+			NumLockedCells += Simulation.GetBoard().GetRowFillCount(Row);
+		}
+		TestEqual("Sequence continues with the next piece after a lock.", NumLockedCells, 8);
+	}
+
+	/* Tests for determinism and game over.*/
+	{
+		FTetrisSimulation SimulationA;
+		FTetrisSimulation SimulationB;
+		SimulationA.Initialize(Config);
+		SimulationB.Initialize(Config);
+		const int32 TicksA = PlayRandomGame(SimulationA, 99, 1000000);
+		const int32 TicksB = PlayRandomGame(SimulationB, 99, 1000000);
+		TestTrue("Random game ends.", SimulationA.IsGameOver());
+		TestEqual("Games with the same seed and actions last as long.", TicksA, TicksB);
+		TestEqual("Games with the same seed and actions score the same.", SimulationA.GetScore(), SimulationB.GetScore());
+		TestNull("No piece is in play after the game ends.", SimulationA.GetCurrentPiece());
+
+		SimulationA.Tick();
+		TestFalse("Actions are ignored after the game ends.", SimulationA.ApplyAction(EAction::LEFT));
+	}
+
+	/* Tests for clearing.*/
+	{
+		FTetrisSimulationConfig ClearConfig;
+		ClearConfig.Width = 4;
+		ClearConfig.CollapseDelayTicks = 3;
+
+		/* A 4-wide board clears a row with every flat I piece.*/
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(ClearConfig, TConstArrayView<FPieceShape>(FStandardPieceShapes::Get().GetData(), FPieceShape::NumRotations));
+		Simulation.Reset(1);
+		Simulation.Start();
+		TestEqual("Piece spawns inside a narrow board.", Simulation.GetCurrentCoordinate().X, 0);
+		while (Simulation.ApplyAction(EAction::DOWN)) {}
+		TestTrue("Filled row is cleared.", Simulation.GetPhase() == ETetrisPhase::Clearing);
+		TestEqual("Lines are counted.", Simulation.GetLinesCleared(), 1);
+		TestEqual("Lines are scored.", Simulation.GetScore(), 100);
+		TestEqual("Cleared row is reported.", Simulation.GetClearedRows().Num(), 1);
+
+		Simulation.ConsumeEvents();
+		Simulation.Tick();
+		Simulation.Tick();
+		TestTrue("Board waits for the collapse delay.", Simulation.GetPhase() == ETetrisPhase::Clearing);
+		TestEqual("Game time runs while rows are cleared.", Simulation.GetElapsedTicks(), int64(2));
+		Simulation.Tick();
+		TestTrue("Lock completes after the collapse.", EnumHasAllFlags(Simulation.ConsumeEvents(), ETetrisEvents::LockComplete | ETetrisEvents::PieceSpawned));
+		TestEqual("Board is empty after the collapse.", Simulation.GetBoard().GetStackHeight(), 0);
+
+		/* Actions after a clearing lock are ignored until the board collapses.*/
+		const EAction DropActions[] = { EAction::HARD_DROP, EAction::HARD_DROP };
+		TestEqual("Actions after a clearing lock aren't applied.", Simulation.ApplyActions(DropActions), 1);
+		TestTrue("Board is clearing after the lock.", Simulation.GetPhase() == ETetrisPhase::Clearing && Simulation.GetLinesCleared() == 2);
+		for (int32 i = 0; i < ClearConfig.CollapseDelayTicks; ++i)
+		{
+			Simulation.Tick();
+		}
+		TestEqual("Only the first piece is placed.", Simulation.GetBoard().GetStackHeight(), 0);
+	}
+
+	/* Measure the headless throughput.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		constexpr int32 NumGames = 200;
+		int64 TotalTicks = 0;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Game = 0; Game < NumGames; ++Game)
+		{
+			TotalTicks += PlayRandomGame(Simulation, Game + 1, 1000000);
+		}
+		const double Duration = FMath::Max(FPlatformTime::Seconds() - StartTime, 1e-9);
+		AddInfo(FString::Printf(TEXT("%d games (%lld ticks) in %.3f s: %.0f games/s, %.0f ticks/s."), NumGames, TotalTicks, Duration, NumGames / Duration, TotalTicks / Duration));
+	}
+	return true;
+}
@@ -0,0 +1,184 @@
+#include "CoreMinimal.h"
+#include "Simulation/TetrisSnapshot.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/AutomationTest.h"
+#include "TetrisTestHelpers.h"
+
+namespace
+{
+	/* Return true if two games are in the same state.*/
+	bool IsSameGame(const FTetrisSimulation& A, const FTetrisSimulation& B)
+	{
+		bool bSame = A.GetPhase() == B.GetPhase() && A.GetScore() == B.GetScore() && A.GetLinesCleared() == B.GetLinesCleared()
+			&& A.GetStepCount() == B.GetStepCount() && A.GetElapsedTicks() == B.GetElapsedTicks()
+			&& A.GetCurrentPiece() == B.GetCurrentPiece() && A.GetCurrentCoordinate() == B.GetCurrentCoordinate()
+			&& A.GetSequence().Num() == B.GetSequence().Num()
+			&& FMemory::Memcmp(A.GetSequence().PeekN(FPieceSequence::Capacity).GetData(), B.GetSequence().PeekN(FPieceSequence::Capacity).GetData(), A.GetSequence().Num()) == 0;
+		for (int32 Row = 0; Row < A.GetBoard().GetHeight(); ++Row)
+		{
+			bSame &= A.GetBoard().GetRowMask(Row) == B.GetBoard().GetRowMask(Row);
+		}
+		return bSame;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTetrisSnapshotTests, "Tetris.Snapshot", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTetrisSnapshotTests::RunTest(const FString& Parameters)
+{
+	FTetrisSimulationConfig Config;
+	Config.Width = 6;
+	Config.TicksPerSecond = 240;
+	Config.CollapseDelayTicks = 40;
+
+	/* Tests for the format.*/
+	{
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(3);
+		Simulation.Start();
+
+		TArray<uint8> Data;
+		TestTrue("Game is saved.", FTetrisSnapshot::Save(Simulation, Data));
+		TestEqual("Snapshot has the computed size.", Data.Num(), FTetrisSnapshot::GetSize(Config));
+		TestEqual("Grid packs the rows tightly.", Data.Num(), int32(sizeof(FTetrisSnapshotHeader)) + 3 * 8);
+
+		const FTetrisSnapshotView View(Data);
+		TestTrue("Snapshot is valid.", View.IsValid());
+		TestEqual("Snapshot holds the level.", int32(View.GetHeader().Level), 1);
+		TestEqual("Snapshot holds the piece.", View.GetHeader().PieceType, Simulation.GetCurrentPiece()->Type);
+
+		TArray<uint8> WrongVersion = Data;
+		reinterpret_cast<FTetrisSnapshotHeader*>(WrongVersion.GetData())->Version = FTetrisSnapshotHeader::CurrentVersion + 1;
+		TestFalse("Other versions are rejected.", FTetrisSnapshotView(WrongVersion).IsValid());
+		TestFalse("Truncated snapshots are rejected.", FTetrisSnapshotView(TConstArrayView<uint8>(Data).Left(Data.Num() - 1)).IsValid());
+
+		FTetrisSimulation Restored;
+		const TConstArrayView<FPieceShape> OtherShapes = FStandardPieceShapes::Get().Left(FPieceShape::NumRotations);
+		TestFalse("Snapshots are rejected with another shape table.", FTetrisSnapshot::Restore(Restored, View, OtherShapes));
+
+		/* Headers that describe an impossible game are rejected.*/
+		TArray<uint8> NoPiece = Data;
+		reinterpret_cast<FTetrisSnapshotHeader*>(NoPiece.GetData())->PieceType = FTetrisSnapshotHeader::NoPiece;
+		TestFalse("Falling phases without a piece are rejected.", FTetrisSnapshot::Restore(Restored, FTetrisSnapshotView(NoPiece)));
+
+		TArray<uint8> GameOverPiece = Data;
+		reinterpret_cast<FTetrisSnapshotHeader*>(GameOverPiece.GetData())->Phase = uint8(ETetrisPhase::GameOver);
+		TestFalse("Pieces outside the falling phase are rejected.", FTetrisSnapshot::Restore(Restored, FTetrisSnapshotView(GameOverPiece)));
+
+		/* Move the piece of a later snapshot onto the cells the first piece locked into.*/
+		const FPieceShape& DroppedPiece = *Simulation.GetCurrentPiece();
+		const FIntPoint DroppedCoordinate = Simulation.GetGhostCoordinate();
+		Simulation.ApplyAction(EAction::HARD_DROP);
+		TArray<uint8> Overlapping;
+		FTetrisSnapshot::Save(Simulation, Overlapping);
+		FTetrisSnapshotHeader& OverlappingHeader = *reinterpret_cast<FTetrisSnapshotHeader*>(Overlapping.GetData());
+		OverlappingHeader.PieceType = DroppedPiece.Type;
+		OverlappingHeader.Rotation = DroppedPiece.Rotation;
+		OverlappingHeader.X = int16(DroppedCoordinate.X);
+		OverlappingHeader.Y = int16(DroppedCoordinate.Y);
+		TestFalse("Pieces overlapping the board are rejected.", FTetrisSnapshot::Restore(Restored, FTetrisSnapshotView(Overlapping)));
+
+		TArray<uint8> OutOfBounds = Data;
+		reinterpret_cast<FTetrisSnapshotHeader*>(OutOfBounds.GetData())->Y = -10;
+		TestFalse("Pieces outside the board are rejected.", FTetrisSnapshot::Restore(Restored, FTetrisSnapshotView(OutOfBounds)));
+		TestTrue("The original snapshot is still restored.", FTetrisSnapshot::Restore(Restored, View));
+	}
+
+	/* Tests for restoring games in every phase. Games are played until one is saved while clearing.*/
+	{
+		int32 NumRestored = 0;
+		bool bRestoredClearing = false;
+		bool bRestoredEveryGame = true;
+		bool bPlaysOnIdentically = true;
+		bool bSavesIdentically = true;
+		for (int32 Seed = 7; Seed < 17 && !bRestoredClearing; ++Seed)
+		{
+			FTetrisSimulation Simulation;
+			Simulation.Initialize(Config);
+			Simulation.Reset(Seed);
+			Simulation.Start();
+			FRandomStream Policy(Seed);
+			while (!Simulation.IsGameOver())
+			{
+				TetrisTests::PlayRandomSteps(Simulation, Policy, Policy.RandRange(1, 40));
+				TArray<uint8> Data;
+				FTetrisSnapshot::Save(Simulation, Data);
+
+				FTetrisSimulation Restored;
+				if (!FTetrisSnapshot::Restore(Restored, FTetrisSnapshotView(Data))) { break; }
+				++NumRestored;
+				bRestoredClearing |= Restored.GetPhase() == ETetrisPhase::Clearing;
+
+				/* A restored game saves to the same bytes and plays on exactly like the original.*/
+				TArray<uint8> Resaved;
+				FTetrisSnapshot::Save(Restored, Resaved);
+				bSavesIdentically &= Resaved == Data;
+
+				FTetrisSimulation Original = Simulation;
+				FRandomStream PolicyA(NumRestored);
+				FRandomStream PolicyB(NumRestored);
+				TetrisTests::PlayRandomSteps(Original, PolicyA, 300);
+				TetrisTests::PlayRandomSteps(Restored, PolicyB, 300);
+				bPlaysOnIdentically &= IsSameGame(Original, Restored);
+			}
+			bRestoredEveryGame &= Simulation.IsGameOver();
+		}
+		TestTrue("Every snapshot is restored.", NumRestored > 0 && bRestoredEveryGame);
+		TestTrue("A game is restored while clearing.", bRestoredClearing);
+		TestTrue("Restored games save identically.", bSavesIdentically);
+		TestTrue("Restored games play on identically.", bPlaysOnIdentically);
+	}
+
+	/* Tests for files of snapshots.*/
+	{
+		constexpr int32 NumSnapshots = 1000;
+		FTetrisSimulation Simulation;
+		Simulation.Initialize(Config);
+		Simulation.Reset(9);
+		Simulation.Start();
+		FRandomStream Policy(9);
+
+		/* Save every position of a few games.*/
+		TArray<uint8> Data;
+		TArray<int32> Scores;
+		const double SaveStart = FPlatformTime::Seconds();
+		for (int32 i = 0; i < NumSnapshots; ++i)
+		{
+			TetrisTests::PlayRandomSteps(Simulation, Policy, 5);
+			if (Simulation.IsGameOver())
+			{
+				Simulation.Reset(9 + i);
+				Simulation.Start();
+			}
+			FTetrisSnapshot::Save(Simulation, Data);
+			Scores.Add(Simulation.GetScore());
+		}
+		const double SaveSeconds = FPlatformTime::Seconds() - SaveStart;
+
+		const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("TetrisSnapshotTest.tetrissnapshots"));
+		TestTrue("Snapshots are written.", FFileHelper::SaveArrayToFile(Data, *Filename));
+
+		{
+			FTetrisSnapshotFile File;
+			TestTrue("Snapshot file is mapped.", File.Open(Filename));
+			TestEqual("Every snapshot is found.", File.Num(), NumSnapshots);
+
+			FTetrisSimulation Restored;
+			bool bAllRestored = true;
+			const double RestoreStart = FPlatformTime::Seconds();
+			for (int32 i = 0; i < File.Num(); ++i)
+			{
+				bAllRestored &= FTetrisSnapshot::Restore(Restored, File.Get(i)) && Restored.GetScore() == Scores[i];
+			}
+			const double RestoreSeconds = FPlatformTime::Seconds() - RestoreStart;
+			TestTrue("Every mapped snapshot is restored.", bAllRestored);
+			AddInfo(FString::Printf(TEXT("%d bytes per snapshot. Save: %.2f us. Restore from a mapped file: %.2f us."),
+				Data.Num() / NumSnapshots, SaveSeconds * 1e6 / NumSnapshots, RestoreSeconds * 1e6 / NumSnapshots));
+		}
+		IFileManager::Get().Delete(*Filename);
+	}
+	return true;
+}
@@ -0,0 +1,85 @@
+#include "CoreMinimal.h"
+#include "AI/TranspositionTable.h"
+#include "Async/ParallelFor.h"
+#include "Misc/AutomationTest.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTranspositionTableTests, "Tetris.AI.Transposition Table", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FTranspositionTableTests::RunTest(const FString& Parameters)
+{
+	/* Tests for storing and probing.*/
+	{
+		FTranspositionTable Table;
+		FTranspositionEntry Entry;
+		TestFalse("Table without entries misses.", Table.Probe(1, Entry));
+		Table.Store(1, 1.f, 0, 0);
+
+		Table.Initialize(1000);
+		TestEqual("Size is rounded down to a power of two.", Table.GetNumEntries(), 512);
+		TestFalse("Empty table misses.", Table.Probe(0, Entry) || Table.Probe(7, Entry));
+
+		Table.Store(7, -2.5f, 12, 3);
+		TestTrue("Stored entry is found.", Table.Probe(7, Entry));
+		TestTrue("Entry is kept.", Entry.Value == -2.5f && Entry.BestMove == 12 && Entry.Depth == 3 && Entry.Generation == Table.GetGeneration());
+		Table.Store(8, 1.f, INDEX_NONE, 0);
+		TestTrue("Entry without a move is kept.", Table.Probe(8, Entry) && Entry.BestMove == INDEX_NONE);
+
+		/* Keys that share a slot replace each other by depth and generation.*/
+		const uint64 Colliding = 7 + 512;
+		TestFalse("Colliding key misses.", Table.Probe(Colliding, Entry));
+		Table.Store(Colliding, 1.f, 1, 2);
+		TestTrue("Shallower entry doesn't replace a deeper one.", !Table.Probe(Colliding, Entry) && Table.Probe(7, Entry));
+		Table.Store(Colliding, 1.f, 1, 3);
+		TestTrue("Entry as deep replaces the old one.", Table.Probe(Colliding, Entry) && !Table.Probe(7, Entry));
+		Table.Store(Colliding, 4.f, 2, 0);
+		TestTrue("Entry of the same key is replaced.", Table.Probe(Colliding, Entry) && Entry.Value == 4.f);
+		Table.Store(7, 0.f, 0, 9);
+		Table.NewGeneration();
+		Table.Store(Colliding, 1.f, 1, 0);
+		TestTrue("Entry of an older generation is replaced.", Table.Probe(Colliding, Entry));
+
+		Table.Clear();
+		TestFalse("Cleared table misses.", Table.Probe(Colliding, Entry));
+	}
+
+	/* Tests that entries written by many threads at once are never read torn.*/
+	{
+		FTranspositionTable Table;
+		Table.Initialize(64);
+		constexpr int32 NumThreads = 8;
+		constexpr int32 NumSteps = 200000;
+		TArray<int32> NumTorn;
+		NumTorn.SetNumZeroed(NumThreads);
+		TArray<int32> NumHits;
+		NumHits.SetNumZeroed(NumThreads);
+		ParallelFor(NumThreads, [&Table, &NumTorn, &NumHits](int32 Thread)
+		{
+			/* Every entry can be checked against its key.*/
+			FRandomStream Random(Thread);
+			for (int32 Step = 0; Step < NumSteps; ++Step)
+			{
+				const uint64 Key = uint64(Random.RandRange(0, 1023)) * 0x9E3779B97F4A7C15ull;
+				FTranspositionEntry Entry;
+				if (Random.RandRange(0, 1) == 0)
+				{
+					Table.Store(Key, float(Key % 1000), int32(Key % 100), 0);
+				}
+				else if (Table.Probe(Key, Entry))
+				{
+					++NumHits[Thread];
+					NumTorn[Thread] += Entry.Value == float(Key % 1000) && Entry.BestMove == int32(Key % 100) ? 0 : 1;
+				}
+			}
+		});
+		int32 TotalTorn = 0;
+		int32 TotalHits = 0;
+		for (int32 Thread = 0; Thread < NumThreads; ++Thread)
+		{
+			TotalTorn += NumTorn[Thread];
+			TotalHits += NumHits[Thread];
+		}
+		TestTrue("Entries are found while threads write.", TotalHits > 0);
+		TestEqual("No torn entry is found.", TotalTorn, 0);
+	}
+	return true;
+}
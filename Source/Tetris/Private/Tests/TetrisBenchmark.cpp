@@ -0,0 +1,279 @@
+#include "TetrisBenchmark.h"
+#include "HAL/MemoryBase.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+namespace
+{
+	/**
+	 * Forwards every call to the engine allocator, counting the allocations made on one thread while installed.
+	 *
+	 * The proxy is never destroyed and keeps forwarding after it is removed, so a thread that read GMalloc just before
+	 * the proxy was removed can still call it.
+	 */
+	class FTetrisBenchmarkMalloc final : public FMalloc
+	{
+	public:
+		/* Route GMalloc through the proxy and count the allocations of the calling thread.*/
+		void Begin()
+		{
+			check(GMalloc != this);
+			Inner = GMalloc;
+			NumAllocations = 0;
+			CountingThreadId.store(FPlatformTLS::GetCurrentThreadId(), std::memory_order_relaxed);
+			GMalloc = this;
+		}
+
+		/* Restore GMalloc and return the number of allocations counted.*/
+		int64 End()
+		{
+			check(GMalloc == this);
+			GMalloc = Inner;
+			CountingThreadId.store(0, std::memory_order_relaxed);
+			return NumAllocations;
+		}
+
+		/*** FMalloc overrides ***/
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			Inner->SetupTLSCachesOnCurrentThread();
+		}
+
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			Inner->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("TetrisBenchmarkMalloc");
+		}
+
+	private:
+		/* The allocator the calls are forwarded to.*/
+		FMalloc* Inner{ GMalloc };
+
+		/* The thread whose allocations are counted, or 0 when not counting.*/
+		std::atomic<uint32> CountingThreadId{ 0 };
+
+		/* The allocations counted, only written by the counting thread.*/
+		int64 NumAllocations{ 0 };
+
+		void CountAllocation()
+		{
+			if (CountingThreadId.load(std::memory_order_relaxed) == FPlatformTLS::GetCurrentThreadId())
+			{
+				++NumAllocations;
+			}
+		}
+	};
+
+	FTetrisBenchmarkMalloc& GetBenchmarkMalloc()
+	{
+		static FTetrisBenchmarkMalloc* BenchmarkMalloc = new FTetrisBenchmarkMalloc();
+		return *BenchmarkMalloc;
+	}
+
+	/* A baseline read from the checked-in file. A negative time means only the allocations are tracked.*/
+	struct FBaseline
+	{
+		double NanosecondsPerOp{ -1.0 };
+		double AllocationsPerOp{ 0.0 };
+	};
+
+	/* Read the baselines, skipping the header, blank lines and comments starting with '#'.*/
+	TMap<FString, FBaseline> LoadBaselines(const FString& Filename)
+	{
+		TMap<FString, FBaseline> Baselines;
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *Filename)) { return Baselines; }
+		for (const FString& Line : Lines)
+		{
+			TArray<FString> Fields;
+			Line.ParseIntoArray(Fields, TEXT(","), false);
+			if (Fields.Num() < 3 || Fields[0].IsEmpty() || Fields[0].StartsWith(TEXT("#")) || Fields[0] == TEXT("Name")) { continue; }
+
+			FBaseline Baseline;
+			Baseline.NanosecondsPerOp = Fields[1].IsEmpty() ? -1.0 : FCString::Atod(*Fields[1]);
+			Baseline.AllocationsPerOp = FCString::Atod(*Fields[2]);
+			Baselines.Add(Fields[0], Baseline);
+		}
+		return Baselines;
+	}
+}
+
+FTetrisBenchmark::FTetrisBenchmark(FAutomationTestBase& InTest, const FString& InSuite)
+	: Test(InTest)
+	, Suite(InSuite)
+{}
+
+void FTetrisBenchmark::Run(const TCHAR* Name, int32 NumOps, TFunctionRef<void(int32)> Op)
+{
+	Run(Name, 1, NumOps, [] {}, Op);
+}
+
+void FTetrisBenchmark::Run(const TCHAR* Name, int32 NumBatches, int32 OpsPerBatch, TFunctionRef<void()> Setup, TFunctionRef<void(int32)> Op)
+{
+	check(NumBatches > 0 && OpsPerBatch > 0);
+	FTetrisBenchmarkResult Result = Measure(NumBatches, OpsPerBatch, Setup, Op);
+	Result.Name = Name;
+
+	/* Subtract the timer and the call of an empty operation with the same batching.*/
+	const double OverheadNs = Measure(NumBatches, OpsPerBatch, [] {}, [](int32) {}).NanosecondsPerOp;
+	Result.NanosecondsPerOp = FMath::Max(Result.NanosecondsPerOp - OverheadNs, 0.0);
+	Results.Add(Result);
+}
+
+FTetrisBenchmarkResult FTetrisBenchmark::Measure(int32 NumBatches, int32 OpsPerBatch, TFunctionRef<void()> Setup, TFunctionRef<void(int32)> Op) const
+{
+	FTetrisBenchmarkMalloc& BenchmarkMalloc = GetBenchmarkMalloc();
+	TArray<uint64> BatchCycles;
+	BatchCycles.Reserve(NumRepeats * NumBatches);
+	int64 NumAllocations = 0;
+
+	/* The first repeat warms the caches and grows any scratch buffers, and isn't counted.*/
+	for (int32 Repeat = 0; Repeat <= NumRepeats; ++Repeat)
+	{
+		for (int32 Batch = 0; Batch < NumBatches; ++Batch)
+		{
+			Setup();
+			BenchmarkMalloc.Begin();
+			const uint64 Start = FPlatformTime::Cycles64();
+			for (int32 OpIndex = 0; OpIndex < OpsPerBatch; ++OpIndex)
+			{
+				Op(OpIndex);
+			}
+			const uint64 Cycles = FPlatformTime::Cycles64() - Start;
+			const int64 BatchAllocations = BenchmarkMalloc.End();
+			if (Repeat > 0)
+			{
+				BatchCycles.Add(Cycles);
+				NumAllocations += BatchAllocations;
+			}
+		}
+	}
+
+	/* The median batch is robust to the batches interrupted by the rest of the engine.*/
+	BatchCycles.Sort();
+	FTetrisBenchmarkResult Result;
+	Result.NanosecondsPerOp = FPlatformTime::ToSeconds64(BatchCycles[BatchCycles.Num() / 2]) * 1e9 / OpsPerBatch;
+	Result.AllocationsPerOp = double(NumAllocations) / (double(BatchCycles.Num()) * OpsPerBatch);
+	return Result;
+}
+
+bool FTetrisBenchmark::Finish()
+{
+	const TMap<FString, FBaseline> Baselines = LoadBaselines(GetBaselineFilename());
+	double Tolerance = 0.25;
+	FParse::Value(FCommandLine::Get(), TEXT("TetrisBenchmarkTolerance="), Tolerance);
+	const bool bUpdateBaselines = FParse::Param(FCommandLine::Get(), TEXT("TetrisBenchmarkUpdateBaselines"));
+
+	bool bPassed = true;
+	FString Csv = TEXT("Name,NsPerOp,AllocsPerOp,BaselineNsPerOp,BaselineAllocsPerOp\n");
+	FString BaselineCsv = TEXT("Name,NsPerOp,AllocsPerOp\n");
+	for (const FTetrisBenchmarkResult& Result : Results)
+	{
+		const FBaseline* Baseline = Baselines.Find(Result.Name);
+		Csv += FString::Printf(TEXT("%s,%.2f,%.3f,"), *Result.Name, Result.NanosecondsPerOp, Result.AllocationsPerOp);
+		Csv += Baseline && Baseline->NanosecondsPerOp >= 0.0 ? FString::Printf(TEXT("%.2f,"), Baseline->NanosecondsPerOp) : FString(TEXT(","));
+		Csv += Baseline ? FString::Printf(TEXT("%.3f\n"), Baseline->AllocationsPerOp) : FString(TEXT("\n"));
+		BaselineCsv += FString::Printf(TEXT("%s,%.2f,%.3f\n"), *Result.Name, Result.NanosecondsPerOp, Result.AllocationsPerOp);
+		Test.AddInfo(FString::Printf(TEXT("%s: %.2f ns/op, %.3f allocs/op"), *Result.Name, Result.NanosecondsPerOp, Result.AllocationsPerOp));
+
+		if (bUpdateBaselines) { continue; }
+		if (!Baseline)
+		{
+			Test.AddWarning(FString::Printf(TEXT("%s has no baseline. Run with -TetrisBenchmarkUpdateBaselines to record one."), *Result.Name));
+			continue;
+		}
+
+		/* Allocations are deterministic, so any increase is a regression. Times are compared within the tolerance.*/
+		if (Result.AllocationsPerOp > Baseline->AllocationsPerOp + 0.001)
+		{
+			Test.AddError(FString::Printf(TEXT("%s allocates %.3f times per op, up from %.3f."), *Result.Name, Result.AllocationsPerOp, Baseline->AllocationsPerOp));
+			bPassed = false;
+		}
+		if (Baseline->NanosecondsPerOp >= 0.0
+			&& Result.NanosecondsPerOp > Baseline->NanosecondsPerOp * (1.0 + Tolerance)
+			&& Result.NanosecondsPerOp - Baseline->NanosecondsPerOp > MinRegressionNs)
+		{
+			Test.AddError(FString::Printf(TEXT("%s takes %.2f ns/op, up from %.2f ns/op."), *Result.Name, Result.NanosecondsPerOp, Baseline->NanosecondsPerOp));
+			bPassed = false;
+		}
+	}
+
+	if (!FFileHelper::SaveStringToFile(Csv, *GetResultsFilename()))
+	{
+		Test.AddWarning(FString::Printf(TEXT("Could not write %s."), *GetResultsFilename()));
+	}
+	if (bUpdateBaselines)
+	{
+		if (FFileHelper::SaveStringToFile(BaselineCsv, *GetBaselineFilename()))
+		{
+			Test.AddInfo(FString::Printf(TEXT("Updated the baselines in %s."), *GetBaselineFilename()));
+		}
+		else
+		{
+			Test.AddError(FString::Printf(TEXT("Could not write %s."), *GetBaselineFilename()));
+			bPassed = false;
+		}
+	}
+	return bPassed;
+}
+
+const TArray<FTetrisBenchmarkResult>& FTetrisBenchmark::GetResults() const
+{
+	return Results;
+}
+
+FString FTetrisBenchmark::GetResultsFilename() const
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("Benchmarks"), Suite + TEXT(".csv"));
+}
+
+FString FTetrisBenchmark::GetBaselineFilename() const
+{
+	return FPaths::Combine(FPaths::GameSourceDir(), TEXT("Tetris"), TEXT("Private"), TEXT("Tests"), TEXT("Baselines"), Suite + TEXT(".csv"));
+}
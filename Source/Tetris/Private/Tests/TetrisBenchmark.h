@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+/* The measurements of one benchmarked operation.*/
+struct FTetrisBenchmarkResult
+{
+	FString Name;
+
+	/* The time per operation of the median batch, in nanoseconds.*/
+	double NanosecondsPerOp{ 0.0 };
+
+	/* The mean number of heap allocations per operation made on the benchmark thread.*/
+	double AllocationsPerOp{ 0.0 };
+};
+
+/**
+ * Times operations for a benchmark automation test and checks them against checked-in baselines.
+ *
+ * Each operation is run in batches after an untimed setup, so that operations which change the board can be measured
+ * from the same state every time. The overhead of the timer and the call is measured the same way and subtracted.
+ * Allocations are counted by routing GMalloc through a counting proxy while a batch runs.
+ *
+ * The results of a suite are written to Saved/Automation/Benchmarks/<Suite>.csv and compared with
+ * Private/Tests/Baselines/<Suite>.csv. A time above the baseline by more than the tolerance, or any extra allocation,
+ * fails the test. Run with -TetrisBenchmarkTolerance=<fraction> to change the tolerance (0.25 by default), or with
+ * -TetrisBenchmarkUpdateBaselines to record the results as the new baselines.
+ */
+class FTetrisBenchmark
+{
+public:
+	FTetrisBenchmark(FAutomationTestBase& InTest, const FString& InSuite);
+
+	/* Time an operation that can be repeated without setup, e.g. a query.*/
+	void Run(const TCHAR* Name, int32 NumOps, TFunctionRef<void(int32 /* OpIndex */)> Op);
+
+	/* Time an operation in batches of OpsPerBatch, calling the untimed setup before each batch.*/
+	void Run(const TCHAR* Name, int32 NumBatches, int32 OpsPerBatch, TFunctionRef<void()> Setup, TFunctionRef<void(int32 /* OpIndex */)> Op);
+
+	/* Write the results and compare them with the baselines. Return false if any operation regressed.*/
+	bool Finish();
+
+	/* Get the results measured so far.*/
+	const TArray<FTetrisBenchmarkResult>& GetResults() const;
+
+private:
+	/* The number of timed repeats of each benchmark, after one warm-up repeat.*/
+	static constexpr int32 NumRepeats = 5;
+
+	/* Differences below this are noise, whatever the tolerance.*/
+	static constexpr double MinRegressionNs = 1.0;
+
+	/* The test that reports the results.*/
+	FAutomationTestBase& Test;
+
+	/* The name of the suite, used for the result and baseline files.*/
+	FString Suite;
+
+	/* The results in the order they were measured.*/
+	TArray<FTetrisBenchmarkResult> Results;
+
+	/* Measure a benchmark without subtracting the overhead.*/
+	FTetrisBenchmarkResult Measure(int32 NumBatches, int32 OpsPerBatch, TFunctionRef<void()> Setup, TFunctionRef<void(int32)> Op) const;
+
+	/* Get the file of the results of this run.*/
+	FString GetResultsFilename() const;
+
+	/* Get the checked-in file of the baselines.*/
+	FString GetBaselineFilename() const;
+};
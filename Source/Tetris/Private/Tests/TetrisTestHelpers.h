@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoardBatch.h"
+#include "Simulation/TetrisSimulation.h"
+
+/* Games, boards and observers shared by the automation tests.*/
+namespace TetrisTests
+{
+	/* Fill a board with random rubble up to a random height, including some full rows.*/
+	inline void FillRandomBoard(FBoardState& Board, FRandomStream& Random)
+	{
+		constexpr uint8 CellMask[FPieceShape::BoxSize] = { 1, 0, 0, 0 };
+		constexpr FPieceShape Cell = FPieceShape::Make(CellMask, 0, 0);
+		const int32 StackHeight = Random.RandRange(0, Board.GetHeight() - FPieceShape::BoxSize);
+		for (int32 Row = 0; Row < StackHeight; ++Row)
+		{
+			const bool bFullRow = Random.RandRange(0, 7) == 0;
+			for (int32 Col = 0; Col < Board.GetWidth(); ++Col)
+			{
+				if (bFullRow || Random.RandRange(0, 2) > 0)
+				{
+					Board.Place(Cell, { Col, Row });
+				}
+			}
+		}
+		Board.Commit();
+	}
+
+	/* Build a batch of random boards, keeping copies of the boards as a reference.*/
+	inline void MakeRandomBatch(FBoardBatch& Batch, TArray<FBoardState>& Boards, int32 NumBoards, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		Batch.Initialize(NumBoards, 10, 24);
+		Boards.SetNum(NumBoards);
+		for (int32 i = 0; i < NumBoards; ++i)
+		{
+			Boards[i].Initialize(10, 24);
+			FillRandomBoard(Boards[i], Random);
+			Batch.SetBoard(i, Boards[i]);
+		}
+	}
+
+	/**
+	 * Step a game with random actions, mostly shifts and rotations so that pieces fall slowly and lines are cleared, until
+	 * the game ends or the steps run out. Cleared rows are sometimes collapsed early if asked, to exercise early collapses.
+	 * Return the number of steps taken.
+	 */
+	inline int64 PlayRandomSteps(FTetrisSimulation& Simulation, FRandomStream& Policy, int64 MaxSteps, bool bCollapseEarly = false)
+	{
+		constexpr EAction Actions[] = { EAction::LEFT, EAction::RIGHT, EAction::ROTATE_R, EAction::ROTATE_L, EAction::DOWN, EAction::HARD_DROP };
+		int64 Step = 0;
+		for (; Step < MaxSteps && !Simulation.IsGameOver(); ++Step)
+		{
+			const int32 Roll = Policy.RandRange(0, 399);
+			Simulation.ApplyAction(Actions[Roll == 0 ? 5 : Roll < 3 ? 4 : Policy.RandRange(0, 3)]);
+			if (bCollapseEarly && Simulation.GetPhase() == ETetrisPhase::Clearing && Policy.RandRange(0, 1) == 0)
+			{
+				Simulation.Collapse();
+			}
+			Simulation.Tick();
+		}
+		return Step;
+	}
+
+	/* Start a game that locks and collapses without waiting, so that it can be played by actions alone.*/
+	inline FTetrisSimulation MakeGame(int32 Seed, float Gravity = 0.f)
+	{
+		FTetrisSimulationConfig Config;
+		Config.CollapseDelayTicks = 0;
+		Config.Gravity = Gravity;
+		FTetrisSimulation Game;
+		Game.Initialize(Config);
+		Game.Reset(Seed);
+		Game.Start();
+		return Game;
+	}
+
+	/* Records where the last piece locked.*/
+	class FLockRecorder : public ITetrisSimulationObserver
+	{
+	public:
+		const FPieceShape* Piece{ nullptr };
+		FIntPoint Coordinate{ 0, 0 };
+
+		virtual void OnLock(const FTetrisSimulation& Simulation, const FPieceShape& InPiece, const FIntPoint& InCoordinate, int32 NumLines) override
+		{
+			Piece = &InPiece;
+			Coordinate = InCoordinate;
+		}
+	};
+}
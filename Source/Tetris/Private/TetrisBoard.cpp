@@ -3,23 +3,30 @@
 
 #include "TetrisBoard.h"
 #include "Components/InstancedStaticMeshComponent.h" 
-#include "InternalBoard.h"
-#include "PieceFactory.h"
+#include "PieceShape.h"
 #include "PieceQueue.h"
 #include "DrawDebugHelpers.h"
 #include "BoardHUD.h"
 #include "Components/WidgetComponent.h" 
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+#include "Simulation/TetrisSnapshot.h"
+#include "Core/TetrisStats.h"
 
 ATetrisBoard::ATetrisBoard()
 {
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
 	BlockMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Block Mesh"));
+	ActivePieceMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Active Piece Mesh"));
+	GhostPieceMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("Ghost Piece Mesh"));
 	BackgroundMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Background Mesh"));
 	PieceQueue = CreateDefaultSubobject<UPieceQueue>(TEXT("Piece Queue"));
 	LineCounter = CreateDefaultSubobject<UWidgetComponent>(TEXT("Line Counter"));
 
 	/* Attach components.*/
 	BlockMesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
+	ActivePieceMesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
+	GhostPieceMesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
 	BackgroundMesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
 	LineCounter->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
 
@@ -32,119 +39,202 @@ ATetrisBoard::ATetrisBoard()
 
 void ATetrisBoard::Reset()
 {
-	/* Clear the board.*/
-	InternalBoard = UInternalBoard::NewInternalBoard(BoardWidth, BoardHeight + BoardTopSpace);
-	Draw();
-
-	/* Reset metrics*/
-	Score = 0;
-	LinesCleared = 0;
-	ElapsedTime = 0;
-
-	/* Update the HUD.*/
-	if (UBoardHUD* BoardHUD = Cast<UBoardHUD>(LineCounter->GetWidget()))
+	/* Clear the board and restart the piece sequence.*/
+	StopPlay();
+	StopReplay();
+	ReplayRecorder.Finish(false);
+	if (AIController)
 	{
-		BoardHUD->Update(this);
+		AIController->Cancel();
 	}
+	Simulation.Initialize(GetSimulationConfig(), PieceQueue->GetShapeTable());
+	Simulation.Reset(PieceQueue->MakeSeed());
+	ProcessSimulationEvents();
 }
 
 void ATetrisBoard::StartGame()
 {
 	/* Ensure the board is reset.*/
 	Reset();
+	if (bRecordReplays)
+	{
+		ReplayRecorder.Begin(Simulation, GetReplayFilename());
+	}
 
-	/* Start the game timer.*/
-	GetWorldTimerManager().SetTimer(GameTimer, this, &ATetrisBoard::HandleGameTimerTick, 1.f, true);
-
-	/* Add a piece to the board.*/
+	/* Add a piece to the board and start stepping.*/
 	AddPiece();
+	ResumePlay();
 }
 
 void ATetrisBoard::Update(EAction Action)
 {
-	if (!InternalBoard){ return; }
+	/* Input is dropped while paused or replaying, however it arrives.*/
+	if (bIsReplaying || !bIsPlaying) { return; }
+	TETRIS_SCOPE_CYCLE_COUNTER(Update);
+	Simulation.ApplyAction(Action);
+	ProcessSimulationEvents();
+}
+
+void ATetrisBoard::UpdateBatch(const TArray<TEnumAsByte<EAction>>& Actions)
+{
+	TArray<EAction> BatchActions;
+	BatchActions.Reserve(Actions.Num());
+	for (const TEnumAsByte<EAction> Action : Actions)
+	{
+		BatchActions.Add(Action);
+	}
+	ApplyActions(BatchActions);
+}
 
-	/* Do nothing if there isn't a piece in play.*/
-	if (!CurrentPiece) { return; }
+void ATetrisBoard::ApplyActions(TConstArrayView<EAction> Actions)
+{
+	if (bIsReplaying || !bIsPlaying) { return; }
+	TETRIS_SCOPE_CYCLE_COUNTER(Update);
+	Simulation.ApplyActions(Actions);
+	ProcessSimulationEvents();
+}
 
-	/* Set the new coordinate according to the action.*/
-	FIntPoint NewCoordinate;
-	ComputeNewCoordinate(NewCoordinate, Action);
+void ATetrisBoard::QueueAction(EAction Action)
+{
+	QueuedActions.Add(Action);
+}
 
-	/* Reset the board to the state before the piece was placed.*/
-	InternalBoard->Undo();
+void ATetrisBoard::Draw()
+{
+	/* Do nothing if the mesh isn't set.*/
+	if (!BlockMesh) { return; }
+	TETRIS_SCOPE_CYCLE_COUNTER(Draw);
 
-	/* If the action is a rotation, change the current piece.*/
-	if (Action == EAction::ROTATE_L)
+	/* Rebuild the pool if the board dimensions changed.*/
+	const FBoardState& Board = Simulation.GetBoard();
+	const int32 Width = Board.GetWidth();
+	const int32 Height = Board.GetHeight();
+	if (DrawnWidth != Width || DrawnRows.Num() != Height || BlockMesh->GetInstanceCount() != Width * Height)
 	{
-		CurrentPiece = CurrentPiece->Prev;
+		InitializeBlockPool();
 	}
-	else if (Action == EAction::ROTATE_R)
+
+	/* Show or hide only the blocks whose occupancy changed since the last draw.*/
+	int32 NumChanged = 0;
+	for (int32 Row = 0; Row < Height; ++Row)
 	{
-		CurrentPiece = CurrentPiece->Next;
-	}
+		const uint32 RowMask = Board.GetRowMask(Row);
+		uint32 ChangedMask = RowMask ^ DrawnRows[Row];
+		while (ChangedMask)
+		{
+			const int32 Col = FMath::CountTrailingZeros(ChangedMask);
+			ChangedMask &= ChangedMask - 1;
 
-	/* Attempt to place the piece at the new location.*/
-	EPlaceResult Result = InternalBoard->Place(CurrentPiece, NewCoordinate);
+			const FIntPoint Coordinate = { Col, Row };
+			const bool bOccupied = (RowMask >> Col) & 1u;
+			BlockMesh->UpdateInstanceTransform(Row * Width + Col, bOccupied ? GetBlockTransform(Coordinate) : GetHiddenBlockTransform(Coordinate), false, false, true);
+			++NumChanged;
+		}
+		DrawnRows[Row] = RowMask;
+	}
 
-	if (Result == EPlaceResult::BAD && Action == EAction::DOWN)
+	/* Push all of the updates to the render thread at once.*/
+	if (NumChanged > 0)
 	{
-		/* If the piece could not be placed and the verb was DOWN, start the lock procedure.*/
-		HandleOnPieceLocked();
+		BlockMesh->MarkRenderStateDirty();
+		INC_DWORD_STAT_BY(STAT_TetrisInstancesUpdated, NumChanged);
 	}
-	else if (Result == EPlaceResult::BAD)
+}
+
+void ATetrisBoard::InitializeBlockPool()
+{
+	const int32 Width = Simulation.GetBoard().GetWidth();
+	const int32 Height = Simulation.GetBoard().GetHeight();
+
+	/* Add every instance hidden, in cell order.*/
+	TArray<FTransform> Transforms;
+	Transforms.Reserve(Width * Height);
+	for (int32 Row = 0; Row < Height; ++Row)
 	{
-		/* Undo rotation.*/
-		if (Action == EAction::ROTATE_L)
+		for (int32 Col = 0; Col < Width; ++Col)
 		{
-			CurrentPiece = CurrentPiece->Next;
+			Transforms.Add(GetHiddenBlockTransform({ Col, Row }));
 		}
-		else if (Action == EAction::ROTATE_R)
-		{
-			CurrentPiece = CurrentPiece->Prev;
-		}
-		/* If the piece could not be placed, do nothing.*/
-		InternalBoard->Place(CurrentPiece, CurrentCoordinate);
 	}
-	else if (Result == EPlaceResult::OK)
+	BlockMesh->ClearInstances();
+	BlockMesh->AddInstances(Transforms, false);
+	INC_DWORD_STAT_BY(STAT_TetrisInstancesRebuilt, Transforms.Num());
+
+	DrawnWidth = Width;
+	DrawnRows.Init(0, Height);
+}
+
+void ATetrisBoard::DrawActivePiece()
+{
+	/* Do nothing if the meshes aren't set.*/
+	if (!ActivePieceMesh || !GhostPieceMesh) { return; }
+	TETRIS_SCOPE_CYCLE_COUNTER(DrawActivePiece);
+
+	const FPieceShape* CurrentPiece = Simulation.GetCurrentPiece();
+	DrawPieceLayer(ActivePieceMesh, DrawnActivePieceBlocks, CurrentPiece, CurrentCoordinate, 1.f);
+	if (bShowGhostPiece && CurrentPiece)
 	{
-		/* If the placement is good, update the current piece coordinate.*/
-		CurrentCoordinate = NewCoordinate;
+		DrawPieceLayer(GhostPieceMesh, DrawnGhostPieceBlocks, CurrentPiece, Simulation.GetGhostCoordinate(), GhostBlockScale);
+	}
+	else
+	{
+		DrawPieceLayer(GhostPieceMesh, DrawnGhostPieceBlocks, nullptr, CurrentCoordinate, GhostBlockScale);
 	}
-	/* Redraw the board.*/
-	Draw();
 }
 
-void ATetrisBoard::Draw()
+void ATetrisBoard::DrawPieceLayer(UInstancedStaticMeshComponent* Layer, int32& DrawnBlocks, const FPieceShape* Piece, const FIntPoint& Coordinate, float Scale)
 {
-	/* Do nothing if the mesh isn't set.*/
-	if (!BlockMesh) { return; }
+	/* The layer holds one instance per cell of the piece box, so drawing never adds or removes instances.*/
+	constexpr int32 NumPieceBoxCells = FPieceShape::BoxSize * FPieceShape::BoxSize;
+	if (Layer->GetInstanceCount() != NumPieceBoxCells)
+	{
+		PieceLayerTransforms.Init(GetHiddenBlockTransform(Coordinate), NumPieceBoxCells);
+		Layer->ClearInstances();
+		Layer->AddInstances(PieceLayerTransforms, false);
+		DrawnBlocks = NumPieceBoxCells;
+		INC_DWORD_STAT_BY(STAT_TetrisInstancesRebuilt, NumPieceBoxCells);
+	}
 
-	/* Update every block for now.*/
-	BlockMesh->ClearInstances();
-	for (int i = 0; i < InternalBoard->GetWidth(); ++i)
+	/* Collect the transforms of the body blocks.*/
+	PieceLayerTransforms.Reset();
+	if (Piece)
 	{
-		for (int j = 0; j < InternalBoard->GetHeight(); ++j)
+		for (int32 Row = Piece->MinY; Row <= Piece->MaxY; ++Row)
 		{
-			FIntPoint Coordinate = { i,j };
-			if (!InternalBoard->IsOccupied(Coordinate)) { continue; }
-			BlockMesh->AddInstance(GetBlockTransform(Coordinate));
+			for (int32 Col = Piece->MinX; Col <= Piece->MaxX; ++Col)
+			{
+				if (!(Piece->RowMasks[Row] & (1 << Col))) { continue; }
+				FTransform Transform = GetBlockTransform(Coordinate + FIntPoint(Col, Row));
+				Transform.SetScale3D(Transform.GetScale3D() * Scale);
+				PieceLayerTransforms.Add(Transform);
+			}
 		}
 	}
+
+	/* Hide the blocks that were visible last time but aren't anymore, then update the whole range at once.*/
+	const int32 NumBlocks = PieceLayerTransforms.Num();
+	while (PieceLayerTransforms.Num() < DrawnBlocks)
+	{
+		PieceLayerTransforms.Add(GetHiddenBlockTransform(Coordinate));
+	}
+	if (!PieceLayerTransforms.IsEmpty())
+	{
+		Layer->BatchUpdateInstancesTransforms(0, PieceLayerTransforms, false, true, true);
+		INC_DWORD_STAT_BY(STAT_TetrisInstancesUpdated, PieceLayerTransforms.Num());
+	}
+	DrawnBlocks = NumBlocks;
 }
 
 void ATetrisBoard::StopPlay()
 {
-	/* Stop the timer.*/
-	GetWorldTimerManager().PauseTimer(UpdateTimer);
-	GetWorldTimerManager().PauseTimer(GameTimer);
+	bIsPlaying = false;
 }
 
 void ATetrisBoard::ResumePlay()
 {
-	/* Start the timer.*/
-	GetWorldTimerManager().SetTimer(UpdateTimer, this, &ATetrisBoard::HandleTick, GetTickDelta(), true);
-	GetWorldTimerManager().UnPauseTimer(GameTimer);
+	/* Start timing from this frame rather than catching up on the time spent stopped.*/
+	bIsPlaying = !Simulation.IsGameOver();
+	StepAccumulator = 0.0;
 }
 
 FTransform ATetrisBoard::GetBackgroundTransform() const
@@ -163,134 +253,274 @@ FTransform ATetrisBoard::GetBlockTransform(const FIntPoint& InCoordinate) const
 	return {FRotator::ZeroRotator, BlockPosition, BlockScale};
 }
 
-void ATetrisBoard::ComputeNewCoordinate(FIntPoint& NewCoordinate, EAction Action) const
+FTransform ATetrisBoard::GetHiddenBlockTransform(const FIntPoint& InCoordinate) const
 {
-	NewCoordinate = CurrentCoordinate;
-	switch (Action)
-	{
-	case EAction::DOWN:
-		--NewCoordinate.Y;
-		break;
-	case EAction::LEFT:
-		--NewCoordinate.X;
-		break;
-	case EAction::RIGHT:
-		++NewCoordinate.X;
-		break;
-	}
+	/* Hidden blocks stay in their cell with zero scale, so they are never rendered.*/
+	FVector BlockPosition = FVector(InCoordinate.Y, InCoordinate.X, 0.f) * BlockWidth;
+	return { FRotator::ZeroRotator, BlockPosition, FVector::ZeroVector };
+}
+
+void ATetrisBoard::AddPiece()
+{
+	Simulation.SpawnPiece();
+	ProcessSimulationEvents();
+}
+
+void ATetrisBoard::Collapse()
+{
+	Simulation.Collapse();
+	ProcessSimulationEvents();
 }
 
-void ATetrisBoard::UpdateScore(int32 NumLines)
+bool ATetrisBoard::IsGameOver() const
+{
+	return Simulation.IsGameOver();
+}
+
+const FTetrisSimulation& ATetrisBoard::GetSimulation() const
 {
-	/* Hard code the scoring rules for simplicity.*/
-	int32 BoardLevel = GetBoardLevel();
-	switch (NumLines)
+	return Simulation;
+}
+
+bool ATetrisBoard::PlayReplay(const FString& Filename, float PlaybackSpeed)
+{
+	Reset();
+	if (!ReplayPlayer.Begin(Simulation, Filename, PieceQueue->GetShapeTable()))
 	{
-	case 1: 
-		Score += BoardLevel * 100;
-		break;
-	case 2:
-		Score += BoardLevel * 300;
-		break;
-	case 3:
-		Score += BoardLevel * 500;
-		break;
-	case 4:
-		Score += BoardLevel * 800;
-		break;
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not play %s: %s"), __FUNCTION__, *Filename, *ReplayPlayer.GetError());
+		Reset();
+		return false;
 	}
+	ReplaySpeed = PlaybackSpeed;
+	bIsReplaying = true;
+	StepAccumulator = 0.0;
+	ProcessSimulationEvents();
+	return true;
+}
+
+void ATetrisBoard::StopReplay()
+{
+	ReplayPlayer.Stop();
+	bIsReplaying = false;
 }
 
-void ATetrisBoard::HandleTick()
+bool ATetrisBoard::IsReplaying() const
 {
-	Update(EAction::DOWN);
+	return bIsReplaying;
 }
 
-void ATetrisBoard::HandleGameTimerTick()
+FString ATetrisBoard::GetReplayError() const
 {
-	if (UBoardHUD* BoardHUD = Cast<UBoardHUD>(LineCounter->GetWidget()))
+	return ReplayPlayer.GetError();
+}
+
+bool ATetrisBoard::SaveSnapshot(const FString& Filename) const
+{
+	TArray<uint8> Data;
+	if (!FTetrisSnapshot::Save(Simulation, Data) || !FFileHelper::SaveArrayToFile(Data, *Filename))
 	{
-		++ElapsedTime;
-		BoardHUD->Update(this);
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not save a snapshot to %s"), __FUNCTION__, *Filename);
+		return false;
 	}
+	return true;
 }
 
-void ATetrisBoard::AddPiece()
+bool ATetrisBoard::LoadSnapshot(const FString& Filename)
 {
-	/* Grab the next piece.*/
-	CurrentPiece = PieceQueue->Pop();
+	/* Read the snapshot in place from the mapped file.*/
+	FTetrisSnapshotFile File;
+	if (!File.Open(Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not open %s"), __FUNCTION__, *Filename);
+		return false;
+	}
+	const FTetrisSnapshotView Snapshot = File.Get(0);
+	const FTetrisSimulationConfig Config = GetSimulationConfig();
+	const FTetrisSnapshotHeader& Header = Snapshot.GetHeader();
+	if (Header.Width != Config.Width || Header.Height != Config.Height || Header.TopSpace != Config.TopSpace)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: %s was saved on a %dx%d board"), __FUNCTION__, *Filename, Header.Width, Header.Height);
+		return false;
+	}
 
-	/* Add the piece to the top of the internal board.*/
-	CurrentCoordinate = { BoardWidth / 2 - 2 , BoardHeight };
-	InternalBoard->Place(CurrentPiece, CurrentCoordinate);
-	Draw();
+	Reset();
+	if (!FTetrisSnapshot::Restore(Simulation, Snapshot, PieceQueue->GetShapeTable()))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Error in %s: Could not restore %s"), __FUNCTION__, *Filename);
+		Reset();
+		return false;
+	}
+	ProcessSimulationEvents();
+	RequestAIPlan();
+	if (Simulation.GetPhase() != ETetrisPhase::Idle)
+	{
+		ResumePlay();
+	}
+	return true;
+}
 
-	/* Restart the board update timer.*/
-	ResumePlay();
+FString ATetrisBoard::GetReplayFilename() const
+{
+	const FString Directory = ReplayDirectory.IsEmpty() ? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Replays")) : ReplayDirectory;
+	return FPaths::Combine(Directory, FString::Printf(TEXT("Tetris-%s.tetrisreplay"), *FDateTime::Now().ToString()));
 }
 
-void ATetrisBoard::HandleOnPieceLocked()
+void ATetrisBoard::TickReplay(float DeltaSeconds)
 {
-	/* Stop board updates.*/
-	StopPlay();
+	TETRIS_SCOPE_CYCLE_COUNTER(ReplayTick);
 
-	/* Place current piece at the current location.*/
-	InternalBoard->Place(CurrentPiece, CurrentCoordinate);
-	CurrentPiece = nullptr;
+	/* Take the steps due at the playback speed, or every remaining step if the speed isn't positive.*/
+	if (ReplaySpeed > 0.f)
+	{
+		const double StepTime = 1.0 / Simulation.GetConfig().TicksPerSecond;
+		StepAccumulator += DeltaSeconds * ReplaySpeed;
+		const int64 NumSteps = static_cast<int64>(StepAccumulator / StepTime);
+		StepAccumulator -= NumSteps * StepTime;
+		ReplayPlayer.Advance(NumSteps);
+	}
+	else
+	{
+		ReplayPlayer.PlayToEnd();
+	}
 
-	/* Clear any filled rows.*/
-	ClearRows();
+	/* The player reports the result once the playback ends.*/
+	if (ReplayPlayer.GetResult() != ETetrisReplayResult::Playing)
+	{
+		bIsReplaying = false;
+	}
+	ProcessSimulationEvents();
 }
 
-void ATetrisBoard::ClearRows()
+void ATetrisBoard::RequestAIPlan()
 {
-	TArray<int32> Lines;
-	InternalBoard->ClearRows(Lines);
-	int32 NumLines = Lines.Num();
-	if (NumLines > 0)
+	if (!bAIPlays || bIsReplaying)
 	{
-		LinesCleared += NumLines;
-		UpdateScore(NumLines);
-		Draw();
-		OnLinesCleared.Broadcast();
-
-		/* Collapse board after a delay.*/
-		FTimerHandle CollapseTimer;
-		GetWorldTimerManager().SetTimer(CollapseTimer, this, &ATetrisBoard::Collapse, 1.0f, false);
+		if (AIController)
+		{
+			AIController->Cancel();
+		}
+		return;
 	}
-	else
+
+	/* The search settings are taken when the AI first plays. Changing them in the editor starts a new AI.*/
+	if (!AIController)
 	{
-		/* Lock is complete if there's nothing to clear.*/
-		OnLockComplete.Broadcast();
+		FTetrisSearchSettings Settings;
+		Settings.BeamWidth = AIBeamWidth;
+		Settings.NumPreviewPieces = AIPreviewPieces;
+		Settings.TimeBudgetSeconds = AIThinkTime;
+		const FBoardEvaluator Evaluator = AIWeights ? FBoardEvaluator(AIWeights->Weights) : FBoardEvaluator();
+		AIController = MakeUnique<FTetrisAIController>(Evaluator, Settings);
 	}
+	AIController->RequestPlan(Simulation);
 }
 
-void ATetrisBoard::Collapse()
+FTetrisSimulationConfig ATetrisBoard::GetSimulationConfig() const
 {
-	/* Collapse the board and notify that lock procedure is complete.*/
-	InternalBoard->Collapse();
-	Draw();
-	OnLockComplete.Broadcast();
+	FTetrisSimulationConfig Config;
+	Config.Width = BoardWidth;
+	Config.Height = BoardHeight;
+	Config.TopSpace = BoardTopSpace;
+	Config.TicksPerSecond = TicksPerSecond;
+	Config.CollapseDelayTicks = FMath::RoundToInt(CollapseDelay * TicksPerSecond);
+	Config.Gravity = Gravity;
+	return Config;
 }
 
-bool ATetrisBoard::IsGameOver() const
+void ATetrisBoard::ProcessSimulationEvents()
 {
-	return InternalBoard->GetStackHeight() > BoardHeight;
+	TETRIS_SCOPE_CYCLE_COUNTER(ProcessEvents);
+	const ETetrisEvents Events = Simulation.ConsumeEvents();
+
+	/* Mirror the simulation state for Blueprints and the details panel.*/
+	const int32 PreviousElapsedTime = ElapsedTime;
+	Score = Simulation.GetScore();
+	LinesCleared = Simulation.GetLinesCleared();
+	ElapsedTime = Simulation.GetElapsedSeconds();
+	CurrentCoordinate = Simulation.GetCurrentCoordinate();
+
+	if (EnumHasAnyFlags(Events, ETetrisEvents::StackChanged))
+	{
+		Draw();
+	}
+	if (EnumHasAnyFlags(Events, ETetrisEvents::PieceMoved))
+	{
+		DrawActivePiece();
+	}
+
+	/* Plan each piece as it enters play.*/
+	if (EnumHasAnyFlags(Events, ETetrisEvents::PieceSpawned))
+	{
+		RequestAIPlan();
+	}
+
+	/* Stop stepping and recording when the game ends. The replay file is closed in the background.*/
+	if (Simulation.IsGameOver())
+	{
+		StopPlay();
+		ReplayRecorder.Finish(false);
+	}
+
+	/* Update the HUD when the metrics change.*/
+	if (EnumHasAnyFlags(Events, ETetrisEvents::LinesCleared) || ElapsedTime != PreviousElapsedTime || Simulation.GetPhase() == ETetrisPhase::Idle)
+	{
+		if (UBoardHUD* BoardHUD = Cast<UBoardHUD>(LineCounter->GetWidget()))
+		{
+			TETRIS_SCOPE_CYCLE_COUNTER(HUDUpdate);
+			BoardHUD->Update(this);
+		}
+	}
+
+	/* Notify listeners in the order the events happen.*/
+	if (EnumHasAnyFlags(Events, ETetrisEvents::LinesCleared))
+	{
+		OnLinesCleared.Broadcast();
+	}
+	if (EnumHasAnyFlags(Events, ETetrisEvents::LockComplete))
+	{
+		OnLockComplete.Broadcast();
+	}
+	if (EnumHasAnyFlags(Events, ETetrisEvents::GameOver))
+	{
+		OnGameOver.Broadcast();
+	}
 }
 
 void ATetrisBoard::BeginPlay()
 {
 	Super::BeginPlay();
-	/* Register delegates*/
-	OnLockComplete.AddUniqueDynamic(this, &ATetrisBoard::HandleOnLockComplete);
+
+	/* Draw the piece layers with the block mesh unless they have their own.*/
+	for (UInstancedStaticMeshComponent* PieceLayer : { ActivePieceMesh, GhostPieceMesh })
+	{
+		if (BlockMesh && PieceLayer && !PieceLayer->GetStaticMesh())
+		{
+			PieceLayer->SetStaticMesh(BlockMesh->GetStaticMesh());
+			PieceLayer->SetMaterial(0, BlockMesh->GetMaterial(0));
+		}
+	}
+
+	/* Build the simulation from the piece queue's shape table, and let the queue preview the pieces it plays.*/
+	Simulation.Initialize(GetSimulationConfig(), PieceQueue->GetShapeTable());
+	PieceQueue->SetSequence(&Simulation.GetSequence());
+}
+
+void ATetrisBoard::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	/* Stop the AI's search before the shape table it reads goes away.*/
+	AIController.Reset();
+	Super::EndPlay(EndPlayReason);
 }
 
 void ATetrisBoard::PostEditChangeProperty(FPropertyChangedEvent & PropertyChangedEvent)
 {
 	Super::PostEditChangeProperty(PropertyChangedEvent);
 
-	/* Reinitialize internal board.*/
-	InternalBoard->Initialize(BoardWidth, BoardHeight);
+	/* Restart the AI with the new settings.*/
+	AIController.Reset();
+
+	/* Reinitialize the simulation.*/
+	Simulation.Initialize(GetSimulationConfig(), PieceQueue->GetShapeTable());
 
 	/* Scale background according to block size.*/
 	BackgroundMesh->SetRelativeTransform(GetBackgroundTransform());
@@ -299,17 +529,64 @@ void ATetrisBoard::PostEditChangeProperty(FPropertyChangedEvent & PropertyChange
 void ATetrisBoard::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
+	TETRIS_SCOPE_CYCLE_COUNTER(BoardTick);
+
+	/* Recorded games are the only input while they play.*/
+	if (bIsReplaying)
+	{
+		QueuedActions.Reset();
+		TickReplay(DeltaSeconds);
+	}
+
+	/* Apply this frame's actions and take every simulation step that is due, then draw and notify once for all of them.
+	Input while the game is paused or over is dropped rather than played on resume.*/
+	bool bSimulationChanged = false;
+	if (bIsPlaying)
+	{
+		bSimulationChanged = !QueuedActions.IsEmpty();
+		Simulation.ApplyActions(QueuedActions);
+		QueuedActions.Reset();
+
+		/* Play the AI's plan once it arrives, from wherever the piece has got to. Taking it never waits for the search. A plan
+		that arrives while paused waits for the game to resume, as the board can't change in the meantime.*/
+		if (AIController && !bIsReplaying && AIController->ConsumePlan(Simulation, QueuedActions))
+		{
+			Simulation.ApplyActions(QueuedActions);
+			QueuedActions.Reset();
+			bSimulationChanged = true;
+		}
+
+		TETRIS_SCOPE_CYCLE_COUNTER(SimulationSteps);
+		const double StepTime = 1.0 / Simulation.GetConfig().TicksPerSecond;
+		StepAccumulator += DeltaSeconds;
+		int32 NumSteps = 0;
+		while (StepAccumulator >= StepTime && NumSteps < MaxStepsPerFrame && !Simulation.IsGameOver())
+		{
+			Simulation.Tick();
+			StepAccumulator -= StepTime;
+			++NumSteps;
+		}
+		StepAccumulator = NumSteps == MaxStepsPerFrame ? 0.0 : StepAccumulator;
+		INC_DWORD_STAT_BY(STAT_TetrisStepsTaken, NumSteps);
+		bSimulationChanged |= NumSteps > 0;
+	}
+	QueuedActions.Reset();
+	if (bSimulationChanged)
+	{
+		ProcessSimulationEvents();
+	}
 
 	if (!DebugMode) { return; }
 
 	/* Superimpose internal board state to board.*/
-	for (int i = 0; i < InternalBoard->GetWidth(); ++i)
+	const FBoardState& Board = Simulation.GetBoard();
+	for (int i = 0; i < Board.GetWidth(); ++i)
 	{
-		for (int j = 0; j < InternalBoard->GetHeight(); ++j)
+		for (int j = 0; j < Board.GetHeight(); ++j)
 		{
 			FIntPoint Coordinate = { i,j };
 			FVector BlockCenter = GetActorLocation() + GetActorRotation().RotateVector(GetBlockTransform(Coordinate).GetLocation());
-			FColor BlockColor = InternalBoard->IsOccupied(Coordinate) ? FColor::Green : FColor::Black;
+			FColor BlockColor = Board.IsOccupied(Coordinate) ? FColor::Green : FColor::Black;
 			DrawDebugPoint(GetWorld(), BlockCenter, 5, BlockColor, false);
 		}
 	}
@@ -318,36 +595,20 @@ void ATetrisBoard::Tick(float DeltaSeconds)
 
 int32 ATetrisBoard::GetScore() const
 {
-	return Score;
+	return Simulation.GetScore();
 }
 
 int32 ATetrisBoard::GetBoardLevel() const
 {
-	/* Using the Tetris guideline formula.*/
-	return FMath::Min( (LinesCleared / 10) + 1, 20);
+	return Simulation.GetLevel();
 }
 
 float ATetrisBoard::GetTickDelta() const
 {
-	/* Using the Tetris guideline formula.*/
-	int32 Level = GetBoardLevel();
-	return FMath::Pow((0.8 - ((Level - 1) * 0.007)), Level - 1);
+	return Simulation.GetTickDelta();
 }
 
 int32 ATetrisBoard::GetLinesNextLevel() const
 {
-	/* Using the Tetris guideline formula.*/
-	return GetBoardLevel() * 10;
-}
-
-void ATetrisBoard::HandleOnLockComplete()
-{
-	if (IsGameOver())
-	{
-		OnGameOver.Broadcast();
-		return;
-	}
-	/* Commit changes and continue play.*/
-	InternalBoard->Commit();
-	AddPiece();
+	return Simulation.GetLinesNextLevel();
 }
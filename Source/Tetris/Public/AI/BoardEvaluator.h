@@ -0,0 +1,113 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "BoardState.h"
+#include "PieceShape.h"
+#include "BoardEvaluator.generated.h"
+
+/* The features of a board that the AI scores.*/
+struct FBoardFeatures
+{
+	/* The sum of the column heights.*/
+	int32 AggregateHeight{ 0 };
+
+	/* The number of empty cells below the top of their column.*/
+	int32 Holes{ 0 };
+
+	/* The sum of the height differences between neighboring columns.*/
+	int32 Bumpiness{ 0 };
+
+	/* The sum of the depths of the columns lower than both neighbors, with the walls counted as high.*/
+	int32 Wells{ 0 };
+
+	/* The number of changes between filled and empty cells along every non-empty row, with the walls counted as filled.*/
+	int32 RowTransitions{ 0 };
+
+	/* The number of changes between filled and empty cells up every column, with the floor counted as filled.*/
+	int32 ColumnTransitions{ 0 };
+
+	/* The number of rows cleared by the placement that led to the board.*/
+	int32 LinesCleared{ 0 };
+
+	/* The number of filled cells, from which the holes are found.*/
+	int32 FilledCells{ 0 };
+};
+
+/* The weight of each feature in the score of a board. Higher scores are better.*/
+USTRUCT(BlueprintType)
+struct FBoardEvaluationWeights
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float AggregateHeight{ -0.51f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float Holes{ -0.36f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float Bumpiness{ -0.18f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float Wells{ -0.1f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float RowTransitions{ -0.1f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float ColumnTransitions{ -0.2f };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Board Evaluation")
+	float LinesCleared{ 0.76f };
+};
+
+/**
+ * Data asset for the weights of the AI's board evaluation.
+ */
+UCLASS(BlueprintType)
+class TETRIS_API UBoardEvaluatorWeights : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Board Evaluation")
+	FBoardEvaluationWeights Weights;
+};
+
+/**
+ * Scores boards, and the boards that placements of a piece would lead to, by a weighted sum of their features.
+ *
+ * The features of a board are measured once by scanning its row masks. The features after a placement are then
+ * updated from the rows and columns the piece touches, without modifying or copying the board. A placement that
+ * fills rows shifts the whole stack, so the rows that remain are scanned instead.
+ *
+ * Nothing is allocated and nothing is changed after construction, so one evaluator can be shared by every worker.
+ */
+class TETRIS_API FBoardEvaluator
+{
+public:
+	FBoardEvaluator() = default;
+	explicit FBoardEvaluator(const FBoardEvaluationWeights& InWeights);
+
+	/* Measure the features of a board.*/
+	static FBoardFeatures Measure(const FBoardState& Board);
+
+	/* Measure the features of the board after placing the piece at the location, which must be a valid placement.
+	 * The given features must be those of the board.*/
+	static FBoardFeatures MeasurePlacement(const FBoardState& Board, const FBoardFeatures& BoardFeatures, const FPieceShape& Piece, const FIntPoint& Coordinate);
+
+	/* Get the score of a board with the given features.*/
+	float Score(const FBoardFeatures& Features) const;
+
+	/* Get the score of the board after placing the piece at the location. The given features must be those of the board.*/
+	float ScorePlacement(const FBoardState& Board, const FBoardFeatures& BoardFeatures, const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+
+	/* Get the weights of the features.*/
+	const FBoardEvaluationWeights& GetWeights() const;
+
+private:
+	FBoardEvaluationWeights Weights;
+};
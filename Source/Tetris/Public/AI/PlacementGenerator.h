@@ -0,0 +1,106 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoardState.h"
+#include "PieceShape.h"
+#include "Core/TetrisActions.h"
+
+/* A final placement of a piece and the actions that reach it.*/
+struct FPiecePlacement
+{
+	/* The rotation the piece locks in.*/
+	const FPieceShape* Piece{ nullptr };
+
+	/* The location the piece locks at.*/
+	FIntPoint Coordinate{ 0, 0 };
+
+	/* The range of the actions of this placement in the generator's action buffer.*/
+	int32 FirstAction{ 0 };
+	int32 NumActions{ 0 };
+
+	/* True if the placement can't be reached by shifting, rotating and hard dropping alone, e.g. a tuck or a spin.*/
+	bool bNeedsSoftDrop{ false };
+};
+
+/**
+ * Finds every final placement a piece can reach on a board, with the actions that reach each one.
+ *
+ * The reachable locations are searched breadth first over (column, row, rotation), using the same moves as
+ * FTetrisSimulation::ApplyAction, so pieces that slide under overhangs or rotate into slots after dropping are found.
+ * A bitset marks the locations visited, and the board is only queried, never modified.
+ *
+ * Every path ends with a hard drop. Paths apply the actions as one batch, before gravity moves the piece again.
+ * Placements that cover the same cells with different rotations, e.g. the rotations of O, are reported once.
+ *
+ * The generator keeps its buffers between calls, so generating again for boards of the same size doesn't allocate.
+ * A generator must only be used by one thread at a time.
+ */
+class TETRIS_API FPlacementGenerator
+{
+public:
+	/* Find the placements of the piece from the given location, which must be a valid placement. Return the number found.*/
+	int32 Generate(const FBoardState& Board, const FPieceShape& Piece, const FIntPoint& Start);
+
+	/* Get the placements found by the last call to Generate, in the order they were reached.*/
+	TConstArrayView<FPiecePlacement> GetPlacements() const;
+
+	/* Get the actions that move the piece from the start location and lock it at the given placement.*/
+	TConstArrayView<EAction> GetPath(const FPiecePlacement& Placement) const;
+
+private:
+	/* A location of the piece reached by the search.*/
+	struct FNode
+	{
+		int16 X;
+		int16 Y;
+		uint8 Rotation;
+
+		/* The action that reached the location from the parent, repeated NumRepeats times.*/
+		uint8 Action;
+		uint16 NumRepeats;
+
+		/* The index of the node this one was reached from, or INDEX_NONE for the start.*/
+		int32 Parent;
+	};
+
+	/* The nodes in the order they were reached, which is also the order they are expanded in.*/
+	TArray<FNode> Nodes;
+
+	/* One bit per column for every rotation and row, set once the location is reached.*/
+	TArray<uint64> Visited;
+
+	/* One bit per column for every rotation and row of the distinct rotations, set once a placement covers the cells.*/
+	TArray<uint64> Placed;
+
+	/* The placements found.*/
+	TArray<FPiecePlacement> Placements;
+
+	/* The actions of every placement, stored back to back.*/
+	TArray<EAction> Actions;
+
+	/* The shape of each rotation of the piece being searched.*/
+	const FPieceShape* Rotations[FPieceShape::NumRotations] = {};
+
+	/* The rotation that covers the same cells as each rotation, with the lowest index.*/
+	int32 DistinctRotations[FPieceShape::NumRotations] = {};
+
+	/* The number of rows of the location bitsets.*/
+	int32 NumRows{ 0 };
+
+	/* Get the index of the bitset word of a location. Returns INDEX_NONE if the piece box is entirely off the grid.*/
+	int32 GetWordIndex(int32 Rotation, int32 Y) const;
+
+	/* Get the bit of a column in a bitset word.*/
+	static uint64 GetColumnBit(int32 X);
+
+	/* Reach a location from a node unless it was reached before or the piece doesn't fit there.*/
+	void Visit(const FBoardState& Board, int32 Rotation, int32 X, int32 Y, int32 Parent, EAction Action, int32 NumRepeats);
+
+	/* Visit the locations one shift or rotation away from a node and, if drops are allowed, the locations below it.*/
+	void Expand(const FBoardState& Board, int32 NodeIndex, bool bAllowDrops);
+
+	/* Record the placement of a node where the piece has landed, unless its cells are already covered by another.*/
+	void AddPlacement(int32 NodeIndex);
+};
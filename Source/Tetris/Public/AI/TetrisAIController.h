@@ -0,0 +1,115 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/TetrisSearch.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+
+/* The placement chosen by the AI for a piece, and the game it was chosen in.*/
+struct FTetrisAIPlan
+{
+	/* The number of the request the plan answers.*/
+	uint32 Serial{ 0 };
+
+	/* The hash of the board the plan was searched on.*/
+	uint64 BoardHash{ 0 };
+
+	/* The location of the piece when the plan was requested, which its path starts from.*/
+	const FPieceShape* StartPiece{ nullptr };
+	FIntPoint StartCoordinate{ 0, 0 };
+
+	/* The result of the search.*/
+	FTetrisSearchResult Result;
+
+	/* The time the search took in seconds.*/
+	double SearchSeconds{ 0.0 };
+};
+
+/**
+ * Plays a game with an FTetrisSearch run on a worker thread, so that a search never holds up a frame.
+ *
+ * When a piece spawns, the game thread hands a copy of the game to the worker through a lock-free queue. The worker
+ * searches the copy and hands the plan back through another queue, which the game thread polls each frame. The game
+ * thread only ever copies the game and, when a plan arrives, looks for one path, whatever the depth of the search.
+ *
+ * Requests are numbered. A new request or a cancel makes every earlier request stale, stopping its search early and
+ * discarding its plan. A plan that arrives after the board changed underneath it is discarded and requested again.
+ * If only the piece moved, e.g. by gravity while the plan was searched, the placement is reached from where it is now.
+ *
+ * The controller must be driven by one thread, normally the game thread.
+ */
+class TETRIS_API FTetrisAIController : public FRunnable
+{
+public:
+	explicit FTetrisAIController(const FBoardEvaluator& InEvaluator = FBoardEvaluator(), const FTetrisSearchSettings& InSettings = FTetrisSearchSettings());
+
+	/* Stop the search in flight and wait for the worker to finish.*/
+	virtual ~FTetrisAIController() override;
+
+	/* Request a plan for the piece in play, cancelling any earlier request. Without a worker thread, the plan is searched at once.*/
+	void RequestPlan(const FTetrisSimulation& Game);
+
+	/* Cancel the request in flight, e.g. when the game is reset.*/
+	void Cancel();
+
+	/* Append the actions that play the plan from the piece's current location, if it has arrived. Return false if there is no plan to play.*/
+	bool ConsumePlan(const FTetrisSimulation& Game, TArray<EAction>& OutActions);
+
+	/* Return true while a request is waiting for its plan.*/
+	bool IsPlanning() const;
+
+	/* Get the last plan played.*/
+	const FTetrisAIPlan& GetLastPlan() const;
+
+	/* Get the number of plans discarded as stale or no longer fitting the game.*/
+	int32 GetNumDiscarded() const;
+
+	/*** FRunnable overrides ***/
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/* A copy of the game to search, and the number of its request.*/
+	struct FPlanRequest
+	{
+		uint32 Serial{ 0 };
+		FTetrisSimulation Game;
+	};
+
+	/* The search, only run by the worker.*/
+	FTetrisSearch Search;
+
+	/* The generator that finds the path to a plan when the piece has moved, only used by the game thread.*/
+	FPlacementGenerator Generator;
+
+	/* The games handed to the worker, and the plans handed back.*/
+	TQueue<FPlanRequest, EQueueMode::Spsc> Requests;
+	TQueue<FTetrisAIPlan, EQueueMode::Spsc> Plans;
+
+	/* The number of the latest request. Any other request is stale.*/
+	std::atomic<uint32> LatestSerial{ 0 };
+
+	/* The number of the request waiting for its plan, or zero if there is none.*/
+	uint32 PendingSerial{ 0 };
+
+	FTetrisAIPlan LastPlan;
+	int32 NumDiscarded{ 0 };
+
+	/* The event that wakes the worker when there is a request.*/
+	FEvent* WakeEvent{ nullptr };
+
+	/* The worker thread, or null if the platform has no threads.*/
+	class FRunnableThread* Thread{ nullptr };
+
+	/* Flag set when the worker must finish.*/
+	std::atomic<bool> bStopping{ false };
+
+	/* Search a request and hand its plan back, unless it goes stale.*/
+	void Plan(const FPlanRequest& Request);
+
+	/* Discard a plan that can't be played.*/
+	void Discard();
+};
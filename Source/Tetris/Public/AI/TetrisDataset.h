@@ -0,0 +1,272 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/TetrisSearch.h"
+
+/* The policies that can choose the placements of a dataset.*/
+enum class ETetrisDatasetPolicy : uint8
+{
+	/* Any placement, with equal chance.*/
+	Random,
+	/* The placement the evaluator scores best.*/
+	Greedy,
+	/* The placement chosen by a beam search over the preview.*/
+	Search,
+};
+
+/**
+ * The index at the start of a dataset file, followed by its records.
+ *
+ * Every record has the same size, so record N starts at HeaderSize + N * RecordSize. Headers and records are padded to
+ * 8 bytes, so a mapped file can be read in place.
+ */
+struct FTetrisDatasetHeader
+{
+	/* The bytes "TDAT" read as a little-endian integer.*/
+	static constexpr uint32 Magic = 'T' | ('D' << 8) | ('A' << 16) | ('T' << 24);
+
+	/* The version written by this build. Files of other versions are rejected.*/
+	static constexpr uint16 CurrentVersion = 1;
+
+	/* The value of NumRecords until the file is finished. Readers then count the records from the file size.*/
+	static constexpr int64 Unfinished = -1;
+
+	uint32 FileMagic;
+	uint16 Version;
+
+	/* The offset of the first record.*/
+	uint16 HeaderSize;
+
+	/* The size of each record in bytes, including its rows.*/
+	uint32 RecordSize;
+
+	/* The number of rows of each record.*/
+	uint16 NumRows;
+
+	/* The width of the boards and the number of preview pieces of each record.*/
+	uint8 Width;
+	uint8 NumPreviewPieces;
+
+	/* The number of records in the file.*/
+	int64 NumRecords;
+
+	/* The shape table the games were played with, as in replays.*/
+	uint32 ShapeTableCrc;
+
+	/* The policy that chose the placements, as an ETetrisDatasetPolicy.*/
+	uint8 Policy;
+	uint8 Reserved0[3];
+
+	/* The producer that wrote the file, and the index of the file among its files.*/
+	int32 Producer;
+	int32 Chunk;
+
+	uint8 Reserved1[24];
+};
+
+/**
+ * The fixed part of a record of a dataset: a position, the placement the policy chose, and how the game went on.
+ * It is followed by the occupancy mask of each row of the board before the placement, bottom row first.
+ */
+struct FTetrisPositionRecord
+{
+	/* The maximum number of preview pieces a record holds.*/
+	static constexpr int32 MaxPreviewPieces = 8;
+
+	/* The most rows a board may have, top space included, so that every placement row fits in Y.*/
+	static constexpr int32 MaxRows = MAX_int8 + 1;
+
+	/* The Zobrist hash of the board before the placement.*/
+	uint64 BoardHash;
+
+	/* The seed of the game, and the number of pieces placed in it before this one.*/
+	int32 Seed;
+	int32 PieceIndex;
+
+	/* The score of the game before the placement.*/
+	int32 Score;
+
+	/* The score gained from this placement to the end of the game, including the placement.*/
+	int32 ScoreToGo;
+
+	/* The number of pieces placed from this placement to the end of the game, including the placement.*/
+	int32 PiecesToGo;
+
+	/* The type of the piece to place, and the rotation and location it was placed at.*/
+	uint8 PieceType;
+	uint8 Rotation;
+	int8 X;
+	int8 Y;
+
+	/* The number of lines the placement cleared.*/
+	uint8 LinesCleared;
+
+	/* 1 if the game ended by topping out, and 0 if it was cut off at the piece limit.*/
+	uint8 bGameOver;
+	uint8 Reserved[2];
+
+	/* The upcoming pieces after the piece to place, next piece first. Entries beyond the header's preview count are MAX_uint8.*/
+	uint8 Preview[MaxPreviewPieces];
+};
+
+/**
+ * A read-only view of a record in memory, e.g. in a mapped file. Nothing is copied.
+ */
+struct TETRIS_API FTetrisPositionView
+{
+public:
+	FTetrisPositionView() = default;
+	FTetrisPositionView(const uint8* InData, int32 InNumRows);
+
+	/* Get the fixed part of the record.*/
+	const FTetrisPositionRecord& GetRecord() const;
+
+	/* Get the occupancy mask of each row of the board, bottom row first.*/
+	TConstArrayView<uint32> GetRows() const;
+
+private:
+	const uint8* Data{ nullptr };
+	int32 NumRows{ 0 };
+};
+
+/**
+ * Writes the records of a single producer to a series of dataset files, starting a new file every given number of records.
+ * Nothing is shared with other writers, so every thread can write its own files without locking.
+ */
+class TETRIS_API FTetrisDatasetWriter
+{
+public:
+	~FTetrisDatasetWriter();
+
+	/* Get the size of a record of boards of the given height, padded to 8 bytes.*/
+	static int32 GetRecordSize(int32 NumRows);
+
+	/* Start writing files named <BaseFilename>-<Chunk>.tetrisdata with the given header. Return false if the first can't be opened.*/
+	bool Open(const FString& InBaseFilename, const FTetrisDatasetHeader& InHeader, int32 InRecordsPerChunk);
+
+	/* Write records of the header's record size. Return false if a file can't be opened.*/
+	bool Write(TConstArrayView<uint8> Records);
+
+	/* Finish the file being written.*/
+	void Close();
+
+	/* Get the files written so far.*/
+	const TArray<FString>& GetFilenames() const;
+
+	/* Get the number of records written.*/
+	int64 GetNumRecords() const;
+
+private:
+	FString BaseFilename;
+	FTetrisDatasetHeader Header;
+	int32 RecordsPerChunk{ 0 };
+	int64 NumRecords{ 0 };
+	TArray<FString> Filenames;
+
+	/* The file being written, and the number of records in it.*/
+	TUniquePtr<FArchive> Archive;
+	int32 NumChunkRecords{ 0 };
+
+	/* Start the next file.*/
+	bool OpenChunk();
+
+	/* Write the final header and close the file.*/
+	void CloseChunk();
+};
+
+/**
+ * A dataset file, mapped into memory so that records are read in place.
+ */
+class TETRIS_API FTetrisDatasetFile
+{
+public:
+	FTetrisDatasetFile();
+	~FTetrisDatasetFile();
+
+	/* Map the file. Return false if it can't be mapped or doesn't start with a valid header.*/
+	bool Open(const FString& Filename);
+
+	/* Unmap the file.*/
+	void Close();
+
+	/* Get the header of the file.*/
+	const FTetrisDatasetHeader& GetHeader() const;
+
+	/* Get the number of records in the file.*/
+	int64 Num() const;
+
+	/* Get a view of a record in the file.*/
+	FTetrisPositionView Get(int64 Index) const;
+
+private:
+	/* The mapped file and region, released in reverse order.*/
+	TUniquePtr<class IMappedFileHandle> Handle;
+	TUniquePtr<class IMappedFileRegion> Region;
+
+	int64 NumRecords{ 0 };
+};
+
+/* The settings of a dataset.*/
+struct FTetrisDatasetSettings
+{
+	/* The configuration of the games. Rows collapse as soon as they clear, as placements are played as actions.*/
+	FTetrisSimulationConfig Config;
+
+	/* The number of games to play. Game N is played with seed FirstSeed + N.*/
+	int32 NumGames{ 100 };
+	int32 FirstSeed{ 0 };
+
+	/* The number of pieces after which a game is cut off.*/
+	int32 MaxPiecesPerGame{ 1000 };
+
+	/* The policy that chooses the placements.*/
+	ETetrisDatasetPolicy Policy{ ETetrisDatasetPolicy::Greedy };
+
+	/* The chance of playing a random placement instead of the policy's, to reach positions the policy wouldn't.*/
+	float RandomPlacementChance{ 0.f };
+
+	/* The weights of the greedy and search policies.*/
+	FBoardEvaluationWeights Weights;
+
+	/* The settings of the search policy. Each producer searches on a single task.*/
+	FTetrisSearchSettings SearchSettings;
+
+	/* The number of preview pieces recorded with each position.*/
+	int32 NumPreviewPieces{ 5 };
+
+	/* The number of records in each file.*/
+	int32 RecordsPerChunk{ 1 << 20 };
+
+	/* The number of threads playing games, or zero for one per core.*/
+	int32 NumProducers{ 0 };
+
+	/* The directory the files are written to, and the start of their names.*/
+	FString OutputDirectory;
+	FString Name{ TEXT("Positions") };
+};
+
+/* The outcome of generating a dataset.*/
+struct FTetrisDatasetResult
+{
+	/* The files written.*/
+	TArray<FString> Filenames;
+
+	int64 NumRecords{ 0 };
+	int32 NumGames{ 0 };
+	double Seconds{ 0.0 };
+};
+
+/**
+ * Plays games with a policy on every core and records every placement to dataset files.
+ *
+ * Each producer thread claims games from a shared counter and writes the records of its games to files of its own, so
+ * producers never wait on each other. A game's records are kept until it ends, so that the outcome can be filled in.
+ */
+struct TETRIS_API FTetrisDatasetGenerator
+{
+public:
+	/* Play the games and write the files. Return false if a file couldn't be written.*/
+	static bool Generate(const FTetrisDatasetSettings& Settings, FTetrisDatasetResult& OutResult);
+};
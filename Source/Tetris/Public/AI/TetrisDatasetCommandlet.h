@@ -0,0 +1,29 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TetrisDatasetCommandlet.generated.h"
+
+/**
+ * Generates a dataset of positions by playing games on every core, e.g.
+ *
+ * UnrealEditor-Cmd Tetris.uproject -run=TetrisDataset -Games=10000 -Policy=Search -RandomChance=0.05
+ *
+ * Options: -Games=, -Seed= (of the first game), -MaxPieces= (per game), -Policy=Random|Greedy|Search, -RandomChance=,
+ * -Weights= (the path of a UBoardEvaluatorWeights asset), -Beam=, -SearchPreview=, -ThinkTime= (seconds per search),
+ * -Preview= (pieces recorded per position), -ChunkSize= (records per file), -Producers=, -Output= and -Name=.
+ * Files are written to Saved/Datasets unless -Output is given.
+ */
+UCLASS()
+class TETRIS_API UTetrisDatasetCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTetrisDatasetCommandlet();
+
+	/* UCommandlet overrides.*/
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,222 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AI/BoardEvaluator.h"
+#include "AI/PlacementGenerator.h"
+#include "AI/TranspositionTable.h"
+#include "Simulation/TetrisSimulation.h"
+#include <atomic>
+
+/* The settings of an AI search.*/
+struct FTetrisSearchSettings
+{
+	/* The number of boards kept at each depth of the search.*/
+	int32 BeamWidth{ 32 };
+
+	/* The number of upcoming pieces the AI is shown, searched after the current piece.*/
+	int32 NumPreviewPieces{ 5 };
+
+	/* Take the expectation over the piece after the preview, from the pieces left in its bag.*/
+	bool bExpectNextPiece{ true };
+
+	/* The time after which the search stops deepening and answers from the deepest depth it completed.*/
+	double TimeBudgetSeconds{ 0.01 };
+
+	/* The number of tasks each depth is split into, or zero for one per core.*/
+	int32 NumTasks{ 0 };
+
+	/* The number of entries of the transposition table, which is shared by the tasks and kept between searches. Zero disables it.*/
+	int32 TranspositionTableSize{ 1 << 16 };
+};
+
+/* The move chosen by a search.*/
+struct FTetrisSearchResult
+{
+	/* The placement of the current piece.*/
+	const FPieceShape* Piece{ nullptr };
+	FIntPoint Coordinate{ 0, 0 };
+
+	/* The actions that move the current piece from its location to the placement and lock it.*/
+	TArray<EAction> Actions;
+
+	/* The value of the best line of play found.*/
+	float Value{ 0.f };
+
+	/* The number of pieces searched, counting the current piece and the expected piece.*/
+	int32 Depth{ 0 };
+
+	/* The number of boards expanded.*/
+	int32 NumExpanded{ 0 };
+
+	/* The number of boards reached by more than one line of play, of which only the best line was kept.*/
+	int32 NumTranspositions{ 0 };
+
+	/* The number of boards whose best placement of the expected piece was found in the transposition table.*/
+	int32 NumTableHits{ 0 };
+
+	/* The number of boards not expanded, as the best placement found by an earlier search couldn't make the beam.*/
+	int32 NumSkipped{ 0 };
+
+	/* True if the search ran out of time before it searched every piece.*/
+	bool bTimedOut{ false };
+};
+
+/**
+ * Chooses the placement of the current piece by a beam search over the upcoming pieces.
+ *
+ * Every placement of the current piece is scored by the evaluator, then the best boards are kept and expanded with
+ * every placement of the next preview piece, and so on through the preview. The boards left are finally valued by the
+ * expectation over the piece after the preview, drawn from the pieces left in its bag. The current piece is placed
+ * where the best line of play starts.
+ *
+ * The boards of each depth are expanded in parallel on the task graph, each task on a board and placement generator
+ * of its own, so the searched game is only ever read. The search deepens until the time budget runs out, and then
+ * answers from the deepest depth it completed.
+ *
+ * Boards are identified by their Zobrist hash. Lines of play that reach the same board at the same depth are merged, and
+ * the best placement of each piece on each board is cached in a transposition table that outlives the search. The next
+ * search meets most of those boards again one depth earlier, so it reuses their expected values, and skips expanding the
+ * boards whose best placement can't make the beam.
+ *
+ * Buffers are kept between searches. A search must only be run by one thread at a time, though any thread may cancel it.
+ */
+class TETRIS_API FTetrisSearch
+{
+public:
+	explicit FTetrisSearch(const FBoardEvaluator& InEvaluator = FBoardEvaluator(), const FTetrisSearchSettings& InSettings = FTetrisSearchSettings());
+
+	/* Search for the best placement of the current piece of a game. Return false if the game has no piece in play.*/
+	bool Search(const FTetrisSimulation& Game, FTetrisSearchResult& OutResult);
+
+	/* Stop the search running on another thread, which then answers from the deepest depth it completed.*/
+	void Cancel();
+
+	/* Get the chance of each piece being drawn at the given index of a sequence, from the pieces left in its bag.*/
+	static void GetPieceChances(const FPieceSequence& Sequence, int32 Index, TArrayView<float> OutChances);
+
+	/* Get the settings of the search.*/
+	const FTetrisSearchSettings& GetSettings() const;
+
+private:
+	/* A board of the beam, reached by placing a piece on a board of the previous depth.*/
+	struct FSearchNode
+	{
+		/* The placement that leads to the board.*/
+		const FPieceShape* Piece;
+		FIntPoint Coordinate;
+
+		/* The index of the board of the previous depth it was placed on.*/
+		int32 Parent;
+
+		/* The index of the placement among the placements on the parent, to order equal boards.*/
+		int32 Order;
+
+		/* The index of the placement of the current piece that starts this line of play.*/
+		int32 RootMove;
+
+		/* The score of the lines cleared along the line of play.*/
+		float LineReward;
+
+		/* The value of the board.*/
+		float Value;
+
+		/* The hash of the board.*/
+		uint64 Hash;
+	};
+
+	/* The state of one task, reused by every depth.*/
+	struct FSearchTask
+	{
+		FBoardState Board;
+		FPlacementGenerator Generator;
+		TArray<int32> ClearedRows;
+
+		/* The boards found by the task at the current depth.*/
+		TArray<FSearchNode> Children;
+
+		/* The number of boards expanded by the task.*/
+		int32 NumExpanded{ 0 };
+
+		/* The number of table hits by the task.*/
+		int32 NumTableHits{ 0 };
+	};
+
+	/* The value of a line of play that ends the game.*/
+	static constexpr float GameOverValue = -1.e6f;
+
+	FBoardEvaluator Evaluator;
+	FTetrisSearchSettings Settings;
+
+	/* The placements of the current piece.*/
+	FPlacementGenerator RootGenerator;
+
+	/* The evaluations shared by the tasks, and kept from one search to the next.*/
+	FTranspositionTable TranspositionTable;
+
+	/* A board of the beam and the best value its children could have.*/
+	struct FBoundedNode
+	{
+		int32 NodeIndex;
+		float Bound;
+	};
+
+	/* The boards of the next depth while the beam is expanded.*/
+	TArray<FSearchNode> NextBeam;
+
+	/* The boards of the beam to expand next, and the boards bounded by the table.*/
+	TArray<int32> FirstNodes;
+	TArray<FBoundedNode> BoundedNodes;
+
+	/* The hashes of the boards kept while trimming the beam.*/
+	TSet<uint64> KeptHashes;
+
+	/* The number of lines of play merged while trimming the beam, and of boards skipped by their bound.*/
+	int32 NumTranspositions{ 0 };
+	int32 NumBoundedSkipped{ 0 };
+
+	/* The tasks, allocated separately so they never share a cache line.*/
+	TArray<TUniquePtr<FSearchTask>> Tasks;
+
+	/* The boards of the current depth, best first.*/
+	TArray<FSearchNode> Beam;
+
+	/* The rows of the boards the beam was placed on, and of the beam once it is expanded.*/
+	TArray<uint32> ParentRows;
+	TArray<uint32> NodeRows;
+
+	/* The game being searched.*/
+	TConstArrayView<FPieceShape> Shapes;
+	FIntPoint SpawnCoordinate{ 0, 0 };
+	int32 NumRows{ 0 };
+	int32 MaxStackHeight{ 0 };
+
+	/* The time the current search must end by, and whether it has run out.*/
+	double Deadline{ 0.0 };
+	std::atomic<bool> bTimedOut{ false };
+
+	/* Create the tasks and size their boards for the game.*/
+	void PrepareTasks(const FBoardState& Board);
+
+	/* Run the body for the given boards of the beam, spread over the tasks. Stops early if the time runs out.*/
+	void RunTasks(TConstArrayView<int32> Nodes, TFunctionRef<void(FSearchTask& /* Task */, int32 /* NodeIndex */)> Body);
+
+	/* Get the hash of the board left by locking a piece on the task's board. Placements that clear rows are played out and undone.*/
+	static uint64 GetLockedHash(FSearchTask& Task, const FPiecePlacement& Placement, int32 LinesCleared);
+
+	/* Build the board of a beam node on the task's board and save its rows. Return false if the placement ends the game.*/
+	bool LoadNode(FSearchTask& Task, int32 NodeIndex);
+
+	/* Replace the beam with the best boards reached by placing the piece type on it. Return false if there are none or the time ran out.*/
+	bool ExpandBeam(int32 Type);
+
+	/* Expand the given boards of the beam and merge their children into the next beam.*/
+	void ExpandNodes(TConstArrayView<int32> Nodes, TFunctionRef<void(FSearchTask& /* Task */, int32 /* NodeIndex */)> Expand);
+
+	/* Value the boards of the beam by the expectation over the given piece chances. Return false if the time ran out.*/
+	bool ExpectBeam(TConstArrayView<float> Chances);
+
+	/* Sort the boards best first and keep the best boards of a beam, once each.*/
+	void TrimBeam(TArray<FSearchNode>& Nodes);
+};
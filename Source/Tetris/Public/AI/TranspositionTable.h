@@ -0,0 +1,75 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/* A cached evaluation of a position.*/
+struct FTranspositionEntry
+{
+	/* The value of the position.*/
+	float Value{ 0.f };
+
+	/* The index of the best move from the position, or INDEX_NONE.*/
+	int32 BestMove{ INDEX_NONE };
+
+	/* How far the value looks ahead. Deeper entries are kept over shallower ones of the same generation.*/
+	int32 Depth{ 0 };
+
+	/* The generation the entry was stored in.*/
+	uint8 Generation{ 0 };
+};
+
+/**
+ * A fixed-size table of evaluations keyed by position hash, e.g. the Zobrist hash of a board, shared by every thread of a search.
+ *
+ * The table is lock-free. Each slot holds the packed entry and the key XORed with it, written as two relaxed atomic stores.
+ * A slot torn by concurrent writes no longer XORs back to its key, so a probe reads it as a miss rather than as a wrong entry.
+ * Collisions between keys overwrite each other, keeping the deeper entry or the entry of the current generation.
+ *
+ * Entries live on across searches. A new generation is started for each search so that old entries are replaced first.
+ */
+class TETRIS_API FTranspositionTable
+{
+public:
+	/* Allocate an empty table of the given number of entries, rounded down to a power of two.*/
+	void Initialize(int32 NumEntries);
+
+	/* Empty the table.*/
+	void Clear();
+
+	/* Start a new generation, e.g. for a new search.*/
+	void NewGeneration();
+
+	/* Get the current generation.*/
+	uint8 GetGeneration() const;
+
+	/* Get the number of entries the table can hold.*/
+	int32 GetNumEntries() const;
+
+	/* Look up the entry of a key. Return false if it isn't in the table.*/
+	bool Probe(uint64 Key, FTranspositionEntry& OutEntry) const;
+
+	/* Store the entry of a key in the current generation, unless its slot holds a deeper entry of another key.*/
+	void Store(uint64 Key, float Value, int32 BestMove, int32 Depth);
+
+private:
+	/* A slot of the table. An empty slot is all zero, which no entry packs to as generations start at one.*/
+	struct FSlot
+	{
+		std::atomic<uint64> Check{ 0 };
+		std::atomic<uint64> Data{ 0 };
+	};
+
+	TUniquePtr<FSlot[]> Slots;
+
+	/* The mask of the slot bits of a key.*/
+	uint64 IndexMask{ 0 };
+
+	uint8 Generation{ 1 };
+
+	/* Pack an entry into a single word, and unpack it.*/
+	static uint64 Pack(float Value, int32 BestMove, int32 Depth, uint8 InGeneration);
+	static FTranspositionEntry Unpack(uint64 Data);
+};
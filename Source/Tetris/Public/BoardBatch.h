@@ -0,0 +1,97 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoardState.h"
+
+/* The batch kernels use AVX2 when the target guarantees it, SSE2 on any other x86 target and plain integers elsewhere.*/
+#define TETRIS_BOARD_BATCH_AVX2 (PLATFORM_ALWAYS_HAS_AVX_2)
+#define TETRIS_BOARD_BATCH_SSE (!TETRIS_BOARD_BATCH_AVX2 && PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY)
+
+/**
+ * The occupancy of many boards of the same size, laid out for evaluating them together.
+ *
+ * Row masks are stored row-major across the batch, so the masks of one row of every board are contiguous. A piece
+ * placement is tested against a whole vector of boards with one load per piece row. Queries follow the semantics of
+ * FBoardState, which remains the reference for a single board.
+ */
+struct TETRIS_API FBoardBatch
+{
+public:
+	/* The number of boards processed together by the kernels.*/
+	static constexpr int32 LaneCount = TETRIS_BOARD_BATCH_AVX2 ? 8 : TETRIS_BOARD_BATCH_SSE ? 4 : 1;
+
+	/* Create the given number of empty boards.*/
+	void Initialize(int32 InNumBoards, int32 BoardWidth, int32 BoardHeight);
+
+	/* Copy the occupancy of a board into the batch. The board must have the dimensions of the batch.*/
+	void SetBoard(int32 BoardIndex, const FBoardState& Board);
+
+	/* Get the number of boards.*/
+	int32 Num() const;
+
+	/* Get the width of the boards.*/
+	int32 GetWidth() const;
+
+	/* Get the height of the boards.*/
+	int32 GetHeight() const;
+
+	/* Get the occupancy mask of a row of a board.*/
+	uint32 GetRowMask(int32 BoardIndex, int32 Row) const;
+
+	/* Return true if the row of the board is full.*/
+	bool IsRowFull(int32 BoardIndex, int32 Row) const;
+
+	/* Get the height of the stack of a board.*/
+	int32 GetStackHeight(int32 BoardIndex) const;
+
+	/* Return true if the full body of the piece fits on the board at the location.*/
+	bool CanPlace(int32 BoardIndex, const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+
+	/* Place a piece on a board. The board is only modified if the placement is valid.*/
+	EPlaceResult Place(int32 BoardIndex, const FPieceShape& Piece, const FIntPoint& Coordinate);
+
+	/* Test one placement against every board. OutFits must hold one entry per board.*/
+	void CanPlaceAll(const FPieceShape& Piece, const FIntPoint& Coordinate, TArrayView<bool> OutFits) const;
+
+	/**
+	 * Find the columns where the piece fits at the given row, for every board. OutColumns must hold one mask per board.
+	 * Bit N is set when the piece fits with the leftmost column of its body in board column N, i.e. at X = N - Piece.MinX.
+	 */
+	void GetFittingColumnsAll(const FPieceShape& Piece, int32 Y, TArrayView<uint32> OutColumns) const;
+
+	/* Find the columns where the piece fits at the given row of one board, with the same bit layout as GetFittingColumnsAll.*/
+	uint32 GetFittingColumns(int32 BoardIndex, const FPieceShape& Piece, int32 Y) const;
+
+	/* Find the full rows of every board, with bit N set when row N is full. The boards must be at most 64 rows high.*/
+	void GetFullRowsAll(TArrayView<uint64> OutFullRows) const;
+
+	/* Get the stack height of every board. OutHeights must hold one entry per board.*/
+	void GetStackHeightsAll(TArrayView<uint8> OutHeights) const;
+
+	/* Get the height of every column of every board. OutHeights holds the columns of each board in turn.*/
+	void GetColumnHeightsAll(TArrayView<uint8> OutHeights) const;
+
+private:
+	/* The row masks, with row N of board B at N * Stride + B.*/
+	TArray<uint32> Rows;
+
+	/* The number of boards.*/
+	int32 NumBoards{ 0 };
+
+	/* The number of boards rounded up to the widest lane count, so that vector loads never leave a row.*/
+	int32 Stride{ 0 };
+
+	/* The width of the boards.*/
+	int32 Width{ 0 };
+
+	/* The height of the boards.*/
+	int32 Height{ 0 };
+
+	/* The mask with a bit set for every column of the board.*/
+	uint32 FullRowMask{ 0 };
+
+	/* Return true if the bounding box of the piece lies inside the boards.*/
+	bool IsInBounds(const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+};
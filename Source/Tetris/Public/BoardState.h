@@ -0,0 +1,167 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PieceShape.h"
+#include "BoardState.generated.h"
+
+/* The result of an attempted piece placement.*/
+UENUM()
+enum EPlaceResult
+{
+	OK	UMETA(DisplayName = "Ok"),
+	BAD	UMETA(DisplayName = "Bad"),
+};
+
+/* A change to a single row of the board, recorded so that it can be rolled back.*/
+struct FBoardJournalEntry
+{
+	/* The row that was changed.*/
+	int32 Row;
+
+	/* The occupancy mask of the row before the change.*/
+	uint32 PreviousMask;
+};
+
+/**
+ * The occupancy of a Tetris board, free of any UObject so that it can be owned and stepped on any thread.
+ * 
+ * Occupancy is stored as one bitmask per row in a single contiguous buffer, with bit N set when column N is occupied.
+ * Every change since the last commit is recorded in a journal of row deltas so it can be rolled back without copying the grid.
+ * The height of each column and of the stack are kept up to date as rows change, so they never need to be scanned for.
+ * A Zobrist hash of the occupied cells is kept up to date the same way, so equal boards can be found without comparing grids.
+ */
+struct TETRIS_API FBoardState
+{
+public:
+	/* Get the width of the grid.*/
+	int32 GetWidth() const;
+
+	/* Get the height of the grid.*/
+	int32 GetHeight() const;
+
+	/* Return true if the given cell is occupied.*/
+	bool IsOccupied(const FIntPoint& Coordinate) const;
+
+	/* Return true if the full body of the piece fits on the board at the location. Doesn't modify the board.*/
+	bool CanPlace(const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+
+	/* Get the row where the piece lands if it is dropped straight down from the location, which must be a valid placement.*/
+	int32 GetDropRow(const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+
+	/* Return true if a placed piece can be moved to the new placement, ignoring the cells it currently occupies. Doesn't modify the board.*/
+	bool CanMove(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate) const;
+
+	/* Query a placement of the given piece at the location. The board is only modified if the placement is valid.*/
+	EPlaceResult Place(const FPieceShape& Piece, const FIntPoint& Coordinate);
+
+	/* Move a placed piece to a new placement. The board is only modified if the move is valid.*/
+	EPlaceResult Move(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate);
+
+	/* Fill in any cleared rows.*/
+	void Collapse();
+
+	/* Clear filled rows and return their IDs.*/
+	bool ClearRows(TArray<int32>& ClearedRows);
+
+	/* Clear filled rows in the given inclusive range, e.g. the rows of a piece that was just placed, and return their IDs.*/
+	bool ClearRows(TArray<int32>& ClearedRows, int32 FirstRow, int32 LastRow);
+
+	/* Return true if the given row is full.*/
+	bool IsRowFull(int32 Row) const;
+
+	/* Get the occupancy mask of the given row. Bit N is set when column N is occupied.*/
+	uint32 GetRowMask(int32 Row) const;
+
+	/* Get the number of occupied cells in the given row.*/
+	int32 GetRowFillCount(int32 Row) const;
+
+	/* Get the mask of a full row.*/
+	uint32 GetFullRowMask() const;
+
+	/* Empty the given row.*/
+	void EmptyRow(int32 Row);
+
+	/* Set the occupancy of the given row, e.g. to restore a saved board. Columns outside the board are ignored.*/
+	void SetRowMask(int32 Row, uint32 Mask);
+
+	/* Initialize an empty grid.*/
+	void Initialize(int32 BoardWidth, int32 BoardHeight);
+
+	/* Undo the grid to the state at the start of the current undo level, or the last commit if there is none.*/
+	void Undo();
+
+	/* Commit the current board state as the backup. Discards the journal and all undo levels.*/
+	void Commit();
+
+	/* Start a new undo level for speculative changes and return the resulting depth.*/
+	int32 PushUndoLevel();
+
+	/* Undo the changes made in the current undo level and discard it.*/
+	void PopUndoLevel();
+
+	/* Get the number of open undo levels.*/
+	int32 GetUndoDepth() const;
+
+	/* Get the height of the stack (i.e. the pieces in the well)*/
+	int32 GetStackHeight() const;
+
+	/* Get the height of the given column, i.e. the row above its highest occupied cell.*/
+	int32 GetColumnHeight(int32 Col) const;
+
+	/* Get the height of every column.*/
+	TConstArrayView<int32> GetColumnHeights() const;
+
+	/* Get the Zobrist hash of the occupied cells. Boards with the same cells occupied have the same hash.*/
+	uint64 GetHash() const;
+
+	/* Get the random key of a cell, which is mixed into the hash while the cell is occupied.*/
+	static uint64 GetCellKey(int32 Row, int32 Col);
+
+	/* Get the keys of the cells a piece would occupy at the location, i.e. the change to the hash if it was placed there.*/
+	static uint64 GetPieceKey(const FPieceShape& Piece, const FIntPoint& Coordinate);
+
+	/* The maximum supported board width, i.e. the number of bits in a row mask.*/
+	static constexpr int32 MaxWidth = 32;
+
+private:
+	/* The occupancy mask of each row, from the bottom row up.*/
+	TArray<uint32> Rows;
+
+	/* The row changes made since the last commit, in order.*/
+	TArray<FBoardJournalEntry> Journal;
+
+	/* The journal length at the start of each open undo level.*/
+	TArray<int32> UndoLevels;
+
+	/* The width of the board.*/
+	int32 Width{ 0 };
+
+	/* The mask with a bit set for every column of the board.*/
+	uint32 FullRowMask{ 0 };
+
+	/* The height of the stack.*/
+	int32 StackHeight{ 0 };
+
+	/* The height of each column.*/
+	int32 ColumnHeights[MaxWidth] = {};
+
+	/* The Zobrist hash of the occupied cells.*/
+	uint64 Hash{ 0 };
+
+	/* Get the keys of the cells set in a row mask.*/
+	static uint64 GetRowKey(int32 Row, uint32 Mask);
+
+	/* Return true if the bounding box of the piece lies inside the board.*/
+	bool IsInBounds(const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+
+	/* Set the occupancy mask of a row, recording the change in the journal.*/
+	void SetRow(int32 Row, uint32 Mask);
+
+	/* Set the occupancy mask of a row and update the heights.*/
+	void WriteRow(int32 Row, uint32 Mask);
+
+	/* Roll back the journal to the given length.*/
+	void RollBack(int32 JournalLength);
+};
@@ -0,0 +1,18 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TetrisActions.generated.h"
+
+/* Board actions.*/
+UENUM(BlueprintType)
+enum EAction
+{
+	LEFT,
+	RIGHT,
+	DOWN,
+	ROTATE_R,
+	ROTATE_L,
+	HARD_DROP,
+};
@@ -0,0 +1,58 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+/**
+ * Profiling of Tetris gameplay.
+ *
+ * Gameplay scopes are timed in the Tetris stat group ("stat Tetris") and traced on the Tetris channel of Unreal Insights,
+ * which is enabled with -trace=default,Tetris or "Trace.Enable Tetris" at runtime. The channel is available in builds
+ * without stats, so boards can be profiled in production. Both cost a single branch while they aren't collected.
+ *
+ * The board operations of FBoardState and UInternalBoard aren't timed themselves, as searches and batches call them far
+ * too often, and they are covered by the benchmarks instead. Their calls from the simulation are timed.
+ */
+
+UE_TRACE_CHANNEL_EXTERN(TetrisChannel, TETRIS_API);
+
+DECLARE_STATS_GROUP(TEXT("Tetris"), STATGROUP_Tetris, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place"), STAT_TetrisPlace, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Clear Rows"), STAT_TetrisClearRows, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collapse"), STAT_TetrisCollapse, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Lock Piece"), STAT_TetrisLockPiece, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update"), STAT_TetrisUpdate, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Board Tick"), STAT_TetrisBoardTick, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulation Steps"), STAT_TetrisSimulationSteps, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Replay Tick"), STAT_TetrisReplayTick, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Process Events"), STAT_TetrisProcessEvents, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Draw"), STAT_TetrisDraw, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Draw Active Piece"), STAT_TetrisDrawActivePiece, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HUD Update"), STAT_TetrisHUDUpdate, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AI Handoff"), STAT_TetrisAIHandoff, STATGROUP_Tetris, TETRIS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AI Search"), STAT_TetrisAISearch, STATGROUP_Tetris, TETRIS_API);
+
+/* Counts per frame.*/
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Simulation Steps Taken"), STAT_TetrisStepsTaken, STATGROUP_Tetris, TETRIS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected Moves"), STAT_TetrisRejectedMoves, STATGROUP_Tetris, TETRIS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected Placements"), STAT_TetrisRejectedPlacements, STATGROUP_Tetris, TETRIS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Instances Updated"), STAT_TetrisInstancesUpdated, STATGROUP_Tetris, TETRIS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Instances Rebuilt"), STAT_TetrisInstancesRebuilt, STATGROUP_Tetris, TETRIS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("AI Plans Discarded"), STAT_TetrisAIPlansDiscarded, STATGROUP_Tetris, TETRIS_API);
+
+/* Diagnostics of the board, such as rejected placements. Verbose messages are compiled out of shipping builds.*/
+#if UE_BUILD_SHIPPING
+DECLARE_LOG_CATEGORY_EXTERN(LogTetrisBoard, Warning, Warning);
+#else
+DECLARE_LOG_CATEGORY_EXTERN(LogTetrisBoard, Warning, All);
+#endif
+
+/* Time the enclosing scope with a Tetris stat, and trace it on the Tetris channel under the name "Tetris.<Name>".*/
+#define TETRIS_SCOPE_CYCLE_COUNTER(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_Tetris##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR("Tetris." #Name, TetrisChannel)
@@ -4,18 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "Core/TetrisDelegates.h"
+#include "BoardState.h"
 #include "InternalBoard.generated.h"
 
-/* The result of an attempted piece placement.*/
-UENUM()
-enum EPlaceResult
-{
-	OK	UMETA(DisplayName = "Ok"),
-	BAD	UMETA(DisplayName = "Bad"),
-};
-
 /**
  * The internal representation of the Tetris board.
+ * 
+ * Wraps an FBoardState so that the board can be created and inspected from Blueprint.
  */
 UCLASS()
 class TETRIS_API UInternalBoard : public UObject
@@ -43,8 +38,17 @@ public:
 	/* Return true if the given cell is occupied.*/
 	bool IsOccupied(const FIntPoint& Coordinate) const;
 
-	/* Query a placement of the given piece at the location.*/
-	EPlaceResult Place(const class UPiece* Piece, const FIntPoint& Coordinate);
+	/* Return true if the full body of the piece fits on the board at the location. Doesn't modify the board.*/
+	bool CanPlace(const FPieceShape& Piece, const FIntPoint& Coordinate) const;
+
+	/* Return true if a placed piece can be moved to the new placement, ignoring the cells it currently occupies. Doesn't modify the board.*/
+	bool CanMove(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate) const;
+
+	/* Query a placement of the given piece at the location. The board is only modified if the placement is valid.*/
+	EPlaceResult Place(const FPieceShape& Piece, const FIntPoint& Coordinate);
+
+	/* Move a placed piece to a new placement. The board is only modified if the move is valid.*/
+	EPlaceResult Move(const FPieceShape& FromPiece, const FIntPoint& FromCoordinate, const FPieceShape& ToPiece, const FIntPoint& ToCoordinate);
 
 	/* Fill in any cleared rows.*/
 	UFUNCTION(BlueprintCallable, Category = "Board")
@@ -57,6 +61,12 @@ public:
 	/* Return true if the given row is full.*/
 	bool IsRowFull(int32 Row) const;
 
+	/* Get the occupancy mask of the given row. Bit N is set when column N is occupied.*/
+	uint32 GetRowMask(int32 Row) const;
+
+	/* Get the mask of a full row.*/
+	uint32 GetFullRowMask() const;
+
 	/* Empty the given row.*/
 	UFUNCTION(BlueprintCallable, Category = "Board")
 	void EmptyRow(int32 Row);
@@ -65,27 +75,39 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Board")
 	void Initialize(int BoardWidth, int BoardHeight);
 
-	/* Undo the grid to its previous state.*/
+	/* Undo the grid to the state at the start of the current undo level, or the last commit if there is none.*/
 	void Undo();
 
-	/* Commit the current board state as the backup.*/
+	/* Commit the current board state as the backup. Discards the journal and all undo levels.*/
 	UFUNCTION(BlueprintCallable, Category = "Board")
 	void Commit();
 
+	/* Start a new undo level for speculative changes and return the resulting depth.*/
+	int32 PushUndoLevel();
+
+	/* Undo the changes made in the current undo level and discard it.*/
+	void PopUndoLevel();
+
+	/* Get the number of open undo levels.*/
+	int32 GetUndoDepth() const;
+
 	/* Get the height of the stack (i.e. the pieces in the well)*/
 	UFUNCTION(BlueprintCallable, Category = "Board")
 	int32 GetStackHeight() const;
 
+	/* Get the Zobrist hash of the occupied cells. Boards with the same cells occupied have the same hash.*/
+	uint64 GetHash() const;
+
 	/* Delegate broadcast when rows are filled after committing a board.*/
 	FOnRowsFilledSignature OnRowsFilled;
 
-private:
-	/* The occupancy state of the board*/
-	TArray<TArray<bool>> Grid;
+	/* The maximum supported board width, i.e. the number of bits in a row mask.*/
+	static constexpr int32 MaxWidth = FBoardState::MaxWidth;
 
-	/* The previous state of the board.*/
-	TArray<TArray<bool>> PreviousGrid;
+	/* Get the underlying board state.*/
+	const FBoardState& GetState() const;
 
-	/* Get the stack height of the column.*/
-	int32 GetStackHeight(int32 Column) const;
+private:
+	/* The state of the board.*/
+	FBoardState State;
 };
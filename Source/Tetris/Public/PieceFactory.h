@@ -4,7 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
-#include "Piece.h"
+#include "PieceShape.h"
 #include "PieceData.h"
 #include "PieceFactory.generated.h"
 
@@ -16,15 +16,10 @@ class TETRIS_API UPieceFactory : public UObject
 {
 	GENERATED_BODY()
 public:
-	/* Build the tetris piece according to the piece data.*/
-	UFUNCTION()
-	UPiece* Build(const FPieceData& PieceData);
+	/* Build the rotations of the tetris piece according to the piece data and append them to the shape table. Returns false if the piece doesn't fit the piece box.*/
+	bool Build(const FPieceData& PieceData, TArray<FPieceShape>& OutShapes) const;
 
 protected:
 	/* Calculate the R-rotation of the given body points.*/
 	TArray<FIntPoint> CalculateRotation(const TArray<FIntPoint>& Points, const FVector2D& RotationOrigin) const;
-
-	/* Calculate the skirt of the given body points.*/
-	TArray<FIntPoint> CalculateSkirt(const TArray<FIntPoint>& Points) const;
-
 };
@@ -4,9 +4,14 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "PieceShape.h"
+#include "PieceSequence.h"
 #include "PieceQueue.generated.h"
 
-
+/**
+ * The pieces of the board's game: builds the shape table from a data table, chooses the seed of each game, and previews the
+ * upcoming pieces of the sequence the board's simulation plays. The queue holds no sequence of its own.
+ */
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class TETRIS_API UPieceQueue : public UActorComponent
 {
@@ -15,32 +20,48 @@ class TETRIS_API UPieceQueue : public UActorComponent
 public:	
 	UPieceQueue();
 
-	/* Add a random batch of pieces into the queue.*/
-	UFUNCTION()
-	void AddBatch();
+	/* Set the sequence to preview. It must outlive the queue, or be cleared first.*/
+	void SetSequence(const FPieceSequence* InSequence);
+
+	/* Return the next piece of the sequence, or null if there is none.*/
+	const FPieceShape* Top() const;
+
+	/* Get a view of the types of the next N pieces in the queue. Use GetPieceShape to look up their shapes.*/
+	TConstArrayView<uint8> PeekN(int32 N) const;
+
+	/* Get the spawn rotation of the piece with the given type.*/
+	const FPieceShape* GetPieceShape(uint8 Type) const;
+
+	/* Get the shape table of the pieces in this queue.*/
+	TConstArrayView<FPieceShape> GetShapeTable() const;
 
-	/* Pop the next piece from the queue.*/
-	UFUNCTION()
-	const UPiece* Pop();
+	/* Get the seed of the sequence being previewed, or the configured seed if there is none.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
+	int32 GetSeed() const;
 
-	/* Return a reference to the top piece in the queue.*/
-	UFUNCTION()
-	const UPiece* Top() const;
+	/* Get the configured seed, or a random one if none is set.*/
+	int32 MakeSeed() const;
 
 protected:
 	virtual void BeginPlay() override;
 
-	/* The Tetris pieces.*/
-	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Tetris Board")
-	TArray<class UPiece*> Pieces;
-
-	/* The datatable used to create pieces.*/
+	/* The datatable used to create pieces. The standard pieces are used if this isn't set.*/
 	UPROPERTY(EditAnywhere, Category = "Tetris Board")
 	UDataTable* PieceDataTable;
 
-	/* The queue of upcoming pieces.*/
-	TQueue<const class UPiece*> Queue;
+	/* The seed used to shuffle the pieces. A random seed is chosen if this is zero.*/
+	UPROPERTY(EditAnywhere, Category = "Tetris Board")
+	int32 Seed{ 0 };
+
+	/* The shapes built from the data table, with the rotations of each piece stored contiguously.*/
+	TArray<FPieceShape> DataTableShapes;
+
+	/* The shape table in use, either the data table shapes or the standard shapes.*/
+	TConstArrayView<FPieceShape> ShapeTable;
+
+	/* The sequence of upcoming pieces, owned by the simulation that plays it.*/
+	const FPieceSequence* Sequence{ nullptr };
 
-	/* The size of the queue.*/
-	int32 QueueSize{ 0 };
+	/* Get the number of distinct pieces.*/
+	int32 GetNumPieces() const;
 };
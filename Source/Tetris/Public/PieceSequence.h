@@ -0,0 +1,88 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* The complete state of a piece sequence, for saving and restoring it.*/
+struct FPieceSequenceState
+{
+	/* The seed the sequence was initialized with.*/
+	int32 Seed;
+
+	/* The current seed of the random stream shuffling the bags.*/
+	int32 RandomSeed;
+
+	/* The number of pieces in a bag.*/
+	uint8 BagSize;
+
+	/* The number of queued pieces.*/
+	uint8 Count;
+
+	/* The queued pieces, next piece first.*/
+	uint8 Pieces[32];
+};
+
+/**
+ * A fixed-capacity ring buffer of upcoming pieces, refilled one shuffled bag at a time from its own random stream.
+ *
+ * Pieces are stored as indices into a shape table. Every entry is mirrored one capacity further along the buffer, so any
+ * run of upcoming pieces can be read as a single contiguous view without copying.
+ */
+struct TETRIS_API FPieceSequence
+{
+	/* The number of pieces the buffer can hold. Must be a power of two.*/
+	static constexpr int32 Capacity = 32;
+
+	/* The largest supported bag, such that two bags plus a refill always fit in the buffer.*/
+	static constexpr int32 MaxBagSize = 10;
+
+	/* Empty the sequence and fill it with bags of the given number of pieces, shuffled by the given seed.*/
+	void Initialize(int32 InBagSize, int32 Seed);
+
+	/* Pop the next piece from the sequence.*/
+	uint8 Pop();
+
+	/* Get the next piece in the sequence.*/
+	uint8 Top() const;
+
+	/* Get a view of the next N pieces in the sequence, or of every queued piece if there are fewer.*/
+	TConstArrayView<uint8> PeekN(int32 N) const;
+
+	/* Get the number of queued pieces.*/
+	int32 Num() const;
+
+	/* Get the number of pieces in a bag.*/
+	int32 GetBagSize() const;
+
+	/* Get the seed the sequence was initialized with.*/
+	int32 GetSeed() const;
+
+	/* Add a shuffled bag of every piece to the end of the sequence. Return false and leave the sequence unchanged if the bag doesn't fit.*/
+	bool AddBag();
+
+	/* Save the queued pieces and the random state.*/
+	void GetState(FPieceSequenceState& OutState) const;
+
+	/* Restore a saved state. Return false and leave the sequence unchanged if the state is invalid.*/
+	bool SetState(const FPieceSequenceState& State);
+
+private:
+	/* The queued pieces, mirrored into the second half of the buffer.*/
+	uint8 Buffer[2 * Capacity] = {};
+
+	/* The buffer index of the next piece.*/
+	int32 Head{ 0 };
+
+	/* The number of queued pieces.*/
+	int32 Count{ 0 };
+
+	/* The number of pieces in a bag.*/
+	int32 BagSize{ 0 };
+
+	/* The seed the sequence was initialized with, kept apart from the random stream so that it survives a restore.*/
+	int32 Seed{ 0 };
+
+	/* The random stream used to shuffle the bags.*/
+	FRandomStream RandomStream;
+};
@@ -0,0 +1,157 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * An immutable rotation of a Tetris piece.
+ *
+ * The body is stored as one bitmask per row of a square piece box, with bit N set when column N is part of the body.
+ * The four rotations of a piece are stored contiguously in clockwise order, so rotating never leaves the table.
+ */
+struct TETRIS_API FPieceShape
+{
+	/* The width and height of the piece box in cells.*/
+	static constexpr int32 BoxSize = 4;
+
+	/* The number of rotations of each piece.*/
+	static constexpr int32 NumRotations = 4;
+
+	/* The body occupancy of each row of the piece box.*/
+	uint8 RowMasks[BoxSize];
+
+	/* The lowest body row of each column of the piece box, or INDEX_NONE if the column is empty.*/
+	int8 Skirt[BoxSize];
+
+	/* The inclusive bounding box of the body in piece space.*/
+	int8 MinX;
+	int8 MinY;
+	int8 MaxX;
+	int8 MaxY;
+
+	/* The index of the piece in its shape table.*/
+	uint8 Type;
+
+	/* The number of clockwise rotations from the spawn rotation.*/
+	uint8 Rotation;
+
+	/* Get the shape obtained from a clockwise rotation of this shape.*/
+	const FPieceShape& RotateR() const
+	{
+		return *(this - Rotation + (Rotation + 1) % NumRotations);
+	}
+
+	/* Get the shape obtained from a counter-clockwise rotation of this shape.*/
+	const FPieceShape& RotateL() const
+	{
+		return *(this - Rotation + (Rotation + NumRotations - 1) % NumRotations);
+	}
+
+	/* Get the body mask of the given piece row, shifted so that the piece box starts at the given board column.*/
+	uint32 GetRowMask(int32 Row, int32 Column) const
+	{
+		return Column >= 0 ? uint32(RowMasks[Row]) << Column : uint32(RowMasks[Row]) >> -Column;
+	}
+
+	/* Get the coordinates of the body in piece space.*/
+	TArray<FIntPoint> GetBody() const;
+
+	/* Get the coordinates of the skirt in piece space.*/
+	TArray<FIntPoint> GetSkirt() const;
+
+	/* Build a shape from the body occupancy of each row of the piece box.*/
+	static constexpr FPieceShape Make(const uint8 (&InRowMasks)[BoxSize], uint8 InType, uint8 InRotation)
+	{
+		FPieceShape Shape{ {}, {}, BoxSize, BoxSize, -1, -1, InType, InRotation };
+		for (int32 Col = 0; Col < BoxSize; ++Col)
+		{
+			Shape.Skirt[Col] = INDEX_NONE;
+		}
+
+		/* Rows are visited from the bottom up, so the first body cell found in a column is its skirt.*/
+		for (int32 Row = 0; Row < BoxSize; ++Row)
+		{
+			Shape.RowMasks[Row] = InRowMasks[Row];
+			for (int32 Col = 0; Col < BoxSize; ++Col)
+			{
+				if (!(InRowMasks[Row] & (1 << Col))) { continue; }
+				if (Shape.Skirt[Col] == INDEX_NONE) { Shape.Skirt[Col] = int8(Row); }
+				Shape.MinX = Col < Shape.MinX ? int8(Col) : Shape.MinX;
+				Shape.MaxX = Col > Shape.MaxX ? int8(Col) : Shape.MaxX;
+				Shape.MinY = Row < Shape.MinY ? int8(Row) : Shape.MinY;
+				Shape.MaxY = Row > Shape.MaxY ? int8(Row) : Shape.MaxY;
+			}
+		}
+		return Shape;
+	}
+
+	/* Apply an R-rotation (clockwise 90 degrees) to a point about an origin given in half cells, rounding halves up.*/
+	static constexpr void RotatePointR(int32& X, int32& Y, int32 OriginX2, int32 OriginY2)
+	{
+		/* Working in half cells keeps origins between cells exact.*/
+		const int32 RotatedX2 = 2 * Y - OriginY2 + OriginX2 + 1;
+		const int32 RotatedY2 = -2 * X + OriginX2 + OriginY2 + 1;
+		X = (RotatedX2 >= 0 ? RotatedX2 : RotatedX2 - 1) / 2;
+		Y = (RotatedY2 >= 0 ? RotatedY2 : RotatedY2 - 1) / 2;
+	}
+};
+
+/**
+ * The rotations of the seven standard tetrominoes, built at compile time.
+ *
+ * Pieces are ordered I, O, T, S, Z, J, L. Each spawns lying flat in the upper rows of its piece box.
+ */
+struct FStandardPieceShapes
+{
+	/* The number of standard pieces.*/
+	static constexpr int32 NumPieces = 7;
+
+	/* The shapes, with the rotations of each piece stored contiguously.*/
+	FPieceShape Shapes[NumPieces * FPieceShape::NumRotations];
+
+	/* Get the shape table.*/
+	static TConstArrayView<FPieceShape> Get();
+
+	/* Build the table.*/
+	static constexpr FStandardPieceShapes Build()
+	{
+		/* The spawn body and rotation origin (in half cells) of each piece.*/
+		constexpr int32 Bodies[NumPieces][4][2] = {
+			{ {0,2}, {1,2}, {2,2}, {3,2} },
+			{ {1,1}, {1,2}, {2,1}, {2,2} },
+			{ {0,1}, {1,1}, {2,1}, {1,2} },
+			{ {0,1}, {1,1}, {1,2}, {2,2} },
+			{ {0,2}, {1,2}, {1,1}, {2,1} },
+			{ {0,2}, {0,1}, {1,1}, {2,1} },
+			{ {2,2}, {0,1}, {1,1}, {2,1} },
+		};
+		constexpr int32 Origins[NumPieces][2] = { {3,3}, {3,3}, {2,2}, {2,2}, {2,2}, {2,2}, {2,2} };
+
+		FStandardPieceShapes Table{};
+		for (int32 Piece = 0; Piece < NumPieces; ++Piece)
+		{
+			int32 Body[4][2] = {};
+			for (int32 i = 0; i < 4; ++i)
+			{
+				Body[i][0] = Bodies[Piece][i][0];
+				Body[i][1] = Bodies[Piece][i][1];
+			}
+
+			for (int32 Rotation = 0; Rotation < FPieceShape::NumRotations; ++Rotation)
+			{
+				uint8 RowMasks[FPieceShape::BoxSize] = {};
+				for (int32 i = 0; i < 4; ++i)
+				{
+					RowMasks[Body[i][1]] |= uint8(1 << Body[i][0]);
+					FPieceShape::RotatePointR(Body[i][0], Body[i][1], Origins[Piece][0], Origins[Piece][1]);
+				}
+				Table.Shapes[Piece * FPieceShape::NumRotations + Rotation] = FPieceShape::Make(RowMasks, uint8(Piece), uint8(Rotation));
+			}
+		}
+		return Table;
+	}
+};
+
+/* The standard piece shapes.*/
+inline constexpr FStandardPieceShapes GStandardPieceShapes = FStandardPieceShapes::Build();
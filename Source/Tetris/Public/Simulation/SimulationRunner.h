@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/TetrisSimulation.h"
+
+/* Totals over the games run by a simulation runner.*/
+struct FSimulationStats
+{
+	/* The number of board steps taken.*/
+	int64 Ticks{ 0 };
+
+	/* The number of games that reached game over.*/
+	int64 GamesFinished{ 0 };
+
+	/* The lines cleared and score of the finished games.*/
+	int64 LinesCleared{ 0 };
+	int64 Score{ 0 };
+
+	FSimulationStats& operator+=(const FSimulationStats& Other);
+};
+
+/**
+ * Steps many independent games in parallel, without any actor or UObject.
+ *
+ * The boards are split into one chunk per worker. Each chunk owns its games, including their boards, piece sequences
+ * and stats, and is allocated and stepped by the task that works on it, so no state is shared between threads.
+ * Finished games are restarted with the next seed of their board, so a runner can be stepped indefinitely.
+ */
+class TETRIS_API FSimulationRunner
+{
+public:
+	/* The function that chooses the actions of a game before each step. Called concurrently for different boards.*/
+	using FController = TFunctionRef<void(FTetrisSimulation& /* Board */, int32 /* BoardIndex */)>;
+
+	/* Create the given number of games. Board N first plays seed FirstSeed + N. Uses one chunk per core if NumChunks is zero.*/
+	void Initialize(const FTetrisSimulationConfig& Config, int32 NumBoards, int32 FirstSeed, TConstArrayView<FPieceShape> Shapes = {}, int32 NumChunks = 0);
+
+	/* Step every game the given number of times with gravity alone.*/
+	void Step(int32 NumTicks);
+
+	/* Step every game the given number of times, letting the controller act before each step.*/
+	void Step(int32 NumTicks, FController Controller);
+
+	/* Get the number of games.*/
+	int32 GetNumBoards() const;
+
+	/* Get the number of chunks the games are split into.*/
+	int32 GetNumChunks() const;
+
+	/* Get the game at the given index.*/
+	const FTetrisSimulation& GetBoard(int32 BoardIndex) const;
+
+	/* Get the totals over every chunk.*/
+	FSimulationStats GetStats() const;
+
+private:
+	/* The games stepped by a single task.*/
+	struct alignas(PLATFORM_CACHE_LINE_SIZE) FChunk
+	{
+		/* The games of the chunk.*/
+		TArray<FTetrisSimulation> Boards;
+
+		/* The seed each game will be restarted with when it ends.*/
+		TArray<int32> NextSeeds;
+
+		/* The index of the first game of the chunk.*/
+		int32 FirstBoard{ 0 };
+
+		/* The totals over the games of the chunk.*/
+		FSimulationStats Stats;
+
+		/* Step every game of the chunk, restarting the finished ones.*/
+		void Step(int32 NumTicks, int32 SeedStride, const FController* Controller);
+	};
+
+	/* The chunks, allocated separately so they never share a cache line.*/
+	TArray<TUniquePtr<FChunk>> Chunks;
+
+	/* The number of games.*/
+	int32 NumBoards{ 0 };
+
+	/* The number of games in every chunk but the last.*/
+	int32 BoardsPerChunk{ 0 };
+
+	/* Step every chunk in parallel.*/
+	void StepChunks(int32 NumTicks, const FController* Controller);
+};
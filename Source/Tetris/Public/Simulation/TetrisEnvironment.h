@@ -0,0 +1,119 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/SimulationRunner.h"
+
+/**
+ * The buffers the observations of every environment are written to, owned by the caller.
+ * Each holds the observations of all environments back to back, environment 0 first. Empty buffers are skipped.
+ */
+struct FTetrisObservationBuffers
+{
+	/* The occupancy planes, each of GetHeight() rows of GetWidth() cells, bottom row first: the locked stack, then the active piece. 1 is occupied and 0 empty.*/
+	TArrayView<uint8> Planes;
+
+	/* The type, rotation, column and row of the active piece, or INDEX_NONE for each if no piece is in play.*/
+	TArrayView<int32> Pieces;
+
+	/* The types of the upcoming pieces, next piece first. Pieces beyond the queued sequence are MAX_uint8.*/
+	TArrayView<uint8> Preview;
+
+	/* The height of each column.*/
+	TArrayView<uint8> ColumnHeights;
+};
+
+/**
+ * A vectorized environment for training policies: many independent games, reset and stepped together.
+ *
+ * Each step applies one action to every game and then ticks it, and reports the score it gained as the reward and whether
+ * it ended as done. Games that end are restarted at once with the next seed of their environment, so the observation
+ * reported with done is the first of the next game. Environment N restarts with its seed plus N times the number of
+ * environments, as in FSimulationRunner.
+ *
+ * The games are split into chunks that are stepped in parallel and own their games, as in FSimulationRunner. Observations
+ * are written straight into the caller's buffers by the task that stepped the game, so stepping allocates nothing of its
+ * own and never touches a UObject.
+ */
+class TETRIS_API FTetrisEnvironment
+{
+public:
+	/* The action that leaves the piece alone for the step. Any greater value does too.*/
+	static constexpr uint8 NoAction = uint8(EAction::HARD_DROP) + 1;
+
+	/* The number of actions, including NoAction.*/
+	static constexpr int32 NumActions = NoAction + 1;
+
+	/* The number of occupancy planes of each observation.*/
+	static constexpr int32 NumPlanes = 2;
+
+	/* The number of values describing the active piece.*/
+	static constexpr int32 NumPieceValues = 4;
+
+	/* Create the environments, each ticked the given number of times per step. Uses one chunk per core if NumChunks is zero.*/
+	void Initialize(const FTetrisSimulationConfig& Config, int32 NumEnvironments, int32 NumPreviewPieces = 5, int32 TicksPerStep = 1, TConstArrayView<FPieceShape> Shapes = {}, int32 NumChunks = 0);
+
+	/* Start a new game in every environment with the given seeds and write their first observations. Return false if a buffer has the wrong size.*/
+	bool Reset(TConstArrayView<int32> Seeds, const FTetrisObservationBuffers& OutObservations);
+
+	/* Apply one action to every environment and tick it, then write the observations, rewards and done flags. Return false if a buffer has the wrong size.*/
+	bool Step(TConstArrayView<uint8> Actions, const FTetrisObservationBuffers& OutObservations, TArrayView<float> OutRewards, TArrayView<uint8> OutDones);
+
+	/* Get the number of environments.*/
+	int32 GetNumEnvironments() const;
+
+	/* Get the number of chunks the environments are split into.*/
+	int32 GetNumChunks() const;
+
+	/* Get the dimensions of the occupancy planes, including the rows above the playfield where pieces spawn.*/
+	int32 GetWidth() const;
+	int32 GetHeight() const;
+
+	/* Get the number of upcoming pieces observed.*/
+	int32 GetNumPreviewPieces() const;
+
+	/* Get the number of elements of each buffer per environment.*/
+	int32 GetPlanesSize() const;
+	int32 GetPreviewSize() const;
+	int32 GetColumnHeightsSize() const;
+
+	/* Get the game of the environment at the given index.*/
+	const FTetrisSimulation& GetEnvironment(int32 Index) const;
+
+	/* Get the totals over every chunk. Only finished games are counted.*/
+	FSimulationStats GetStats() const;
+
+private:
+	/* The games stepped by a single task.*/
+	struct alignas(PLATFORM_CACHE_LINE_SIZE) FChunk
+	{
+		/* The games of the chunk.*/
+		TArray<FTetrisSimulation> Games;
+
+		/* The seed each game will be restarted with when it ends.*/
+		TArray<int32> NextSeeds;
+
+		/* The index of the first environment of the chunk.*/
+		int32 FirstEnvironment{ 0 };
+
+		/* The totals over the games of the chunk.*/
+		FSimulationStats Stats;
+	};
+
+	/* The chunks, allocated separately so they never share a cache line.*/
+	TArray<TUniquePtr<FChunk>> Chunks;
+
+	int32 NumEnvironments{ 0 };
+	int32 EnvironmentsPerChunk{ 0 };
+	int32 NumPreviewPieces{ 0 };
+	int32 TicksPerStep{ 1 };
+	int32 Width{ 0 };
+	int32 Height{ 0 };
+
+	/* Check that every buffer that isn't empty holds the observations of every environment.*/
+	bool ValidateObservations(const FTetrisObservationBuffers& Observations) const;
+
+	/* Write the observation of a game to the buffers.*/
+	void WriteObservation(const FTetrisSimulation& Game, int32 Index, const FTetrisObservationBuffers& OutObservations) const;
+};
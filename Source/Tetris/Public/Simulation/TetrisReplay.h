@@ -0,0 +1,257 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/TetrisSimulation.h"
+
+/**
+ * The fixed header at the start of a replay log.
+ *
+ * The header holds everything needed to rebuild the game: the configuration, the seed of the piece sequence and a
+ * checksum of the shape table. It is followed by a stream of variable length records, see ETetrisReplayRecord.
+ */
+struct FTetrisReplayHeader
+{
+	/* The bytes "TRPL" read as a little-endian integer.*/
+	static constexpr uint32 Magic = 'T' | ('R' << 8) | ('P' << 16) | ('L' << 24);
+
+	/* The version written by this build. Logs of other versions are rejected.*/
+	static constexpr uint16 CurrentVersion = 2;
+
+	/* The most rows, top space included, a replay may describe. Taller headers are taken as corrupt.*/
+	static constexpr int32 MaxRows = 1024;
+
+	uint32 FileMagic;
+	uint16 Version;
+	uint16 HeaderSize;
+	int32 Width;
+	int32 Height;
+	int32 TopSpace;
+	int32 TicksPerSecond;
+	int32 CollapseDelayTicks;
+	float Gravity;
+	int32 Seed;
+	uint32 ShapeTableCrc;
+	int32 NumShapes;
+};
+
+/**
+ * The kinds of record in a replay log.
+ *
+ * Each record starts with one byte holding the kind in its low two bits, followed by the number of steps since the
+ * previous record as a variable length integer. Actions store the action in the upper bits of the first byte, locks
+ * add the piece type, rotation, coordinate and lines cleared, and the end record adds the final score and lines.
+ */
+enum class ETetrisReplayRecord : uint8
+{
+	/* An action applied to the piece in play. Actions are the only input of a game.*/
+	Action,
+	/* A piece locked. Used to find where a playback diverges.*/
+	Lock,
+	/* The board collapsed. Collapses before the delay runs out are applied during playback.*/
+	Collapse,
+	/* The game ended or recording stopped.*/
+	End,
+};
+
+/* One decoded record of a replay log.*/
+struct FTetrisReplayEntry
+{
+	ETetrisReplayRecord Type{ ETetrisReplayRecord::End };
+
+	/* The number of simulation steps taken before the record.*/
+	int64 Step{ 0 };
+
+	/* The applied action.*/
+	EAction Action{ EAction::DOWN };
+
+	/* The locked piece, its placement and the number of lines it cleared.*/
+	uint8 PieceType{ 0 };
+	uint8 Rotation{ 0 };
+	FIntPoint Coordinate{ 0, 0 };
+	int32 NumLines{ 0 };
+
+	/* The final metrics of the game.*/
+	int32 Score{ 0 };
+	int32 LinesCleared{ 0 };
+};
+
+/* Decodes a replay log in place, one record at a time.*/
+struct TETRIS_API FTetrisReplayReader
+{
+public:
+	/* Start reading the log. Return false if the header is missing or of another version.*/
+	bool Initialize(TConstArrayView<uint8> InData);
+
+	/* Get the header of the log.*/
+	const FTetrisReplayHeader& GetHeader() const;
+
+	/* Decode the next record. Return false at the end of the log or if the record is truncated.*/
+	bool Next(FTetrisReplayEntry& OutEntry);
+
+	/* Return true if every byte of the log has been read.*/
+	bool IsAtEnd() const;
+
+	/* Compute the checksum of a shape table stored in the header.*/
+	static uint32 GetShapeTableCrc(TConstArrayView<FPieceShape> Shapes);
+
+private:
+	/* The log being read.*/
+	TConstArrayView<uint8> Data;
+
+	/* The header of the log.*/
+	FTetrisReplayHeader Header{};
+
+	/* The offset of the next record.*/
+	int32 Offset{ 0 };
+
+	/* The step of the last record read.*/
+	int64 Step{ 0 };
+
+	/* Read a variable length integer.*/
+	bool ReadVarInt(uint64& OutValue);
+};
+
+/**
+ * Records a game into a replay log as it is played.
+ *
+ * The recorder observes the simulation, so every action applied to a piece in play is logged with the step it happened
+ * on, whoever applied it. Logs are either kept in memory or streamed to a file from a background thread, so that the
+ * game thread never waits on the disk.
+ */
+class TETRIS_API FTetrisReplayRecorder : public ITetrisSimulationObserver
+{
+public:
+	FTetrisReplayRecorder();
+	virtual ~FTetrisReplayRecorder() override;
+
+	/* Start recording a game into memory. The game must have been reset and not yet started.*/
+	bool Begin(FTetrisSimulation& InSimulation);
+
+	/* Start recording a game into the file, written from a background thread. The game must have been reset and not yet started.*/
+	bool Begin(FTetrisSimulation& InSimulation, const FString& Filename);
+
+	/* Log the final metrics and stop observing the game. The file is written in the background unless told to wait for it.*/
+	void Finish(bool bWaitForWriter = true);
+
+	/* Return true while a game is being recorded.*/
+	bool IsRecording() const;
+
+	/* Get the log of the last game recorded into memory.*/
+	TConstArrayView<uint8> GetRecording() const;
+
+	/*** ITetrisSimulationObserver overrides ***/
+	virtual void OnAction(const FTetrisSimulation& InSimulation, EAction Action) override;
+	virtual void OnLock(const FTetrisSimulation& InSimulation, const FPieceShape& Piece, const FIntPoint& Coordinate, int32 NumLines) override;
+	virtual void OnCollapse(const FTetrisSimulation& InSimulation) override;
+
+private:
+	/* The number of bytes buffered before they are handed to the writer.*/
+	static constexpr int32 ChunkSize = 4096;
+
+	/* The game being recorded.*/
+	FTetrisSimulation* Simulation{ nullptr };
+
+	/* The bytes not yet handed to the writer, or the whole log when recording into memory.*/
+	TArray<uint8> Buffer;
+
+	/* The step of the last record.*/
+	int64 LastStep{ 0 };
+
+	/* The background writer, or null when recording into memory.*/
+	TUniquePtr<class FTetrisReplayWriter> Writer;
+
+	/* The writer of the last recording, still closing its file.*/
+	TUniquePtr<class FTetrisReplayWriter> RetiredWriter;
+
+	/* Write the header of the game.*/
+	bool BeginRecording(FTetrisSimulation& InSimulation);
+
+	/* Write the first byte and the step of a record.*/
+	void WriteRecord(ETetrisReplayRecord Type, uint8 Payload = 0);
+
+	/* Hand the buffer to the writer once it holds a chunk.*/
+	void FlushChunk(bool bForce);
+};
+
+/* The state of a replay playback.*/
+enum class ETetrisReplayResult : uint8
+{
+	/* The playback hasn't reached the end of the log.*/
+	Playing,
+	/* The playback reached the end of the log with the recorded score and lines.*/
+	Verified,
+	/* The game played differently from the recording.*/
+	Diverged,
+	/* The log could not be read.*/
+	Invalid,
+};
+
+/**
+ * Plays a replay log back through a simulation.
+ *
+ * The game is rebuilt from the header and the recorded actions are applied on their steps. Locks and collapses are
+ * checked against the log as they happen, and the final score and lines against the end record. Playback can be
+ * advanced a few steps per frame to watch it at any speed, or run to the end unthrottled.
+ */
+class TETRIS_API FTetrisReplayPlayer : public ITetrisSimulationObserver
+{
+public:
+	virtual ~FTetrisReplayPlayer() override;
+
+	/* Start playing the log into the game. The shape table must be the one the game was recorded with, and must outlive the playback.*/
+	bool Begin(FTetrisSimulation& InSimulation, TArray<uint8>&& InReplay, TConstArrayView<FPieceShape> Shapes = {});
+
+	/* Load the log from a file and start playing it into the game.*/
+	bool Begin(FTetrisSimulation& InSimulation, const FString& Filename, TConstArrayView<FPieceShape> Shapes = {});
+
+	/* Take up to the given number of simulation steps, applying the recorded actions. Return the state of the playback.*/
+	ETetrisReplayResult Advance(int64 NumSteps);
+
+	/* Play the rest of the log as fast as possible.*/
+	ETetrisReplayResult PlayToEnd();
+
+	/* Stop the playback and stop observing the game.*/
+	void Stop();
+
+	/* Get the state of the playback.*/
+	ETetrisReplayResult GetResult() const;
+
+	/* Get a description of why the playback failed.*/
+	const FString& GetError() const;
+
+	/* Get the header of the log being played.*/
+	const FTetrisReplayHeader& GetHeader() const;
+
+	/*** ITetrisSimulationObserver overrides ***/
+	virtual void OnLock(const FTetrisSimulation& InSimulation, const FPieceShape& Piece, const FIntPoint& Coordinate, int32 NumLines) override;
+	virtual void OnCollapse(const FTetrisSimulation& InSimulation) override;
+
+private:
+	/* The game being played.*/
+	FTetrisSimulation* Simulation{ nullptr };
+
+	/* The log being played.*/
+	TArray<uint8> Replay;
+
+	/* The reader of the log.*/
+	FTetrisReplayReader Reader;
+
+	/* The next record to play, valid if bHasEntry is set.*/
+	FTetrisReplayEntry Entry;
+	bool bHasEntry{ false };
+
+	/* The state of the playback.*/
+	ETetrisReplayResult Result{ ETetrisReplayResult::Invalid };
+	FString Error;
+
+	/* Apply the records due on the current step.*/
+	void PlayDueRecords();
+
+	/* Read the next record, failing if the log ends without an end record.*/
+	void ReadEntry();
+
+	/* End the playback with the given result.*/
+	void Finish(ETetrisReplayResult InResult, const FString& InError = FString());
+};
@@ -0,0 +1,254 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoardState.h"
+#include "PieceSequence.h"
+#include "PieceShape.h"
+#include "Core/TetrisActions.h"
+
+/* The dimensions and timing of a simulated game.*/
+struct FTetrisSimulationConfig
+{
+	/* The width of the board in blocks.*/
+	int32 Width{ 10 };
+
+	/* The height of the board playspace in blocks.*/
+	int32 Height{ 20 };
+
+	/* The extra height for spawning pieces.*/
+	int32 TopSpace{ 4 };
+
+	/* The number of simulation steps per second of game time.*/
+	int32 TicksPerSecond{ 60 };
+
+	/* The number of steps between clearing rows and collapsing the board.*/
+	int32 CollapseDelayTicks{ 60 };
+
+	/* The gravity in rows per step, overriding the level curve when positive. 20 drops pieces instantly (20G).
+	There is no lock delay at any gravity: a landed piece locks on the next due drop, which at 20G is the very next step.*/
+	float Gravity{ 0.f };
+};
+
+/* The phase of a simulated game.*/
+enum class ETetrisPhase : uint8
+{
+	/* The game hasn't started.*/
+	Idle,
+	/* A piece is falling.*/
+	Falling,
+	/* Rows have been cleared and the board is waiting to collapse.*/
+	Clearing,
+	/* A piece could not be spawned.*/
+	GameOver,
+};
+
+/* The things that happened in a simulated game since the events were last consumed.*/
+enum class ETetrisEvents : uint8
+{
+	None			= 0,
+	/* The active piece moved or rotated.*/
+	PieceMoved		= 1 << 0,
+	/* A new piece entered play.*/
+	PieceSpawned	= 1 << 1,
+	/* The locked stack changed.*/
+	StackChanged	= 1 << 2,
+	/* Rows were cleared.*/
+	LinesCleared	= 1 << 3,
+	/* A piece finished locking, including any clear and collapse.*/
+	LockComplete	= 1 << 4,
+	/* The game ended.*/
+	GameOver		= 1 << 5,
+};
+ENUM_CLASS_FLAGS(ETetrisEvents);
+
+struct FTetrisSimulation;
+
+/**
+ * Receives the inputs and outcomes of a simulated game as they happen, e.g. to record or verify it.
+ * Calls are made from inside the simulation, so observers must not modify it.
+ */
+class TETRIS_API ITetrisSimulationObserver
+{
+public:
+	virtual ~ITetrisSimulationObserver() = default;
+
+	/* Called before an action is applied to a piece in play.*/
+	virtual void OnAction(const FTetrisSimulation& Simulation, EAction Action) {}
+
+	/* Called when a piece has been placed on the stack and any filled rows cleared.*/
+	virtual void OnLock(const FTetrisSimulation& Simulation, const FPieceShape& Piece, const FIntPoint& Coordinate, int32 NumLines) {}
+
+	/* Called when the board collapses after a clear.*/
+	virtual void OnCollapse(const FTetrisSimulation& Simulation) {}
+};
+
+/**
+ * A headless game of Tetris, stepped by explicit ticks.
+ *
+ * Owns the board, the piece sequence, the score and the lock/clear/collapse state machine. Nothing here depends on a
+ * world or a UObject, so games can be run faster than real time and on any thread. Anything that presents the game
+ * should drive it with Tick and ApplyAction and react to ConsumeEvents.
+ */
+struct TETRIS_API FTetrisSimulation
+{
+public:
+	/* Set the dimensions, timing and shape table of the game. The standard pieces are used if the table is empty.*/
+	void Initialize(const FTetrisSimulationConfig& InConfig, TConstArrayView<FPieceShape> InShapes = {});
+
+	/* Empty the board, reset the metrics and restart the piece sequence from the given seed.*/
+	void Reset(int32 Seed);
+
+	/* Start the game by spawning the first piece.*/
+	void Start();
+
+	/* Advance the game by one fixed step.*/
+	void Tick();
+
+	/* Move the active piece according to the action, locking it if it can't move down. Return true if the piece moved.*/
+	bool ApplyAction(EAction Action);
+
+	/* Apply a sequence of actions in order, continuing with the next piece if one locks. Actions after a lock that clears rows
+	are ignored while the board waits to collapse, as there is no piece to move. Return the number that moved a piece.*/
+	int32 ApplyActions(TConstArrayView<EAction> Actions);
+
+	/* Spawn the next piece at the top of the board, ending the game if it doesn't fit.*/
+	void SpawnPiece();
+
+	/* Collapse the cleared rows without waiting for the collapse delay.*/
+	void Collapse();
+
+	/* Get and clear the events raised since the last call.*/
+	ETetrisEvents ConsumeEvents();
+
+	/* Get the configuration of the game.*/
+	const FTetrisSimulationConfig& GetConfig() const;
+
+	/* Get the locked stack.*/
+	const FBoardState& GetBoard() const;
+
+	/* Get the sequence of upcoming pieces.*/
+	const FPieceSequence& GetSequence() const;
+
+	/* Get the shape table of the pieces.*/
+	TConstArrayView<FPieceShape> GetShapeTable() const;
+
+	/* Get the rows cleared by the last lock.*/
+	TConstArrayView<int32> GetClearedRows() const;
+
+	/* Get the active piece, or null if there is none.*/
+	const FPieceShape* GetCurrentPiece() const;
+
+	/* Get the position of the origin of the active piece's local frame in board space.*/
+	const FIntPoint& GetCurrentCoordinate() const;
+
+	/* Get the position where the active piece would land if dropped.*/
+	FIntPoint GetGhostCoordinate() const;
+
+	/* Get the position new pieces spawn at.*/
+	FIntPoint GetSpawnCoordinate() const;
+
+	/* Get the phase of the game.*/
+	ETetrisPhase GetPhase() const;
+
+	/* Return true if the game has ended.*/
+	bool IsGameOver() const;
+
+	/* Get the score.*/
+	int32 GetScore() const;
+
+	/* Get the number of lines cleared.*/
+	int32 GetLinesCleared() const;
+
+	/* Get the current level.*/
+	int32 GetLevel() const;
+
+	/* Get the number of line clears needed for the next level.*/
+	int32 GetLinesNextLevel() const;
+
+	/* Get the time in seconds between gravity drops.*/
+	float GetTickDelta() const;
+
+	/* Get the gravity as a number of rows per number of steps, both in 16.16 fixed point. Whichever side is the whole
+	number is kept exact, so a level that drops a row every N steps drops on exactly every Nth step.*/
+	void GetGravity(int32& OutRows, int32& OutSteps) const;
+
+	/* One row of gravity in 16.16 fixed point.*/
+	static constexpr int32 GravityOne = 1 << 16;
+
+	/* Get the number of steps the game has been in progress, from its first piece and including the steps spent clearing rows.*/
+	int64 GetElapsedTicks() const;
+
+	/* Get the time in seconds the game has been in progress.*/
+	int32 GetElapsedSeconds() const;
+
+	/* Get the number of times the game has been ticked since it was reset, in every phase.*/
+	int64 GetStepCount() const;
+
+	/* Set the observer notified of actions, locks and collapses, or null to stop notifying. The observer must outlive its use.*/
+	void SetObserver(ITetrisSimulationObserver* InObserver);
+
+	/* Get the observer, or null if there is none.*/
+	ITetrisSimulationObserver* GetObserver() const;
+
+private:
+	/* Snapshots save and restore the complete state of the game.*/
+	friend struct FTetrisSnapshot;
+
+	/* The dimensions and timing of the game.*/
+	FTetrisSimulationConfig Config;
+
+	/* The locked stack.*/
+	FBoardState Board;
+
+	/* The sequence of upcoming pieces.*/
+	FPieceSequence Sequence;
+
+	/* The shape table in use, with the rotations of each piece stored contiguously.*/
+	TConstArrayView<FPieceShape> Shapes;
+
+	/* The active piece.*/
+	const FPieceShape* CurrentPiece{ nullptr };
+
+	/* The position of the origin of the active piece's local frame in board space (can be negative).*/
+	FIntPoint CurrentCoordinate{ 0, 0 };
+
+	/* The phase of the game.*/
+	ETetrisPhase Phase{ ETetrisPhase::Idle };
+
+	/* The events raised since they were last consumed.*/
+	ETetrisEvents PendingEvents{ ETetrisEvents::None };
+
+	/* The metrics of the game.*/
+	int32 Score{ 0 };
+	int32 LinesCleared{ 0 };
+	int64 ElapsedTicks{ 0 };
+	int64 StepCount{ 0 };
+
+	/* The observer of the game, kept across resets.*/
+	ITetrisSimulationObserver* Observer{ nullptr };
+
+	/* The gravity accumulated since the last drop, in the 16.16 fixed point rows of GetGravity. Fixed point keeps the drops
+	identical on every platform.*/
+	int32 GravityAccumulator{ 0 };
+
+	/* Apply the drops that are due after the given 16.16 fixed point steps per drop, moving the piece at most to its landing
+	row in one step.*/
+	void ApplyGravity(int32 StepsPerRow);
+
+	/* The steps remaining until the board collapses.*/
+	int32 CollapseCounter{ 0 };
+
+	/* The rows cleared by the last lock, kept to avoid reallocating on every lock.*/
+	TArray<int32> ClearedRows;
+
+	/* Lock the active piece into the stack and clear any filled rows.*/
+	void LockPiece();
+
+	/* Finish the lock procedure and continue play, unless the stack has topped out.*/
+	void CompleteLock();
+
+	/* Update the score given the number of cleared lines.*/
+	void UpdateScore(int32 NumLines);
+};
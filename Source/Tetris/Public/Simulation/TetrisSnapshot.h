@@ -0,0 +1,152 @@
+// Copyright (C) 2024 Peter Carsten Collins
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PieceSequence.h"
+#include "Simulation/TetrisSimulation.h"
+
+/**
+ * The fixed part of a saved game, followed by the occupancy of the board packed into 64-bit words.
+ *
+ * The grid stores Width bits per row from the bottom row up, with cell (X, Y) at bit Y * Width + X. Snapshots are
+ * padded to 8 bytes, so a file of snapshots can be mapped into memory and read in place.
+ */
+struct FTetrisSnapshotHeader
+{
+	/* The bytes "TSNP" read as a little-endian integer.*/
+	static constexpr uint32 Magic = 'T' | ('S' << 8) | ('N' << 16) | ('P' << 24);
+
+	/* The version written by this build. Snapshots of other versions are rejected.*/
+	static constexpr uint16 CurrentVersion = 2;
+
+	/* The value of PieceType when there is no piece in play.*/
+	static constexpr uint8 NoPiece = 0xFF;
+
+	uint32 FileMagic;
+	uint16 Version;
+
+	/* The size of the snapshot in bytes, including the grid.*/
+	uint16 Size;
+
+	/* The configuration of the game.*/
+	uint8 Width;
+	uint8 Height;
+	uint8 TopSpace;
+	uint8 NumPieces;
+	uint16 TicksPerSecond;
+	uint16 CollapseDelayTicks;
+	float Gravity;
+	uint32 ShapeTableCrc;
+
+	/* The active piece and its placement.*/
+	uint8 Phase;
+	uint8 PieceType;
+	uint8 Rotation;
+	uint8 Reserved0;
+	int16 X;
+	int16 Y;
+
+	/* The steps remaining until a clear collapses.*/
+	uint16 CollapseCounter;
+
+	/* The level, derived from the lines cleared and stored for readers of the snapshot.*/
+	uint16 Level;
+
+	/* The metrics of the game.*/
+	int32 Score;
+	int32 LinesCleared;
+	int32 GravityAccumulator;
+	int64 ElapsedTicks;
+	int64 StepCount;
+
+	/* The rows cleared by the last lock, with bit N set for row N.*/
+	uint64 ClearedRows;
+
+	/* The upcoming pieces and the random state of the sequence.*/
+	FPieceSequenceState Sequence;
+	uint8 Reserved1[4];
+};
+
+/**
+ * A read-only view of a snapshot in memory, e.g. in a mapped file. Nothing is copied until the snapshot is restored.
+ */
+struct TETRIS_API FTetrisSnapshotView
+{
+public:
+	FTetrisSnapshotView() = default;
+
+	/* View the snapshot at the start of the data. Check IsValid before reading it.*/
+	explicit FTetrisSnapshotView(TConstArrayView<uint8> InData);
+
+	/* Return true if the data holds a complete snapshot of the current version.*/
+	bool IsValid() const;
+
+	/* Get the fixed part of the snapshot.*/
+	const FTetrisSnapshotHeader& GetHeader() const;
+
+	/* Get the occupancy mask of a row of the saved board.*/
+	uint32 GetRowMask(int32 Row) const;
+
+	/* Get the number of rows of the saved board.*/
+	int32 GetNumRows() const;
+
+private:
+	/* The viewed bytes.*/
+	TConstArrayView<uint8> Data;
+};
+
+/**
+ * Saves and restores the complete state of a simulated game.
+ *
+ * A snapshot holds the board, the active piece, the piece sequence with its random state, the metrics and the lock
+ * state machine, so a restored game plays on exactly as the saved one would have.
+ */
+struct TETRIS_API FTetrisSnapshot
+{
+public:
+	/* Get the size in bytes of a snapshot of a game with the given configuration.*/
+	static int32 GetSize(const FTetrisSimulationConfig& Config);
+
+	/* Write a snapshot of the game into the buffer, which must hold GetSize bytes. Return the number of bytes written, or 0 if the game can't be saved.*/
+	static int32 Write(const FTetrisSimulation& Simulation, TArrayView<uint8> OutData);
+
+	/* Append a snapshot of the game to the array.*/
+	static bool Save(const FTetrisSimulation& Simulation, TArray<uint8>& OutData);
+
+	/* Restore a game from a snapshot. The shape table must be the one the game was saved with, and must outlive the game.*/
+	static bool Restore(FTetrisSimulation& Simulation, const FTetrisSnapshotView& Snapshot, TConstArrayView<FPieceShape> Shapes = {});
+};
+
+/**
+ * A file of snapshots of the same size, mapped into memory so that snapshots are read in place.
+ */
+class TETRIS_API FTetrisSnapshotFile
+{
+public:
+	FTetrisSnapshotFile();
+	~FTetrisSnapshotFile();
+
+	/* Map the file. Return false if it can't be mapped or doesn't start with a valid snapshot.*/
+	bool Open(const FString& Filename);
+
+	/* Unmap the file.*/
+	void Close();
+
+	/* Get the number of snapshots in the file.*/
+	int32 Num() const;
+
+	/* Get a view of a snapshot in the file.*/
+	FTetrisSnapshotView Get(int32 Index) const;
+
+private:
+	/* The mapped file and region, released in reverse order.*/
+	TUniquePtr<class IMappedFileHandle> Handle;
+	TUniquePtr<class IMappedFileRegion> Region;
+
+	/* The size of each snapshot.*/
+	int32 Stride{ 0 };
+
+	/* The number of snapshots.*/
+	int32 NumSnapshots{ 0 };
+};
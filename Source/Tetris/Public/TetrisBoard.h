@@ -3,8 +3,12 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "AI/TetrisAIController.h"
 #include "Core/TetrisDelegates.h"
+#include "Core/TetrisActions.h"
 #include "GameFramework/Actor.h"
+#include "Simulation/TetrisSimulation.h"
+#include "Simulation/TetrisReplay.h"
 #include "TetrisBoard.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnRowsClearedSignature);
@@ -12,21 +16,10 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnLinesClearedSignature);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnLockCompleteSignature);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnGameOverSignature);
 
-/* Board actions.*/
-UENUM(BlueprintType)
-enum EAction
-{
-	LEFT,
-	RIGHT,
-	DOWN,
-	ROTATE_R,
-	ROTATE_L,
-};
-
 /*
 * The in-game representation of the Tetris board.
 * 
-* Responsible for rendering and modifying internal board state.
+* Presents a headless FTetrisSimulation: steps it at a fixed rate from Tick, draws its state and forwards its events.
 */
 UCLASS(Blueprintable)
 class TETRIS_API ATetrisBoard : public AActor
@@ -37,11 +30,19 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Blocks")
 	UInstancedStaticMeshComponent* BlockMesh;
 
+	/* Static meshes for the blocks of the active piece. Uses the block mesh if not set.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Blocks")
+	UInstancedStaticMeshComponent* ActivePieceMesh;
+
+	/* Static meshes for the blocks of the ghost piece. Uses the block mesh if not set.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Blocks")
+	UInstancedStaticMeshComponent* GhostPieceMesh;
+
 	/* Static mesh for the background. Assumed to have unit extent.*/
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Background")
 	UStaticMeshComponent* BackgroundMesh;
 
-	/* The queue of tetris pieces.*/
+	/* The pieces of the game, and the preview of the upcoming pieces the simulation plays.*/
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Blocks")
 	class UPieceQueue* PieceQueue;
 	
@@ -65,42 +66,41 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
 	void Update(EAction Action);
 
-	/* Draw the board to reflect the internal board data.*/
+	/* Update the board according to a sequence of actions, then draw and notify once for all of them.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
+	void UpdateBatch(const TArray<TEnumAsByte<EAction>>& Actions);
+
+	/* Update the board according to a sequence of actions, then draw and notify once for all of them.*/
+	void ApplyActions(TConstArrayView<EAction> Actions);
+
+	/* Buffer an action to be applied with the rest of this frame's actions before the next simulation step.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
+	void QueueAction(EAction Action);
+
+	/* Draw the locked stack to reflect the internal board data. Only the blocks that changed since the last draw are updated.*/
 	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
 	void Draw();
 
-	/* Stop board updates.*/
+	/* Draw the active piece and its ghost.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
+	void DrawActivePiece();
+
+	/* Stop stepping the simulation.*/
 	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Timer")
 	void StopPlay();
 
-	/* Resume board updates.*/
+	/* Resume stepping the simulation.*/
 	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Timer")
 	void ResumePlay();
 
-	/* Handler for updating the board on tick.*/
-	UFUNCTION()
-	void HandleTick();
-
 	/* The elapsed time for this game.*/
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Tetris Board | Timer")
 	int32 ElapsedTime;
 
-	/* Handler for game timer tick logic.*/
-	UFUNCTION()
-	void HandleGameTimerTick();
-
 	/* Add a piece to the top of the board.*/
 	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
 	void AddPiece();
 
-	/* Logic executed when a piece has been locked.*/
-	UFUNCTION()
-	void HandleOnPieceLocked();
-
-	/* Logic executed for clearing rows.*/
-	UFUNCTION()
-	void ClearRows();
-
 	/* Collapse empty rows in the board.*/
 	UFUNCTION(BlueprintCallable, Category = "Tetris Board")
 	void Collapse();
@@ -142,14 +142,41 @@ public:
 	UPROPERTY(BlueprintCallable, BlueprintAssignable, Category = "Tetris Board")
 	FOnGameOverSignature OnGameOver;
 
-	/* Event handler to run after piece locking is complete.*/
-	UFUNCTION()
-	void HandleOnLockComplete();
+	/* Get the simulation presented by this board.*/
+	const FTetrisSimulation& GetSimulation() const;
+
+	/* Play a recorded game back on the board, at the given multiple of real time. Plays to the end at once if the speed isn't positive.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Replay")
+	bool PlayReplay(const FString& Filename, float PlaybackSpeed = 1.f);
+
+	/* Stop playing a recorded game.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Replay")
+	void StopReplay();
+
+	/* Check if a recorded game is being played.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Replay")
+	bool IsReplaying() const;
+
+	/* Get a description of why the last recorded game failed to play back, or an empty string if it didn't fail.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Replay")
+	FString GetReplayError() const;
+
+	/* Save the game on the board to a snapshot file.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Snapshot")
+	bool SaveSnapshot(const FString& Filename) const;
+
+	/* Restore a game saved with SaveSnapshot and resume playing it. The board must have the size it was saved with.*/
+	UFUNCTION(BlueprintCallable, Category = "Tetris Board | Snapshot")
+	bool LoadSnapshot(const FString& Filename);
 
 protected:
-	/* The internal board data.*/
-	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Tetris Board")
-	class UInternalBoard* InternalBoard;
+	/* The game presented by this board.*/
+	FTetrisSimulation Simulation;
+
+	/* The board the Blueprint created before the game moved into the simulation. Nothing reads it, but BP_TetrisBoard and
+	M_Tetris still set it, so it is kept until they are migrated.*/
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Tetris Board", meta = (DeprecatedProperty, DeprecationMessage = "The board state is owned by the simulation."))
+	class UInternalBoard* InternalBoard{ nullptr };
 
 	/* Flag to enable debug visuals during gameplay.*/
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board")
@@ -159,12 +186,82 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Timer")
 	float TickSpeed{ 1.f };
 
-	/* The timer for board updates.*/
-	FTimerHandle UpdateTimer;
+	/* The number of simulation steps per second.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | Timer", meta = (ClampMin = 1))
+	int32 TicksPerSecond{ 60 };
+
+	/* The gravity in rows per step, overriding the level curve when positive. 20 drops pieces instantly (20G).*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | Timer", meta = (ClampMin = 0))
+	float Gravity{ 0.f };
+
+	/* The most simulation steps taken in one frame. Time beyond this is dropped so that a long frame can't stall the game.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | Timer", meta = (ClampMin = 1))
+	int32 MaxStepsPerFrame{ 30 };
+
+	/* The time in seconds between clearing rows and collapsing the board.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | Timer", meta = (ClampMin = 0))
+	float CollapseDelay{ 1.f };
+
+	/* Flag set while the simulation is stepped.*/
+	bool bIsPlaying{ false };
+
+	/* The frame time not yet consumed by simulation steps.*/
+	double StepAccumulator{ 0.0 };
 
-	/* The timer for game time.*/
-	UPROPERTY(VisibleInstanceOnly, Category = "Tetris Board")
-	FTimerHandle GameTimer;
+	/* The actions buffered since the last frame.*/
+	TArray<EAction> QueuedActions;
+
+	/* Flag to record every game to a replay file.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Replay")
+	bool bRecordReplays{ false };
+
+	/* The directory replays are recorded to. Uses Saved/Replays if empty.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | Replay")
+	FString ReplayDirectory;
+
+	/* The recorder of the game in play.*/
+	FTetrisReplayRecorder ReplayRecorder;
+
+	/* The player of the recorded game being played.*/
+	FTetrisReplayPlayer ReplayPlayer;
+
+	/* The speed of the playback as a multiple of real time.*/
+	float ReplaySpeed{ 1.f };
+
+	/* Flag set while a recorded game is played.*/
+	bool bIsReplaying{ false };
+
+	/* Get the file to record a new game to.*/
+	FString GetReplayFilename() const;
+
+	/* Flag to let the AI play. Its moves are searched on a worker thread and played when they arrive.*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Tetris Board | AI")
+	bool bAIPlays{ false };
+
+	/* The weights the AI values boards with. Uses the default weights if not set.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | AI")
+	UBoardEvaluatorWeights* AIWeights{ nullptr };
+
+	/* The number of boards the AI keeps at each depth of its search.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | AI", meta = (ClampMin = 1))
+	int32 AIBeamWidth{ 32 };
+
+	/* The number of upcoming pieces the AI searches after the current piece.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | AI", meta = (ClampMin = 0))
+	int32 AIPreviewPieces{ 5 };
+
+	/* The longest the AI searches for one piece, in seconds. The search runs beside the game, so it delays the AI's move but never a frame.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | AI", meta = (ClampMin = 0))
+	float AIThinkTime{ 0.1f };
+
+	/* The AI playing the game, created when it first plans.*/
+	TUniquePtr<FTetrisAIController> AIController;
+
+	/* Request a plan from the AI for the piece in play, or cancel the plan in flight if the AI isn't playing it.*/
+	void RequestAIPlan();
+
+	/* Advance the playback by the frame time.*/
+	void TickReplay(float DeltaSeconds);
 
 	/* The width of the board in blocks.*/
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board")
@@ -192,10 +289,42 @@ protected:
 	/* Compute the transform of the block at the given coordinate.*/
 	FTransform GetBlockTransform(const FIntPoint& InCoordinate) const;
 
-	/* The currently active piece.*/
-	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Current Piece")
-	const class UPiece* CurrentPiece;
-	
+	/* Compute the transform of a hidden block at the given coordinate.*/
+	FTransform GetHiddenBlockTransform(const FIntPoint& InCoordinate) const;
+
+	/* Fill the block mesh with one hidden instance per board cell, so that drawing never adds or removes instances.*/
+	void InitializeBlockPool();
+
+	/* The occupancy of each row of the board at the last draw, used to find the blocks that changed.*/
+	TArray<uint32> DrawnRows;
+
+	/* The board width at the last draw. Instance N of the block pool is the cell (N % width, N / width).*/
+	int32 DrawnWidth{ 0 };
+
+	/* Flag to draw the ghost piece where the active piece would land.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | Blocks")
+	bool bShowGhostPiece{ true };
+
+	/* The scale of the ghost piece blocks relative to the board blocks.*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tetris Board | Blocks")
+	float GhostBlockScale{ 0.4f };
+
+	/* The number of visible blocks in the active and ghost piece layers at the last draw.*/
+	int32 DrawnActivePieceBlocks{ 0 };
+	int32 DrawnGhostPieceBlocks{ 0 };
+
+	/* Scratch buffer for piece layer transforms, kept to avoid reallocating on every move.*/
+	TArray<FTransform> PieceLayerTransforms;
+
+	/* Draw a piece into a layer holding one instance per cell of the piece box. Hides the layer if the piece is null.*/
+	void DrawPieceLayer(UInstancedStaticMeshComponent* Layer, int32& DrawnBlocks, const struct FPieceShape* Piece, const FIntPoint& Coordinate, float Scale);
+
+	/* Build the simulation configuration from the board properties.*/
+	FTetrisSimulationConfig GetSimulationConfig() const;
+
+	/* Draw, notify and update the HUD for everything that happened in the simulation since the last call.*/
+	void ProcessSimulationEvents();
+
 	/* The position of the origin of the current piece's local frame in board space (can be negative).*/
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Current Piece")
 	FIntPoint CurrentCoordinate;
@@ -204,14 +333,9 @@ protected:
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, Category = "Tetris Board")
 	int32 Score {0};
 
-	/* Compute the new coordinate according to the given action.*/
-	void ComputeNewCoordinate(FIntPoint& NewCoordinate, EAction Action) const;
-
-	/* Update the score given the IDs of the cleared lines.*/
-	void UpdateScore(int32 NumLines);
-
 	/*** AActor overrides ***/
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 	virtual void Tick(float DeltaSeconds) override;
 };